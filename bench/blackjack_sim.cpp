@@ -0,0 +1,148 @@
+//
+// Copyright (c) 2020 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Estimates the house edge of a set of table rules by
+// playing basic strategy against the dealer, using the
+// shoe and hand of the live tables.
+//
+// Usage: blackjack-sim [--rounds=N] [--threads=N] [--seed=N]
+//                      [--decks=N] [--h17=0|1] [--das=0|1]
+//                      [--surrender=0|1] [--max-hands=N]
+//                      [--payout=3:2|6:5|1:1] [--penetration=F]
+
+#include "blackjack/simulator.hpp"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace {
+
+struct options
+{
+    std::uint64_t rounds = 100000000;
+    unsigned threads = std::thread::hardware_concurrency();
+    std::uint64_t seed = 1;
+    blackjack::rules rules;
+};
+
+bool
+parse_payout(std::string const& s, double& payout)
+{
+    auto const colon = s.find(':');
+    if(colon == std::string::npos)
+        return false;
+    auto const num = std::strtod(s.substr(0, colon).c_str(), nullptr);
+    auto const den = std::strtod(s.substr(colon + 1).c_str(), nullptr);
+    if(num <= 0 || den <= 0)
+        return false;
+    payout = num / den;
+    return true;
+}
+
+bool
+parse_options(
+    int argc,
+    char* argv[],
+    options& opt)
+{
+    auto& r = opt.rules;
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string const arg = argv[i];
+        auto const eq = arg.find('=');
+        if(eq == std::string::npos)
+            return false;
+        auto const name = arg.substr(0, eq);
+        auto const value = arg.substr(eq + 1);
+        auto const n = std::strtoull(value.c_str(), nullptr, 10);
+        if(name == "--rounds")
+            opt.rounds = n;
+        else if(name == "--threads")
+            opt.threads = static_cast<unsigned>(n);
+        else if(name == "--seed")
+            opt.seed = n;
+        else if(name == "--decks")
+            r.decks = static_cast<int>(n);
+        else if(name == "--h17")
+            r.hit_soft_17 = n != 0;
+        else if(name == "--das")
+            r.double_after_split = n != 0;
+        else if(name == "--surrender")
+            r.surrender = n != 0;
+        else if(name == "--max-hands")
+            r.max_hands = static_cast<int>(n);
+        else if(name == "--payout")
+        {
+            if(! parse_payout(value, r.blackjack_payout))
+                return false;
+        }
+        else if(name == "--penetration")
+            r.penetration = std::strtod(value.c_str(), nullptr);
+        else
+            return false;
+    }
+    if(opt.threads < 1)
+        opt.threads = 1;
+    return
+        r.decks >= 1 && r.decks <= 8 &&
+        r.max_hands >= 1 &&
+        r.penetration > 0 && r.penetration < 1;
+}
+
+} // (anon)
+
+int
+main(int argc, char* argv[])
+{
+    options opt;
+    if(! parse_options(argc, argv, opt))
+    {
+        std::cerr <<
+            "Usage: blackjack-sim [--rounds=N] [--threads=N] [--seed=N]\n"
+            "                     [--decks=N] [--h17=0|1] [--das=0|1]\n"
+            "                     [--surrender=0|1] [--max-hands=N]\n"
+            "                     [--payout=3:2|6:5|1:1] [--penetration=F]\n";
+        return EXIT_FAILURE;
+    }
+
+    auto const t0 = std::chrono::steady_clock::now();
+    auto const result = blackjack::simulate(
+        opt.rules, opt.rounds, opt.threads, opt.seed);
+    auto const elapsed = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - t0).count();
+
+    auto const& r = opt.rules;
+    auto const sd = std::sqrt(result.variance());
+    std::printf(
+        "rules        %d decks, %s, %s, %s, payout %.2f, "
+            "%d hands, penetration %.2f\n"
+        "rounds       %llu on %u threads\n"
+        "house edge   %.4f%% +/- %.4f%%\n"
+        "variance     %.4f (sd %.4f)\n"
+        "rate         %.0f rounds/s\n",
+        r.decks,
+        r.hit_soft_17 ? "H17" : "S17",
+        r.double_after_split ? "DAS" : "no DAS",
+        r.surrender ? "LS" : "no LS",
+        r.blackjack_payout,
+        r.max_hands,
+        r.penetration,
+        static_cast<unsigned long long>(result.rounds),
+        opt.threads,
+        100 * result.house_edge(),
+        100 * sd / std::sqrt(
+            static_cast<double>(result.rounds)),
+        result.variance(), sd,
+        result.rounds / elapsed);
+    return EXIT_SUCCESS;
+}
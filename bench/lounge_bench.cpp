@@ -0,0 +1,758 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Puts a running lounge-server under load. Each client opens
+// a WebSocket connection, optionally over TLS, then sends
+// "identify" and "join" the way lounge-chat.js does. Some
+// clients say things in the General room, some ask the
+// Blackjack lobby for a seat and bet at the table they are
+// given, and the rest stay idle.
+//
+// Reported are the connect rate, the round trip time of RPC
+// requests, the time from a "say" being sent until each
+// client receives the broadcast, and the growth of the
+// server's resident set per connection when --pid is given.
+//
+// Loopback only offers about 28000 ephemeral ports for one
+// source and destination address, so --sources spreads the
+// clients over 127.0.0.1, 127.0.0.2, and so on.
+
+#include "core/metrics.hpp"
+#include <boost/beast/core/tcp_stream.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <boost/beast/websocket/ssl.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/ssl/context.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/json/parser.hpp>
+#include <boost/json/value.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+struct options
+{
+    std::string host = "127.0.0.1";
+    std::string port = "8080";
+    std::size_t connections = 1000;
+    std::size_t concurrency = 256;
+    std::size_t threads = 4;
+    std::size_t sources = 1;
+    unsigned say = 10;          // percent of clients which say
+    unsigned blackjack = 10;    // percent of clients which bet
+    std::size_t interval = 1000;// milliseconds between actions
+    std::size_t duration = 30;  // seconds after connecting
+    bool tls = false;
+    int pid = 0;
+};
+
+void
+usage()
+{
+    std::cerr <<
+        "Usage: lounge-bench [options]\n"
+        "  --host=ADDRESS     server address (127.0.0.1)\n"
+        "  --port=PORT        server port (8080)\n"
+        "  --connections=N    number of clients (1000)\n"
+        "  --concurrency=N    connects in progress at once (256)\n"
+        "  --threads=N        client threads (4)\n"
+        "  --sources=N        loopback source addresses to use (1)\n"
+        "  --say=PERCENT      clients which say in General (10)\n"
+        "  --blackjack=PERCENT clients which bet at Blackjack (10)\n"
+        "  --interval=MS      time between actions of a client (1000)\n"
+        "  --duration=SEC     time to run once connected (30)\n"
+        "  --tls              connect using TLS\n"
+        "  --pid=PID          server process, to report its memory\n";
+}
+
+bool
+parse_options(
+    int argc,
+    char* argv[],
+    options& opt)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string const arg = argv[i];
+        auto const eq = arg.find('=');
+        auto const name = arg.substr(0, eq);
+        auto const value = eq == std::string::npos ?
+            std::string() : arg.substr(eq + 1);
+        auto const number =
+            [&value]
+            {
+                return static_cast<std::size_t>(
+                    std::strtoull(value.c_str(), nullptr, 10));
+            };
+        if(name == "--host")
+            opt.host = value;
+        else if(name == "--port")
+            opt.port = value;
+        else if(name == "--connections")
+            opt.connections = number();
+        else if(name == "--concurrency")
+            opt.concurrency = number();
+        else if(name == "--threads")
+            opt.threads = number();
+        else if(name == "--sources")
+            opt.sources = number();
+        else if(name == "--say")
+            opt.say = static_cast<unsigned>(number());
+        else if(name == "--blackjack")
+            opt.blackjack = static_cast<unsigned>(number());
+        else if(name == "--interval")
+            opt.interval = number();
+        else if(name == "--duration")
+            opt.duration = number();
+        else if(name == "--tls")
+            opt.tls = true;
+        else if(name == "--pid")
+            opt.pid = static_cast<int>(number());
+        else
+            return false;
+    }
+    return
+        opt.connections > 0 &&
+        opt.concurrency > 0 &&
+        opt.threads > 0 &&
+        opt.sources > 0 &&
+        opt.sources < 255 &&
+        opt.interval > 0 &&
+        opt.say + opt.blackjack <= 100;
+}
+
+// Returns the resident set of a process in bytes, or zero
+std::uint64_t
+resident_bytes(int pid)
+{
+    if(pid == 0)
+        return 0;
+    std::ifstream is(
+        "/proc/" + std::to_string(pid) + "/status");
+    std::string line;
+    while(std::getline(is, line))
+        if(line.compare(0, 6, "VmRSS:") == 0)
+            return std::strtoull(
+                line.c_str() + 6, nullptr, 10) * 1024;
+    return 0;
+}
+
+// Tens of thousands of sockets need more descriptors
+// than the usual soft limit allows.
+void
+raise_file_limit()
+{
+#ifndef _WIN32
+    rlimit rl;
+    if(::getrlimit(RLIMIT_NOFILE, &rl) == 0)
+    {
+        rl.rlim_cur = rl.rlim_max;
+        ::setrlimit(RLIMIT_NOFILE, &rl);
+    }
+#endif
+}
+
+std::uint64_t
+now_ns()
+{
+    return static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now().time_since_epoch()).count());
+}
+
+//------------------------------------------------------------------------------
+
+// State shared by all clients
+struct shared_state
+{
+    options const& opt;
+    net::ip::tcp::endpoint ep;
+    std::vector<std::unique_ptr<net::io_context>> iocs;
+    net::ssl::context ctx;
+
+    std::atomic<std::size_t> next;
+    std::atomic<std::size_t> connected;
+    std::atomic<std::size_t> failed;
+    std::atomic<std::size_t> closed;
+    std::atomic<std::uint64_t> requests;
+    std::atomic<std::uint64_t> errors;
+    std::atomic<std::uint64_t> broadcasts;
+
+    histogram connect_us;
+    histogram rpc_us;
+    histogram broadcast_us;
+
+    shared_state(
+        options const& opt_,
+        net::ip::tcp::endpoint ep_)
+        : opt(opt_)
+        , ep(ep_)
+        , ctx(net::ssl::context::tlsv12_client)
+        , next(0)
+        , connected(0)
+        , failed(0)
+        , closed(0)
+        , requests(0)
+        , errors(0)
+        , broadcasts(0)
+        , connect_us(log_linear_bounds(60000000, 8))
+        , rpc_us(log_linear_bounds(60000000, 8))
+        , broadcast_us(log_linear_bounds(60000000, 8))
+    {
+        // The server certificate is self-signed
+        ctx.set_verify_mode(net::ssl::verify_none);
+        for(std::size_t i = 0; i < opt.threads; ++i)
+            iocs.emplace_back(new net::io_context(1));
+    }
+};
+
+void
+spawn(shared_state& st);
+
+enum class role
+{
+    idle,
+    say,
+    blackjack
+};
+
+/** One simulated user.
+
+    Each client runs on a single io_context, so no
+    strand is needed. Writes are queued, since a
+    websocket stream allows one at a time.
+*/
+template<class Derived>
+class client
+{
+protected:
+    shared_state& st_;
+    std::size_t const n_;
+    role const role_;
+    net::steady_timer timer_;
+    beast::flat_buffer buffer_;
+    std::deque<std::string> queue_;
+    std::unordered_map<std::int64_t, clock_type::time_point> pending_;
+    clock_type::time_point start_;
+    std::int64_t id_ = 1;
+    std::int64_t seat_id_ = 0;      // the lobby's "play" request
+    std::size_t table_ = 0;         // the table we were seated at
+    bool connected_ = false;
+    bool done_ = false;
+
+    Derived&
+    impl()
+    {
+        return static_cast<Derived&>(*this);
+    }
+
+    // Set up the source address, then connect
+    void
+    open()
+    {
+        auto& sock = beast::get_lowest_layer(
+            impl().ws()).socket();
+        if(st_.opt.sources > 1 && st_.ep.address().is_v4())
+        {
+            beast::error_code ec;
+            auto bytes = st_.ep.address().to_v4().to_bytes();
+            bytes[3] = static_cast<unsigned char>(
+                1 + n_ % st_.opt.sources);
+            sock.open(net::ip::tcp::v4(), ec);
+            if(! ec)
+                sock.bind({net::ip::address_v4(bytes), 0}, ec);
+            if(ec)
+                return fail(ec, "bind");
+        }
+        beast::get_lowest_layer(impl().ws()).async_connect(
+            st_.ep,
+            [this](beast::error_code ec)
+            {
+                if(ec)
+                    return fail(ec, "connect");
+                impl().on_connect();
+            });
+    }
+
+    void
+    do_ws_handshake()
+    {
+        impl().ws().async_handshake(
+            st_.opt.host, "/",
+            [this](beast::error_code ec)
+            {
+                if(ec)
+                    return fail(ec, "handshake");
+                on_handshake();
+            });
+    }
+
+    void
+    fail(beast::error_code ec, char const* what)
+    {
+        if(done_)
+            return;
+        done_ = true;
+        if(! connected_)
+        {
+            if(st_.failed++ == 0)
+                std::cerr << what << ": " << ec.message() << "\n";
+            spawn(st_);
+        }
+        else
+        {
+            ++st_.closed;
+        }
+        // The client is leaked on purpose, the
+        // process exits when the run is over.
+        timer_.cancel();
+    }
+
+private:
+    void
+    on_handshake()
+    {
+        connected_ = true;
+        st_.connect_us.observe(static_cast<std::uint64_t>(
+            std::chrono::duration_cast<std::chrono::microseconds>(
+                clock_type::now() - start_).count()));
+        ++st_.connected;
+        spawn(st_);
+
+        send("identify", "\"cid\":1,\"name\":\"bench" +
+            std::to_string(n_) + "\"");
+        send("join", "\"cid\":2");
+        if(role_ == role::blackjack)
+            seat_id_ = send("play", "\"cid\":3");
+        do_read();
+
+        if(role_ != role::idle)
+        {
+            // Spread the first action over one interval
+            std::minstd_rand g(static_cast<unsigned>(n_));
+            timer_.expires_after(std::chrono::milliseconds(
+                g() % st_.opt.interval));
+            timer_.async_wait(
+                [this](beast::error_code ec)
+                {
+                    on_timer(ec);
+                });
+        }
+    }
+
+    void
+    on_timer(beast::error_code ec)
+    {
+        if(ec)
+            return;
+        if(role_ == role::say)
+            send("say", "\"cid\":2,\"message\":\"t=" +
+                std::to_string(now_ns()) + "\"");
+        else if(table_ != 0)
+            send("bet", "\"cid\":" + std::to_string(table_));
+        timer_.expires_after(std::chrono::milliseconds(
+            st_.opt.interval));
+        timer_.async_wait(
+            [this](beast::error_code ec)
+            {
+                on_timer(ec);
+            });
+    }
+
+    std::int64_t
+    send(char const* method, std::string const& params)
+    {
+        auto const id = id_++;
+        pending_[id] = clock_type::now();
+        ++st_.requests;
+        queue_.emplace_back(
+            "{\"jsonrpc\":\"2.0\",\"method\":\"" +
+            std::string(method) + "\",\"id\":" +
+            std::to_string(id) + ",\"params\":{" +
+            params + "}}");
+        if(queue_.size() == 1)
+            do_write();
+        return id;
+    }
+
+    // The lobby found a table, take a seat there
+    void
+    on_seat(json::object& obj)
+    {
+        auto it = obj.find("result");
+        if(it == obj.end() || ! it->value().is_object())
+            return;
+        auto& result = it->value().as_object();
+        auto const t = result.find("table");
+        if(t == result.end() || ! t->value().is_int64())
+            return;
+        table_ = static_cast<std::size_t>(
+            t->value().as_int64());
+        auto const cid = "\"cid\":" + std::to_string(table_);
+        send("join", cid);
+        send("play", cid);
+    }
+
+    void
+    do_write()
+    {
+        impl().ws().async_write(
+            net::buffer(queue_.front()),
+            [this](beast::error_code ec, std::size_t)
+            {
+                if(ec)
+                    return fail(ec, "write");
+                queue_.pop_front();
+                if(! queue_.empty())
+                    do_write();
+            });
+    }
+
+    void
+    do_read()
+    {
+        impl().ws().async_read(
+            buffer_,
+            [this](beast::error_code ec, std::size_t)
+            {
+                if(ec)
+                    return fail(ec, "read");
+                on_message();
+                buffer_.consume(buffer_.size());
+                do_read();
+            });
+    }
+
+    void
+    on_message()
+    {
+        auto const now = clock_type::now();
+        auto const cb = buffer_.data();
+        beast::error_code ec;
+        json::value jv = json::parse(
+            { static_cast<char const*>(
+                cb.data()), cb.size() }, ec);
+        if(ec || ! jv.is_object())
+            return;
+        auto& obj = jv.as_object();
+
+        // A response to one of our requests
+        auto it = obj.find("id");
+        if(it != obj.end() && it->value().is_int64())
+        {
+            auto p = pending_.find(it->value().as_int64());
+            if(p == pending_.end())
+                return;
+            st_.rpc_us.observe(static_cast<std::uint64_t>(
+                std::chrono::duration_cast<
+                    std::chrono::microseconds>(
+                        now - p->second).count()));
+            pending_.erase(p);
+            if(obj.find("error") != obj.end())
+                ++st_.errors;
+            else if(it->value().as_int64() == seat_id_)
+                on_seat(obj);
+            return;
+        }
+
+        // A broadcast of something a client said
+        it = obj.find("verb");
+        if( it == obj.end() ||
+            ! it->value().is_string() ||
+            it->value().as_string() != "say")
+            return;
+        it = obj.find("message");
+        if( it == obj.end() ||
+            ! it->value().is_string())
+            return;
+        auto const& s = it->value().as_string();
+        if(s.size() < 3 || std::memcmp(s.data(), "t=", 2) != 0)
+            return;
+        auto const sent = std::strtoull(
+            std::string(s.data() + 2, s.size() - 2).c_str(),
+            nullptr, 10);
+        auto const t = now_ns();
+        if(t > sent)
+            st_.broadcast_us.observe((t - sent) / 1000);
+        ++st_.broadcasts;
+    }
+
+public:
+    client(
+        shared_state& st,
+        std::size_t n,
+        role r,
+        net::io_context& ioc)
+        : st_(st)
+        , n_(n)
+        , role_(r)
+        , timer_(ioc)
+        , start_(clock_type::now())
+    {
+    }
+
+    void
+    run()
+    {
+        start_ = clock_type::now();
+        open();
+    }
+};
+
+class plain_client
+    : public client<plain_client>
+{
+    websocket::stream<beast::tcp_stream> ws_;
+
+public:
+    plain_client(
+        shared_state& st,
+        std::size_t n,
+        role r,
+        net::io_context& ioc)
+        : client<plain_client>(st, n, r, ioc)
+        , ws_(ioc)
+    {
+    }
+
+    websocket::stream<beast::tcp_stream>&
+    ws()
+    {
+        return ws_;
+    }
+
+    void
+    on_connect()
+    {
+        do_ws_handshake();
+    }
+};
+
+class ssl_client
+    : public client<ssl_client>
+{
+    websocket::stream<
+        beast::ssl_stream<beast::tcp_stream>> ws_;
+
+public:
+    ssl_client(
+        shared_state& st,
+        std::size_t n,
+        role r,
+        net::io_context& ioc)
+        : client<ssl_client>(st, n, r, ioc)
+        , ws_(ioc, st.ctx)
+    {
+    }
+
+    websocket::stream<
+        beast::ssl_stream<beast::tcp_stream>>&
+    ws()
+    {
+        return ws_;
+    }
+
+    void
+    on_connect()
+    {
+        ws_.next_layer().async_handshake(
+            net::ssl::stream_base::client,
+            [this](beast::error_code ec)
+            {
+                if(ec)
+                    return fail(ec, "tls handshake");
+                do_ws_handshake();
+            });
+    }
+};
+
+// Start the next client, if any are left. This is
+// called once at first for each allowed concurrent
+// connect, then again whenever a connect finishes.
+void
+spawn(shared_state& st)
+{
+    auto const n = st.next++;
+    if(n >= st.opt.connections)
+        return;
+    auto& ioc = *st.iocs[n % st.iocs.size()];
+
+    // Interleave the roles, so every stage of the
+    // connect phase has the same mix of clients
+    auto const pct = static_cast<unsigned>(n % 100);
+    auto const r =
+        pct < st.opt.say ? role::say :
+        pct < st.opt.say + st.opt.blackjack ? role::blackjack :
+        role::idle;
+
+    net::post(ioc,
+        [&st, &ioc, n, r]
+        {
+            if(st.opt.tls)
+                (new ssl_client(st, n, r, ioc))->run();
+            else
+                (new plain_client(st, n, r, ioc))->run();
+        });
+}
+
+void
+print_histogram(
+    char const* name,
+    histogram const& h,
+    std::uint64_t count)
+{
+    std::printf("%-12s %10llu %10llu %10llu %10llu\n",
+        name,
+        static_cast<unsigned long long>(count),
+        static_cast<unsigned long long>(h.quantile(0.5)),
+        static_cast<unsigned long long>(h.quantile(0.99)),
+        static_cast<unsigned long long>(h.quantile(0.999)));
+}
+
+std::uint64_t
+total(histogram const& h)
+{
+    std::uint64_t n = 0;
+    for(auto c : h.counts())
+        n += c;
+    return n;
+}
+
+} // (anon)
+
+int
+main(int argc, char* argv[])
+{
+    options opt;
+    if(! parse_options(argc, argv, opt))
+    {
+        usage();
+        return EXIT_FAILURE;
+    }
+    raise_file_limit();
+
+    beast::error_code ec;
+    {
+        net::io_context ioc;
+        net::ip::tcp::resolver r(ioc);
+        auto const results = r.resolve(opt.host, opt.port, ec);
+        if(ec || results.empty())
+        {
+            std::cerr << "resolve: " << ec.message() << "\n";
+            return EXIT_FAILURE;
+        }
+        opt.host = results.begin()->endpoint().address().to_string();
+    }
+    shared_state st(opt, net::ip::tcp::endpoint(
+        net::ip::make_address(opt.host),
+        static_cast<unsigned short>(std::atoi(opt.port.c_str()))));
+
+    std::vector<std::thread> threads;
+    std::vector<net::executor_work_guard<
+        net::io_context::executor_type>> work;
+    for(auto& ioc : st.iocs)
+    {
+        work.emplace_back(ioc->get_executor());
+        threads.emplace_back(
+            [&ioc]
+            {
+                ioc->run();
+            });
+    }
+
+    auto const rss0 = resident_bytes(opt.pid);
+    auto const t0 = clock_type::now();
+    for(std::size_t i = 0; i < opt.concurrency; ++i)
+        spawn(st);
+
+    // Connect phase
+    auto last = t0;
+    while(st.connected + st.failed < opt.connections)
+    {
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(10));
+        if(clock_type::now() - last >= std::chrono::seconds(1))
+        {
+            last = clock_type::now();
+            std::cerr <<
+                "connected " << st.connected <<
+                ", failed " << st.failed << "\n";
+        }
+    }
+    auto const t1 = clock_type::now();
+    auto const rss1 = resident_bytes(opt.pid);
+    auto const connected = st.connected.load();
+
+    // Load phase
+    std::this_thread::sleep_for(
+        std::chrono::seconds(opt.duration));
+    auto const rss2 = resident_bytes(opt.pid);
+
+    for(auto& ioc : st.iocs)
+        ioc->stop();
+    for(auto& t : threads)
+        t.join();
+
+    auto const seconds =
+        std::chrono::duration<double>(t1 - t0).count();
+    std::printf("%-12s %10s %10s %10s %10s\n",
+        "", "clients", "failed", "closed", "conn/s");
+    std::printf("%-12s %10zu %10zu %10zu %10.1f\n",
+        "connect",
+        connected,
+        st.failed.load(),
+        st.closed.load(),
+        seconds > 0 ? connected / seconds : 0.0);
+    std::printf("%-12s %10s %10s %10s %10s\n",
+        "", "count", "p50 us", "p99 us", "p999 us");
+    print_histogram("connect", st.connect_us,
+        total(st.connect_us));
+    print_histogram("rpc", st.rpc_us,
+        total(st.rpc_us));
+    print_histogram("broadcast", st.broadcast_us,
+        st.broadcasts.load());
+    std::printf("%-12s %10llu requests, %llu errors\n",
+        "",
+        static_cast<unsigned long long>(st.requests.load()),
+        static_cast<unsigned long long>(st.errors.load()));
+    if(opt.pid != 0 && connected > 0)
+        std::printf("%-12s %10llu KB before, %llu KB connected, "
+            "%llu KB at end, %lld bytes/connection\n",
+            "server rss",
+            static_cast<unsigned long long>(rss0 / 1024),
+            static_cast<unsigned long long>(rss1 / 1024),
+            static_cast<unsigned long long>(rss2 / 1024),
+            (static_cast<long long>(rss1) -
+                static_cast<long long>(rss0)) /
+                static_cast<long long>(connected));
+    return EXIT_SUCCESS;
+}
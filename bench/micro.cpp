@@ -0,0 +1,571 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Times the primitives on the server's hot paths: serializing
+// broadcasts, extracting JSON-RPC requests, fanning a message
+// out to the users of a channel, looking up channels from
+// several threads, rearming session deadlines, journaling
+// wagers in the chip ledger, and the blackjack shoe and hand.
+//
+// Each benchmark is repeated with a doubling iteration count
+// until one run takes at least --min-time, and the fastest of
+// --repeat runs is reported. The results are written to stdout
+// as JSON; tools/bench_compare.py compares two such files.
+//
+// Usage: bench-micro [--filter=TEXT] [--min-time=MS] [--repeat=N]
+
+#include "blackjack/game.hpp"
+#include "core/archive.hpp"
+#include "core/channel.hpp"
+#include "core/channel_list.hpp"
+#include "core/json_writer.hpp"
+#include "core/ledger.hpp"
+#include "core/message.hpp"
+#include "core/metrics.hpp"
+#include "core/recorder.hpp"
+#include "core/rpc.hpp"
+#include "core/server.hpp"
+#include "core/timer_wheel.hpp"
+#include "core/user.hpp"
+#include <boost/json/parser.hpp>
+#include <boost/json/value.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/make_shared.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+extern
+std::unique_ptr<channel_list>
+make_channel_list(server& srv);
+
+namespace {
+
+using clock_type = std::chrono::steady_clock;
+
+// Results are added here so the optimizer keeps the work
+volatile std::size_t sink = 0;
+
+struct options
+{
+    std::string filter;
+    std::size_t min_time = 200;     // milliseconds
+    std::size_t repeat = 3;
+};
+
+struct result
+{
+    std::string name;
+    std::uint64_t iterations;
+    double ns_per_op;
+};
+
+class suite
+{
+    options const& opt_;
+    std::vector<result> results_;
+
+    template<class F>
+    double
+    time(F& f, std::uint64_t n)
+    {
+        auto const t0 = clock_type::now();
+        f(n);
+        return std::chrono::duration<double>(
+            clock_type::now() - t0).count();
+    }
+
+public:
+    explicit
+    suite(options const& opt)
+        : opt_(opt)
+    {
+    }
+
+    /// Return `true` if the filter selects a benchmark
+    bool
+    selected(std::string const& name) const
+    {
+        return name.find(opt_.filter) != std::string::npos;
+    }
+
+    /** Time a function.
+
+        @param f A function which performs the
+        operation `n` times, called as `f(n)`.
+    */
+    template<class F>
+    void
+    run(std::string const& name, F f)
+    {
+        if(! selected(name))
+            return;
+        auto const min_time = opt_.min_time / 1000.0;
+        std::uint64_t n = 1;
+        auto t = time(f, n);
+        while(t < min_time)
+        {
+            n *= 2;
+            t = time(f, n);
+        }
+        for(std::size_t i = 1; i < opt_.repeat; ++i)
+            t = (std::min)(t, time(f, n));
+        results_.push_back({name, n, 1e9 * t / n});
+        std::fprintf(stderr, "%-40s %12.1f ns/op\n",
+            name.c_str(), 1e9 * t / n);
+    }
+
+    void
+    write(std::string& out) const
+    {
+        json_writer w(out);
+        w.begin_object();
+        w.key("benchmarks");
+        w.begin_array();
+        for(auto const& r : results_)
+        {
+            w.begin_object();
+            w.member("name", r.name);
+            w.member("iterations", r.iterations);
+            w.member("ns_per_op", r.ns_per_op);
+            w.end_object();
+        }
+        w.end_array();
+        w.end_object();
+    }
+};
+
+//------------------------------------------------------------------------------
+
+// A server with only the parts a channel list uses
+class bench_server : public server
+{
+    ::metrics metrics_;
+    ::recorder recorder_;
+    ::archive archive_;     // never opened, so nothing is kept
+    std::unique_ptr<::channel_list> channel_list_;
+    std::vector<listener*> listeners_;
+
+    [[noreturn]]
+    static
+    void
+    unused()
+    {
+        throw std::logic_error("not available in bench_server");
+    }
+
+public:
+    bench_server()
+        : recorder_(16)
+        , channel_list_(make_channel_list(*this))
+    {
+        recorder_.enable(false);
+    }
+
+    executor_type make_executor() override { unused(); }
+    void insert(std::unique_ptr<service>) override { unused(); }
+    void insert(listener&) override { unused(); }
+    std::vector<listener*> const& listeners() const override { return listeners_; }
+    beast::string_view doc_root() const override { return {}; }
+    logger& log() override { unused(); }
+    ::channel_list& channel_list() override { return *channel_list_; }
+    ::static_cache& static_cache() override { unused(); }
+    ::router& router() override { unused(); }
+    ::buffer_pool& buffers() override { unused(); }
+    ::metrics& metrics() override { return metrics_; }
+    ::recorder& recorder() override { return recorder_; }
+    ::timer_wheel& timer_wheel() override { unused(); }
+    ::ledger& ledger() override { unused(); }
+    ::archive& archive() override { return archive_; }
+    void run() override { unused(); }
+    bool is_shutting_down() override { return false; }
+    void shutdown(std::chrono::seconds) override { unused(); }
+    void stop() override { unused(); }
+};
+
+// A user which counts what it is sent
+class bench_user : public user
+{
+public:
+    std::size_t bytes = 0;
+
+    void on_stop() override {}
+
+    void
+    send(json::value const&) override
+    {
+    }
+
+    void
+    send(message m) override
+    {
+        bytes += m.size();
+    }
+};
+
+class bench_channel : public channel
+{
+public:
+    bench_channel(
+        beast::string_view name,
+        ::channel_list& list)
+        : channel(name, list)
+    {
+    }
+
+    beast::string_view
+    type() const noexcept override
+    {
+        return "bench";
+    }
+
+    void on_insert(user&) override {}
+    void on_erase(user&) override {}
+    void on_dispatch(rpc_call&) override {}
+};
+
+//------------------------------------------------------------------------------
+
+json::value
+say_message(std::size_t size)
+{
+    json::value jv(json::object_kind);
+    auto& obj = jv.get_object();
+    obj["verb"] = "say";
+    obj["cid"] = 2;
+    obj["name"] = "General";
+    obj["user"] = "bench";
+    obj["message"] = std::string(size, 'x');
+    return jv;
+}
+
+void
+bench_make_message(suite& s)
+{
+    for(std::size_t size : { 64, 1024, 8192 })
+    {
+        auto const jv = say_message(size);
+        s.run("make_message/bytes:" + std::to_string(size),
+            [&jv](std::uint64_t n)
+            {
+                for(std::uint64_t i = 0; i < n; ++i)
+                    sink += make_message(jv).size();
+            });
+    }
+}
+
+// Parse and extract, as ws_user does for each frame
+void
+bench_rpc_extract(suite& s)
+{
+    struct request
+    {
+        char const* name;
+        char const* text;
+    };
+    static request const requests[] = {
+        { "identify",
+            "{\"jsonrpc\":\"2.0\",\"method\":\"identify\",\"id\":1,"
+            "\"params\":{\"cid\":1,\"name\":\"alice\"}}" },
+        { "say",
+            "{\"jsonrpc\":\"2.0\",\"method\":\"say\",\"id\":2,"
+            "\"params\":{\"cid\":2,\"message\":"
+            "\"Has anyone seen the dealer shuffle lately?\"}}" },
+        { "bet",
+            "{\"jsonrpc\":\"2.0\",\"method\":\"bet\",\"id\":3,"
+            "\"params\":{\"cid\":3}}" }
+    };
+    auto const u = boost::make_shared<bench_user>();
+    for(auto const& req : requests)
+    {
+        beast::string_view const text(req.text);
+        s.run(std::string("rpc_extract/") + req.name,
+            [&u, text](std::uint64_t n)
+            {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    beast::error_code ec;
+                    json::value jv = json::parse(
+                        { text.data(), text.size() }, ec);
+                    rpc_call rpc(*u);
+                    rpc.extract(std::move(jv), ec);
+                    sink += rpc.method.size();
+                }
+            });
+    }
+}
+
+// Users join before they are owned by a shared_ptr, so the
+// join broadcasts reach nobody, otherwise building a large
+// channel would cost a broadcast to every member per join.
+// Leaving also broadcasts, so the fixtures are never torn
+// down and the process exit reclaims them.
+void
+bench_channel_send(suite& s, bench_server& srv)
+{
+    for(std::size_t size : { 10, 1000, 100000 })
+    {
+        auto const label =
+            "channel_send/members:" + std::to_string(size);
+        if(! s.selected(label))
+            continue;
+        auto const name = "bench" + std::to_string(size);
+        insert<bench_channel>(
+            srv.channel_list(), name, srv.channel_list());
+        boost::shared_ptr<channel> c;
+        for(auto const& p : srv.channel_list().channels())
+            if(p->name() == name)
+                c = p;
+
+        auto users = new std::vector<boost::shared_ptr<bench_user>>;
+        users->reserve(size);
+        for(std::size_t i = 0; i < size; ++i)
+        {
+            auto const u = new bench_user;
+            u->name = "user" + std::to_string(i);
+            c->insert(*u);
+            users->emplace_back(u);
+        }
+
+        auto const jv = say_message(64);
+        s.run(label,
+            [&c, &jv](std::uint64_t n)
+            {
+                for(std::uint64_t i = 0; i < n; ++i)
+                    c->send(jv);
+            });
+    }
+}
+
+void
+bench_channel_list_at(suite& s, bench_server& srv)
+{
+    auto& list = srv.channel_list();
+    for(std::size_t threads : { 1, 2, 4, 8 })
+    {
+        s.run("channel_list_at/threads:" + std::to_string(threads),
+            [&list, threads](std::uint64_t n)
+            {
+                std::atomic<bool> go(false);
+                std::vector<std::thread> v;
+                for(std::size_t t = 0; t < threads; ++t)
+                    v.emplace_back(
+                        [&list, &go, n]
+                        {
+                            while(! go.load())
+                                std::this_thread::yield();
+                            std::size_t found = 0;
+                            for(std::uint64_t i = 0; i < n; ++i)
+                                if(list.at(2))
+                                    ++found;
+                            sink += found;
+                        });
+                go = true;
+                for(auto& t : v)
+                    t.join();
+            });
+    }
+}
+
+void
+bench_blackjack(suite& s)
+{
+    for(int decks : { 1, 6 })
+    {
+        blackjack::shoe sh(decks);
+        s.run("shoe_shuffle/decks:" + std::to_string(decks),
+            [&sh](std::uint64_t n)
+            {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    sh.shuffle();
+                    sink += sh.deal();
+                }
+            });
+    }
+
+    // Hands of two to five cards, as they occur in play
+    blackjack::shoe sh(6);
+    std::vector<blackjack::hand> hands(1024);
+    for(std::size_t i = 0; i < hands.size(); ++i)
+        for(std::size_t j = 0; j < 2 + i % 4; ++j)
+            hands[i].cards.push_back(sh.deal());
+    s.run("hand_eval",
+        [&hands](std::uint64_t n)
+        {
+            for(std::uint64_t i = 0; i < n; ++i)
+            {
+                auto& h = hands[i % hands.size()];
+                h.eval();
+                sink += h.busted;
+            }
+        });
+
+    // Dealing a hand card by card, as the tables do
+    s.run("hand_add",
+        [&hands](std::uint64_t n)
+        {
+            blackjack::hand h;
+            for(std::uint64_t i = 0; i < n; ++i)
+            {
+                auto const& src = hands[i % hands.size()];
+                h.clear();
+                for(auto c : src.cards)
+                    h.add(c);
+                sink += h.busted;
+            }
+        });
+}
+
+// Sessions rearm their deadline for every message, which
+// is what the timer wheel is for. The I/O context is not
+// run, only the cost of scheduling is measured.
+void
+bench_timers(suite& s)
+{
+    for(std::size_t count : { 1024, 65536 })
+    {
+        timer_wheel w(1);
+        std::vector<std::unique_ptr<wheel_timer>> v;
+        for(std::size_t i = 0; i < count; ++i)
+            v.emplace_back(new wheel_timer(w));
+        s.run("wheel_rearm/timers:" + std::to_string(count),
+            [&v](std::uint64_t n)
+            {
+                for(std::uint64_t i = 0; i < n; ++i)
+                    v[i % v.size()]->expires_after(
+                        std::chrono::seconds(30), []{});
+            });
+    }
+
+    for(std::size_t count : { 1024, 65536 })
+    {
+        net::io_context ioc;
+        std::vector<std::unique_ptr<timer_type>> v;
+        for(std::size_t i = 0; i < count; ++i)
+            v.emplace_back(new timer_type(
+                net::make_strand(ioc.get_executor())));
+        s.run("asio_rearm/timers:" + std::to_string(count),
+            [&v, &ioc](std::uint64_t n)
+            {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    auto& t = *v[i % v.size()];
+                    t.expires_after(std::chrono::seconds(30));
+                    t.async_wait([](beast::error_code){});
+
+                    // Drain the cancelled waits
+                    if((i & 1023) == 1023)
+                        ioc.poll();
+                }
+                ioc.poll();
+            });
+        for(auto& t : v)
+            t->cancel();
+        ioc.poll();
+    }
+}
+
+// Every bet at a table is journaled while the table's strand
+// waits, the commits to disk happen on the ledger's thread.
+void
+bench_ledger(suite& s)
+{
+    namespace fs = boost::filesystem;
+    auto const dir = fs::temp_directory_path() /
+        fs::unique_path("lounge-bench-ledger-%%%%-%%%%");
+    {
+        ledger lg(dir.string());
+        beast::error_code ec;
+        lg.open(ec);
+        if(ec)
+            throw beast::system_error(ec);
+        std::vector<std::string> names;
+        for(int i = 0; i < 1000; ++i)
+            names.emplace_back("player" + std::to_string(i));
+        s.run("ledger_wager",
+            [&lg, &names](std::uint64_t n)
+            {
+                for(std::uint64_t i = 0; i < n; ++i)
+                {
+                    auto const& name = names[i % names.size()];
+                    if(lg.wager(name, 5) < 0)
+                        lg.settle(name, 1000);
+                }
+                sink += lg.sequence();
+            });
+    }
+    beast::error_code ec;
+    fs::remove_all(dir, ec);
+}
+
+bool
+parse_options(
+    int argc,
+    char* argv[],
+    options& opt)
+{
+    for(int i = 1; i < argc; ++i)
+    {
+        std::string const arg = argv[i];
+        auto const eq = arg.find('=');
+        if(eq == std::string::npos)
+            return false;
+        auto const name = arg.substr(0, eq);
+        auto const value = arg.substr(eq + 1);
+        if(name == "--filter")
+            opt.filter = value;
+        else if(name == "--min-time")
+            opt.min_time = std::strtoul(value.c_str(), nullptr, 10);
+        else if(name == "--repeat")
+            opt.repeat = std::strtoul(value.c_str(), nullptr, 10);
+        else
+            return false;
+    }
+    return opt.repeat > 0;
+}
+
+} // (anon)
+
+int
+main(int argc, char* argv[])
+{
+    options opt;
+    if(! parse_options(argc, argv, opt))
+    {
+        std::cerr <<
+            "Usage: bench-micro [--filter=TEXT] "
+            "[--min-time=MS] [--repeat=N]\n";
+        return EXIT_FAILURE;
+    }
+
+    suite s(opt);
+
+    // Never destroyed, see bench_channel_send
+    auto const srv = new bench_server;
+    bench_make_message(s);
+    bench_rpc_extract(s);
+    bench_channel_send(s, *srv);
+    bench_channel_list_at(s, *srv);
+    bench_timers(s);
+    bench_ledger(s);
+    bench_blackjack(s);
+
+    std::string out;
+    s.write(out);
+    std::cout << out << std::endl;
+    return EXIT_SUCCESS;
+}
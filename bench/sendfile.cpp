@@ -0,0 +1,235 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Compares the two ways the server sends a static file on
+// a plain connection: serializing an http::file_body, which
+// copies the file through a user-space buffer, and writing
+// the header followed by sendfile. Every response is sent
+// over loopback TCP to a thread which discards it.
+
+#include "core/sendfile.hpp"
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/file_body.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/asio/coroutine.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef LOUNGE_HAS_SENDFILE
+
+namespace {
+
+namespace fs = boost::filesystem;
+
+using socket_type = net::ip::tcp::socket;
+
+// Returns the CPU time used by the calling thread, in seconds
+double
+thread_cpu()
+{
+    timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Create a file filled with a repeating pattern
+void
+make_file(
+    std::string const& path,
+    std::size_t size)
+{
+    beast::error_code ec;
+    beast::file f;
+    f.open(path.c_str(), beast::file_mode::write, ec);
+    if(ec)
+        throw beast::system_error(ec);
+    std::string chunk(64 * 1024, 0);
+    for(std::size_t i = 0; i < chunk.size(); ++i)
+        chunk[i] = "0123456789abcdef"[i % 16];
+    while(size > 0)
+    {
+        auto const n = (std::min)(size, chunk.size());
+        f.write(chunk.data(), n, ec);
+        if(ec)
+            throw beast::system_error(ec);
+        size -= n;
+    }
+}
+
+// Sends the same file repeatedly in one of the two modes
+class sender : public net::coroutine
+{
+    socket_type& sock_;
+    std::string path_;
+    std::size_t count_;
+    bool use_sendfile_;
+    std::unique_ptr<http::response<http::file_body>> res_;
+    std::unique_ptr<http::response_serializer<http::file_body>> sr_;
+
+public:
+    sender(
+        socket_type& sock,
+        std::string path,
+        std::size_t count,
+        bool use_sendfile)
+        : sock_(sock)
+        , path_(std::move(path))
+        , count_(count)
+        , use_sendfile_(use_sendfile)
+    {
+    }
+
+    void
+    operator()(
+        beast::error_code ec = {},
+        std::size_t = 0)
+    {
+    #include <boost/asio/yield.hpp>
+        reenter(*this)
+        {
+            while(count_-- > 0)
+            {
+                res_.reset(new http::response<http::file_body>(
+                    http::status::ok, 11));
+                res_->body().open(
+                    path_.c_str(), beast::file_mode::scan, ec);
+                if(ec)
+                    throw beast::system_error(ec);
+                res_->prepare_payload();
+
+                if(! use_sendfile_)
+                {
+                    yield http::async_write(
+                        sock_, *res_, std::ref(*this));
+                }
+                else
+                {
+                    sr_.reset(new http::response_serializer<
+                        http::file_body>(*res_));
+                    yield http::async_write_header(
+                        sock_, *sr_, std::ref(*this));
+                    if(ec)
+                        throw beast::system_error(ec);
+                    yield async_sendfile(
+                        sock_,
+                        res_->body().file().native_handle(),
+                        0,
+                        res_->body().size(),
+                        std::ref(*this));
+                }
+                if(ec)
+                    throw beast::system_error(ec);
+            }
+        }
+    #include <boost/asio/unyield.hpp>
+    }
+};
+
+struct result
+{
+    double seconds;
+    double cpu;
+};
+
+result
+run(
+    std::string const& path,
+    std::size_t count,
+    bool use_sendfile)
+{
+    net::io_context ioc;
+    net::ip::tcp::acceptor acceptor(ioc,
+        {net::ip::make_address("127.0.0.1"), 0});
+    socket_type client(ioc);
+    client.connect(acceptor.local_endpoint());
+    socket_type server(ioc);
+    acceptor.accept(server);
+
+    // Discard everything until the sender closes
+    std::thread reader(
+        [&client]
+        {
+            std::vector<char> buf(256 * 1024);
+            beast::error_code ec;
+            while(! ec)
+                client.read_some(
+                    net::buffer(buf), ec);
+        });
+
+    auto const cpu0 = thread_cpu();
+    auto const t0 = std::chrono::steady_clock::now();
+    sender s(server, path, count, use_sendfile);
+    s();
+    ioc.run();
+    auto const t1 = std::chrono::steady_clock::now();
+    auto const cpu1 = thread_cpu();
+
+    server.shutdown(socket_type::shutdown_send);
+    reader.join();
+
+    return {
+        std::chrono::duration<double>(t1 - t0).count(),
+        cpu1 - cpu0 };
+}
+
+} // (anon)
+
+int
+main()
+{
+    std::size_t const sizes[] = {
+        64 * 1024, 4 * 1024 * 1024, 32 * 1024 * 1024 };
+
+    // Send about this many bytes for each measurement
+    std::size_t const total = 1024 * 1024 * 1024;
+
+    auto const path = (fs::temp_directory_path() /
+        fs::unique_path("lounge-bench-%%%%%%%%")).string();
+
+    std::printf("%10s %10s %8s %10s %12s\n",
+        "size", "mode", "count", "MB/s", "cpu us/req");
+    for(auto size : sizes)
+    {
+        make_file(path, size);
+        auto const count = total / size;
+        for(auto use_sendfile : { false, true })
+        {
+            auto const r = run(path, count, use_sendfile);
+            std::printf("%10zu %10s %8zu %10.1f %12.1f\n",
+                size,
+                use_sendfile ? "sendfile" : "file_body",
+                count,
+                (double(size) * count / (1024 * 1024)) / r.seconds,
+                1e6 * r.cpu / count);
+        }
+    }
+    fs::remove(path);
+    return EXIT_SUCCESS;
+}
+
+#else
+
+int
+main()
+{
+    std::cerr << "sendfile is not available on this platform\n";
+    return EXIT_SUCCESS;
+}
+
+#endif
@@ -11,61 +11,127 @@
 #define LOUNGE_BLACKJACK_GAME_HPP
 
 #include "core/config.hpp"
+#include "blackjack/random.hpp"
 #include <boost/beast/core/static_string.hpp>
+#include <cstdint>
 #include <vector>
 
 namespace blackjack {
 
 //----------------------------------------------------------
 
-class shoe
+/** A shoe of one or more decks, with its own generator.
+
+    Each shoe owns a generator so tables on different
+    threads never share state. Constructing a shoe with
+    the seed of another replays its shuffles exactly.
+
+    @tparam Generator A generator returning 32 random bits.
+*/
+template<class Generator>
+class basic_shoe
 {
-    std::string cards_;
-    std::string::iterator pos_;
+    std::vector<char> cards_;
+    std::size_t pos_ = 0;
+    std::uint64_t seed_;
+    Generator g_;
 
 public:
+    /// Construct a shoe seeded from the system
     explicit
-    shoe(int decks)
+    basic_shoe(int decks)
+        : basic_shoe(decks, make_seed())
     {
-        cards_.resize(decks * 52);
-        shuffle();
     }
 
-    void
-    shuffle()
+    /// Construct a shoe with a given seed
+    basic_shoe(
+        int decks,
+        std::uint64_t seed)
+        : seed_(seed)
+        , g_(seed)
     {
+        cards_.resize(decks * 52);
         for(std::size_t i = 0;
             i < cards_.size(); ++i)
         {
             cards_[i] = 1 + (i % 52);
         }
-        for(std::size_t i = 0;
-            i < cards_.size() - 1; ++i)
-        {
-            auto const j = i +
-                (rand() % (cards_.size() - i));
-            std::swap(
-                cards_[i], cards_[j]);
-        }
-        pos_ = cards_.begin();
+        shuffle();
+    }
+
+    // Returns the seed, for replaying the shoe
+    std::uint64_t
+    seed() const
+    {
+        return seed_;
+    }
+
+    // The cards are not put back in order first,
+    // shuffling any permutation is equally uniform.
+    void
+    shuffle()
+    {
+        blackjack::shuffle(
+            cards_.begin(), cards_.end(), g_);
+        pos_ = 0;
+    }
+
+    // Returns the number of cards in the shoe
+    std::size_t
+    size() const
+    {
+        return cards_.size();
+    }
+
+    // Returns the number of cards left to deal
+    std::size_t
+    remaining() const
+    {
+        return cards_.size() - pos_;
     }
 
     char
     deal()
     {
-        if(pos_ == cards_.end())
+        if(pos_ == cards_.size())
             shuffle();
-        return *pos_++;
+        return cards_[pos_++];
     }
 };
 
+using shoe = basic_shoe<pcg32>;
+
 //----------------------------------------------------------
 
+namespace detail {
+
+// The value of each card, indexed by its code. Aces
+// are one and the hole card, code zero, has no value.
+constexpr signed char card_value[53] = {
+    0,
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 10, 10,
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 10, 10,
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 10, 10,
+    1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 10, 10, 10
+};
+
+} // detail
+
+/** The cards of a player or the dealer.
+
+    The totals are updated as each card is added, so
+    every question about the hand takes constant time.
+*/
 struct hand
 {
     // cards[0]==0 for hole card
     beast::static_string<22> cards;
     int wager = 0;
+    int hard_total = 0;     // aces count as one
+    int total = 0;          // the best total
+    bool has_ace = false;
+    bool soft = false;      // an ace counts as eleven
     bool busted = false;
     bool twenty_one = false;
     bool blackjack = false;
@@ -75,6 +141,10 @@ struct hand
     {
         cards.clear();
         wager = 0;
+        hard_total = 0;
+        total = 0;
+        has_ace = false;
+        soft = false;
         busted = false;
         twenty_one = false;
         blackjack = false;
@@ -86,46 +156,51 @@ struct hand
     int
     value(char c)
     {
-        auto v = 1 + ((c - 1) % 13);
-        if( v > 10)
-            v = 10;
-        return v;
+        return detail::card_value[
+            static_cast<unsigned char>(c)];
+    }
+
+    // Add a card to the hand
+    void
+    add(char c)
+    {
+        cards.push_back(c);
+        auto const v = value(c);
+        hard_total += v;
+        has_ace |= v == 1;
+        update();
     }
 
+    // Recalculate the totals after
+    // changing the cards directly.
     void
     eval()
     {
-        int aces = 0;
-        int total = 0;
+        hard_total = 0;
+        has_ace = false;
         for(auto c : cards)
         {
-            auto const v =
-                value(c);
-            if(v != 1)
-            {
-                total += v;
-            }
-            else
-            {
-                ++aces;
-                total += 11;
-            }
+            auto const v = value(c);
+            hard_total += v;
+            has_ace |= v == 1;
         }
-        while(total > 21 && aces--)
-            total -= 10;
+        update();
+    }
 
-        busted = total > 21;
-        twenty_one = total == 21;
-        blackjack =
-            twenty_one &&
-            cards.size() == 2;
+    // Remove and return the second card of a pair
+    char
+    split()
+    {
+        auto const c = cards[1];
+        cards.resize(1);
+        eval();
+        return c;
     }
 
     void
     deal(shoe& s)
     {
-        cards.push_back(s.deal());
-        eval();
+        add(s.deal());
     }
 
     bool
@@ -133,6 +208,28 @@ struct hand
     {
         return busted || twenty_one;
     }
+
+    // Returns `true` for a soft seventeen,
+    // on which the dealer may have to hit.
+    bool
+    is_soft_17() const
+    {
+        return soft && total == 17;
+    }
+
+private:
+    // Only one ace can count as eleven
+    void
+    update()
+    {
+        soft = has_ace && hard_total <= 11;
+        total = hard_total + 10 * soft;
+        busted = total > 21;
+        twenty_one = total == 21;
+        blackjack =
+            twenty_one &&
+            cards.size() == 2;
+    }
 };
 
 //----------------------------------------------------------
@@ -0,0 +1,175 @@
+//
+// Copyright (c) 2020 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_BLACKJACK_RANDOM_HPP
+#define LOUNGE_BLACKJACK_RANDOM_HPP
+
+#include "core/config.hpp"
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <utility>
+
+namespace blackjack {
+
+//----------------------------------------------------------
+
+/** A PCG generator with 64 bits of state and 32-bit output.
+
+    This is PCG-XSH-RR from https://www.pcg-random.org.
+    It is small and fast enough for each table to own
+    one, and meets the requirements of
+    UniformRandomBitGenerator.
+*/
+class pcg32
+{
+    std::uint64_t state_ = 0;
+    std::uint64_t inc_ = 1;
+
+public:
+    using result_type = std::uint32_t;
+
+    explicit
+    pcg32(
+        std::uint64_t seed = 0,
+        std::uint64_t stream = 0) noexcept
+    {
+        this->seed(seed, stream);
+    }
+
+    void
+    seed(
+        std::uint64_t seed,
+        std::uint64_t stream = 0) noexcept
+    {
+        state_ = 0;
+        inc_ = (stream << 1) | 1;
+        (*this)();
+        state_ += seed;
+        (*this)();
+    }
+
+    static
+    constexpr
+    result_type
+    min() noexcept
+    {
+        return 0;
+    }
+
+    static
+    constexpr
+    result_type
+    max() noexcept
+    {
+        return (std::numeric_limits<result_type>::max)();
+    }
+
+    result_type
+    operator()() noexcept
+    {
+        auto const old = state_;
+        state_ = old * 6364136223846793005ULL + inc_;
+        auto const xs = static_cast<std::uint32_t>(
+            ((old >> 18) ^ old) >> 27);
+        auto const rot = static_cast<unsigned>(old >> 59);
+        return (xs >> rot) | (xs << ((0u - rot) & 31));
+    }
+};
+
+//----------------------------------------------------------
+
+/** Return a uniformly distributed integer in [0, n).
+
+    This uses Lemire's multiply and reject method, which
+    is unbiased and rarely needs a division.
+
+    @param g A generator returning 32 random bits.
+
+    @param n The size of the range, which must be positive.
+*/
+template<class Generator>
+std::uint32_t
+bounded(Generator& g, std::uint32_t n)
+{
+    std::uint64_t m = std::uint64_t(g()) * n;
+    auto l = static_cast<std::uint32_t>(m);
+    if(l < n)
+    {
+        auto const t = (0u - n) % n;
+        while(l < t)
+        {
+            m = std::uint64_t(g()) * n;
+            l = static_cast<std::uint32_t>(m);
+        }
+    }
+    return static_cast<std::uint32_t>(m >> 32);
+}
+
+/** Shuffle a sequence uniformly.
+
+    This is the Fisher-Yates shuffle, drawing the swap
+    positions for three steps from a single output of
+    the generator whenever their ranges fit, following
+    Brackett-Rozinsky and Lemire's batched method.
+
+    @param g A generator returning 32 random bits.
+*/
+template<class RandomIt, class Generator>
+void
+shuffle(
+    RandomIt first,
+    RandomIt last,
+    Generator& g)
+{
+    using std::swap;
+    auto i = static_cast<std::uint32_t>(last - first);
+
+    // The product of three ranges fits in 32 bits
+    while(i > 3 && i <= 1625)
+    {
+        std::uint32_t const n0 = i;
+        std::uint32_t const n1 = i - 1;
+        std::uint32_t const n2 = i - 2;
+        auto const bound = n0 * n1 * n2;
+        std::uint64_t m;
+        std::uint32_t j0, j1, j2, l;
+        for(;;)
+        {
+            m = std::uint64_t(g()) * n0;
+            j0 = static_cast<std::uint32_t>(m >> 32);
+            m = std::uint64_t(static_cast<std::uint32_t>(m)) * n1;
+            j1 = static_cast<std::uint32_t>(m >> 32);
+            m = std::uint64_t(static_cast<std::uint32_t>(m)) * n2;
+            j2 = static_cast<std::uint32_t>(m >> 32);
+            l = static_cast<std::uint32_t>(m);
+            if(l >= bound || l >= (0u - bound) % bound)
+                break;
+        }
+        swap(first[n0 - 1], first[j0]);
+        swap(first[n1 - 1], first[j1]);
+        swap(first[n2 - 1], first[j2]);
+        i -= 3;
+    }
+    for(; i > 1; --i)
+        swap(first[i - 1], first[bounded(g, i)]);
+}
+
+/// Return a seed from the system's entropy source
+inline
+std::uint64_t
+make_seed()
+{
+    std::random_device rd;
+    return (std::uint64_t(rd()) << 32) | rd();
+}
+
+} // blackjack
+
+#endif
@@ -0,0 +1,344 @@
+//
+// Copyright (c) 2020 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "blackjack/simulator.hpp"
+#include <algorithm>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+namespace blackjack {
+
+//----------------------------------------------------------
+
+namespace {
+
+// Basic strategy for four or more decks, dealer stands
+// on soft 17, double after split and late surrender.
+//
+//  H  hit
+//  S  stand
+//  D  double, otherwise hit
+//  d  double, otherwise stand
+//  R  surrender, otherwise hit
+//  P  split
+//  p  split if doubling after a split is allowed, otherwise hit
+//  -  do not split
+//
+//                              23456789TA
+char const* const hard_table[] = {
+    /*  4 */                   "HHHHHHHHHH",
+    /*  5 */                   "HHHHHHHHHH",
+    /*  6 */                   "HHHHHHHHHH",
+    /*  7 */                   "HHHHHHHHHH",
+    /*  8 */                   "HHHHHHHHHH",
+    /*  9 */                   "HDDDDHHHHH",
+    /* 10 */                   "DDDDDDDDHH",
+    /* 11 */                   "DDDDDDDDDH",
+    /* 12 */                   "HHSSSHHHHH",
+    /* 13 */                   "SSSSSHHHHH",
+    /* 14 */                   "SSSSSHHHHH",
+    /* 15 */                   "SSSSSHHHRH",
+    /* 16 */                   "SSSSSHHRRR",
+    /* 17 */                   "SSSSSSSSSS",
+    /* 18 */                   "SSSSSSSSSS",
+    /* 19 */                   "SSSSSSSSSS",
+    /* 20 */                   "SSSSSSSSSS",
+    /* 21 */                   "SSSSSSSSSS"
+};
+
+char const* const soft_table[] = {
+    /* 12 */                   "HHHHHHHHHH",
+    /* 13 */                   "HHHDDHHHHH",
+    /* 14 */                   "HHHDDHHHHH",
+    /* 15 */                   "HHDDDHHHHH",
+    /* 16 */                   "HHDDDHHHHH",
+    /* 17 */                   "HDDDDHHHHH",
+    /* 18 */                   "SddddSSHHH",
+    /* 19 */                   "SSSSSSSSSS",
+    /* 20 */                   "SSSSSSSSSS",
+    /* 21 */                   "SSSSSSSSSS"
+};
+
+char const* const pair_table[] = {
+    /* A */                    "PPPPPPPPPP",
+    /* 2 */                    "ppPPPPHHHH",
+    /* 3 */                    "ppPPPPHHHH",
+    /* 4 */                    "HHHppHHHHH",
+    /* 5 */                    "----------",
+    /* 6 */                    "pPPPP-----",
+    /* 7 */                    "PPPPPP----",
+    /* 8 */                    "PPPPPPPPPP",
+    /* 9 */                    "PPPPP-PP--",
+    /* T */                    "----------"
+};
+
+// Returns the column for the dealer's up card
+inline
+int
+column(int up)
+{
+    return up == 1 ? 9 : up - 2;
+}
+
+//----------------------------------------------------------
+
+// A hand of the player, one of several after a split
+struct seat_hand
+{
+    hand h;
+    int units = 1;
+    bool split = false;
+};
+
+// Plays rounds on one thread
+class player
+{
+    rules const& r_;
+    strategy const& st_;
+    shoe sh_;
+    std::size_t cut_;
+    seat_hand hands_[8];
+    hand dealer_;
+
+public:
+    player(
+        rules const& r,
+        strategy const& st,
+        std::uint64_t seed)
+        : r_(r)
+        , st_(st)
+        , sh_(r.decks, seed)
+        , cut_(static_cast<std::size_t>(
+            sh_.size() * (1 - r.penetration)))
+    {
+    }
+
+    // The totals are kept locally, since the results
+    // of all threads are adjacent in memory.
+    void
+    run(std::uint64_t rounds, sim_result& out)
+    {
+        sim_result result;
+        for(std::uint64_t i = 0; i < rounds; ++i)
+        {
+            if(sh_.remaining() <= cut_)
+                sh_.shuffle();
+            auto const x = play();
+            result.sum += x;
+            result.sum_sq += x * x;
+        }
+        result.rounds = rounds;
+        out = result;
+    }
+
+private:
+    // A round which splits many times can run past
+    // the end of a small shoe, which then reshuffles.
+    char
+    draw()
+    {
+        return sh_.deal();
+    }
+
+    void
+    hit(hand& h)
+    {
+        h.add(draw());
+    }
+
+    // Play one round, returning the units won
+    double
+    play()
+    {
+        auto& first = hands_[0];
+        first.h.clear();
+        first.units = 1;
+        first.split = false;
+        dealer_.clear();
+        hit(first.h);
+        hit(dealer_);
+        hit(first.h);
+        hit(dealer_);
+
+        // The dealer peeks for a natural
+        if(dealer_.blackjack)
+            return first.h.blackjack ? 0 : -1;
+        if(first.h.blackjack)
+            return r_.blackjack_payout;
+
+        auto const up = hand::value(dealer_.cards[0]);
+        auto const max_hands = (std::min)(r_.max_hands, 8);
+        int n = 1;
+        bool live = false;
+        for(int i = 0; i < n; ++i)
+        {
+            auto& sh = hands_[i];
+            bool const split_aces = sh.split &&
+                hand::value(sh.h.cards[0]) == 1;
+            if(sh.split)
+                hit(sh.h);
+            while(! split_aces && sh.h.total < 21)
+            {
+                auto const two = sh.h.cards.size() == 2;
+                auto const a = st_.decide(sh.h, up,
+                    two && (! sh.split || r_.double_after_split),
+                    n < max_hands,
+                    two && n == 1 && r_.surrender);
+                if(a == action::stand)
+                    break;
+                if(a == action::surrender)
+                    return -0.5;
+                if(a == action::double_down)
+                {
+                    sh.units = 2;
+                    hit(sh.h);
+                    break;
+                }
+                if(a == action::split)
+                {
+                    auto& other = hands_[n++];
+                    other.h.clear();
+                    other.h.add(sh.h.split());
+                    other.units = 1;
+                    other.split = true;
+                    sh.split = true;
+                    hit(sh.h);
+                    if(hand::value(sh.h.cards[0]) == 1)
+                        break;
+                    continue;
+                }
+                hit(sh.h);
+            }
+            live |= ! sh.h.busted;
+        }
+
+        // The dealer draws only against a live hand
+        if(live)
+            while( dealer_.total < 17 || (
+                r_.hit_soft_17 && dealer_.is_soft_17()))
+                hit(dealer_);
+
+        double x = 0;
+        for(int i = 0; i < n; ++i)
+        {
+            auto const& sh = hands_[i];
+            if(sh.h.busted)
+                x -= sh.units;
+            else if(dealer_.busted || sh.h.total > dealer_.total)
+                x += sh.units;
+            else if(sh.h.total < dealer_.total)
+                x -= sh.units;
+        }
+        return x;
+    }
+};
+
+} // (anon)
+
+//----------------------------------------------------------
+
+strategy::
+strategy(rules const& r)
+    : double_after_split_(r.double_after_split)
+{
+    for(int i = 0; i < 22; ++i)
+    {
+        std::memcpy(hard_[i], hard_table[
+            (std::max)(i, 4) - 4], 10);
+        std::memcpy(soft_[i], soft_table[
+            (std::max)(i, 12) - 12], 10);
+    }
+    for(int i = 1; i <= 10; ++i)
+        std::memcpy(pair_[i], pair_table[i - 1], 10);
+    std::memset(pair_[0], '-', 10);
+
+    // Changes when the dealer hits soft 17
+    if(r.hit_soft_17)
+    {
+        hard_[11][column(1)] = 'D';
+        hard_[15][column(1)] = 'R';
+        soft_[18][column(2)] = 'd';
+        soft_[19][column(6)] = 'd';
+    }
+}
+
+action
+strategy::
+decide(
+    hand const& h,
+    int up,
+    bool can_double,
+    bool can_split,
+    bool can_surrender) const
+{
+    auto const col = column(up);
+    if( can_split &&
+        h.cards.size() == 2 &&
+        hand::value(h.cards[0]) == hand::value(h.cards[1]))
+    {
+        auto const c = pair_[hand::value(h.cards[0])][col];
+        if(c == 'P' || (c == 'p' && double_after_split_))
+            return action::split;
+    }
+    switch(h.soft ? soft_[h.total][col] : hard_[h.total][col])
+    {
+    case 'S':
+        return action::stand;
+    case 'D':
+        return can_double ?
+            action::double_down : action::hit;
+    case 'd':
+        return can_double ?
+            action::double_down : action::stand;
+    case 'R':
+        return can_surrender ?
+            action::surrender : action::hit;
+    default:
+        return action::hit;
+    }
+}
+
+//----------------------------------------------------------
+
+sim_result
+simulate(
+    rules const& r,
+    std::uint64_t rounds,
+    unsigned threads,
+    std::uint64_t seed)
+{
+    if(threads < 1)
+        threads = 1;
+    strategy const st(r);
+    std::vector<sim_result> results(threads);
+    std::vector<std::thread> v;
+    v.reserve(threads);
+    for(unsigned i = 0; i < threads; ++i)
+    {
+        auto const n = rounds / threads +
+            (i < rounds % threads ? 1 : 0);
+        v.emplace_back(
+            [&r, &st, &results, seed, i, n]
+            {
+                player p(r, st,
+                    seed + i * 0x9E3779B97F4A7C15ULL);
+                p.run(n, results[i]);
+            });
+    }
+    sim_result result;
+    for(unsigned i = 0; i < threads; ++i)
+    {
+        v[i].join();
+        result.merge(results[i]);
+    }
+    return result;
+}
+
+} // blackjack
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2020 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_BLACKJACK_SIMULATOR_HPP
+#define LOUNGE_BLACKJACK_SIMULATOR_HPP
+
+#include "blackjack/game.hpp"
+#include <cstdint>
+
+namespace blackjack {
+
+//----------------------------------------------------------
+
+/// The rules of a table, as they affect the house edge
+struct rules
+{
+    int decks = 6;
+
+    // dealer hits soft 17
+    bool hit_soft_17 = false;
+
+    // double down is allowed after a split
+    bool double_after_split = true;
+
+    // late surrender is offered
+    bool surrender = true;
+
+    // maximum number of hands after splitting
+    int max_hands = 4;
+
+    // payout for a natural, per unit wagered
+    double blackjack_payout = 1.5;
+
+    // fraction of the shoe dealt before a reshuffle
+    double penetration = 0.75;
+};
+
+//----------------------------------------------------------
+
+enum class action
+{
+    hit,
+    stand,
+    double_down,
+    split,
+    surrender
+};
+
+/** Basic strategy for a set of rules.
+
+    The decisions are looked up in tables indexed
+    by the player's total and the dealer's up card.
+*/
+class strategy
+{
+    // Columns are the dealer's up card 2..10, A
+    char hard_[22][10];
+    char soft_[22][10];
+    char pair_[11][10];
+    bool double_after_split_;
+
+public:
+    explicit
+    strategy(rules const& r);
+
+    /** Return the decision for a hand.
+
+        @param h The player's hand, which must be evaluated.
+
+        @param up The value of the dealer's up card, 1 for an ace.
+
+        @param can_split `true` if a pair may be split.
+    */
+    action
+    decide(
+        hand const& h,
+        int up,
+        bool can_double,
+        bool can_split,
+        bool can_surrender) const;
+};
+
+//----------------------------------------------------------
+
+/// The outcome of a simulation
+struct sim_result
+{
+    // rounds played
+    std::uint64_t rounds = 0;
+
+    // units won by the player, and their squares
+    double sum = 0;
+    double sum_sq = 0;
+
+    // Add the results of another simulation
+    void
+    merge(sim_result const& other)
+    {
+        rounds += other.rounds;
+        sum += other.sum;
+        sum_sq += other.sum_sq;
+    }
+
+    // Return the house edge, as a fraction of the initial wager
+    double
+    house_edge() const
+    {
+        return rounds ? -sum / rounds : 0;
+    }
+
+    // Return the variance of a round
+    double
+    variance() const
+    {
+        if(rounds == 0)
+            return 0;
+        auto const mean = sum / rounds;
+        return sum_sq / rounds - mean * mean;
+    }
+};
+
+/** Play rounds of one player against the dealer.
+
+    The rounds are divided among the threads, each of which
+    owns a shoe seeded from `seed`, so the work scales with
+    the number of cores.
+
+    @param r The rules of the table.
+
+    @param rounds The number of rounds to play.
+
+    @param threads The number of threads to use.
+
+    @param seed The seed for the shoes.
+*/
+sim_result
+simulate(
+    rules const& r,
+    std::uint64_t rounds,
+    unsigned threads,
+    std::uint64_t seed);
+
+} // blackjack
+
+#endif
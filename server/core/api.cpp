@@ -0,0 +1,238 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "channel.hpp"
+#include "channel_list.hpp"
+#include "json_writer.hpp"
+#include "listener.hpp"
+#include "metrics.hpp"
+#include "router.hpp"
+#include "rpc_stats.hpp"
+#include "server.hpp"
+#include <chrono>
+#include <memory>
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+char const*
+to_string(listener_config const& cfg) noexcept
+{
+    switch(cfg.kind)
+    {
+    case listener_config::no_tls:       return "http";
+    case listener_config::allow_tls:    return "flex";
+    case listener_config::require_tls:  return "https";
+    }
+    return "";
+}
+
+bool
+parse_cid(beast::string_view s, std::size_t& cid) noexcept
+{
+    if(s.empty() || s.size() > 9)
+        return false;
+    cid = 0;
+    for(auto c : s)
+    {
+        if(c < '0' || c > '9')
+            return false;
+        cid = 10 * cid + (c - '0');
+    }
+    return true;
+}
+
+void
+write_channel(json_writer& w, channel const& c)
+{
+    w.begin_object();
+    w.member("cid", c.cid());
+    w.member("name", c.name());
+    w.member("users", c.user_count());
+    w.end_object();
+}
+
+void
+write_error(
+    route_response& res,
+    http::status result,
+    beast::string_view message)
+{
+    res.result = result;
+    json_writer w(res.body);
+    w.begin_object();
+    w.member("error", message);
+    w.end_object();
+}
+
+class api
+{
+    using clock_type = std::chrono::steady_clock;
+
+    server& srv_;
+    clock_type::time_point start_;
+
+public:
+    explicit
+    api(server& srv)
+        : srv_(srv)
+        , start_(clock_type::now())
+    {
+    }
+
+    // GET /api/http
+    void
+    on_http(route_request const&, route_response& res)
+    {
+        json_writer w(res.body);
+        w.begin_array();
+        for(auto lst : srv_.listeners())
+        {
+            auto const& cfg = lst->config();
+            w.begin_object();
+            w.member("name", beast::string_view(
+                cfg.name.data(), cfg.name.size()));
+            w.member("type", to_string(cfg));
+            w.member("address", cfg.address.to_string());
+            w.member("port_num", cfg.port_num);
+            w.member("sessions", lst->session_count());
+            w.end_object();
+        }
+        w.end_array();
+    }
+
+    // GET /api/channels
+    void
+    on_channels(route_request const&, route_response& res)
+    {
+        json_writer w(res.body);
+        w.begin_array();
+        for(auto const& c : srv_.channel_list().channels())
+            write_channel(w, *c);
+        w.end_array();
+    }
+
+    // GET /api/channels/{cid}
+    void
+    on_channel(route_request const& req, route_response& res)
+    {
+        std::size_t cid = 0;
+        boost::shared_ptr<channel> c;
+        if(parse_cid(req.params["cid"], cid))
+            c = srv_.channel_list().at(cid);
+        if(! c)
+            return write_error(res,
+                http::status::not_found, "Unknown channel");
+        json_writer w(res.body);
+        write_channel(w, *c);
+    }
+
+    // GET /api/stats
+    void
+    on_stats(route_request const&, route_response& res)
+    {
+        std::size_t sessions = 0;
+        for(auto lst : srv_.listeners())
+            sessions += lst->session_count();
+        auto const uptime =
+            std::chrono::duration_cast<std::chrono::seconds>(
+                clock_type::now() - start_).count();
+
+        json_writer w(res.body);
+        w.begin_object();
+        w.member("uptime", uptime);
+        w.member("sessions", sessions);
+        w.member("channels",
+            srv_.channel_list().channels().size());
+        w.member("shutting_down", srv_.is_shutting_down());
+        w.end_object();
+    }
+
+    // GET /api/rpc
+    void
+    on_rpc(route_request const&, route_response& res)
+    {
+        static char const* const names[3] = {
+            "p50", "p99", "p999" };
+
+        json_writer w(res.body);
+        w.begin_array();
+        for(auto const& s :
+            srv_.channel_list().rpc_stats().summaries())
+        {
+            w.begin_object();
+            w.member("channel", s.channel);
+            w.member("method", s.method);
+            w.member("count", s.count);
+            w.key("queue");
+            w.begin_object();
+            for(std::size_t i = 0; i < 3; ++i)
+                w.member(names[i], s.queue[i]);
+            w.end_object();
+            w.key("run");
+            w.begin_object();
+            for(std::size_t i = 0; i < 3; ++i)
+                w.member(names[i], s.run[i]);
+            w.end_object();
+            w.end_object();
+        }
+        w.end_array();
+    }
+
+    // GET /metrics
+    void
+    on_metrics(route_request const&, route_response& res)
+    {
+        res.content_type = "text/plain; version=0.0.4";
+        srv_.metrics().write(res.body);
+    }
+};
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+void
+make_api_routes(server& srv)
+{
+    // The handlers share ownership of the api
+    auto const sp = std::make_shared<api>(srv);
+    auto& r = srv.router();
+    r.insert(http::verb::get, "/api/http",
+        [sp](route_request const& req, route_response& res)
+        {
+            sp->on_http(req, res);
+        });
+    r.insert(http::verb::get, "/api/channels",
+        [sp](route_request const& req, route_response& res)
+        {
+            sp->on_channels(req, res);
+        });
+    r.insert(http::verb::get, "/api/channels/{cid}",
+        [sp](route_request const& req, route_response& res)
+        {
+            sp->on_channel(req, res);
+        });
+    r.insert(http::verb::get, "/api/stats",
+        [sp](route_request const& req, route_response& res)
+        {
+            sp->on_stats(req, res);
+        });
+    r.insert(http::verb::get, "/api/rpc",
+        [sp](route_request const& req, route_response& res)
+        {
+            sp->on_rpc(req, res);
+        });
+    r.insert(http::verb::get, "/metrics",
+        [sp](route_request const& req, route_response& res)
+        {
+            sp->on_metrics(req, res);
+        });
+}
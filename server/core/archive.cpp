@@ -0,0 +1,743 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "archive.hpp"
+#include <boost/assert.hpp>
+#include <boost/crc.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <utility>
+
+/*
+    Each segment.N file starts with the 8 byte magic number
+    "LNGCA001" and its generation, followed by records with
+    the messages, in the order they were written. The rest
+    of the file is zero, a record with a size of zero ends
+    the segment. Integers are in the byte order of the host.
+
+    Merged segments are written to segment.N.tmp, and renamed
+    over the first segment of the run. If the other segments
+    are still there after a crash, their records are skipped
+    when loading, since their numbers are not increasing, and
+    a segment with no records left is removed.
+*/
+
+namespace fs = boost::filesystem;
+namespace ipc = boost::interprocess;
+
+namespace {
+
+char const segment_magic[8] =
+    { 'L', 'N', 'G', 'C', 'A', '0', '0', '1' };
+
+// Start of the first record in a segment
+std::size_t constexpr segment_header = 32;
+
+struct record
+{
+    std::uint32_t size;         // with padding, 0 = end
+    std::uint32_t crc;          // of everything after crc
+    std::uint32_t length;       // of the message
+    std::uint32_t pad;
+    std::uint64_t cid;
+    std::uint64_t seq;
+    std::int64_t time;          // milliseconds since the epoch
+};
+
+static_assert(sizeof(record) == 40, "");
+
+std::uint32_t
+record_crc(
+    record const& r,
+    char const* body) noexcept
+{
+    boost::crc_32_type crc;
+    auto const p = reinterpret_cast<char const*>(&r);
+    crc.process_bytes(p + 8, sizeof(r) - 8);
+    crc.process_bytes(body, r.length);
+    return crc.checksum();
+}
+
+std::int64_t
+now_ms()
+{
+    return std::chrono::duration_cast<
+        std::chrono::milliseconds>(
+            std::chrono::system_clock::now().
+                time_since_epoch()).count();
+}
+
+// Return the generation of a segment file name, or zero
+std::uint64_t
+segment_gen(std::string const& name)
+{
+    if(name.compare(0, 8, "segment.") != 0 || name.size() == 8)
+        return 0;
+    std::uint64_t gen = 0;
+    for(auto it = name.begin() + 8; it != name.end(); ++it)
+    {
+        if(*it < '0' || *it > '9')
+            return 0;
+        gen = gen * 10 + (*it - '0');
+    }
+    return gen;
+}
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+struct archive::segment
+{
+    std::uint64_t gen;
+    std::string path;
+    ipc::file_mapping file;
+    ipc::mapped_region region;
+    char* data;
+    std::size_t capacity;
+
+    // Bytes which may be read
+    std::atomic<std::size_t> size;
+
+    // Used only by the writer thread
+    std::size_t synced = 0;
+    std::int64_t newest = 0;
+
+    segment(
+        std::uint64_t gen_,
+        std::string path_)
+        : gen(gen_)
+        , path(std::move(path_))
+        , file(path.c_str(), ipc::read_write)
+        , region(file, ipc::read_write)
+        , data(static_cast<char*>(region.get_address()))
+        , capacity(region.get_size())
+        , size(segment_header)
+    {
+    }
+
+    // Write the bytes up to `end` to disk
+    void
+    flush(std::size_t end)
+    {
+        if(end <= synced)
+            return;
+        region.flush(synced, end - synced, false);
+        synced = end;
+    }
+};
+
+//------------------------------------------------------------------------------
+
+archive::
+archive(
+    std::string path,
+    std::size_t segment_size,
+    duration retention)
+    : path_(std::move(path))
+    , segment_size_(segment_size < 65536 ? 65536 : segment_size)
+    , retention_(retention)
+    , open_(false)
+{
+}
+
+archive::
+~archive()
+{
+    close();
+    while(auto p = queue_.pop())
+        delete p;
+}
+
+void
+archive::
+open(beast::error_code& ec)
+{
+    BOOST_ASSERT(! thread_.joinable());
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.clear();
+        index_.clear();
+    }
+    fs::create_directories(path_, ec);
+    if(ec)
+        return;
+
+    // Load the segments in order, leftover merges are removed
+    std::vector<std::uint64_t> gens;
+    for(fs::directory_iterator it(path_, ec), end;
+        ! ec && it != end; it.increment(ec))
+    {
+        auto const name = it->path().filename().string();
+        if(it->path().extension() == ".tmp")
+        {
+            beast::error_code ec2;
+            fs::remove(it->path(), ec2);
+            continue;
+        }
+        auto const gen = segment_gen(name);
+        if(gen != 0)
+            gens.push_back(gen);
+    }
+    if(ec)
+        return;
+    std::sort(gens.begin(), gens.end());
+    for(auto gen : gens)
+    {
+        std::shared_ptr<segment> sp;
+        try
+        {
+            sp = std::make_shared<segment>(
+                gen, segment_path(gen));
+        }
+        catch(ipc::interprocess_exception const&)
+        {
+            continue;
+        }
+        if( sp->capacity < segment_header ||
+            std::memcmp(sp->data, segment_magic,
+                sizeof(segment_magic)) != 0)
+            continue;
+        if(! load(sp))
+        {
+            auto const path = sp->path;
+            sp.reset();
+            fs::remove(path, ec);
+            ec = {};
+        }
+    }
+
+    expire();
+    compact();
+
+    auto const gen = segments_.empty() ?
+        1 : segments_.rbegin()->first + 1;
+    auto sp = create_segment(gen, ec);
+    if(ec)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        segments_.emplace(gen, sp);
+        active_ = std::move(sp);
+        stop_ = false;
+    }
+    make_spare();
+    open_ = true;
+    thread_ = std::thread(&archive::run, this);
+}
+
+void
+archive::
+close()
+{
+    if(! thread_.joinable())
+        return;
+    open_ = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+    if(spare_)
+    {
+        beast::error_code ec;
+        fs::remove(spare_->path, ec);
+        spare_.reset();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    active_.reset();
+}
+
+void
+archive::
+append(
+    std::size_t cid,
+    std::uint64_t seq,
+    message m)
+{
+    if(! open_.load(std::memory_order_relaxed) || m.size() == 0)
+        return;
+    queue_.push(new pending(cid, seq, std::move(m)));
+}
+
+std::uint64_t
+archive::
+read(
+    std::size_t cid,
+    std::uint64_t before,
+    std::size_t limit,
+    std::vector<message>& v) const
+{
+    if(limit == 0)
+        return 0;
+    std::vector<point> points;
+    std::vector<std::shared_ptr<segment>> segs;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto const it = index_.find(cid);
+        if(it == index_.end())
+            return 0;
+        auto const& r = it->second.points;
+
+        // The newest messages numbered before `before`
+        auto last = r.end();
+        if(before != 0)
+            last = std::lower_bound(
+                r.begin(), r.end(), before,
+                [](point const& pt, std::uint64_t seq)
+                {
+                    return pt.seq < seq;
+                });
+        auto const n = std::min<std::size_t>(
+            limit, last - r.begin());
+        points.assign(last - n, last);
+        for(auto const& pt : points)
+        {
+            if(! segs.empty() && segs.back()->gen == pt.gen)
+                continue;
+            auto const s = segments_.find(pt.gen);
+            BOOST_ASSERT(s != segments_.end());
+            segs.push_back(s->second);
+        }
+    }
+    if(points.empty())
+        return 0;
+
+    // Read without the lock, the records were published
+    // before their points, and a segment which is removed
+    // meanwhile stays mapped until the last reference is gone.
+    v.reserve(v.size() + points.size());
+    auto s = segs.begin();
+    for(auto const& pt : points)
+    {
+        while((*s)->gen != pt.gen)
+            ++s;
+        record h;
+        std::memcpy(&h, (*s)->data + pt.offset, sizeof(h));
+        v.emplace_back(net::const_buffer(
+            (*s)->data + pt.offset + sizeof(h), h.length));
+    }
+    return points.front().seq;
+}
+
+std::uint64_t
+archive::
+first(std::size_t cid) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto const it = index_.find(cid);
+    if(it == index_.end() || it->second.points.empty())
+        return 0;
+    return it->second.points.front().seq;
+}
+
+std::uint64_t
+archive::
+last(std::size_t cid) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto const it = index_.find(cid);
+    if(it == index_.end())
+        return 0;
+    return it->second.last;
+}
+
+std::size_t
+archive::
+segments() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return segments_.size();
+}
+
+//------------------------------------------------------------------------------
+
+std::string
+archive::
+segment_path(std::uint64_t gen) const
+{
+    return (fs::path(path_) /
+        ("segment." + std::to_string(gen))).string();
+}
+
+std::shared_ptr<archive::segment>
+archive::
+create_segment(
+    std::uint64_t gen,
+    beast::error_code& ec)
+{
+    auto const path = segment_path(gen);
+    {
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        if(! f)
+        {
+            ec = boost::system::errc::make_error_code(
+                boost::system::errc::io_error);
+            return nullptr;
+        }
+    }
+    fs::resize_file(path, segment_size_, ec);
+    if(ec)
+        return nullptr;
+    try
+    {
+        auto sp = std::make_shared<segment>(gen, path);
+        std::memcpy(sp->data, segment_magic, sizeof(segment_magic));
+        std::memcpy(sp->data + 8, &gen, sizeof(gen));
+        return sp;
+    }
+    catch(ipc::interprocess_exception const& e)
+    {
+        ec = beast::error_code(e.get_native_error(),
+            boost::system::system_category());
+        return nullptr;
+    }
+}
+
+// Called with the lock held, for each record in order
+void
+archive::
+add_point(
+    std::size_t cid,
+    std::uint64_t seq,
+    std::uint64_t gen,
+    std::size_t offset)
+{
+    auto& r = index_[cid];
+    r.points.push_back({seq, gen, offset});
+    r.last = seq;
+}
+
+// Index the records of an existing segment, stopping at
+// the first one which is incomplete, as after a crash.
+// Returns `false` if no record was kept.
+bool
+archive::
+load(std::shared_ptr<segment> const& sp)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool kept = false;
+    auto off = segment_header;
+    while(off + sizeof(record) <= sp->capacity)
+    {
+        record h;
+        std::memcpy(&h, sp->data + off, sizeof(h));
+        auto const body = sp->data + off + sizeof(h);
+        if( h.size == 0 ||
+            h.size % 8 != 0 ||
+            h.size < sizeof(h) + h.length ||
+            off + h.size > sp->capacity ||
+            h.crc != record_crc(h, body))
+            break;
+        auto const it = index_.find(h.cid);
+        if(it == index_.end() || h.seq > it->second.last)
+        {
+            add_point(h.cid, h.seq, sp->gen, off);
+            if(sp->newest < h.time)
+                sp->newest = h.time;
+            kept = true;
+        }
+        off += h.size;
+    }
+    if(! kept)
+        return false;
+    sp->size = off;
+    sp->synced = off;
+    segments_.emplace(sp->gen, sp);
+    return true;
+}
+
+// Called on the writer thread with the lock held. Returns
+// `false` if the segment is full and there is no spare to
+// switch to, otherwise the message is written or dropped.
+bool
+archive::
+write(
+    pending& p,
+    std::vector<std::shared_ptr<segment>>& sealed)
+{
+    auto const it = index_.find(p.cid);
+    if(it != index_.end() && p.seq <= it->second.last)
+        return true;
+    auto const size = (sizeof(record) +
+        p.m.size() + 7) & ~std::size_t(7);
+    if(segment_header + size > segment_size_)
+        return true;
+
+    auto off = active_->size.load(std::memory_order_relaxed);
+    if(off + size > active_->capacity)
+    {
+        // Seal the segment and start the spare,
+        // the seal is flushed after the lock.
+        if(! spare_)
+            return false;
+        sealed.push_back(active_);
+        segments_.emplace(spare_->gen, spare_);
+        active_ = std::move(spare_);
+        off = active_->size.load(std::memory_order_relaxed);
+    }
+    auto& s = *active_;
+
+    record h;
+    std::memset(&h, 0, sizeof(h));
+    h.size = static_cast<std::uint32_t>(size);
+    h.length = static_cast<std::uint32_t>(p.m.size());
+    h.cid = p.cid;
+    h.seq = p.seq;
+    h.time = now_ms();
+    auto const body = s.data + off + sizeof(h);
+    net::buffer_copy(
+        net::mutable_buffer(body, p.m.size()), p.m);
+    h.crc = record_crc(h, body);
+    std::memcpy(s.data + off, &h, sizeof(h));
+    s.newest = h.time;
+    s.size.store(off + size, std::memory_order_release);
+    add_point(p.cid, p.seq, s.gen, off);
+    return true;
+}
+
+// Write everything queued in one batch, then flush it
+void
+archive::
+drain()
+{
+    std::vector<std::unique_ptr<pending>> batch;
+    while(auto p = queue_.pop())
+        batch.emplace_back(p);
+    if(batch.empty())
+        return;
+
+    // Only this thread changes the active segment, and
+    // segments are created before taking the lock.
+    std::vector<std::shared_ptr<segment>> sealed;
+    std::size_t i = 0;
+    while(i < batch.size())
+    {
+        make_spare();
+        auto const ready = spare_ != nullptr;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            while(i < batch.size() && write(*batch[i], sealed))
+                ++i;
+        }
+
+        // Without a segment to switch to, the message is dropped
+        if(! ready && i < batch.size())
+            ++i;
+    }
+    for(auto const& sp : sealed)
+        sp->flush(sp->size.load(std::memory_order_relaxed));
+    active_->flush(active_->size.load(std::memory_order_relaxed));
+
+    // Ready for the next rotation
+    make_spare();
+}
+
+// Called on the writer thread, without the lock
+void
+archive::
+make_spare()
+{
+    if(spare_)
+        return;
+    beast::error_code ec;
+    spare_ = create_segment(active_->gen + 1, ec);
+}
+
+// Remove the oldest segments while they are past retention
+void
+archive::
+expire()
+{
+    auto const cutoff = now_ms() -
+        std::chrono::duration_cast<
+            std::chrono::milliseconds>(retention_).count();
+    std::vector<std::string> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        while(! segments_.empty())
+        {
+            auto const it = segments_.begin();
+            auto const& sp = it->second;
+            if(sp == active_ || sp->newest >= cutoff)
+                break;
+            auto const gen = sp->gen;
+            removed.push_back(sp->path);
+            segments_.erase(it);
+
+            // Points are in order, so these are at the front
+            auto r = index_.begin();
+            while(r != index_.end())
+            {
+                auto& v = r->second.points;
+                auto p = v.begin();
+                while(p != v.end() && p->gen <= gen)
+                    ++p;
+                v.erase(v.begin(), p);
+                if(v.empty())
+                    r = index_.erase(r);
+                else
+                    ++r;
+            }
+        }
+    }
+    for(auto const& path : removed)
+    {
+        beast::error_code ec;
+        fs::remove(path, ec);
+    }
+}
+
+// Merge runs of sealed segments which are less than half
+// full, into the first segment of the run.
+void
+archive::
+compact()
+{
+    for(;;)
+    {
+        std::vector<std::shared_ptr<segment>> run;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::size_t total = segment_header;
+            for(auto const& e : segments_)
+            {
+                auto const& sp = e.second;
+                auto const n = sp->size.load() - segment_header;
+                if( sp == active_ ||
+                    sp->size.load() > segment_size_ / 2 ||
+                    total + n > segment_size_)
+                {
+                    if(run.size() > 1)
+                        break;
+                    run.clear();
+                    total = segment_header;
+                    if( sp == active_ ||
+                        sp->size.load() > segment_size_ / 2)
+                        continue;
+                }
+                run.push_back(sp);
+                total += n;
+            }
+        }
+        if(run.size() < 2)
+            return;
+
+        // Copy the records, which only move by an offset
+        auto const gen = run.front()->gen;
+        auto const tmp = segment_path(gen) + ".tmp";
+        std::shared_ptr<segment> dest;
+        std::unordered_map<std::uint64_t, std::size_t> delta;
+        try
+        {
+            {
+                std::ofstream f(tmp,
+                    std::ios::binary | std::ios::trunc);
+                if(! f)
+                    return;
+            }
+            beast::error_code ec;
+            fs::resize_file(tmp, segment_size_, ec);
+            if(ec)
+                return;
+            dest = std::make_shared<segment>(gen, tmp);
+            std::memcpy(dest->data, segment_magic, sizeof(segment_magic));
+            std::memcpy(dest->data + 8, &gen, sizeof(gen));
+            std::size_t off = segment_header;
+            for(auto const& sp : run)
+            {
+                auto const n = sp->size.load() - segment_header;
+                std::memcpy(dest->data + off,
+                    sp->data + segment_header, n);
+                delta[sp->gen] = off - segment_header;
+                off += n;
+                if(dest->newest < sp->newest)
+                    dest->newest = sp->newest;
+            }
+            dest->size = off;
+            dest->flush(off);
+        }
+        catch(ipc::interprocess_exception const&)
+        {
+            beast::error_code ec;
+            fs::remove(tmp, ec);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            beast::error_code ec;
+            fs::rename(tmp, segment_path(gen), ec);
+            if(ec)
+            {
+                fs::remove(tmp, ec);
+                return;
+            }
+            dest->path = segment_path(gen);
+            for(auto const& sp : run)
+                segments_.erase(sp->gen);
+            segments_.emplace(gen, dest);
+            for(auto& r : index_)
+            {
+                for(auto& pt : r.second.points)
+                {
+                    auto const it = delta.find(pt.gen);
+                    if(it == delta.end())
+                        continue;
+                    pt.gen = gen;
+                    pt.offset += it->second;
+                }
+            }
+        }
+        for(std::size_t i = 1; i < run.size(); ++i)
+        {
+            beast::error_code ec;
+            fs::remove(run[i]->path, ec);
+        }
+    }
+}
+
+// The writer thread
+void
+archive::
+run()
+{
+    // Messages queued within this interval share one flush
+    auto const interval = std::chrono::milliseconds(5);
+    auto const maintenance = std::chrono::minutes(1);
+
+    auto next = std::chrono::steady_clock::now() + maintenance;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(;;)
+    {
+        cv_.wait_for(lock, interval,
+            [this]
+            {
+                return stop_;
+            });
+        auto const stop = stop_;
+        lock.unlock();
+        drain();
+        auto const now = std::chrono::steady_clock::now();
+        if(! stop && now >= next)
+        {
+            expire();
+            compact();
+            next = now + maintenance;
+        }
+        lock.lock();
+        if(stop)
+            break;
+    }
+}
@@ -0,0 +1,223 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_ARCHIVE_HPP
+#define LOUNGE_ARCHIVE_HPP
+
+#include "config.hpp"
+#include "message.hpp"
+#include "mpsc_queue.hpp"
+#include <boost/beast/core/error.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** The messages broadcast by the rooms, kept on disk.
+
+    Messages are appended to segment files of a fixed size,
+    which are memory mapped. Appending only pushes the message
+    on a lock-free queue, and a background thread writes the
+    queued messages in batches, so a broadcast never waits.
+
+    Each room has an index with the location of each of its
+    messages. Reading the messages before a number finds the
+    newest of them with a binary search, and then reads only
+    the records of that room, however busy the others are.
+
+    Segments older than the retention period are deleted,
+    and runs of small segments, as left by restarts, are
+    merged into one. This is done when opening, and then
+    in the background once a minute.
+*/
+class archive
+{
+public:
+    using duration = std::chrono::hours;
+
+    /** Constructor
+
+        @param path The directory holding the segments.
+
+        @param segment_size The size of each segment file.
+
+        @param retention How long messages are kept.
+    */
+    explicit
+    archive(
+        std::string path = "archive",
+        std::size_t segment_size = 16 * 1024 * 1024,
+        duration retention = std::chrono::hours(24 * 30));
+
+    ~archive();
+
+    /// Return the directory holding the segments
+    std::string const&
+    path() const noexcept
+    {
+        return path_;
+    }
+
+    /// Load the index and start the writer thread
+    void
+    open(beast::error_code& ec);
+
+    /** Write the queued messages and stop the writer thread.
+
+        Messages may still be read afterwards.
+    */
+    void
+    close();
+
+    /** Queue a message for writing.
+
+        This does not block, and may be called from any
+        thread. Nothing is kept if the archive is not open.
+
+        @param cid The channel which sent the message.
+
+        @param seq The number of the message in the channel.
+        Messages of a channel must be appended in the order
+        of their numbers, a message numbered at or below the
+        last one written is dropped.
+    */
+    void
+    append(
+        std::size_t cid,
+        std::uint64_t seq,
+        message m);
+
+    /** Return messages of a channel, oldest first.
+
+        @param before Only messages numbered less than this
+        are returned, or the newest ones if this is zero.
+
+        @param limit The largest number of messages returned.
+
+        @param v The vector to receive the messages.
+
+        @return The number of the first message returned,
+        or zero if there are none.
+    */
+    std::uint64_t
+    read(
+        std::size_t cid,
+        std::uint64_t before,
+        std::size_t limit,
+        std::vector<message>& v) const;
+
+    /// Return the number of the oldest message kept for a channel
+    std::uint64_t
+    first(std::size_t cid) const;
+
+    /// Return the number of the newest message written for a channel
+    std::uint64_t
+    last(std::size_t cid) const;
+
+    /// Return the number of segment files
+    std::size_t
+    segments() const;
+
+private:
+    struct segment;
+
+    struct pending : mpsc_node
+    {
+        std::size_t cid;
+        std::uint64_t seq;
+        message m;
+
+        pending(
+            std::size_t cid_,
+            std::uint64_t seq_,
+            message m_)
+            : cid(cid_)
+            , seq(seq_)
+            , m(std::move(m_))
+        {
+        }
+    };
+
+    struct point
+    {
+        std::uint64_t seq;
+        std::uint64_t gen;
+        std::size_t offset;
+    };
+
+    struct room_index
+    {
+        std::vector<point> points;
+        std::uint64_t last = 0;
+    };
+
+    std::string const path_;
+    std::size_t const segment_size_;
+    duration const retention_;
+
+    std::mutex mutable mutex_;
+    std::condition_variable cv_;
+    std::map<std::uint64_t,
+        std::shared_ptr<segment>> segments_;
+    std::unordered_map<std::size_t, room_index> index_;
+    std::shared_ptr<segment> active_;
+    std::shared_ptr<segment> spare_;    // writer thread only
+    mpsc_queue<pending> queue_;
+    std::atomic<bool> open_;
+    bool stop_ = false;
+    std::thread thread_;
+
+    std::string
+    segment_path(std::uint64_t gen) const;
+
+    std::shared_ptr<segment>
+    create_segment(
+        std::uint64_t gen,
+        beast::error_code& ec);
+
+    void
+    add_point(
+        std::size_t cid,
+        std::uint64_t seq,
+        std::uint64_t gen,
+        std::size_t offset);
+
+    bool
+    load(
+        std::shared_ptr<segment> const& sp);
+
+    bool
+    write(
+        pending& p,
+        std::vector<std::shared_ptr<segment>>& sealed);
+
+    void
+    drain();
+
+    void
+    make_spare();
+
+    void
+    expire();
+
+    void
+    compact();
+
+    void
+    run();
+};
+
+#endif
@@ -0,0 +1,157 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_ARENA_HPP
+#define LOUNGE_ARENA_HPP
+
+#include "config.hpp"
+#include <boost/assert.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+/** A buffer which hands out memory in increasing order.
+
+    Allocations are not reclaimed individually. Once every
+    allocation has been returned, the whole buffer is used
+    again from the start, so a series of short-lived objects
+    which are destroyed together never touch the heap.
+    Requests which do not fit are passed on to the heap.
+
+    This is not thread-safe.
+*/
+class arena
+{
+    std::unique_ptr<char[]> buf_;
+    std::size_t size_;
+    std::size_t used_ = 0;
+    std::size_t live_ = 0;
+
+public:
+    arena(arena const&) = delete;
+    arena& operator=(arena const&) = delete;
+
+    explicit
+    arena(std::size_t size)
+        : buf_(new char[size])
+        , size_(size)
+    {
+    }
+
+    ~arena()
+    {
+        BOOST_ASSERT(live_ == 0);
+    }
+
+    /// Return the number of bytes in the buffer which are in use
+    std::size_t
+    used() const noexcept
+    {
+        return used_;
+    }
+
+    void*
+    allocate(
+        std::size_t n,
+        std::size_t align)
+    {
+        auto const base =
+            reinterpret_cast<std::uintptr_t>(buf_.get());
+        auto const pos = ((base + used_ + align - 1) &
+            ~(static_cast<std::uintptr_t>(align) - 1)) - base;
+        if(pos + n > size_)
+            return ::operator new(n);
+        used_ = pos + n;
+        ++live_;
+        return buf_.get() + pos;
+    }
+
+    void
+    deallocate(void* p) noexcept
+    {
+        auto const c = static_cast<char*>(p);
+        if(c < buf_.get() || c >= buf_.get() + size_)
+            return ::operator delete(p);
+        BOOST_ASSERT(live_ > 0);
+        if(--live_ == 0)
+            used_ = 0;
+    }
+};
+
+/// An Allocator which uses an @ref arena
+template<class T>
+class arena_allocator
+{
+    arena* a_;
+
+public:
+    using value_type = T;
+
+    template<class U>
+    struct rebind
+    {
+        using other = arena_allocator<U>;
+    };
+
+    explicit
+    arena_allocator(arena& a) noexcept
+        : a_(&a)
+    {
+    }
+
+    template<class U>
+    arena_allocator(
+        arena_allocator<U> const& other) noexcept
+        : a_(&other.get_arena())
+    {
+    }
+
+    /// Return the arena
+    arena&
+    get_arena() const noexcept
+    {
+        return *a_;
+    }
+
+    T*
+    allocate(std::size_t n)
+    {
+        return static_cast<T*>(a_->allocate(
+            n * sizeof(T), alignof(T)));
+    }
+
+    void
+    deallocate(T* p, std::size_t) noexcept
+    {
+        a_->deallocate(p);
+    }
+
+    template<class U>
+    friend
+    bool
+    operator==(
+        arena_allocator const& lhs,
+        arena_allocator<U> const& rhs) noexcept
+    {
+        return &lhs.get_arena() == &rhs.get_arena();
+    }
+
+    template<class U>
+    friend
+    bool
+    operator!=(
+        arena_allocator const& lhs,
+        arena_allocator<U> const& rhs) noexcept
+    {
+        return &lhs.get_arena() != &rhs.get_arena();
+    }
+};
+
+#endif
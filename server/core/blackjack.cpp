@@ -9,15 +9,25 @@
 
 #include "channel.hpp"
 #include "channel_list.hpp"
+#include "ledger.hpp"
+#include "logger.hpp"
 #include "rpc.hpp"
 #include "server.hpp"
 #include "service.hpp"
+#include "stake.hpp"
+#include "timer_wheel.hpp"
 #include "types.hpp"
 #include "user.hpp"
+#include "blackjack/game.hpp"
 #include <boost/json/value.hpp>
 #include <boost/beast/core/static_string.hpp>
 #include <boost/make_unique.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
 #include <functional>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
 #include <vector>
 #include <utility>
 
@@ -31,7 +41,8 @@ enum class error
     already_playing,
     already_leaving,
     no_open_seat,
-    no_more_bets
+    no_more_bets,
+    not_enough_chips
 };
 
 } // (anon)
@@ -71,6 +82,8 @@ public:
             "No open seat";
         case error::no_more_bets: return
             "No more bets";
+        case error::not_enough_chips: return
+            "Not enough chips";
         }
     }
 
@@ -93,119 +106,13 @@ make_error_code(error e)
 
 //------------------------------------------------------------------------------
 
-class shoe
-{
-    std::vector<char> cards_;
-    std::vector<char>::iterator pos_;
-
-public:
-    explicit
-    shoe(int decks)
-    {
-        cards_.resize(decks * 52);
-        shuffle();
-    }
-
-    void
-    shuffle()
-    {
-        for(std::size_t i = 0;
-            i < cards_.size(); ++i)
-        {
-            cards_[i] = 1 + (i % 52);
-        }
-        for(std::size_t i = 0;
-            i < cards_.size() - 1; ++i)
-        {
-            auto const j = i +
-                (rand() % (cards_.size() - i));
-            std::swap(
-                cards_[i], cards_[j]);
-        }
-        pos_ = cards_.begin();
-    }
-
-    char
-    deal()
-    {
-        if(pos_ == cards_.end())
-            shuffle();
-        return *pos_++;
-    }
-};
+using blackjack::shoe;
 
 //------------------------------------------------------------------------------
 
-struct hand
+// A hand of the shared engine, with its JSON representation
+struct hand : blackjack::hand
 {
-    // cards[0]==0 for hole card
-    beast::static_string<22> cards;
-    int wager = 0;
-    bool busted = false;
-    bool twenty_one = false;
-    bool blackjack = false;
-
-    void
-    clear()
-    {
-        cards.clear();
-        wager = 0;
-        busted = false;
-        twenty_one = false;
-        blackjack = false;
-    }
-
-    // Returns the value of a card,
-    // always returns 1 for aces
-    static
-    int
-    value(char c)
-    {
-        auto v = 1 + ((c - 1) % 13);
-        if( v > 10)
-            v = 10;
-        return v;
-    }
-
-    void
-    eval()
-    {
-        int aces = 0;
-        int total = 0;
-        for(auto c : cards)
-        {
-            if(c != 1)
-            {
-                total += c;
-            }
-            else
-            {
-                ++aces;
-                total += 11;
-            }
-        }
-        while(total > 21 && aces--)
-            total -= 10;
-
-        busted = total > 21;
-        twenty_one = total == 21;
-        blackjack =
-            twenty_one &&
-            cards.size() == 2;
-    }
-
-    void
-    deal(shoe& s)
-    {
-        cards.push_back(s.deal());
-    }
-
-    bool
-    is_finished() const
-    {
-        return busted || twenty_one;
-    }
-
     void
     to_json(json::value& jv) const
     {
@@ -234,8 +141,7 @@ struct seat
     user* u = nullptr;
     state_t state = open;
     std::vector<hand> hands;
-    int chips;
-    int wager = 0;
+    ::stake stake;
 
     seat()
     {
@@ -246,8 +152,6 @@ struct seat
     clear()
     {
         hands[0].clear();
-        wager = 0;
-        chips = 1000;
     }
 
     void
@@ -264,21 +168,21 @@ struct seat
         case waiting:
             obj.emplace("state", "waiting");
             obj.emplace("user", u->name);
-            obj.emplace("chips", chips);
+            obj.emplace("chips", stake.chips());
             break;
 
         case playing:
             obj.emplace("state", "playing");
             obj.emplace("user", u->name);
-            obj.emplace("chips", chips);
-            obj.emplace("wager", wager);
+            obj.emplace("chips", stake.chips());
+            obj.emplace("wager", stake.wager());
             break;
 
         case leaving:
             obj.emplace("state", "leaving");
             obj.emplace("user", u->name);
-            obj.emplace("chips", chips);
-            obj.emplace("wager", wager);
+            obj.emplace("chips", stake.chips());
+            obj.emplace("wager", stake.wager());
             break;
 
         case open:
@@ -315,16 +219,39 @@ public:
 
     game(
         callback& cb,
-        int decks)
+        ::ledger& lg,
+        int seats,
+        int decks,
+        std::uint64_t seed)
         : cb_(cb)
-        , shoe_(decks)
+        , ledger_(lg)
+        , shoe_(decks, seed)
     {
         BOOST_ASSERT(
             decks >= 1 && decks <= 6);
-        seat_.resize(6);
+        BOOST_ASSERT(seats >= 1);
+        seat_.resize(seats + 1);
         seat_[0].state = seat::dealer;
     }
 
+    // Return the number of seats nobody is using
+    int
+    open_seats() const
+    {
+        int n = 0;
+        for(auto const& s : seat_)
+            n += s.state == seat::open;
+        return n;
+    }
+
+    // Return `true` if every player seat is open
+    bool
+    is_empty() const
+    {
+        return open_seats() + 1 ==
+            static_cast<int>(seat_.size());
+    }
+
     // Advance the game state, invoking
     // any appropriate callbacks.
     void
@@ -350,6 +277,7 @@ public:
             {
                 s.u = &u;
                 s.state = seat::playing;
+                s.stake.sit(ledger_, u.name);
                 ec.clear();
                 return &s - &seat_.front();
             }
@@ -376,11 +304,14 @@ public:
         {
         case seat::waiting:
             seat_[i].state = seat::open;
+            seat_[i].stake.refund();
             return 2;
 
         case seat::playing:
+            // There is no round to finish yet,
+            // so the wager is given back now.
             seat_[i].state = seat::leaving;
-            // TEMPORARY
+            seat_[i].stake.refund();
             seat_[i].clear();
             return 1;
         
@@ -402,6 +333,8 @@ public:
         if(! i)
             return -1;
         seat_[i].state = seat::open;
+        seat_[i].stake.refund();
+        seat_[i].clear();
         return 1;
     }
 
@@ -424,9 +357,14 @@ public:
         case seat::leaving:
             break;
         }
+        // The ledger journals the wager,
+        // without waiting for the disk.
         int const size = 5;
-        seat_[i].wager += size;
-        seat_[i].chips -= size;
+        if(! seat_[i].stake.bet(size))
+        {
+            ec = error::not_enough_chips;
+            return;
+        }
         cb_.on_game_bet();
     }
 
@@ -467,6 +405,7 @@ public:
 
 private:
     callback& cb_;
+    ::ledger& ledger_;
     shoe shoe_;
 
     std::vector<seat> seat_; // 0 = dealer
@@ -507,6 +446,153 @@ private:
 
 //------------------------------------------------------------------------------
 
+/** The channel listing the tables.
+
+    The lobby keeps an index of the open seats at each
+    table, which the tables update as players come and
+    go, so finding a seat never visits every table.
+    Tables are created when no seat is open.
+*/
+class lobby : public channel
+{
+    server& srv_;
+    std::uint64_t seed_;
+    unsigned spectator_rate_;
+    std::mutex mutable mutex_;
+
+    // cid to open seats, for every table
+    std::unordered_map<std::size_t, int> open_;
+
+    // (open seats, cid) for tables with an open seat
+    std::set<std::pair<int, std::size_t>> avail_;
+
+public:
+    static int constexpr seats = 5;
+    static std::size_t constexpr max_tables = 10000;
+
+    lobby(
+        server& srv,
+        std::uint64_t seed,
+        unsigned spectator_rate)
+        : channel(
+            3,
+            "Blackjack",
+            srv.channel_list())
+        , srv_(srv)
+        , seed_(seed)
+        , spectator_rate_(spectator_rate)
+    {
+    }
+
+    // Called by a table when its open seats change
+    void
+    update(std::size_t cid, int open);
+
+    // Called by a table when it is reclaimed
+    void
+    remove(std::size_t cid);
+
+private:
+    //--------------------------------------------------------------------------
+    //
+    // channel
+    //
+    //--------------------------------------------------------------------------
+
+    beast::string_view
+    type() const noexcept override
+    {
+        return "lobby";
+    }
+
+    void
+    on_insert(user& u) override
+    {
+        json::value jv(json::object_kind);
+        auto& obj = jv.get_object();
+        obj["cid"] = cid();
+        obj["verb"] = "tables";
+        obj["tables"] = tables();
+        u.send(jv);
+    }
+
+    void
+    on_erase(user&) override
+    {
+    }
+
+    void
+    on_dispatch(rpc_call& rpc) override
+    {
+        if(rpc.method == "tables")
+        {
+            rpc.result = tables();
+            rpc.complete();
+        }
+        else if(rpc.method == "play")
+        {
+            checked_user(rpc);
+            json::value jv(json::object_kind);
+            jv.get_object()["table"] = find_or_create(rpc);
+            rpc.result = std::move(jv);
+            rpc.complete();
+        }
+        else
+        {
+            rpc.fail(rpc_code::method_not_found);
+        }
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // lobby
+    //
+    //--------------------------------------------------------------------------
+
+    // Return the open seats of every table
+    json::value
+    tables() const
+    {
+        json::value jv(json::array_kind);
+        auto& arr = jv.get_array();
+        std::lock_guard<std::mutex> lock(mutex_);
+        arr.reserve(open_.size());
+        for(auto const& e : open_)
+        {
+            json::value t(json::object_kind);
+            auto& obj = t.get_object();
+            obj["table"] = e.first;
+            obj["open"] = e.second;
+            arr.emplace_back(std::move(t));
+        }
+        return jv;
+    }
+
+    // Broadcast a change to one table
+    void
+    notify(std::size_t cid, int open)
+    {
+        json::value jv(json::object_kind);
+        auto& obj = jv.get_object();
+        obj["cid"] = this->cid();
+        obj["verb"] = "table";
+        obj["table"] = cid;
+        if(open >= 0)
+            obj["open"] = open;
+        else
+            obj["open"] = nullptr;
+        send(jv);
+    }
+
+    std::size_t
+    find_or_create(rpc_call& rpc);
+};
+
+int constexpr lobby::seats;
+std::size_t constexpr lobby::max_tables;
+
+//------------------------------------------------------------------------------
+
 class table
     : public channel
     , public game::callback
@@ -515,48 +601,111 @@ class table
         std::lock_guard<std::mutex>;
    
     server& srv_;
-    timer_type timer_;
+    boost::shared_ptr<lobby> lobby_;
+    executor_type strand_;
+    wheel_timer timer_;
+    wheel_timer snapshot_timer_;
+    timer_wheel::duration snapshot_interval_;
     std::mutex mutable mutex_;
+    std::uint64_t seed_;
     game g_;
+    int open_;
+    bool idle_ = false;
+    bool closed_ = false;
+    bool snapshot_pending_ = false;
 
 public:
-    explicit
-    table(server& srv)
+    // Each table has its own strand, so the tables are
+    // spread over the I/O threads. The seed of the shoe
+    // is logged, so any game can be replayed from it.
+    // Spectators are sent at most `spectator_rate`
+    // snapshots of the game per second.
+    table(
+        server& srv,
+        boost::shared_ptr<lobby> lb,
+        std::size_t cid,
+        int seats,
+        std::uint64_t seed,
+        unsigned spectator_rate)
         :  channel(
-            3,
-            "Blackjack",
+            cid,
+            "Table " + std::to_string(cid),
             srv.channel_list())
         , srv_(srv)
-        , timer_(srv.make_executor())
-        , g_(*this, 1)
+        , lobby_(std::move(lb))
+        , strand_(srv.make_executor())
+        , timer_(srv.timer_wheel())
+        , snapshot_timer_(srv.timer_wheel())
+        , snapshot_interval_(1000 / spectator_rate)
+        , seed_(seed ? seed + cid : blackjack::make_seed())
+        , g_(*this, srv.ledger(), seats, 1, seed_)
+        , open_(seats)
+    {
+        set_default_tier(tier::spectator);
+        auto& log = srv_.log().get_section("blackjack");
+        LOG_INF(log, "table ", cid, "\tseed ", seed_);
+    }
+
+    // Start the idle timer
+    void
+    run()
     {
-        boost::ignore_unused(srv_);
+        post(&table::on_timer);
     }
 
+
 private:
-    // Post a call to the strand
-    template<class... Args>
+    // Post a member function call to the strand. The table
+    // is kept alive until the call, since it may be reclaimed.
+    template<class F, class... Args>
     void
-    post(Args&&... args)
+    post(F f, Args&&... args)
     {
         net::post(
-            timer_.get_executor(),
+            strand_,
             beast::bind_front_handler(
+                f,
+                boost::shared_from(this),
                 std::forward<Args>(args)...));
     }
 
+    // Post an RPC call to the strand
+    void
+    post_rpc(
+        void (table::*f)(rpc_call&&),
+        rpc_call&& rpc)
+    {
+        post(&table::on_rpc, f, std::move(rpc));
+    }
+
+    // Time spent waiting for the strand is
+    // recorded separately from the handler.
+    void
+    on_rpc(
+        void (table::*f)(rpc_call&&),
+        rpc_call&& rpc)
+    {
+        rpc.start();
+        (this->*f)(std::move(rpc));
+    }
+
     //--------------------------------------------------------------------------
     //
     // channel
     //
     //--------------------------------------------------------------------------
 
+    beast::string_view
+    type() const noexcept override
+    {
+        return "blackjack";
+    }
+
     void
     on_insert(user& u) override
     {
         post(
             &table::do_insert,
-            this,
             boost::shared_from(&u));
     }
 
@@ -565,7 +714,6 @@ private:
     {
         post(
             &table::do_erase,
-            this,
             std::reference_wrapper<user>(u));
     }
 
@@ -574,27 +722,27 @@ private:
     {
         if(rpc.method == "play")
         {
-            post(&table::do_play, this, std::move(rpc));
+            post_rpc(&table::do_play, std::move(rpc));
         }
         else if(rpc.method == "watch")
         {
-            post(&table::do_watch, this, std::move(rpc));
+            post_rpc(&table::do_watch, std::move(rpc));
         }
         else if(rpc.method == "bet")
         {
-            post(&table::do_bet, this, std::move(rpc));
+            post_rpc(&table::do_bet, std::move(rpc));
         }
         else if(rpc.method == "start")
         {
-            post(&table::do_start, this, std::move(rpc));
+            post_rpc(&table::do_start, std::move(rpc));
         }
         else if(rpc.method == "hit")
         {
-            post(&table::do_hit, this, std::move(rpc));
+            post_rpc(&table::do_hit, std::move(rpc));
         }
         else if(rpc.method == "stand")
         {
-            post(&table::do_stand, this, std::move(rpc));
+            post_rpc(&table::do_stand, std::move(rpc));
         }
         else
         {
@@ -608,6 +756,8 @@ private:
     //
     //--------------------------------------------------------------------------
 
+    // Players see every change, spectators
+    // see the latest state at a bounded rate.
     void
     update(beast::string_view action)
     {
@@ -617,32 +767,89 @@ private:
         obj["verb"] = "update";
         obj["action"] = action;
         obj["game"] = json::to_value(g_);
-        send(jv);
+        send_live(jv);
+        schedule_snapshot();
     }
 
     void
-    on_timer(beast::error_code ec)
+    schedule_snapshot()
     {
-        if(ec == net::error::operation_aborted)
+        if(snapshot_pending_)
             return;
+        snapshot_pending_ = true;
+        boost::weak_ptr<table> wp = boost::weak_from(this);
+        snapshot_timer_.expires_after(snapshot_interval_,
+            [wp]
+            {
+                if(auto sp = wp.lock())
+                    sp->post(&table::on_snapshot);
+            });
+    }
 
-        if(ec)
-        {
-            // log error
-            BOOST_ASSERT(! ec);
-        }
+    void
+    on_snapshot()
+    {
+        snapshot_pending_ = false;
+        if(closed_)
+            return;
+        json::value jv(json::object_kind);
+        auto& obj = jv.get_object();
+        obj["cid"] = cid();
+        obj["verb"] = "update";
+        obj["action"] = "snapshot";
+        obj["game"] = json::to_value(g_);
+        send_snapshot(jv);
+    }
 
-        if(srv_.is_shutting_down())
+    void
+    on_timer()
+    {
+        if(srv_.is_shutting_down() || closed_)
             return;
 
-        //g_.tick();
+        // A table is reclaimed if nobody joined it
+        // for a whole period of the timer.
+        if(idle_)
+            maybe_reclaim();
+        if(closed_)
+            return;
+        idle_ = true;
 
-        timer_.expires_after(
-            std::chrono::seconds(1));
-        timer_.async_wait(
-            beast::bind_front_handler(
-                &table::on_timer,
-                this));
+        // The timer is on the server's wheel, which
+        // invokes the handler outside of our strand.
+        boost::weak_ptr<table> wp = boost::weak_from(this);
+        timer_.expires_after(std::chrono::seconds(60),
+            [wp]
+            {
+                if(auto sp = wp.lock())
+                    sp->post(&table::on_timer);
+            });
+    }
+
+    // Tell the lobby if the number of open seats changed
+    void
+    update_lobby()
+    {
+        auto const open = g_.open_seats();
+        if(open == open_)
+            return;
+        open_ = open;
+        lobby_->update(cid(), open);
+    }
+
+    // Remove the table once nobody is in it
+    void
+    maybe_reclaim()
+    {
+        if(closed_ || user_count() > 0 || ! g_.is_empty())
+            return;
+        closed_ = true;
+        timer_.cancel();
+        snapshot_timer_.cancel();
+        lobby_->remove(cid());
+        srv_.channel_list().erase(*this);
+        auto& log = srv_.log().get_section("blackjack");
+        LOG_INF(log, "table ", cid(), "\treclaimed");
     }
 
     //--------------------------------------------------------------------------
@@ -650,6 +857,15 @@ private:
     void
     do_insert(boost::shared_ptr<user> sp)
     {
+        // The lobby may have handed out the table
+        // just before it was reclaimed.
+        if(closed_)
+        {
+            erase(*sp);
+            return;
+        }
+        idle_ = false;
+
         json::value jv(json::object_kind);
         auto& obj = jv.get_object();
         obj["cid"] = cid();
@@ -665,6 +881,8 @@ private:
         auto const result = g_.surrender(u);
         if(result == 1)
             update("surrender");
+        update_lobby();
+        maybe_reclaim();
     }
 
     void
@@ -673,11 +891,16 @@ private:
         try
         {
             // TODO Optional seat choice
+            checked_user(rpc);
+            if(! is_joined(*rpc.u))
+                rpc.fail("Not in channel");
             beast::error_code ec;
             g_.join(*rpc.u, ec);
             if(ec)
                 rpc.fail(ec.message());
+            set_tier(*rpc.u, tier::live);
             update("play");
+            update_lobby();
             rpc.complete();
         }
         catch(rpc_error const& e)
@@ -695,7 +918,9 @@ private:
             g_.leave(*rpc.u, ec);
             if(ec)
                 rpc.fail(ec.message());
+            set_tier(*rpc.u, tier::spectator);
             update("watch");
+            update_lobby();
             rpc.complete();
         }
         catch(rpc_error const& e)
@@ -785,15 +1010,101 @@ private:
 
 //------------------------------------------------------------------------------
 
+void
+lobby::
+update(std::size_t cid, int open)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = open_.find(cid);
+        if(it == open_.end() || it->second == open)
+            return;
+        if(it->second > 0)
+            avail_.erase({it->second, cid});
+        if(open > 0)
+            avail_.emplace(open, cid);
+        it->second = open;
+    }
+    notify(cid, open);
+}
+
+void
+lobby::
+remove(std::size_t cid)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = open_.find(cid);
+        if(it == open_.end())
+            return;
+        if(it->second > 0)
+            avail_.erase({it->second, cid});
+        open_.erase(it);
+    }
+    notify(cid, -1);
+}
+
+// Fill the fullest table with an open seat first,
+// so players are not spread thinly over many tables.
+std::size_t
+lobby::
+find_or_create(rpc_call& rpc)
+{
+    // The slot is reserved with the lock held, and the
+    // table is created without it. It is offered to other
+    // players once it is in the channel list.
+    auto& list = srv_.channel_list();
+    std::size_t cid;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(! avail_.empty())
+            return avail_.begin()->second;
+        if(open_.size() >= max_tables)
+            rpc.fail("No tables available");
+        cid = list.next_cid();
+        open_.emplace(cid, seats);
+    }
+    try
+    {
+        ::insert<table>(list, srv_,
+            boost::shared_from(this),
+            cid, seats, seed_, spectator_rate_);
+    }
+    catch(...)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_.erase(cid);
+        throw;
+    }
+    boost::static_pointer_cast<table>(
+        list.at(cid))->run();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto const it = open_.find(cid);
+        if(it != open_.end() && it->second > 0)
+            avail_.emplace(it->second, cid);
+    }
+    notify(cid, seats);
+    return cid;
+}
+
+//------------------------------------------------------------------------------
+
 class blackjack_service
     : public service
 {
     server& srv_;
+    std::uint64_t seed_;
+    unsigned spectator_rate_;
 
 public:
     blackjack_service(
-        server& srv)
+        server& srv,
+        std::uint64_t seed,
+        unsigned spectator_rate)
         : srv_(srv)
+        , seed_(seed)
+        , spectator_rate_(spectator_rate)
     {
     }
 
@@ -806,7 +1117,8 @@ public:
     void
     on_start() override
     {
-        insert<table>(srv_.channel_list(), srv_);
+        insert<lobby>(srv_.channel_list(),
+            srv_, seed_, spectator_rate_);
     }
 
     void
@@ -821,7 +1133,10 @@ public:
 
 void
 make_blackjack_service(
-    server& srv)
+    server& srv,
+    std::uint64_t seed,
+    unsigned spectator_rate)
 {
-    srv.insert(boost::make_unique<blackjack_service>(srv));
+    srv.insert(boost::make_unique<blackjack_service>(
+        srv, seed, spectator_rate));
 }
@@ -0,0 +1,60 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "buffer_pool.hpp"
+
+pooled_buffer::
+~pooled_buffer()
+{
+    if(s_)
+        pool_->release(std::move(s_));
+}
+
+//------------------------------------------------------------------------------
+
+buffer_pool::
+buffer_pool(
+    std::size_t max_count,
+    std::size_t max_capacity)
+    : max_count_(max_count)
+    , max_capacity_(max_capacity)
+{
+    // So that release never allocates
+    v_.reserve(max_count_);
+}
+
+pooled_buffer
+buffer_pool::
+acquire()
+{
+    std::unique_ptr<std::string> s;
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        if(! v_.empty())
+        {
+            s = std::move(v_.back());
+            v_.pop_back();
+        }
+    }
+    if(! s)
+        s.reset(new std::string);
+    return pooled_buffer(*this, std::move(s));
+}
+
+void
+buffer_pool::
+release(std::unique_ptr<std::string> s) noexcept
+{
+    if(s->capacity() > max_capacity_)
+        return;
+    s->clear();
+    std::lock_guard<std::mutex> lock(m_);
+    if(v_.size() < max_count_)
+        v_.emplace_back(std::move(s));
+}
@@ -0,0 +1,165 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_BUFFER_POOL_HPP
+#define LOUNGE_BUFFER_POOL_HPP
+
+#include "config.hpp"
+#include <boost/beast/http/message.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+class buffer_pool;
+
+/** A string borrowed from a @ref buffer_pool.
+
+    The string is returned to the pool on destruction,
+    keeping its capacity for the next borrower.
+*/
+class pooled_buffer
+{
+    friend class buffer_pool;
+
+    buffer_pool* pool_ = nullptr;
+    std::unique_ptr<std::string> s_;
+
+    pooled_buffer(
+        buffer_pool& pool,
+        std::unique_ptr<std::string> s) noexcept
+        : pool_(&pool)
+        , s_(std::move(s))
+    {
+    }
+
+public:
+    pooled_buffer() = default;
+    pooled_buffer(pooled_buffer&&) = default;
+
+    ~pooled_buffer();
+
+    pooled_buffer&
+    operator=(pooled_buffer&& other) noexcept
+    {
+        std::swap(pool_, other.pool_);
+        std::swap(s_, other.s_);
+        return *this;
+    }
+
+    /// Return `true` if a string is held
+    explicit
+    operator bool() const noexcept
+    {
+        return s_ != nullptr;
+    }
+
+    std::string&
+    operator*() const noexcept
+    {
+        return *s_;
+    }
+
+    std::string*
+    operator->() const noexcept
+    {
+        return s_.get();
+    }
+};
+
+/** A thread-safe pool of reusable strings.
+
+    Responses which are produced often, such as those from
+    the API routes, can be written into a pooled string to
+    avoid allocating a new buffer each time.
+*/
+class buffer_pool
+{
+    friend class pooled_buffer;
+
+    std::mutex m_;
+    std::vector<std::unique_ptr<std::string>> v_;
+    std::size_t max_count_;
+    std::size_t max_capacity_;
+
+    void
+    release(std::unique_ptr<std::string> s) noexcept;
+
+public:
+    /** Constructor
+
+        @param max_count The largest number of idle
+        strings to keep.
+
+        @param max_capacity Strings whose capacity grew
+        larger than this are freed instead of kept.
+    */
+    explicit
+    buffer_pool(
+        std::size_t max_count = 64,
+        std::size_t max_capacity = 64 * 1024);
+
+    /// Borrow an empty string from the pool
+    pooled_buffer
+    acquire();
+};
+
+//------------------------------------------------------------------------------
+
+/// A Body which sends a @ref pooled_buffer
+struct pooled_body
+{
+    using value_type = pooled_buffer;
+
+    static
+    std::uint64_t
+    size(value_type const& body) noexcept
+    {
+        return body ? body->size() : 0;
+    }
+
+    class writer
+    {
+        value_type const& body_;
+
+    public:
+        using const_buffers_type =
+            net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        explicit
+        writer(
+            http::header<isRequest, Fields> const&,
+            value_type const& body)
+            : body_(body)
+        {
+        }
+
+        void
+        init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code& ec)
+        {
+            ec = {};
+            if(! body_)
+                return boost::none;
+            return {{ net::buffer(*body_), false }};
+        }
+    };
+};
+
+#endif
@@ -56,6 +56,14 @@ is_joined(user& u) const noexcept
     return users_.find(&u) != users_.end();
 }
 
+std::size_t
+channel::
+user_count() const noexcept
+{
+    shared_lock_guard lock(mutex_);
+    return users_.size();
+}
+
 bool
 channel::
 insert(user& u)
@@ -64,7 +72,8 @@ insert(user& u)
         auto const inserted = [&]
         {
             lock_guard lock(mutex_);
-            return users_.insert(&u).second;
+            return users_.emplace(
+                &u, member{default_tier_, 0}).second;
         }();
         if(! inserted)
             return false;
@@ -124,10 +133,96 @@ send(json::value const& jv)
     send(make_message(jv));
 }
 
+void
+channel::
+send_live(json::value const& jv)
+{
+    std::vector<boost::weak_ptr<user>> v;
+    {
+        shared_lock_guard lock(mutex_);
+        v.reserve(users_.size());
+        for(auto const& e : users_)
+            if(e.second.level == tier::live)
+                v.emplace_back(boost::weak_from(e.first));
+    }
+    if(! v.empty())
+        deliver(make_message(jv), v);
+}
+
+void
+channel::
+send_snapshot(json::value const& jv)
+{
+    // Serialized once, however many spectators there are
+    auto const v = spectators();
+    if(! v.empty())
+        deliver(make_message(jv), v);
+}
+
+void
+channel::
+send_snapshot(message m)
+{
+    auto const v = spectators();
+    if(! v.empty())
+        deliver(m, v);
+}
+
+auto
+channel::
+spectators() ->
+    std::vector<boost::weak_ptr<user>>
+{
+    // A connection with more messages than this
+    // waiting is sent half as many snapshots.
+    std::size_t const max_backlog = 4;
+    unsigned const max_skip = 4;
+
+    std::vector<boost::weak_ptr<user>> v;
+    lock_guard lock(mutex_);
+    auto const n = snapshots_++;
+    for(auto& e : users_)
+    {
+        auto& m = e.second;
+        if(m.level != tier::spectator)
+            continue;
+        if(n & ((std::uint64_t(1) << m.skip) - 1))
+            continue;
+        auto const backlog = e.first->backlog();
+        if(backlog > max_backlog)
+        {
+            if(m.skip < max_skip)
+                ++m.skip;
+            continue;
+        }
+        if(backlog == 0 && m.skip > 0)
+            --m.skip;
+        v.emplace_back(boost::weak_from(e.first));
+    }
+    return v;
+}
+
+bool
+channel::
+set_tier(user& u, tier t)
+{
+    lock_guard lock(mutex_);
+    auto it = users_.find(&u);
+    if(it == users_.end())
+        return false;
+    it->second.level = t;
+    it->second.skip = 0;
+    return true;
+}
+
 void
 channel::
 dispatch(rpc_call& rpc)
 {
+    rpc.stats = &list_.rpc_stats();
+    rpc.channel_type = type();
+    rpc.start();
+
     if(rpc.method == "join")
     {
         do_join(rpc);
@@ -180,14 +275,29 @@ send(message m)
     {
         shared_lock_guard lock(mutex_);
         v.reserve(users_.size());
-        for(auto p : users_)
-            v.emplace_back(boost::weak_from(p));
+        for(auto const& e : users_)
+            v.emplace_back(boost::weak_from(e.first));
     }
+    deliver(m, v);
+}
 
+void
+channel::
+deliver(
+    message const& m,
+    std::vector<boost::weak_ptr<user>> const& v)
+{
     // For each user in our local list, try to
     // acquire a strong pointer. If successful,
     // then send the message to that user.
+    std::size_t n = 0;
     for(auto const& wp : v)
+    {
         if(auto sp = wp.lock())
+        {
             sp->send(m);
+            ++n;
+        }
+    }
+    list_.on_send(n, m.size());
 }
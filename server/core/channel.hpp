@@ -15,10 +15,12 @@
 #include "utility.hpp"
 #include <boost/beast/core/string.hpp>
 #include <boost/json/value.hpp>
-#include <boost/container/flat_set.hpp>
+#include <boost/container/flat_map.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
 #include <boost/thread/lock_guard.hpp>
 #include <boost/thread/shared_lock_guard.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#include <cstdint>
 #include <mutex>
 #include <vector>
 
@@ -31,13 +33,39 @@ class user;
 
 class channel : public boost::enable_shared_from
 {
+public:
+    /** How a user receives the events of a channel.
+
+        Spectators of a busy channel can be sent coalesced
+        snapshots at a bounded rate, instead of every event.
+    */
+    enum class tier
+    {
+        // Every event, as it happens
+        live,
+
+        // Only snapshots, see @ref send_snapshot
+        spectator
+    };
+
+private:
     using mutex = boost::shared_mutex;
     using lock_guard = boost::lock_guard<mutex>;
     using shared_lock_guard = boost::shared_lock_guard<mutex>;
 
+    struct member
+    {
+        tier level;
+
+        // Receives one of every 2^skip snapshots
+        unsigned skip;
+    };
+
     channel_list& list_;
     boost::shared_mutex mutable mutex_;
-    boost::container::flat_set<user*> users_;
+    boost::container::flat_map<user*, member> users_;
+    std::uint64_t snapshots_ = 0;
+    tier default_tier_ = tier::live;
     uid_type uid_;
     std::size_t cid_;
     std::string name_;
@@ -69,6 +97,15 @@ public:
         return name_;
     }
 
+    /// Return the kind of channel, used to group statistics
+    virtual
+    beast::string_view
+    type() const noexcept = 0;
+
+    /// Return the number of users in the channel
+    std::size_t
+    user_count() const noexcept;
+
     /// Returns `true` if the user has joined the channel
     bool
     is_joined(user& u) const noexcept;
@@ -87,9 +124,43 @@ public:
     bool
     erase(user& u);
 
+    /// Send a message to every user
     void
     send(json::value const& jv);
 
+    /// Send a serialized message to every user
+    void
+    send(message m);
+
+    /** Send a message to the users at the live tier.
+
+        Membership changes are sent to every tier.
+    */
+    void
+    send_live(json::value const& jv);
+
+    /** Send a snapshot to the spectators.
+
+        Callers coalesce their events, and send snapshots
+        at a fixed rate. A spectator whose connection falls
+        behind receives one of every 2, 4, and so on up
+        to one of every 16 snapshots, and returns to every
+        snapshot once its queue drains.
+    */
+    void
+    send_snapshot(json::value const& jv);
+
+    /// Send a serialized snapshot to the spectators
+    void
+    send_snapshot(message m);
+
+    /** Set how a user receives the events of the channel.
+
+        @returns `false` if the user is not in the channel.
+    */
+    bool
+    set_tier(user& u, tier t);
+
     /// Process an RPC command for this channel
     void
     dispatch(rpc_call& rpc);
@@ -109,6 +180,16 @@ protected:
     void
     checked_user(rpc_call& rpc);
 
+    /** Set the tier of users as they join.
+
+        This must be called from the constructor.
+    */
+    void
+    set_default_tier(tier t) noexcept
+    {
+        default_tier_ = t;
+    }
+
     /** Called when a user is inserted to the channel's list.
 
         @param u A strong reference to the user.
@@ -133,7 +214,15 @@ protected:
 private:
     void do_join(rpc_call& rpc);
     void do_leave(rpc_call& rpc);
-    void send(message m);
+
+    // Return the spectators due the next snapshot
+    std::vector<boost::weak_ptr<user>>
+    spectators();
+
+    void
+    deliver(
+        message const& m,
+        std::vector<boost::weak_ptr<user>> const& v);
 };
 
 #endif
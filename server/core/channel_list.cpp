@@ -10,7 +10,10 @@
 #include "channel.hpp"
 #include "channel_list.hpp"
 #include "message.hpp"
+#include "metrics.hpp"
+#include "recorder.hpp"
 #include "rpc.hpp"
+#include "rpc_stats.hpp"
 #include "server.hpp"
 #include "service.hpp"
 #include "user.hpp"
@@ -27,6 +30,7 @@
 extern
 void
 make_room(
+    server& srv,
     channel_list& list,
     beast::string_view name);
 
@@ -53,6 +57,11 @@ class channel_list_impl
     boost::container::flat_set<channel*> users_;
     std::atomic<uid_type> next_uid_;
     std::atomic<std::size_t> next_cid_;
+    counter& messages_;
+    counter& deliveries_;
+    counter& bytes_;
+    counter& rpc_errors_;
+    ::rpc_stats rpc_stats_;
 
 public:
     channel_list_impl(
@@ -60,11 +69,24 @@ public:
         : srv_(srv)
         , next_uid_(1000)
         , next_cid_(1000)
+        , messages_(srv_.metrics().make_counter(
+            "lounge_channel_messages_total",
+            "Messages sent by channels"))
+        , deliveries_(srv_.metrics().make_counter(
+            "lounge_channel_deliveries_total",
+            "Messages delivered to channel users"))
+        , bytes_(srv_.metrics().make_counter(
+            "lounge_channel_bytes_total",
+            "Bytes of messages delivered to channel users"))
+        , rpc_errors_(srv_.metrics().make_counter(
+            "lounge_rpc_errors_total",
+            "JSON-RPC calls which failed"))
+        , rpc_stats_(srv_.metrics())
     {
         // element 0 is unused
         v_.resize(1);
 
-        make_room(*this, "General");
+        make_room(srv_, *this, "General");
     }
 
     //--------------------------------------------------------------------------
@@ -98,6 +120,18 @@ public:
         return v_[cid].c;
     }
 
+    std::vector<boost::shared_ptr<channel>>
+    channels() const override
+    {
+        std::vector<boost::shared_ptr<channel>> v;
+        shared_lock_guard lock(m_);
+        v.reserve(v_.size());
+        for(auto const& e : v_)
+            if(e.c)
+                v.push_back(e.c);
+        return v;
+    }
+
     void
     dispatch(rpc_call& rpc) override
     {
@@ -114,9 +148,33 @@ public:
                 "Unknown cid");
 
         // Dispatch the request
+        srv_.recorder().add(
+            trace_event::dispatch, rpc.u.get(), cid);
         c->dispatch(rpc);
     }
 
+    ::rpc_stats&
+    rpc_stats() noexcept override
+    {
+        return rpc_stats_;
+    }
+
+    counter&
+    rpc_errors() noexcept override
+    {
+        return rpc_errors_;
+    }
+
+    void
+    on_send(
+        std::size_t users,
+        std::size_t bytes) noexcept override
+    {
+        messages_.inc();
+        deliveries_.inc(users);
+        bytes_.inc(users * bytes);
+    }
+
     uid_type
     next_uid() noexcept override
     {
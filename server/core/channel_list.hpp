@@ -17,9 +17,12 @@
 #include <boost/make_shared.hpp>
 #include <boost/shared_ptr.hpp>
 #include <utility>
+#include <vector>
 
 class channel;
+class counter;
 class rpc_call;
+class rpc_stats;
 class user;
 
 //------------------------------------------------------------------------------
@@ -43,6 +46,11 @@ public:
     boost::shared_ptr<channel>
     at(std::size_t cid) const = 0;
 
+    /// Return all of the channels
+    virtual
+    std::vector<boost::shared_ptr<channel>>
+    channels() const = 0;
+
     /// Process a serialized message from a user
     virtual
     void
@@ -59,6 +67,23 @@ public:
     void
     erase(channel const& c) = 0;
 
+    /// Return the latency statistics for RPC calls
+    virtual
+    ::rpc_stats&
+    rpc_stats() noexcept = 0;
+
+    /// Return the counter of JSON-RPC calls which failed
+    virtual
+    counter&
+    rpc_errors() noexcept = 0;
+
+    /// Called when a channel sends a message to its users
+    virtual
+    void
+    on_send(
+        std::size_t users,
+        std::size_t bytes) noexcept = 0;
+
 private:
     virtual
     void
@@ -0,0 +1,190 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_FILE_RANGE_BODY_HPP
+#define LOUNGE_FILE_RANGE_BODY_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/http/error.hpp>
+#include <boost/beast/http/message.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** A Body which sends ranges of an open file.
+
+    Each range may be preceded by text, and more text may
+    follow the last range. This is sufficient to send a
+    single range, or a multipart/byteranges body.
+*/
+struct file_range_body
+{
+    /// A range of the file and the text before it
+    struct part
+    {
+        std::string head;
+        std::uint64_t offset;
+        std::uint64_t length;
+    };
+
+    class writer;
+
+    class value_type
+    {
+        friend class writer;
+
+        beast::file file_;
+        std::vector<part> parts_;
+        std::string tail_;
+        std::uint64_t size_ = 0;
+
+    public:
+        value_type() = default;
+        value_type(value_type&&) = default;
+        value_type& operator=(value_type&&) = default;
+
+        /// Return the file
+        beast::file&
+        file() noexcept
+        {
+            return file_;
+        }
+
+        /// Return the parts
+        std::vector<part> const&
+        parts() const noexcept
+        {
+            return parts_;
+        }
+
+        /// Return the total number of bytes in the body
+        std::uint64_t
+        size() const noexcept
+        {
+            return size_;
+        }
+
+        /// Set the open file to send from, removing all parts
+        void
+        reset(beast::file&& file)
+        {
+            file_ = std::move(file);
+            parts_.clear();
+            tail_.clear();
+            size_ = 0;
+        }
+
+        /// Append a range of the file, preceded by `head`
+        void
+        add(
+            std::uint64_t offset,
+            std::uint64_t length,
+            std::string head = {})
+        {
+            size_ += head.size() + length;
+            parts_.push_back({std::move(head), offset, length});
+        }
+
+        /// Set the text sent after the last range
+        void
+        tail(std::string s)
+        {
+            size_ -= tail_.size();
+            tail_ = std::move(s);
+            size_ += tail_.size();
+        }
+    };
+
+    static
+    std::uint64_t
+    size(value_type const& body) noexcept
+    {
+        return body.size();
+    }
+
+    class writer
+    {
+        value_type& body_;
+        std::size_t i_ = 0;
+        bool in_head_ = true;
+        bool done_ = false;
+        std::uint64_t remain_ = 0;
+        char buf_[4096];
+
+    public:
+        using const_buffers_type =
+            net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        explicit
+        writer(
+            http::header<isRequest, Fields> const&,
+            value_type& body)
+            : body_(body)
+        {
+        }
+
+        void
+        init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code& ec)
+        {
+            ec = {};
+            while(i_ < body_.parts_.size())
+            {
+                auto const& p = body_.parts_[i_];
+                if(in_head_)
+                {
+                    in_head_ = false;
+                    remain_ = p.length;
+                    body_.file_.seek(p.offset, ec);
+                    if(ec)
+                        return boost::none;
+                    if(! p.head.empty())
+                        return {{ net::buffer(p.head), true }};
+                }
+                if(remain_ > 0)
+                {
+                    auto const amount = remain_ > sizeof(buf_) ?
+                        sizeof(buf_) : static_cast<std::size_t>(remain_);
+                    auto const n = body_.file_.read(buf_, amount, ec);
+                    if(ec)
+                        return boost::none;
+                    if(n == 0)
+                    {
+                        // The file is shorter than expected
+                        ec = http::error::short_read;
+                        return boost::none;
+                    }
+                    remain_ -= n;
+                    return {{ net::const_buffer(buf_, n), true }};
+                }
+                ++i_;
+                in_head_ = true;
+            }
+            if(! done_)
+            {
+                done_ = true;
+                if(! body_.tail_.empty())
+                    return {{ net::buffer(body_.tail_), false }};
+            }
+            return boost::none;
+        }
+    };
+};
+
+#endif
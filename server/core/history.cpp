@@ -0,0 +1,100 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "history.hpp"
+#include <boost/assert.hpp>
+
+history::
+history(std::size_t capacity)
+    : v_(capacity < 1 ? 1 : capacity)
+{
+}
+
+std::uint64_t
+history::
+first() const noexcept
+{
+    if(last_ == base_)
+        return 0;
+    if(last_ - base_ <= v_.size())
+        return base_ + 1;
+    return last_ - v_.size() + 1;
+}
+
+std::uint64_t
+history::
+push(message m)
+{
+    // Replace the oldest, the ring slot of n is n % size
+    auto& slot = v_[++last_ % v_.size()];
+    swap(slot, m);
+    return last_;
+}
+
+void
+history::
+restart(std::uint64_t n)
+{
+    for(auto& m : v_)
+    {
+        message none;
+        swap(m, none);
+    }
+    base_ = n;
+    last_ = n;
+}
+
+std::uint64_t
+history::
+page(
+    std::uint64_t before,
+    std::size_t limit,
+    std::vector<message>& v) const
+{
+    auto const lo = first();
+    if(lo == 0 || limit == 0)
+        return 0;
+    auto hi = last_;
+    if(before != 0)
+    {
+        if(before <= lo)
+            return 0;
+        if(before - 1 < hi)
+            hi = before - 1;
+    }
+    auto start = lo;
+    if(hi - lo + 1 > limit)
+        start = hi - limit + 1;
+    v.reserve(v.size() + (hi - start + 1));
+    for(auto n = start; n <= hi; ++n)
+        v.push_back(v_[n % v_.size()]);
+    return start;
+}
+
+message
+make_batch(
+    beast::string_view prefix,
+    std::vector<message> const& v,
+    beast::string_view suffix)
+{
+    // Gathered into a single allocation by the message
+    std::vector<net::const_buffer> b;
+    b.reserve(2 * v.size() + 1);
+    b.emplace_back(prefix.data(), prefix.size());
+    for(auto const& m : v)
+    {
+        if(m.size() == 0)
+            continue;
+        if(b.size() > 1)
+            b.emplace_back(",", 1);
+        b.emplace_back(*m.begin());
+    }
+    b.emplace_back(suffix.data(), suffix.size());
+    return message(b);
+}
@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_HISTORY_HPP
+#define LOUNGE_HISTORY_HPP
+
+#include "config.hpp"
+#include "message.hpp"
+#include <boost/beast/core/string.hpp>
+#include <cstdint>
+#include <vector>
+
+/** The most recent messages broadcast by a channel.
+
+    The messages are kept in a ring of fixed capacity, and
+    share the buffers which were serialized for the broadcast,
+    so keeping a message costs no copy. Each message is given
+    the next number in sequence, starting from one, which
+    is used as the cursor when paging back.
+
+    This is not thread-safe.
+*/
+class history
+{
+    std::vector<message> v_;
+    std::uint64_t base_ = 0;    // numbers up to this are not kept
+    std::uint64_t last_ = 0;
+
+public:
+    /// Constructor
+    explicit
+    history(std::size_t capacity);
+
+    /// Return the number of the next message
+    std::uint64_t
+    next() const noexcept
+    {
+        return last_ + 1;
+    }
+
+    /// Return the number of the oldest message kept, or zero
+    std::uint64_t
+    first() const noexcept;
+
+    /** Add a message, returning its number.
+
+        The oldest message is dropped when full.
+    */
+    std::uint64_t
+    push(message m);
+
+    /** Drop every message, and continue numbering after `n`.
+
+        This is used to carry on the numbers of messages which
+        were kept elsewhere, such as on disk.
+    */
+    void
+    restart(std::uint64_t n);
+
+    /** Return a page of messages, oldest first.
+
+        @param before Only messages numbered less than this
+        are returned, or the newest ones if this is zero.
+
+        @param limit The largest number of messages returned.
+
+        @param v The vector to receive the messages.
+
+        @return The number of the first message returned,
+        or zero if there are none.
+    */
+    std::uint64_t
+    page(
+        std::uint64_t before,
+        std::size_t limit,
+        std::vector<message>& v) const;
+};
+
+/** Return one message holding an array of messages.
+
+    The result is the prefix, then the messages separated
+    by commas, then the suffix. When the messages are JSON,
+    a prefix ending in `[` and a suffix starting with `]`
+    make a JSON message of them, without serializing again.
+*/
+message
+make_batch(
+    beast::string_view prefix,
+    std::vector<message> const& v,
+    beast::string_view suffix);
+
+#endif
@@ -0,0 +1,434 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "http_conditional.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+
+namespace {
+
+// Ranges beyond this count are a sign of abuse
+std::size_t constexpr max_ranges = 16;
+
+char const* const day_names[] = {
+    "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+char const* const month_names[] = {
+    "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+    "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+
+// Days since 1970-01-01 for a date in the proleptic Gregorian
+// calendar. See http://howardhinnant.github.io/date_algorithms.html
+std::int64_t
+days_from_civil(
+    std::int64_t y,
+    unsigned m,
+    unsigned d) noexcept
+{
+    y -= m <= 2;
+    auto const era = (y >= 0 ? y : y - 399) / 400;
+    auto const yoe = static_cast<unsigned>(y - era * 400);
+    auto const doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+    auto const doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<std::int64_t>(doe) - 719468;
+}
+
+void
+civil_from_days(
+    std::int64_t z,
+    std::int64_t& y,
+    unsigned& m,
+    unsigned& d) noexcept
+{
+    z += 719468;
+    auto const era = (z >= 0 ? z : z - 146096) / 146097;
+    auto const doe = static_cast<unsigned>(z - era * 146097);
+    auto const yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    auto const doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    auto const mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<std::int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+// Parse exactly `n` digits
+bool
+parse_digits(
+    char const* p,
+    std::size_t n,
+    unsigned& v) noexcept
+{
+    v = 0;
+    for(; n > 0; --n, ++p)
+    {
+        if(*p < '0' || *p > '9')
+            return false;
+        v = 10 * v + static_cast<unsigned>(*p - '0');
+    }
+    return true;
+}
+
+// Parse one or more digits, advancing `it`
+bool
+parse_number(
+    char const*& it,
+    char const* end,
+    std::uint64_t& v) noexcept
+{
+    auto const start = it;
+    v = 0;
+    for(; it != end && *it >= '0' && *it <= '9'; ++it)
+    {
+        auto const d = static_cast<unsigned>(*it - '0');
+        if(v > (UINT64_MAX - d) / 10)
+            return false;
+        v = 10 * v + d;
+    }
+    return it != start;
+}
+
+bool
+is_ows(char c) noexcept
+{
+    return c == ' ' || c == '\t';
+}
+
+beast::string_view
+trim(beast::string_view s) noexcept
+{
+    while(! s.empty() && is_ows(s.front()))
+        s.remove_prefix(1);
+    while(! s.empty() && is_ows(s.back()))
+        s.remove_suffix(1);
+    return s;
+}
+
+// Return the opaque-tag of an entity-tag, or an empty
+// string if the entity-tag is malformed.
+beast::string_view
+opaque_tag(
+    beast::string_view s,
+    bool& weak) noexcept
+{
+    weak = s.starts_with("W/");
+    if(weak)
+        s.remove_prefix(2);
+    if( s.size() < 2 ||
+        s.front() != '"' ||
+        s.back() != '"' ||
+        s.substr(1, s.size() - 2).find('"') !=
+            beast::string_view::npos)
+        return {};
+    return s;
+}
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+std::string
+format_http_date(std::time_t t)
+{
+    auto secs = static_cast<std::int64_t>(t);
+    auto days = secs / 86400;
+    secs %= 86400;
+    if(secs < 0)
+    {
+        secs += 86400;
+        --days;
+    }
+    std::int64_t y;
+    unsigned m;
+    unsigned d;
+    civil_from_days(days, y, m, d);
+    auto const wd = static_cast<unsigned>(
+        ((days % 7) + 11) % 7);
+
+    char buf[32];
+    std::snprintf(buf, sizeof(buf),
+        "%s, %02u %s %04lld %02u:%02u:%02u GMT",
+        day_names[wd],
+        d,
+        month_names[m - 1],
+        static_cast<long long>(y),
+        static_cast<unsigned>(secs / 3600),
+        static_cast<unsigned>((secs / 60) % 60),
+        static_cast<unsigned>(secs % 60));
+    return buf;
+}
+
+bool
+parse_http_date(
+    beast::string_view s,
+    std::time_t& t)
+{
+    // "Sun, 06 Nov 1994 08:49:37 GMT"
+    if( s.size() != 29 ||
+        s.substr(3, 2) != ", " ||
+        s[7] != ' ' ||
+        s[11] != ' ' ||
+        s[16] != ' ' ||
+        s[19] != ':' ||
+        s[22] != ':' ||
+        s.substr(25) != " GMT")
+        return false;
+    if(std::find(std::begin(day_names), std::end(day_names),
+        s.substr(0, 3)) == std::end(day_names))
+        return false;
+    auto const mi = std::find(
+        std::begin(month_names), std::end(month_names),
+            s.substr(8, 3));
+    if(mi == std::end(month_names))
+        return false;
+
+    unsigned d, y, hh, mm, ss;
+    if( ! parse_digits(&s[5], 2, d) ||
+        ! parse_digits(&s[12], 4, y) ||
+        ! parse_digits(&s[17], 2, hh) ||
+        ! parse_digits(&s[20], 2, mm) ||
+        ! parse_digits(&s[23], 2, ss))
+        return false;
+    if(d < 1 || d > 31 || hh > 23 || mm > 59 || ss > 60)
+        return false;
+
+    auto const m = static_cast<unsigned>(
+        mi - std::begin(month_names)) + 1;
+    t = static_cast<std::time_t>(
+        days_from_civil(y, m, d) * 86400 +
+        hh * 3600 + mm * 60 + ss);
+    return true;
+}
+
+std::string
+make_etag(
+    std::uint64_t size,
+    std::time_t last_write,
+    beast::string_view suffix)
+{
+    char buf[48];
+    auto const n = std::snprintf(buf, sizeof(buf),
+        "\"%llx-%llx",
+        static_cast<unsigned long long>(size),
+        static_cast<unsigned long long>(last_write));
+    std::string s(buf, static_cast<std::size_t>(n));
+    if(! suffix.empty())
+    {
+        s.push_back('-');
+        s.append(suffix.data(), suffix.size());
+    }
+    s.push_back('"');
+    return s;
+}
+
+bool
+is_not_modified(
+    beast::string_view if_none_match,
+    beast::string_view if_modified_since,
+    beast::string_view etag,
+    std::time_t last_write)
+{
+    if(! if_none_match.empty())
+    {
+        // If-None-Match uses the weak comparison
+        bool weak;
+        auto const tag = opaque_tag(etag, weak);
+        auto it = if_none_match.begin();
+        auto const end = if_none_match.end();
+        for(;;)
+        {
+            auto const next = std::find(it, end, ',');
+            auto const elem = trim({it,
+                static_cast<std::size_t>(next - it)});
+            if(elem == "*")
+                return true;
+            if(! elem.empty())
+            {
+                auto const other = opaque_tag(elem, weak);
+                if(! other.empty() && other == tag)
+                    return true;
+            }
+            if(next == end)
+                break;
+            it = next + 1;
+        }
+        return false;
+    }
+
+    std::time_t t;
+    if( ! if_modified_since.empty() &&
+        parse_http_date(if_modified_since, t))
+        return last_write <= t;
+
+    return false;
+}
+
+bool
+is_range_current(
+    beast::string_view if_range,
+    beast::string_view etag,
+    std::time_t last_write)
+{
+    if_range = trim(if_range);
+    if(if_range.empty())
+        return true;
+
+    // If-Range uses the strong comparison
+    if(if_range.front() == '"' || if_range.starts_with("W/"))
+    {
+        bool weak;
+        auto const tag = opaque_tag(if_range, weak);
+        return ! weak && ! tag.empty() && tag == etag;
+    }
+
+    std::time_t t;
+    return
+        parse_http_date(if_range, t) &&
+        t == last_write;
+}
+
+range_result
+parse_range(
+    beast::string_view field,
+    std::uint64_t size,
+    std::vector<byte_range>& ranges)
+{
+    ranges.clear();
+
+    field = trim(field);
+    if( field.size() < 6 ||
+        ! beast::iequals(field.substr(0, 6), "bytes="))
+        return range_result::ignore;
+    field.remove_prefix(6);
+
+    std::size_t count = 0;
+    auto it = field.begin();
+    auto const end = field.end();
+    for(;;)
+    {
+        auto const next = std::find(it, end, ',');
+        auto const elem = trim({it,
+            static_cast<std::size_t>(next - it)});
+        if(! elem.empty())
+        {
+            if(++count > max_ranges)
+                return range_result::ignore;
+
+            auto p = elem.data();
+            auto const pe = p + elem.size();
+            if(*p == '-')
+            {
+                // suffix-byte-range-spec
+                std::uint64_t n;
+                ++p;
+                if(! parse_number(p, pe, n) || p != pe)
+                    return range_result::ignore;
+                if(n > 0 && size > 0)
+                    ranges.push_back({
+                        n < size ? size - n : 0, size - 1 });
+            }
+            else
+            {
+                // byte-range-spec
+                std::uint64_t first;
+                std::uint64_t last = UINT64_MAX;
+                if( ! parse_number(p, pe, first) ||
+                    p == pe || *p++ != '-')
+                    return range_result::ignore;
+                if(p != pe && (
+                    ! parse_number(p, pe, last) || p != pe))
+                    return range_result::ignore;
+                if(last < first)
+                    return range_result::ignore;
+                if(first < size)
+                    ranges.push_back({
+                        first, (std::min)(last, size - 1) });
+            }
+        }
+        if(next == end)
+            break;
+        it = next + 1;
+    }
+
+    if(count == 0)
+        return range_result::ignore;
+    if(ranges.empty())
+        return range_result::unsatisfiable;
+
+    // Coalesce, so that overlapping ranges
+    // can't be used to amplify the response.
+    std::sort(ranges.begin(), ranges.end(),
+        [](byte_range const& a, byte_range const& b)
+        {
+            return a.first < b.first;
+        });
+    auto out = ranges.begin();
+    for(auto in = out + 1; in != ranges.end(); ++in)
+    {
+        if(in->first <= out->last + 1)
+            out->last = (std::max)(out->last, in->last);
+        else
+            *++out = *in;
+    }
+    ranges.erase(out + 1, ranges.end());
+    return range_result::satisfiable;
+}
+
+std::string
+content_range(
+    byte_range const& r,
+    std::uint64_t size)
+{
+    char buf[72];
+    auto const n = std::snprintf(buf, sizeof(buf),
+        "bytes %llu-%llu/%llu",
+        static_cast<unsigned long long>(r.first),
+        static_cast<unsigned long long>(r.last),
+        static_cast<unsigned long long>(size));
+    return {buf, static_cast<std::size_t>(n)};
+}
+
+std::string
+make_boundary()
+{
+    static std::atomic<std::uint64_t> next{0};
+    char buf[24];
+    auto const n = std::snprintf(buf, sizeof(buf),
+        "%020llu", static_cast<unsigned long long>(++next));
+    return {buf, static_cast<std::size_t>(n)};
+}
+
+std::string
+multipart_head(
+    beast::string_view boundary,
+    beast::string_view type,
+    byte_range const& r,
+    std::uint64_t size)
+{
+    std::string s;
+    s.append("\r\n--");
+    s.append(boundary.data(), boundary.size());
+    s.append("\r\nContent-Type: ");
+    s.append(type.data(), type.size());
+    s.append("\r\nContent-Range: ");
+    s.append(content_range(r, size));
+    s.append("\r\n\r\n");
+    return s;
+}
+
+std::string
+multipart_tail(
+    beast::string_view boundary)
+{
+    std::string s;
+    s.append("\r\n--");
+    s.append(boundary.data(), boundary.size());
+    s.append("--\r\n");
+    return s;
+}
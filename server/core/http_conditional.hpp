@@ -0,0 +1,147 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_HTTP_CONDITIONAL_HPP
+#define LOUNGE_HTTP_CONDITIONAL_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+
+// Conditional requests (rfc7232) and range requests (rfc7233)
+
+/// Format a time as an IMF-fixdate, for example "Sun, 06 Nov 1994 08:49:37 GMT"
+std::string
+format_http_date(std::time_t t);
+
+/** Parse an IMF-fixdate.
+
+    The obsolete date formats are not recognized.
+
+    @return `false` if the string is not a valid date.
+*/
+bool
+parse_http_date(
+    beast::string_view s,
+    std::time_t& t);
+
+/** Return a strong entity tag for a representation.
+
+    The tag is derived from the size and modification time.
+    A suffix distinguishes the content codings of the same file.
+*/
+std::string
+make_etag(
+    std::uint64_t size,
+    std::time_t last_write,
+    beast::string_view suffix = {});
+
+/** Return `true` if a conditional GET may be answered with 304.
+
+    If-None-Match takes precedence over If-Modified-Since
+    when both are present.
+
+    @param if_none_match The value of the If-None-Match field.
+
+    @param if_modified_since The value of the If-Modified-Since field.
+
+    @param etag The entity tag of the selected representation.
+
+    @param last_write The modification time of the representation.
+*/
+bool
+is_not_modified(
+    beast::string_view if_none_match,
+    beast::string_view if_modified_since,
+    beast::string_view etag,
+    std::time_t last_write);
+
+/** Return `true` if a Range field should be honored.
+
+    @param if_range The value of the If-Range field, which
+    may be empty.
+*/
+bool
+is_range_current(
+    beast::string_view if_range,
+    beast::string_view etag,
+    std::time_t last_write);
+
+/// An inclusive range of byte positions
+struct byte_range
+{
+    std::uint64_t first;
+    std::uint64_t last;
+
+    std::uint64_t
+    size() const noexcept
+    {
+        return last - first + 1;
+    }
+};
+
+/// The result of parsing a Range field
+enum class range_result
+{
+    /// The field is absent or invalid, send the whole representation
+    ignore,
+
+    /// At least one range may be sent
+    satisfiable,
+
+    /// No range overlaps the representation
+    unsatisfiable
+};
+
+/** Parse the value of a Range field.
+
+    Overlapping and adjacent ranges are coalesced and the
+    result is sorted, so the total never exceeds `size`.
+    Fields listing an excessive number of ranges are ignored.
+
+    @param field The value of the Range field.
+
+    @param size The size of the representation.
+
+    @param ranges Receives the ranges when the result
+    is @ref range_result::satisfiable.
+*/
+range_result
+parse_range(
+    beast::string_view field,
+    std::uint64_t size,
+    std::vector<byte_range>& ranges);
+
+/// Return the value of Content-Range for a range
+std::string
+content_range(
+    byte_range const& r,
+    std::uint64_t size);
+
+/// Return a new boundary for a multipart/byteranges body
+std::string
+make_boundary();
+
+/// Return the text which precedes a part of a multipart/byteranges body
+std::string
+multipart_head(
+    beast::string_view boundary,
+    beast::string_view type,
+    byte_range const& r,
+    std::uint64_t size);
+
+/// Return the text which ends a multipart/byteranges body
+std::string
+multipart_tail(
+    beast::string_view boundary);
+
+#endif
@@ -0,0 +1,178 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "channel_list.hpp"
+#include "message.hpp"
+#include "metrics.hpp"
+#include "rpc.hpp"
+#include "server.hpp"
+#include "user.hpp"
+#include <boost/json.hpp>
+#include <boost/make_shared.hpp>
+#include <functional>
+#include <mutex>
+#include <string>
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+// Append the serialized value to a string
+void
+append(std::string& s, json::value const& jv)
+{
+    char buf[4096];
+    json::serializer sr(jv);
+    while(! sr.is_done())
+        s.append(buf, sr.read(buf, sizeof(buf)));
+}
+
+/** A user which lives for one HTTP request.
+
+    Each call in the request holds a reference to the user.
+    The responses are collected as the calls complete, and
+    delivered to the handler when the last reference goes
+    away, which may be on a different thread.
+*/
+class http_rpc_user : public user
+{
+    std::mutex mutex_;
+    std::string body_;
+    std::function<void(std::string)> handler_;
+    std::size_t count_ = 0;
+    bool batch_;
+
+public:
+    http_rpc_user(
+        bool batch,
+        std::function<void(std::string)> handler)
+        : handler_(std::move(handler))
+        , batch_(batch)
+    {
+    }
+
+    ~http_rpc_user()
+    {
+        if(batch_ && count_ > 0)
+        {
+            body_.insert(body_.begin(), '[');
+            body_.push_back(']');
+        }
+        handler_(std::move(body_));
+    }
+
+    void
+    on_stop() override
+    {
+    }
+
+    void
+    send(json::value const& jv) override
+    {
+        // Channels also send events to their users,
+        // only responses to our calls have an id.
+        if( ! jv.is_object() ||
+            ! jv.get_object().contains("id"))
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(count_++ > 0)
+            body_.push_back(',');
+        append(body_, jv);
+    }
+
+    void
+    send(message) override
+    {
+        // Broadcasts are not delivered over HTTP
+    }
+};
+
+// Extract and dispatch one call
+void
+do_call(
+    server& srv,
+    user& u,
+    counter& errors,
+    json::value&& jv)
+{
+    beast::error_code ec;
+    rpc_call rpc(u);
+    rpc.errors = &errors;
+    rpc.extract(std::move(jv), ec);
+    try
+    {
+        if(ec)
+            rpc.fail(
+                rpc_code::invalid_request,
+                ec.message());
+
+        // Dispatch to the proper channel
+        srv.channel_list().dispatch(rpc);
+    }
+    catch(rpc_error const& e)
+    {
+        rpc.complete(e);
+    }
+}
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+/** Run a JSON-RPC request or batch received over HTTP.
+
+    The handler is invoked with the serialized response once
+    every call has completed, possibly from another thread.
+    The string is empty when there is nothing to send,
+    because every call was a notification.
+*/
+void
+run_http_rpc(
+    server& srv,
+    beast::string_view body,
+    std::function<void(std::string)> handler)
+{
+    // Limit the work one request can queue up
+    static std::size_t constexpr max_batch = 64;
+
+    auto& errors = srv.channel_list().rpc_errors();
+
+    beast::error_code ec;
+    auto jv = json::parse(body, ec);
+    if(ec)
+    {
+        errors.inc();
+        std::string s;
+        append(s, rpc_error(rpc_code::parse_error).to_json(
+            json::value(nullptr)));
+        return handler(std::move(s));
+    }
+
+    if(! jv.is_array())
+    {
+        auto const u = boost::make_shared<
+            http_rpc_user>(false, std::move(handler));
+        return do_call(srv, *u, errors, std::move(jv));
+    }
+
+    auto& arr = jv.get_array();
+    if(arr.empty() || arr.size() > max_batch)
+    {
+        errors.inc();
+        std::string s;
+        append(s, rpc_error(rpc_code::invalid_request,
+            arr.empty() ? "Empty batch" : "Batch too large"
+                ).to_json(json::value(nullptr)));
+        return handler(std::move(s));
+    }
+    auto const u = boost::make_shared<
+        http_rpc_user>(true, std::move(handler));
+    for(auto& e : arr)
+        do_call(srv, *u, errors, std::move(e));
+}
@@ -7,10 +7,24 @@
 // Official repository: https://github.com/vinniefalco/BeastLounge
 //
 
+#include "arena.hpp"
+#include "buffer_pool.hpp"
+#include "file_range_body.hpp"
+#include "http_conditional.hpp"
+#include "ktls.hpp"
 #include "listener.hpp"
 #include "logger.hpp"
+#include "message_body.hpp"
+#include "metrics.hpp"
+#include "pipe_stream.hpp"
+#include "recorder.hpp"
+#include "router.hpp"
+#include "sendfile.hpp"
 #include "server.hpp"
 #include "session.hpp"
+#include "session_metrics.hpp"
+#include "static_cache.hpp"
+#include "timer_wheel.hpp"
 #include "utility.hpp"
 #include <boost/beast/core/stream_traits.hpp>
 #include <boost/beast/http/file_body.hpp>
@@ -20,12 +34,54 @@
 #include <boost/beast/websocket/rfc6455.hpp>
 #include <boost/beast/ssl/ssl_stream.hpp>
 #include <boost/beast/version.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <boost/asio/coroutine.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/post.hpp>
 #include <boost/asio/yield.hpp>
 #include <boost/optional.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
+#include <array>
+#include <ctime>
+#include <functional>
 #include <iostream>
+#include <type_traits>
+#include <vector>
+
+extern
+void
+run_http_rpc(
+    server& srv,
+    beast::string_view body,
+    std::function<void(std::string)> handler);
+
+extern
+void
+run_sse_session(
+    server& srv,
+    listener& lst,
+    stream_type stream,
+    endpoint_type ep,
+    std::size_t cid);
+
+extern
+void
+run_sse_session(
+    server& srv,
+    listener& lst,
+    beast::ssl_stream<
+        stream_type> stream,
+    endpoint_type ep,
+    std::size_t cid);
+
+extern
+void
+run_sse_session(
+    server& srv,
+    listener& lst,
+    pipe_stream stream,
+    endpoint_type ep,
+    std::size_t cid);
 
 extern
 void
@@ -46,43 +102,24 @@ run_ws_session(
     endpoint_type ep,
     websocket::request_type req);
 
-namespace {
+extern
+void
+run_ws_session(
+    server& srv,
+    listener& lst,
+    pipe_stream stream,
+    endpoint_type ep,
+    websocket::request_type req);
 
-// Return a reasonable mime type based on the extension of a file.
-beast::string_view
-mime_type(beast::string_view path)
-{
-    using beast::iequals;
-    auto const ext = [&path]
-    {
-        auto const pos = path.rfind(".");
-        if(pos == beast::string_view::npos)
-            return beast::string_view{};
-        return path.substr(pos);
-    }();
-    if(iequals(ext, ".htm"))  return "text/html";
-    if(iequals(ext, ".html")) return "text/html";
-    if(iequals(ext, ".php"))  return "text/html";
-    if(iequals(ext, ".css"))  return "text/css";
-    if(iequals(ext, ".txt"))  return "text/plain";
-    if(iequals(ext, ".js"))   return "application/javascript";
-    if(iequals(ext, ".json")) return "application/json";
-    if(iequals(ext, ".xml"))  return "application/xml";
-    if(iequals(ext, ".swf"))  return "application/x-shockwave-flash";
-    if(iequals(ext, ".flv"))  return "video/x-flv";
-    if(iequals(ext, ".png"))  return "image/png";
-    if(iequals(ext, ".jpe"))  return "image/jpeg";
-    if(iequals(ext, ".jpeg")) return "image/jpeg";
-    if(iequals(ext, ".jpg"))  return "image/jpeg";
-    if(iequals(ext, ".gif"))  return "image/gif";
-    if(iequals(ext, ".bmp"))  return "image/bmp";
-    if(iequals(ext, ".ico"))  return "image/vnd.microsoft.icon";
-    if(iequals(ext, ".tiff")) return "image/tiff";
-    if(iequals(ext, ".tif"))  return "image/tiff";
-    if(iequals(ext, ".svg"))  return "image/svg+xml";
-    if(iequals(ext, ".svgz")) return "image/svg+xml";
-    return "application/text";
-}
+void
+run_http_session(
+    server& srv,
+    listener& lst,
+    stream_type stream,
+    endpoint_type ep,
+    flat_storage storage);
+
+namespace {
 
 // Append an HTTP rel-path to a local filesystem path.
 // The returned path is normalized for the platform.
@@ -111,6 +148,197 @@ path_cat(
     return result;
 }
 
+// Produces the bodies for a file in the static cache
+struct cached_source
+{
+    message const& m;
+
+    http::response<message_body>
+    full(http::response_header<>&& h) const
+    {
+        http::response<message_body> res{std::move(h), m};
+        return res;
+    }
+
+    http::response<message_body>
+    range(
+        http::response_header<>&& h,
+        byte_range const& r) const
+    {
+        http::response<message_body> res{std::move(h),
+            message_body::value_type(m,
+                static_cast<std::size_t>(r.first),
+                static_cast<std::size_t>(r.size()))};
+        return res;
+    }
+
+    // Cached files are small, so the parts are copied
+    http::response<http::string_body>
+    multipart(
+        http::response_header<>&& h,
+        std::vector<byte_range> const& ranges,
+        std::vector<std::string> const& heads,
+        std::string const& tail) const
+    {
+        http::response<http::string_body> res{std::move(h)};
+        auto const p = static_cast<char const*>(
+            m.begin()->data());
+        auto& s = res.body();
+        for(std::size_t i = 0; i < ranges.size(); ++i)
+        {
+            s.append(heads[i]);
+            s.append(p + ranges[i].first,
+                static_cast<std::size_t>(ranges[i].size()));
+        }
+        s.append(tail);
+        return res;
+    }
+};
+
+// Produces the bodies for a file opened from disk
+struct file_source
+{
+    http::file_body::value_type& body;
+
+    http::response<http::file_body>
+    full(http::response_header<>&& h)
+    {
+        http::response<http::file_body> res{
+            std::move(h), std::move(body)};
+        return res;
+    }
+
+    http::response<file_range_body>
+    range(
+        http::response_header<>&& h,
+        byte_range const& r)
+    {
+        http::response<file_range_body> res{std::move(h)};
+        res.body().reset(std::move(body.file()));
+        res.body().add(r.first, r.size());
+        return res;
+    }
+
+    http::response<file_range_body>
+    multipart(
+        http::response_header<>&& h,
+        std::vector<byte_range> const& ranges,
+        std::vector<std::string>& heads,
+        std::string const& tail)
+    {
+        http::response<file_range_body> res{std::move(h)};
+        res.body().reset(std::move(body.file()));
+        for(std::size_t i = 0; i < ranges.size(); ++i)
+            res.body().add(ranges[i].first,
+                ranges[i].size(), std::move(heads[i]));
+        res.body().tail(tail);
+        return res;
+    }
+};
+
+// Send a static file, answering conditional and range
+// requests from its validators. The header `h` must
+// already contain the fields describing the file.
+template<
+    class Body, class Allocator,
+    class Source, class Send>
+void
+send_representation(
+    http::request<Body, http::basic_fields<Allocator>> const& req,
+    http::response_header<>&& h,
+    beast::string_view type,
+    beast::string_view etag,
+    std::time_t last_write,
+    std::uint64_t size,
+    Source& src,
+    Send& send)
+{
+    // The client's copy is current
+    if(is_not_modified(
+        req[http::field::if_none_match],
+        req[http::field::if_modified_since],
+        etag, last_write))
+    {
+        h.result(http::status::not_modified);
+        h.erase(http::field::content_type);
+        h.erase(http::field::content_encoding);
+        http::response<http::empty_body> res{std::move(h)};
+        res.keep_alive(req.keep_alive());
+        return send(std::move(res));
+    }
+
+    h.set(http::field::accept_ranges, "bytes");
+
+    std::vector<byte_range> ranges;
+    auto const result =
+        req.method() == http::verb::get &&
+        is_range_current(req[http::field::if_range],
+            etag, last_write) ?
+        parse_range(req[http::field::range], size, ranges) :
+        range_result::ignore;
+
+    if(result == range_result::unsatisfiable)
+    {
+        h.result(http::status::range_not_satisfiable);
+        h.set(http::field::content_range,
+            "bytes */" + std::to_string(size));
+        http::response<http::empty_body> res{std::move(h)};
+        res.content_length(0);
+        res.keep_alive(req.keep_alive());
+        return send(std::move(res));
+    }
+
+    if(result == range_result::satisfiable)
+    {
+        h.result(http::status::partial_content);
+        if(ranges.size() == 1)
+        {
+            h.set(http::field::content_range,
+                content_range(ranges[0], size));
+            auto res = src.range(std::move(h), ranges[0]);
+            res.content_length(ranges[0].size());
+            res.keep_alive(req.keep_alive());
+            return send(std::move(res));
+        }
+
+        auto const boundary = make_boundary();
+        auto const tail = multipart_tail(boundary);
+        std::vector<std::string> heads;
+        heads.reserve(ranges.size());
+        std::uint64_t n = tail.size();
+        for(auto const& r : ranges)
+        {
+            heads.push_back(multipart_head(
+                boundary, type, r, size));
+            n += heads.back().size() + r.size();
+        }
+        h.set(http::field::content_type,
+            "multipart/byteranges; boundary=" + boundary);
+        auto res = src.multipart(
+            std::move(h), ranges, heads, tail);
+        res.content_length(n);
+        res.keep_alive(req.keep_alive());
+        return send(std::move(res));
+    }
+
+    h.result(http::status::ok);
+
+    // Respond to HEAD request
+    if(req.method() == http::verb::head)
+    {
+        http::response<http::empty_body> res{std::move(h)};
+        res.content_length(size);
+        res.keep_alive(req.keep_alive());
+        return send(std::move(res));
+    }
+
+    // Respond to GET request
+    auto res = src.full(std::move(h));
+    res.content_length(size);
+    res.keep_alive(req.keep_alive());
+    return send(std::move(res));
+}
+
 // This function produces an HTTP response for the given
 // request. The type of the response object depends on the
 // contents of the request, so the interface requires the
@@ -120,7 +348,7 @@ template<
     class Send>
 void
 handle_request(
-    beast::string_view doc_root,
+    server& srv,
     http::request<Body, http::basic_fields<Allocator>>&& req,
     Send&& send)
 {
@@ -163,6 +391,62 @@ handle_request(
         return res;
     };
 
+    // Dynamic resources take precedence over files
+    {
+        route_request rr;
+        rr.method = req.method();
+        rr.path = req.target();
+        auto const pos = rr.path.find('?');
+        if(pos != beast::string_view::npos)
+        {
+            rr.query = rr.path.substr(pos + 1);
+            rr.path = rr.path.substr(0, pos);
+        }
+        rr.body = beast::string_view(
+            req.body().data(), req.body().size());
+
+        router::handler_type const* handler;
+        switch(srv.router().match(rr, handler))
+        {
+        case router::match_result::not_found:
+            break;
+
+        case router::match_result::method_not_allowed:
+        {
+            http::response<http::empty_body> res{
+                http::status::method_not_allowed, req.version()};
+            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            res.set(http::field::allow, rr.allow);
+            res.keep_alive(req.keep_alive());
+            res.prepare_payload();
+            return send(std::move(res));
+        }
+
+        case router::match_result::found:
+        {
+            http::response<pooled_body> res{
+                http::status::ok, req.version()};
+            res.body() = srv.buffers().acquire();
+            route_response rs(*res.body());
+            try
+            {
+                (*handler)(rr, rs);
+            }
+            catch(std::exception const& e)
+            {
+                return send(server_error(e.what()));
+            }
+            res.result(rs.result);
+            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            res.set(http::field::content_type, rs.content_type);
+            res.set(http::field::cache_control, "no-store");
+            res.keep_alive(req.keep_alive());
+            res.prepare_payload();
+            return send(std::move(res));
+        }
+        }
+    }
+
     // Make sure we can handle the method
     if( req.method() != http::verb::get &&
         req.method() != http::verb::head)
@@ -174,8 +458,34 @@ handle_request(
         req.target().find("..") != beast::string_view::npos)
         return send(bad_request("Illegal request-target"));
 
+    // Serve from the cache if possible
+    if(auto const f = srv.static_cache().find(req.target()))
+    {
+        // Ranges always refer to the identity coding
+        auto const coding = req[http::field::range].empty() ?
+            f->select(req[http::field::accept_encoding]) :
+            static_file::identity;
+
+        http::response_header<> h;
+        h.version(req.version());
+        h.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        h.set(http::field::content_type, f->type);
+        if(coding != static_file::identity)
+            h.set(http::field::content_encoding,
+                static_file::name(coding));
+        if(f->has_codings())
+            h.set(http::field::vary, "Accept-Encoding");
+        h.set(http::field::etag, f->etag[coding]);
+        h.set(http::field::last_modified, f->last_modified);
+
+        cached_source src{f->body[coding]};
+        return send_representation(
+            req, std::move(h), f->type, f->etag[coding],
+            f->last_write, f->body[coding].size(), src, send);
+    }
+
     // Build the path to the requested file
-    std::string path = path_cat(doc_root, req.target());
+    std::string path = path_cat(srv.doc_root(), req.target());
     if(req.target().back() == '/')
         path.append("index.html");
 
@@ -192,30 +502,96 @@ handle_request(
     if(ec)
         return send(server_error(ec.message()));
 
-    // Cache the size since we need it after the move
+    auto const last_write =
+        boost::filesystem::last_write_time(path, ec);
+    if(ec)
+        return send(server_error(ec.message()));
+    auto const type = mime_type(path);
+    auto const etag = make_etag(body.size(), last_write);
+
+    http::response_header<> h;
+    h.version(req.version());
+    h.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+    h.set(http::field::content_type, type);
+    h.set(http::field::etag, etag);
+    h.set(http::field::last_modified,
+        format_http_date(last_write));
+
     auto const size = body.size();
+    file_source src{body};
+    return send_representation(
+        req, std::move(h), type, etag,
+        last_write, size, src, send);
+}
 
-    // Respond to HEAD request
-    if(req.method() == http::verb::head)
+// Returns `true` if this is a JSON-RPC
+// call over HTTP, in the form:
+//
+//  POST /rpc
+//
+template<class Body, class Fields>
+bool
+is_rpc_call(http::request<Body, Fields> const& req)
+{
+    if(req.method() != http::verb::post)
+        return false;
+    beast::string_view s = req.target();
+    auto const pos = s.find('?');
+    if(pos != beast::string_view::npos)
+        s = s.substr(0, pos);
+    return s == "/rpc";
+}
+
+// Returns `true` if this is a request
+// for the events of a channel, in the form:
+//
+//  GET /channels/{cid}/events
+//
+template<class Body, class Fields>
+bool
+is_event_stream(
+    http::request<Body, Fields> const& req,
+    std::size_t& cid)
+{
+    // Chunked encoding is required
+    if( req.method() != http::verb::get ||
+        req.version() != 11)
+        return false;
+    beast::string_view s = req.target();
+    auto const pos = s.find('?');
+    if(pos != beast::string_view::npos)
+        s = s.substr(0, pos);
+    if(! s.starts_with("/channels/"))
+        return false;
+    s.remove_prefix(10);
+    auto const n = s.find('/');
+    if( n == 0 || n > 9 ||
+        n == beast::string_view::npos ||
+        s.substr(n) != "/events")
+        return false;
+    cid = 0;
+    for(auto c : s.substr(0, n))
     {
-        http::response<http::empty_body> res{http::status::ok, req.version()};
-        res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-        res.set(http::field::content_type, mime_type(path));
-        res.content_length(size);
-        res.keep_alive(req.keep_alive());
-        return send(std::move(res));
+        if(c < '0' || c > '9')
+            return false;
+        cid = 10 * cid + (c - '0');
     }
+    return true;
+}
 
-    // Respond to GET request
-    http::response<http::file_body> res{
-        std::piecewise_construct,
-        std::make_tuple(std::move(body)),
-        std::make_tuple(http::status::ok, req.version())};
-    res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
-    res.set(http::field::content_type, mime_type(path));
-    res.content_length(size);
-    res.keep_alive(req.keep_alive());
-    return send(std::move(res));
+// Copy a request into the type used by websocket sessions
+template<class Body, class Fields>
+websocket::request_type
+to_request_type(
+    http::request<Body, Fields> const& req)
+{
+    websocket::request_type res;
+    res.method_string(req.method_string());
+    res.target(req.target());
+    res.version(req.version());
+    for(auto const& f : req)
+        res.insert(f.name_string(), f.value());
+    return res;
 }
 
 //------------------------------------------------------------------------------
@@ -225,15 +601,81 @@ class http_session_base
     : public asio::coroutine
     , public session
 {
+    // Requests are read ahead while earlier responses
+    // are written, until this many responses are queued.
+    static std::size_t constexpr queue_limit = 8;
+
+    // The fields and body of each request are allocated from
+    // this buffer, which is reused once the request is destroyed.
+    static std::size_t constexpr arena_size = 8192;
+
+    // A response waiting to be written
+    struct slot
+    {
+        typename std::aligned_union<0,
+            http::response<http::empty_body>,
+            http::response<http::string_body>,
+            http::response<http::file_body>,
+            http::response<file_range_body>,
+            http::response<message_body>,
+            http::response<pooled_body>>::type storage;
+        bool need_eof;
+        void (*write)(http_session_base&, void*);
+        void (*destroy)(void*);
+    };
+
+    template<class Body>
+    struct slot_ops
+    {
+        using message_type = http::response<Body>;
+
+        static
+        void
+        write(http_session_base& self, void* p)
+        {
+            self.impl()->write_response(
+                *static_cast<message_type*>(p));
+        }
+
+        static
+        void
+        destroy(void* p)
+        {
+            static_cast<message_type*>(p)->~message_type();
+        }
+    };
+
 protected:
+    using request_body = http::basic_string_body<
+        char, std::char_traits<char>, arena_allocator<char>>;
+
+    using request_fields = http::basic_fields<
+        arena_allocator<char>>;
+
     server& srv_;
     listener& lst_;
     section& log_;
     endpoint_type ep_;
     flat_storage storage_;
+    arena arena_;
     boost::optional<
         http::request_parser<
-            http::string_body>> pr_;
+            request_body,
+            arena_allocator<char>>> pr_;
+    std::array<slot, queue_limit> slots_;
+    std::size_t head_ = 0;
+    std::size_t count_ = 0;
+    bool paused_ = false;
+    bool closing_ = false;
+    bool rpc_pending_ = false;
+    std::size_t cid_ = 0;
+    counter& requests_;
+    counter& bytes_in_;
+    counter& bytes_out_;
+    gauge& queued_;
+    recorder& rec_;
+    wheel_timer deadline_;
+    std::uint64_t deadline_gen_ = 0;
 
 public:
     http_session_base(
@@ -246,12 +688,28 @@ public:
         , log_(srv_.log().get_section("http_session"))
         , ep_(ep)
         , storage_(std::move(storage))
+        , arena_(arena_size)
+        , requests_(srv_.session_metrics().http_requests)
+        , bytes_in_(srv_.session_metrics().http_bytes_in)
+        , bytes_out_(srv_.session_metrics().http_bytes_out)
+        , queued_(srv_.session_metrics().http_queued)
+        , rec_(srv_.recorder())
+        , deadline_(srv_.timer_wheel())
     {
         lst_.insert(this);
+        rec_.add(trace_event::accept, this);
     }
 
     ~http_session_base()
     {
+        rec_.add(trace_event::close, this);
+        queued_.sub(count_);
+        for(; count_ > 0; --count_)
+        {
+            auto& s = slots_[head_];
+            s.destroy(&s.storage);
+            head_ = (head_ + 1) % queue_limit;
+        }
         lst_.erase(this);
     }
 
@@ -292,113 +750,359 @@ public:
     //
     //--------------------------------------------------------------------------
 
-    // We only require C++11, this helper is
-    // the equivalent of a C++14 generic lambda.
-    struct send_lambda
+    // Queue a response, and start writing it if
+    // no other response is being written.
+    template<class Body>
+    void
+    enqueue(http::response<Body>&& res)
     {
-        http_session_base& self_;
+        using message_type = http::response<Body>;
+        static_assert(sizeof(message_type) <=
+            sizeof(decltype(slot::storage)),
+            "Add the response type to slot::storage");
+        BOOST_ASSERT(count_ < queue_limit);
+
+        auto& s = slots_[(head_ + count_) % queue_limit];
+        auto const p = ::new(&s.storage)
+            message_type(std::move(res));
+        s.need_eof = p->need_eof();
+        s.write = &slot_ops<Body>::write;
+        s.destroy = &slot_ops<Body>::destroy;
+
+        // Stop reading, the connection closes after this response
+        if(s.need_eof)
+            closing_ = true;
+
+        queued_.add();
+        rec_.add(trace_event::enqueue, this);
+        if(++count_ == 1)
+            do_write();
+    }
+
+    // Close the connection if the deadline passes first. The
+    // deadline is kept on the server's timer wheel, since it
+    // is rearmed for every request and every response.
+    void
+    set_deadline(std::chrono::seconds n)
+    {
+        boost::weak_ptr<http_session_base> wp =
+            boost::weak_from(this);
+        auto const gen = ++deadline_gen_;
+        deadline_.expires_after(n,
+            [wp, gen]
+            {
+                auto sp = wp.lock();
+                if(! sp)
+                    return;
+                auto const ex = sp->impl()->stream().get_executor();
+                net::post(ex,
+                    beast::bind_front_handler(
+                        &http_session_base::on_deadline,
+                        std::move(sp), gen));
+            });
+    }
+
+    void
+    cancel_deadline()
+    {
+        ++deadline_gen_;
+        deadline_.cancel();
+    }
+
+    void
+    on_deadline(std::uint64_t gen)
+    {
+        // The deadline was rearmed or cancelled after
+        // the wheel fired, and before this ran.
+        if(gen != deadline_gen_)
+            return;
+        LOG_TRC(log_, "deadline", '\t', ep_);
+        beast::close_socket(
+            beast::get_lowest_layer(impl()->stream()));
+    }
+
+    // Write the response at the head of the queue
+    void
+    do_write()
+    {
+        impl()->expires_after(std::chrono::seconds(30));
+        auto& s = slots_[head_];
+        s.write(*this, &s.storage);
+    }
+
+    // Completes the response at the head of the queue
+    struct write_handler
+    {
+        boost::shared_ptr<http_session_base> self;
 
-        template<bool isRequest, class Body, class Fields>
         void
-        operator()(http::message<isRequest, Body, Fields>&& msg) const
+        operator()(
+            beast::error_code ec,
+            std::size_t bytes_transferred) const
         {
-            // The lifetime of the message has to extend
-            // for the duration of the async operation so
-            // we use a shared_ptr to manage it.
-            auto sp = std::make_shared<
-                http::message<isRequest, Body, Fields>>(
-                    std::move(msg));
-
-            // Write the response
-            auto self = bind_front(&self_);
-            http::async_write(
-                self_.impl()->stream(),
-                *sp,
-                [self, sp](
-                    beast::error_code ec,
-                    std::size_t bytes_transferred)
-                {
-                    self(
-                        ec,
-                        bytes_transferred,
-                        sp->need_eof());
-                });
+            self->on_write(ec, bytes_transferred);
         }
     };
 
+    write_handler
+    make_write_handler()
+    {
+        return {boost::shared_from(this)};
+    }
+
     void
-    operator()(
-        beast::error_code ec = {},
-        std::size_t bytes_transferred = 0,
-        bool need_eof = false)
+    on_write(
+        beast::error_code ec,
+        std::size_t bytes_transferred)
     {
-        boost::ignore_unused(bytes_transferred);
-        reenter(*this)
+        bytes_out_.inc(bytes_transferred);
+        rec_.add(trace_event::write, this);
+
+        auto& s = slots_[head_];
+        auto const need_eof = s.need_eof;
+        s.destroy(&s.storage);
+        head_ = (head_ + 1) % queue_limit;
+        --count_;
+        queued_.sub();
+
+        // Handle the error, if any
+        if(ec)
         {
-            // Set the expiration
-            impl()->expires_after(std::chrono::seconds(30));
+            impl()->fail(ec, "http::async_write");
 
-            // A new HTTP parser is required for each message
-            pr_.emplace();
+            // Abandon the queue and any pending read
+            return do_stop();
+        }
 
-            // Set some limits to discourage attackers.
-            pr_->body_limit(64 * 1024);
-            pr_->header_limit(2048);
+        if(need_eof)
+        {
+            // This means we should close the connection, usually because
+            // the response indicated the "Connection: close" semantic.
+            return impl()->do_close();
+        }
 
-            // Read the next HTTP request
-            yield http::async_read(
-                impl()->stream(),
-                storage_,
-                *pr_,
-                bind_front(this));
+        if(count_ > 0)
+            do_write();
 
-            // This means they closed the connection
-            if(ec == http::error::end_of_stream)
-            {
-                return impl()->do_close();
-            }
+        // Let the reader continue
+        if(paused_)
+        {
+            paused_ = false;
+            (*this)();
+        }
+    }
+
+    // Write a response, calling on_write when done.
+    // The message is owned by the queue until then.
+    template<class Body>
+    void
+    write_response(http::response<Body>& res)
+    {
+        http::async_write(
+            impl()->stream(),
+            res,
+            make_write_handler());
+    }
 
-            // Handle the error, if any
-            if(ec)
-                return impl()->fail(ec, "http::async_read");
+    // Called on any thread when the calls in a
+    // JSON-RPC request have all completed.
+    struct rpc_handler
+    {
+        boost::shared_ptr<http_session_base> self;
 
-            // See if it is a WebSocket Upgrade
-            if(websocket::is_upgrade(pr_->get()))
-            {
-                // Turn off the expiration timer
-                impl()->expires_never();
+        void
+        operator()(std::string body) const
+        {
+            net::post(
+                self->impl()->stream().get_executor(),
+                beast::bind_front_handler(
+                    &http_session_base::on_rpc,
+                    self,
+                    std::move(body)));
+        }
+    };
 
-                // Convert the request type
-                websocket::request_type req(pr_->release());
+    void
+    on_rpc(std::string const& body)
+    {
+        auto const& req = pr_->get();
+        if(body.empty())
+        {
+            // Every call was a notification
+            http::response<http::empty_body> res{
+                http::status::no_content, req.version()};
+            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            res.keep_alive(req.keep_alive());
+            enqueue(std::move(res));
+        }
+        else
+        {
+            http::response<http::string_body> res{
+                http::status::ok, req.version()};
+            res.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            res.set(http::field::content_type, "application/json");
+            res.keep_alive(req.keep_alive());
+            res.body() = body;
+            res.prepare_payload();
+            enqueue(std::move(res));
+        }
 
-                // Create a WebSocket session by transferring the socket
-                return run_ws_session(
-                    srv_, lst_,
-                    std::move(impl()->stream()),
-                    ep_,
-                    std::move(req));
-            }
+        // Let the reader continue
+        rpc_pending_ = false;
+        (*this)();
+    }
 
-            // Send the response
-            yield
-            handle_request(
-                srv_.doc_root(),
-                pr_->release(),
-                send_lambda{*this});
+    // We only require C++11, this helper is
+    // the equivalent of a C++14 generic lambda.
+    struct send_lambda
+    {
+        http_session_base& self_;
 
-            // Handle the error, if any
-            if(ec)
-                return impl()->fail(ec, "http::async_write");
+        template<class Body>
+        void
+        operator()(http::response<Body>&& res) const
+        {
+            self_.enqueue(std::move(res));
+        }
+    };
 
-            if(need_eof)
+    // The read loop
+    void
+    operator()(
+        beast::error_code ec = {},
+        std::size_t bytes_transferred = 0)
+    {
+        reenter(*this)
+        {
+            for(;;)
             {
-                // This means we should close the connection, usually because
-                // the response indicated the "Connection: close" semantic.
-                return impl()->do_close();
+                // Wait for room in the queue
+                while(count_ == queue_limit)
+                {
+                    paused_ = true;
+                    yield return;
+                }
+
+                // Set the expiration
+                impl()->expires_after(std::chrono::seconds(30));
+
+                // A new HTTP parser is required for each message,
+                // but the memory for the request is reused.
+                pr_.emplace(
+                    std::piecewise_construct,
+                    std::make_tuple(
+                        arena_allocator<char>(arena_)),
+                    std::make_tuple(
+                        arena_allocator<char>(arena_)));
+
+                // Set some limits to discourage attackers.
+                pr_->body_limit(64 * 1024);
+                pr_->header_limit(2048);
+
+                // Read the next HTTP request
+                yield http::async_read(
+                    impl()->stream(),
+                    storage_,
+                    *pr_,
+                    bind_front(this));
+
+                // This means they closed the connection
+                if(ec == http::error::end_of_stream)
+                {
+                    // Finish the responses which are queued
+                    while(count_ > 0)
+                    {
+                        paused_ = true;
+                        yield return;
+                    }
+                    return impl()->do_close();
+                }
+
+                // Handle the error, if any
+                if(ec)
+                    return impl()->fail(ec, "http::async_read");
+
+                requests_.inc();
+                bytes_in_.inc(bytes_transferred);
+                rec_.add(trace_event::read, this);
+
+                // See if it is a WebSocket Upgrade
+                if(websocket::is_upgrade(pr_->get()))
+                {
+                    // The stream can't be handed
+                    // off until the queue is empty
+                    while(count_ > 0)
+                    {
+                        paused_ = true;
+                        yield return;
+                    }
+
+                    // Turn off the expiration timer
+                    impl()->expires_never();
+
+                    // Convert the request type
+                    auto req = to_request_type(pr_->get());
+                    pr_.reset();
+
+                    // Create a WebSocket session by transferring the socket
+                    return run_ws_session(
+                        srv_, lst_,
+                        std::move(impl()->stream()),
+                        ep_,
+                        std::move(req));
+                }
+
+                // See if it is a request for Server-Sent Events
+                if(is_event_stream(pr_->get(), cid_))
+                {
+                    // The stream can't be handed
+                    // off until the queue is empty
+                    while(count_ > 0)
+                    {
+                        paused_ = true;
+                        yield return;
+                    }
+
+                    pr_.reset();
+                    impl()->expires_never();
+
+                    // Subscribe a streaming response to the channel
+                    return run_sse_session(
+                        srv_, lst_,
+                        std::move(impl()->stream()),
+                        ep_,
+                        cid_);
+                }
+
+                // JSON-RPC calls may complete asynchronously, so
+                // reading stops until the response is queued.
+                if(is_rpc_call(pr_->get()))
+                {
+                    rpc_pending_ = true;
+                    run_http_rpc(
+                        srv_,
+                        beast::string_view(
+                            pr_->get().body().data(),
+                            pr_->get().body().size()),
+                        rpc_handler{boost::shared_from(this)});
+                    while(rpc_pending_)
+                        yield return;
+                    if(closing_)
+                        return;
+                    continue;
+                }
+
+                // Queue the response
+                handle_request(
+                    srv_,
+                    pr_->release(),
+                    send_lambda{*this});
+
+                if(closing_)
+                    return;
             }
         }
     }
-
 };
 
 //------------------------------------------------------------------------------
@@ -431,13 +1135,13 @@ public:
     expires_after(
         std::chrono::seconds n)
     {
-        stream_.expires_after(n);
+        set_deadline(n);
     }
 
     void
     expires_never()
     {
-        stream_.expires_never();
+        this->cancel_deadline();
     }
 
     void
@@ -457,6 +1161,71 @@ public:
             tcp::socket::shutdown_send, ec);
     }
 
+    using http_session_base::write_response;
+
+#ifdef LOUNGE_HAS_SENDFILE
+    // Small files are not worth the extra system calls
+    static std::uint64_t constexpr sendfile_threshold = 16 * 1024;
+
+    void
+    write_response(http::response<http::file_body>& res)
+    {
+        if(res.body().size() < sendfile_threshold)
+            return http_session_base::write_response(res);
+        write_sendfile(res,
+            res.body().file().native_handle(),
+            0, res.body().size());
+    }
+
+    void
+    write_response(http::response<file_range_body>& res)
+    {
+        // Multipart bodies interleave text with the file
+        auto const& parts = res.body().parts();
+        if( parts.size() != 1 ||
+            ! parts[0].head.empty() ||
+            res.body().size() != parts[0].length ||
+            parts[0].length < sendfile_threshold)
+            return http_session_base::write_response(res);
+        write_sendfile(res,
+            res.body().file().native_handle(),
+            parts[0].offset, parts[0].length);
+    }
+
+    // Write the header, then have the kernel send the file.
+    // Only the serializer is allocated, the message stays
+    // in the queue until the write completes.
+    template<class Body>
+    void
+    write_sendfile(
+        http::response<Body>& res,
+        int fd,
+        std::uint64_t offset,
+        std::uint64_t length)
+    {
+        auto sr = std::make_shared<
+            http::response_serializer<Body>>(res);
+        auto handler = make_write_handler();
+        http::async_write_header(
+            stream_,
+            *sr,
+            [this, handler, sr, fd, offset, length](
+                beast::error_code ec,
+                std::size_t bytes_transferred)
+            {
+                if(ec)
+                    return handler(ec, bytes_transferred);
+
+                async_sendfile(
+                    stream_.socket(),
+                    fd,
+                    offset,
+                    length,
+                    handler);
+            });
+    }
+#endif
+
     // Report a failure
     void
     fail(beast::error_code ec, char const* what)
@@ -499,13 +1268,13 @@ public:
     expires_after(
         std::chrono::seconds n)
     {
-        stream_.next_layer().expires_after(n);
+        set_deadline(n);
     }
 
     void
     expires_never()
     {
-        stream_.next_layer().expires_never();
+        this->cancel_deadline();
     }
 
     void
@@ -546,6 +1315,39 @@ public:
         if(ec)
             return fail(ec, "async_handshake");
 
+        rec_.add(trace_event::handshake, this);
+
+        // Move the record layer into the kernel if requested
+        if(lst_.config().ktls)
+        {
+            if(storage_.size() > 0)
+                ec = ktls_error::pending_data;
+            else
+                enable_ktls(
+                    stream_.native_handle(),
+                    beast::get_lowest_layer(
+                        stream_).socket().native_handle(),
+                    ec);
+            if(! ec)
+            {
+                // The kernel now encrypts and decrypts the
+                // application data, so continue as plain HTTP.
+                expires_never();
+                return run_http_session(
+                    srv_, lst_,
+                    std::move(stream_.next_layer()),
+                    ep_,
+                    std::move(storage_));
+            }
+
+            // The socket is unusable
+            if(ec == ktls_error::partial_install)
+                return fail(ec, "enable_ktls");
+
+            // Fall back to user-space TLS
+            LOG_TRC(log_, "enable_ktls", '\t', ec.message());
+        }
+
         // Process HTTP
         (*this)();
     }
@@ -601,6 +1403,73 @@ public:
     }
 };
 
+//------------------------------------------------------------------------------
+
+// A session on an in-process pipe, files are always
+// written through the serializer as there is no socket.
+class pipe_http_session_impl
+    : public http_session_base<pipe_http_session_impl>
+{
+    pipe_stream stream_;
+
+public:
+    pipe_http_session_impl(
+        server& srv,
+        listener& lst,
+        pipe_stream stream,
+        endpoint_type ep,
+        flat_storage storage)
+        : http_session_base(
+            srv, lst, ep, std::move(storage))
+        , stream_(std::move(stream))
+    {
+    }
+
+    pipe_stream&
+    stream()
+    {
+        return stream_;
+    }
+
+    void
+    expires_after(
+        std::chrono::seconds n)
+    {
+        stream_.expires_after(n);
+    }
+
+    void
+    expires_never()
+    {
+        stream_.expires_never();
+    }
+
+    void
+    run()
+    {
+        // Use post to get on to our strand.
+        net::post(
+            stream_.get_executor(),
+            bind_front(this));
+    }
+
+    void
+    do_close()
+    {
+        stream_.shutdown_send();
+    }
+
+    // Report a failure
+    void
+    fail(beast::error_code ec, char const* what)
+    {
+        if(ec == net::error::operation_aborted)
+            LOG_TRC(log_, what, '\t', ec.message());
+        else
+            LOG_INF(log_, what, '\t', ec.message());
+    }
+};
+
 } // (anon)
 
 //------------------------------------------------------------------------------
@@ -639,3 +1508,20 @@ run_https_session(
         std::move(storage));
     sp->run();
 }
+
+void
+run_http_session(
+    server& srv,
+    listener& lst,
+    pipe_stream stream,
+    endpoint_type ep,
+    flat_storage storage)
+{
+    auto sp = boost::make_shared<
+            pipe_http_session_impl>(
+        srv, lst,
+        std::move(stream),
+        ep,
+        std::move(storage));
+    sp->run();
+}
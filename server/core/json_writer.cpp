@@ -0,0 +1,97 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "json_writer.hpp"
+#include <cmath>
+#include <cstdio>
+
+void
+json_writer::
+value(double v)
+{
+    // JSON has no representation for these
+    if(! std::isfinite(v))
+        return null();
+    separate();
+    char buf[32];
+    auto const n = std::snprintf(
+        buf, sizeof(buf), "%.17g", v);
+    s_.append(buf, static_cast<std::size_t>(n));
+    comma_ = true;
+}
+
+void
+json_writer::
+string(beast::string_view s)
+{
+    static char const hex[] = "0123456789abcdef";
+    s_.push_back('"');
+    auto p = s.data();
+    auto const end = p + s.size();
+    while(p != end)
+    {
+        // Copy the run which needs no escaping
+        auto q = p;
+        while( q != end &&
+            static_cast<unsigned char>(*q) >= 0x20 &&
+            *q != '"' && *q != '\\')
+            ++q;
+        s_.append(p, q);
+        if(q == end)
+            break;
+        auto const c = static_cast<unsigned char>(*q);
+        s_.push_back('\\');
+        switch(c)
+        {
+        case '"':  s_.push_back('"'); break;
+        case '\\': s_.push_back('\\'); break;
+        case '\b': s_.push_back('b'); break;
+        case '\f': s_.push_back('f'); break;
+        case '\n': s_.push_back('n'); break;
+        case '\r': s_.push_back('r'); break;
+        case '\t': s_.push_back('t'); break;
+        default:
+            s_.append("u00");
+            s_.push_back(hex[c >> 4]);
+            s_.push_back(hex[c & 0xf]);
+            break;
+        }
+        p = q + 1;
+    }
+    s_.push_back('"');
+}
+
+void
+json_writer::
+write_signed(std::int64_t v)
+{
+    if(v < 0)
+    {
+        s_.push_back('-');
+        // avoid overflow for the most negative value
+        write_unsigned(0 - static_cast<std::uint64_t>(v));
+        return;
+    }
+    write_unsigned(static_cast<std::uint64_t>(v));
+}
+
+void
+json_writer::
+write_unsigned(std::uint64_t v)
+{
+    char buf[20];
+    auto p = buf + sizeof(buf);
+    do
+    {
+        *--p = static_cast<char>('0' + v % 10);
+        v /= 10;
+    }
+    while(v > 0);
+    s_.append(p, buf + sizeof(buf));
+}
@@ -0,0 +1,152 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_JSON_WRITER_HPP
+#define LOUNGE_JSON_WRITER_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+
+/** Appends JSON text to a string.
+
+    This is used to produce frequently requested documents
+    without building a `json::value` first. Commas between
+    elements are inserted automatically, the caller is
+    responsible for balancing objects and arrays.
+*/
+class json_writer
+{
+    std::string& s_;
+    bool comma_ = false;
+
+    void
+    separate()
+    {
+        if(comma_)
+            s_.push_back(',');
+    }
+
+public:
+    explicit
+    json_writer(std::string& s) noexcept
+        : s_(s)
+    {
+    }
+
+    void
+    begin_object()
+    {
+        separate();
+        s_.push_back('{');
+        comma_ = false;
+    }
+
+    void
+    end_object()
+    {
+        s_.push_back('}');
+        comma_ = true;
+    }
+
+    void
+    begin_array()
+    {
+        separate();
+        s_.push_back('[');
+        comma_ = false;
+    }
+
+    void
+    end_array()
+    {
+        s_.push_back(']');
+        comma_ = true;
+    }
+
+    /// Write the key of the next member of an object
+    void
+    key(beast::string_view k)
+    {
+        separate();
+        string(k);
+        s_.push_back(':');
+        comma_ = false;
+    }
+
+    void
+    value(beast::string_view v)
+    {
+        separate();
+        string(v);
+        comma_ = true;
+    }
+
+    void
+    value(char const* v)
+    {
+        value(beast::string_view(v));
+    }
+
+    template<class Integer>
+    typename std::enable_if<
+        std::is_integral<Integer>::value &&
+        ! std::is_same<Integer, bool>::value>::type
+    value(Integer v)
+    {
+        separate();
+        if(std::is_signed<Integer>::value)
+            write_signed(static_cast<std::int64_t>(v));
+        else
+            write_unsigned(static_cast<std::uint64_t>(v));
+        comma_ = true;
+    }
+
+    void
+    value(bool v)
+    {
+        separate();
+        s_.append(v ? "true" : "false");
+        comma_ = true;
+    }
+
+    void
+    value(double v);
+
+    void
+    null()
+    {
+        separate();
+        s_.append("null");
+        comma_ = true;
+    }
+
+    /// Write a member of an object
+    template<class T>
+    void
+    member(beast::string_view k, T const& v)
+    {
+        key(k);
+        value(v);
+    }
+
+private:
+    void
+    string(beast::string_view s);
+
+    void
+    write_signed(std::int64_t v);
+
+    void
+    write_unsigned(std::uint64_t v);
+};
+
+#endif
@@ -0,0 +1,355 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "ktls.hpp"
+#include <boost/assert.hpp>
+#include <boost/config.hpp>
+#include <boost/core/ignore_unused.hpp>
+#include <openssl/evp.h>
+#include <openssl/kdf.h>
+#include <cstring>
+#include <type_traits>
+
+#if defined(__linux__) && defined(__has_include)
+# if __has_include(<linux/tls.h>)
+#  define LOUNGE_HAS_KTLS 1
+# endif
+#endif
+
+#ifdef LOUNGE_HAS_KTLS
+# include <linux/tls.h>
+# include <netinet/in.h>
+# include <netinet/tcp.h>
+# include <sys/socket.h>
+# include <cerrno>
+# ifndef SOL_TLS
+#  define SOL_TLS 282
+# endif
+# ifndef TCP_ULP
+#  define TCP_ULP 31
+# endif
+#endif
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+class ktls_error_codes : public beast::error_category
+{
+public:
+    const char*
+    name() const noexcept override
+    {
+        return "beast-lounge.ktls";
+    }
+
+    std::string
+    message(int ev) const override
+    {
+        switch(static_cast<ktls_error>(ev))
+        {
+        case ktls_error::unsupported_platform: return
+            "Kernel TLS is not supported on this platform";
+        case ktls_error::unsupported_version: return
+            "Kernel TLS requires TLS 1.2";
+        case ktls_error::unsupported_cipher: return
+            "The negotiated cipher is not supported by kernel TLS";
+        case ktls_error::pending_data: return
+            "TLS records are buffered in user space";
+        case ktls_error::key_derivation: return
+            "Deriving the TLS session keys failed";
+        case ktls_error::partial_install: return
+            "The kernel accepted only part of the TLS session";
+        }
+        return "Unknown kTLS error #" + std::to_string(ev);
+    }
+
+    beast::error_condition
+    default_error_condition(int ev) const noexcept override
+    {
+        return {ev, *this};
+    }
+};
+
+#ifdef LOUNGE_HAS_KTLS
+
+// Per-direction session state handed to the kernel
+struct direction
+{
+    unsigned char const* key;
+    unsigned char const* iv;
+    unsigned char rec_seq[8];
+};
+
+// Sizes of the key block parts for a cipher
+struct cipher_sizes
+{
+    std::size_t key;
+    std::size_t iv;
+};
+
+bool
+get_sizes(int nid, cipher_sizes& cs)
+{
+    switch(nid)
+    {
+    case NID_aes_128_gcm:
+        cs = { TLS_CIPHER_AES_GCM_128_KEY_SIZE,
+               TLS_CIPHER_AES_GCM_128_SALT_SIZE };
+        return true;
+
+#ifdef TLS_CIPHER_AES_GCM_256
+    case NID_aes_256_gcm:
+        cs = { TLS_CIPHER_AES_GCM_256_KEY_SIZE,
+               TLS_CIPHER_AES_GCM_256_SALT_SIZE };
+        return true;
+#endif
+
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+        cs = { TLS_CIPHER_CHACHA20_POLY1305_KEY_SIZE,
+               TLS_CIPHER_CHACHA20_POLY1305_IV_SIZE };
+        return true;
+#endif
+
+    default:
+        return false;
+    }
+}
+
+// Compute the TLS 1.2 key block (RFC 5246 section 6.3)
+bool
+derive_key_block(
+    SSL* ssl,
+    unsigned char* out,
+    std::size_t size)
+{
+    unsigned char master[SSL_MAX_MASTER_KEY_LENGTH];
+    unsigned char client_random[SSL3_RANDOM_SIZE];
+    unsigned char server_random[SSL3_RANDOM_SIZE];
+    static char const label[] = "key expansion";
+
+    auto const md = SSL_CIPHER_get_handshake_digest(
+        SSL_get_current_cipher(ssl));
+    auto const master_size = SSL_SESSION_get_master_key(
+        SSL_get_session(ssl), master, sizeof(master));
+    if(! md || master_size == 0)
+        return false;
+    SSL_get_client_random(
+        ssl, client_random, sizeof(client_random));
+    SSL_get_server_random(
+        ssl, server_random, sizeof(server_random));
+
+    struct cleanup
+    {
+        EVP_PKEY_CTX* ctx;
+        unsigned char* master;
+
+        ~cleanup()
+        {
+            EVP_PKEY_CTX_free(ctx);
+            OPENSSL_cleanse(master, SSL_MAX_MASTER_KEY_LENGTH);
+        }
+    };
+
+    cleanup c{EVP_PKEY_CTX_new_id(
+        EVP_PKEY_TLS1_PRF, nullptr), master};
+    if(! c.ctx)
+        return false;
+    std::size_t n = size;
+    return
+        EVP_PKEY_derive_init(c.ctx) > 0 &&
+        EVP_PKEY_CTX_set_tls1_prf_md(c.ctx, md) > 0 &&
+        EVP_PKEY_CTX_set1_tls1_prf_secret(c.ctx,
+            master, static_cast<int>(master_size)) > 0 &&
+        EVP_PKEY_CTX_add1_tls1_prf_seed(c.ctx,
+            reinterpret_cast<unsigned char const*>(label),
+            sizeof(label) - 1) > 0 &&
+        EVP_PKEY_CTX_add1_tls1_prf_seed(c.ctx,
+            server_random, sizeof(server_random)) > 0 &&
+        EVP_PKEY_CTX_add1_tls1_prf_seed(c.ctx,
+            client_random, sizeof(client_random)) > 0 &&
+        EVP_PKEY_derive(c.ctx, out, &n) > 0 &&
+        n == size;
+}
+
+// Fill in an AES-GCM crypto_info. For TLS 1.2 the kernel
+// takes the implicit part of the nonce as the salt, and
+// the explicit part from `iv`, which must never repeat.
+template<class Info>
+void
+fill_gcm(
+    Info& info,
+    unsigned short cipher_type,
+    direction const& d)
+{
+    std::memset(&info, 0, sizeof(info));
+    info.info.version = TLS_1_2_VERSION;
+    info.info.cipher_type = cipher_type;
+    std::memcpy(info.key, d.key, sizeof(info.key));
+    std::memcpy(info.salt, d.iv, sizeof(info.salt));
+    std::memcpy(info.iv, d.rec_seq, sizeof(info.iv));
+    std::memcpy(info.rec_seq, d.rec_seq, sizeof(info.rec_seq));
+}
+
+int
+install(
+    int fd,
+    int optname,
+    int nid,
+    direction const& d)
+{
+    switch(nid)
+    {
+    case NID_aes_128_gcm:
+    {
+        tls12_crypto_info_aes_gcm_128 info;
+        fill_gcm(info, TLS_CIPHER_AES_GCM_128, d);
+        return ::setsockopt(fd,
+            SOL_TLS, optname, &info, sizeof(info));
+    }
+
+#ifdef TLS_CIPHER_AES_GCM_256
+    case NID_aes_256_gcm:
+    {
+        tls12_crypto_info_aes_gcm_256 info;
+        fill_gcm(info, TLS_CIPHER_AES_GCM_256, d);
+        return ::setsockopt(fd,
+            SOL_TLS, optname, &info, sizeof(info));
+    }
+#endif
+
+#ifdef TLS_CIPHER_CHACHA20_POLY1305
+    case NID_chacha20_poly1305:
+    {
+        tls12_crypto_info_chacha20_poly1305 info;
+        std::memset(&info, 0, sizeof(info));
+        info.info.version = TLS_1_2_VERSION;
+        info.info.cipher_type = TLS_CIPHER_CHACHA20_POLY1305;
+        std::memcpy(info.key, d.key, sizeof(info.key));
+        std::memcpy(info.iv, d.iv, sizeof(info.iv));
+        std::memcpy(info.rec_seq, d.rec_seq, sizeof(info.rec_seq));
+        return ::setsockopt(fd,
+            SOL_TLS, optname, &info, sizeof(info));
+    }
+#endif
+
+    default:
+        errno = EINVAL;
+        return -1;
+    }
+}
+
+#endif
+
+} // (anon)
+
+beast::error_code
+make_error_code(ktls_error e)
+{
+    static ktls_error_codes const cat{};
+    return {static_cast<std::underlying_type<
+        ktls_error>::type>(e), cat};
+}
+
+//------------------------------------------------------------------------------
+
+void
+enable_ktls(
+    SSL* ssl,
+    socket_type::native_handle_type fd,
+    beast::error_code& ec)
+{
+#ifndef LOUNGE_HAS_KTLS
+    boost::ignore_unused(ssl, fd);
+    ec = ktls_error::unsupported_platform;
+#else
+    ec = {};
+
+    if(SSL_version(ssl) != TLS1_2_VERSION)
+    {
+        ec = ktls_error::unsupported_version;
+        return;
+    }
+
+    auto const nid = SSL_CIPHER_get_cipher_nid(
+        SSL_get_current_cipher(ssl));
+    cipher_sizes cs;
+    if(! get_sizes(nid, cs))
+    {
+        ec = ktls_error::unsupported_cipher;
+        return;
+    }
+
+    // Any record which OpenSSL already holds would
+    // never be seen by the kernel, and the sequence
+    // numbers below assume nothing was exchanged
+    // after the Finished messages.
+    if( SSL_pending(ssl) > 0 ||
+        BIO_ctrl_pending(SSL_get_rbio(ssl)) > 0 ||
+        BIO_ctrl_wpending(SSL_get_wbio(ssl)) > 0)
+    {
+        ec = ktls_error::pending_data;
+        return;
+    }
+
+    // client_write_key, server_write_key,
+    // client_write_IV, server_write_IV
+    unsigned char kb[2 * (32 + 12)];
+    auto const kb_size = 2 * (cs.key + cs.iv);
+    BOOST_ASSERT(kb_size <= sizeof(kb));
+    if(! derive_key_block(ssl, kb, kb_size))
+    {
+        OPENSSL_cleanse(kb, sizeof(kb));
+        ec = ktls_error::key_derivation;
+        return;
+    }
+
+    // The Finished message in each direction used
+    // sequence number zero of the new epoch.
+    direction rx{ kb, kb + 2 * cs.key, { 0,0,0,0,0,0,0,1 } };
+    direction tx{ kb + cs.key, kb + 2 * cs.key + cs.iv, { 0,0,0,0,0,0,0,1 } };
+
+    struct cleanup
+    {
+        unsigned char* p;
+        std::size_t n;
+
+        ~cleanup()
+        {
+            OPENSSL_cleanse(p, n);
+        }
+    };
+    cleanup c{kb, sizeof(kb)};
+
+    auto const& gc =
+        boost::system::generic_category();
+
+    // Attaching the upper layer protocol without
+    // any keys leaves the socket unchanged.
+    if(::setsockopt(fd, SOL_TCP, TCP_ULP,
+        "tls", sizeof("tls")) != 0)
+    {
+        ec = beast::error_code(errno, gc);
+        return;
+    }
+
+    if(install(fd, TLS_RX, nid, rx) != 0)
+    {
+        ec = beast::error_code(errno, gc);
+        return;
+    }
+
+    if(install(fd, TLS_TX, nid, tx) != 0)
+    {
+        ec = ktls_error::partial_install;
+        return;
+    }
+#endif
+}
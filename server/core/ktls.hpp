@@ -0,0 +1,81 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_KTLS_HPP
+#define LOUNGE_KTLS_HPP
+
+#include "config.hpp"
+#include "types.hpp"
+#include <boost/beast/core/error.hpp>
+#include <openssl/ssl.h>
+
+/// Errors produced when offloading TLS to the kernel
+enum class ktls_error
+{
+    /// The kernel or platform does not support kTLS
+    unsupported_platform = 1,
+
+    /// The negotiated protocol version cannot be offloaded
+    unsupported_version,
+
+    /// The negotiated cipher cannot be offloaded
+    unsupported_cipher,
+
+    /// Records are buffered in user space
+    pending_data,
+
+    /// Deriving the session keys failed
+    key_derivation,
+
+    /** The kernel accepted only part of the session state.
+
+        The socket can no longer be used with
+        either kernel or user-space TLS.
+    */
+    partial_install
+};
+
+namespace boost {
+namespace system {
+template<>
+struct is_error_code_enum<ktls_error>
+{
+    static bool constexpr value = true;
+};
+} // system
+} // boost
+
+beast::error_code
+make_error_code(ktls_error e);
+
+/** Move the record layer of a TLS session into the kernel.
+
+    This must be called immediately after the server handshake
+    completes, before any application data is read or written
+    through OpenSSL. On success the kernel encrypts and decrypts
+    application data on `fd`, and the caller continues using
+    plain socket I/O. On failure the session may continue using
+    user-space TLS, unless the error is
+    @ref ktls_error::partial_install.
+
+    Only TLS 1.2 with AES-GCM or ChaCha20-Poly1305 is supported.
+
+    @param ssl The OpenSSL session which completed the handshake.
+
+    @param fd The native socket handle of the connection.
+
+    @param ec Set to the error, if any occurred.
+*/
+void
+enable_ktls(
+    SSL* ssl,
+    socket_type::native_handle_type fd,
+    beast::error_code& ec);
+
+#endif
@@ -0,0 +1,805 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "ledger.hpp"
+#include <boost/assert.hpp>
+#include <boost/crc.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <stdexcept>
+
+#ifdef __linux__
+# include <fcntl.h>
+# include <unistd.h>
+#endif
+
+/*
+    Files in the ledger directory:
+
+    journal.N   Changes, in records appended to a zero
+                filled file. A record with a size of zero
+                ends the journal, and the sequence numbers
+                continue in journal N+1.
+
+    snapshot    The balances at a sequence number, and the
+                first journal to replay after it. Written
+                to snapshot.tmp and renamed into place.
+
+    Integers are in the byte order of the host.
+*/
+
+namespace fs = boost::filesystem;
+namespace ipc = boost::interprocess;
+
+namespace {
+
+char const journal_magic[8] =
+    { 'L', 'N', 'G', 'L', 'J', '0', '0', '1' };
+
+char const snapshot_magic[8] =
+    { 'L', 'N', 'G', 'L', 'S', '0', '0', '1' };
+
+// Accounts are named by the user names, which are shorter
+std::size_t constexpr max_account = 255;
+
+// Start of the first record in a journal
+std::size_t constexpr journal_header = 32;
+
+// Header of each record, followed by the account name
+struct entry
+{
+    std::uint32_t size;         // with padding, 0 = end
+    std::uint32_t crc;          // of everything after crc
+    std::uint64_t seq;
+    std::int64_t amount;        // added to the balance
+    std::uint16_t name_size;
+    std::uint8_t kind;
+    std::uint8_t pad[5];
+};
+
+static_assert(sizeof(entry) == 32, "");
+
+struct snapshot_header
+{
+    char magic[8];
+    std::uint64_t seq;
+    std::uint64_t gen;          // first journal to replay
+    std::uint64_t count;
+    std::uint32_t crc;          // of the accounts
+    std::uint32_t pad;
+};
+
+static_assert(sizeof(snapshot_header) == 40, "");
+
+std::uint32_t
+entry_crc(
+    entry const& e,
+    char const* name) noexcept
+{
+    boost::crc_32_type crc;
+    auto const p = reinterpret_cast<char const*>(&e);
+    crc.process_bytes(p + 8, sizeof(e) - 8);
+    crc.process_bytes(name, e.name_size);
+    return crc.checksum();
+}
+
+beast::error_code
+corrupt()
+{
+    return boost::system::errc::make_error_code(
+        boost::system::errc::bad_message);
+}
+
+// Make a rename in the directory durable
+void
+sync_directory(std::string const& path)
+{
+#ifdef __linux__
+    auto const fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY);
+    if(fd >= 0)
+    {
+        ::fsync(fd);
+        ::close(fd);
+    }
+#else
+    (void)path;
+#endif
+}
+
+bool
+file_exists(std::string const& path)
+{
+    beast::error_code ec;
+    return fs::is_regular_file(path, ec);
+}
+
+// Return the generation of a journal file name, or zero
+std::uint64_t
+journal_gen(std::string const& name)
+{
+    if(name.compare(0, 8, "journal.") != 0 || name.size() == 8)
+        return 0;
+    std::uint64_t gen = 0;
+    for(auto it = name.begin() + 8; it != name.end(); ++it)
+    {
+        if(*it < '0' || *it > '9')
+            return 0;
+        gen = gen * 10 + (*it - '0');
+    }
+    return gen;
+}
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+struct ledger::journal
+{
+    std::uint64_t gen;
+    ipc::file_mapping file;
+    ipc::mapped_region region;
+    char* data;
+    std::size_t capacity;
+
+    // Bytes written, guarded by the ledger's mutex
+    std::size_t size = journal_header;
+
+    // Bytes on disk, used only by the commit thread
+    std::size_t synced = 0;
+
+    journal(
+        std::uint64_t gen_,
+        std::string const& path)
+        : gen(gen_)
+        , file(path.c_str(), ipc::read_write)
+        , region(file, ipc::read_write)
+        , data(static_cast<char*>(region.get_address()))
+        , capacity(region.get_size())
+    {
+    }
+
+    // Write the bytes up to `end` to disk
+    void
+    flush(std::size_t end)
+    {
+        if(end <= synced)
+            return;
+        region.flush(synced, end - synced, false);
+        synced = end;
+    }
+};
+
+//------------------------------------------------------------------------------
+
+ledger::
+ledger(
+    std::string path,
+    std::size_t journal_size,
+    std::int64_t initial_balance)
+    : path_(std::move(path))
+    , journal_size_(journal_size < 4096 ? 4096 : journal_size)
+    , initial_balance_(initial_balance)
+    , seq_(0)
+    , committed_(0)
+    , snapshots_(0)
+{
+}
+
+ledger::
+~ledger()
+{
+    close();
+}
+
+void
+ledger::
+open(beast::error_code& ec)
+{
+    BOOST_ASSERT(! thread_.joinable());
+    fs::create_directories(path_, ec);
+    if(ec)
+        return;
+
+    std::uint64_t gen;
+    replay(gen, ec);
+    if(ec)
+        return;
+
+    // Compact what was replayed, so the journals can go
+    write_snapshot(balances_, seq_, gen, ec);
+    if(ec)
+        return;
+    remove_journals((std::numeric_limits<std::uint64_t>::max)());
+    committed_ = seq_.load();
+
+    journal_ = create_journal(gen, ec);
+    if(ec)
+        return;
+    spare_ = create_journal(gen + 1, ec);
+    if(ec)
+        return;
+    mirror_ = balances_;
+    mirror_journal_ = journal_;
+    mirror_end_ = journal_header;
+    mirror_seq_ = seq_;
+
+    stop_ = false;
+    thread_ = std::thread(&ledger::run, this);
+}
+
+void
+ledger::
+close()
+{
+    if(! thread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    spare_cv_.notify_all();
+    thread_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    journal_.reset();
+    spare_.reset();
+    retired_.clear();
+    mirror_journal_.reset();
+}
+
+std::int64_t
+ledger::
+balance(beast::string_view account)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    make_room(lock, 1, account);
+    return find_or_open(account);
+}
+
+std::int64_t
+ledger::
+wager(
+    beast::string_view account,
+    std::int64_t amount)
+{
+    BOOST_ASSERT(amount >= 0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    make_room(lock, 2, account);
+    auto& b = find_or_open(account);
+    if(b < amount)
+        return -1;
+    append(kind::wager, account, -amount);
+    b -= amount;
+    return b;
+}
+
+std::int64_t
+ledger::
+settle(
+    beast::string_view account,
+    std::int64_t amount)
+{
+    BOOST_ASSERT(amount >= 0);
+    std::unique_lock<std::mutex> lock(mutex_);
+    make_room(lock, 2, account);
+    auto& b = find_or_open(account);
+    append(kind::settle, account, amount);
+    b += amount;
+    return b;
+}
+
+//------------------------------------------------------------------------------
+
+// Make sure the journal has room for the records of a
+// change, before anything is changed. Files are never
+// created with the lock held, if the spare journal is
+// not ready yet this waits for the commit thread.
+void
+ledger::
+make_room(
+    std::unique_lock<std::mutex>& lock,
+    std::size_t records,
+    beast::string_view account)
+{
+    if(account.size() > max_account)
+        throw std::invalid_argument(
+            "ledger account name too long");
+    auto const size = records * ((sizeof(entry) +
+        account.size() + 7) & ~std::size_t(7));
+    for(;;)
+    {
+        if(! journal_ || stop_)
+            throw std::logic_error("ledger is closed");
+        if(journal_->size + size <= journal_->capacity)
+            return;
+        if(rotate())
+            continue;
+        dirty_ = true;
+        cv_.notify_one();
+        spare_cv_.wait(lock);
+    }
+}
+
+std::int64_t&
+ledger::
+find_or_open(beast::string_view account)
+{
+    if(account.size() > max_account)
+        throw std::invalid_argument(
+            "ledger account name too long");
+    auto const result = balances_.emplace(
+        std::string(account.data(), account.size()), 0);
+    if(result.second)
+    {
+        try
+        {
+            append(kind::open, account, initial_balance_);
+        }
+        catch(...)
+        {
+            balances_.erase(result.first);
+            throw;
+        }
+        result.first->second = initial_balance_;
+    }
+    return result.first->second;
+}
+
+// Called with the lock held
+void
+ledger::
+append(
+    kind k,
+    beast::string_view account,
+    std::int64_t amount)
+{
+    if(! journal_)
+        throw std::logic_error("ledger is closed");
+    auto const size = (sizeof(entry) +
+        account.size() + 7) & ~std::size_t(7);
+    BOOST_ASSERT(journal_->size + size <= journal_->capacity);
+    auto& j = *journal_;
+
+    entry e;
+    std::memset(&e, 0, sizeof(e));
+    e.size = static_cast<std::uint32_t>(size);
+    e.seq = seq_.load(std::memory_order_relaxed) + 1;
+    e.amount = amount;
+    e.name_size = static_cast<std::uint16_t>(account.size());
+    e.kind = static_cast<std::uint8_t>(k);
+    e.crc = entry_crc(e, account.data());
+
+    // The padding is already zero
+    auto const p = j.data + j.size;
+    std::memcpy(p, &e, sizeof(e));
+    std::memcpy(p + sizeof(e), account.data(), account.size());
+    j.size += size;
+    seq_.store(e.seq, std::memory_order_release);
+
+    if(! want_snapshot_ && j.size > j.capacity / 2)
+        want_snapshot_ = true;
+    if(! dirty_)
+    {
+        dirty_ = true;
+        cv_.notify_one();
+    }
+}
+
+// Called with the lock held. Switch to the spare journal,
+// the commit thread prepares another one. Returns `false`
+// if the spare is not ready yet.
+bool
+ledger::
+rotate()
+{
+    if(! spare_ || spare_->gen != journal_->gen + 1)
+        return false;
+    retired_.emplace_back(std::move(journal_));
+    journal_ = std::move(spare_);
+    want_snapshot_ = true;
+    dirty_ = true;
+    cv_.notify_one();
+    return true;
+}
+
+// Called on the commit thread. Apply the records of a journal
+// up to `end` to the mirror, skipping those already applied.
+void
+ledger::
+mirror(
+    std::shared_ptr<journal> const& j,
+    std::size_t end)
+{
+    std::size_t off = journal_header;
+    if(j == mirror_journal_)
+        off = mirror_end_;
+    else if(mirror_journal_ && j->gen < mirror_journal_->gen)
+        return;
+    while(off < end)
+    {
+        entry e;
+        std::memcpy(&e, j->data + off, sizeof(e));
+        auto& b = mirror_[std::string(
+            j->data + off + sizeof(e), e.name_size)];
+        if(static_cast<kind>(e.kind) == kind::open)
+            b = e.amount;
+        else
+            b += e.amount;
+        mirror_seq_ = e.seq;
+        off += e.size;
+    }
+    mirror_journal_ = j;
+    mirror_end_ = off;
+}
+
+std::string
+ledger::
+journal_path(std::uint64_t gen) const
+{
+    return (fs::path(path_) /
+        ("journal." + std::to_string(gen))).string();
+}
+
+std::shared_ptr<ledger::journal>
+ledger::
+create_journal(
+    std::uint64_t gen,
+    beast::error_code& ec)
+{
+    auto const path = journal_path(gen);
+    {
+        // Replaces a stale file, the new one reads as zeroes
+        std::ofstream f(path, std::ios::binary | std::ios::trunc);
+        if(! f)
+        {
+            ec = boost::system::errc::make_error_code(
+                boost::system::errc::io_error);
+            return nullptr;
+        }
+    }
+    fs::resize_file(path, journal_size_, ec);
+    if(ec)
+        return nullptr;
+    try
+    {
+        auto j = std::make_shared<journal>(gen, path);
+        std::memcpy(j->data, journal_magic, sizeof(journal_magic));
+        std::memcpy(j->data + 8, &gen, sizeof(gen));
+        return j;
+    }
+    catch(ipc::interprocess_exception const& e)
+    {
+        ec = beast::error_code(e.get_native_error(),
+            boost::system::system_category());
+        return nullptr;
+    }
+}
+
+// Load the snapshot and apply the journals after it,
+// setting `gen` to the generation of the next journal.
+void
+ledger::
+replay(
+    std::uint64_t& gen,
+    beast::error_code& ec)
+{
+    balances_.clear();
+    gen = 1;
+    std::uint64_t seq = 0;
+
+    auto const snapshot_path =
+        (fs::path(path_) / "snapshot").string();
+    if(file_exists(snapshot_path))
+    {
+        std::ifstream f(snapshot_path, std::ios::binary);
+        std::vector<char> buf{
+            std::istreambuf_iterator<char>(f),
+            std::istreambuf_iterator<char>()};
+        snapshot_header h;
+        if( buf.size() < sizeof(h) ||
+            std::memcmp(buf.data(), snapshot_magic,
+                sizeof(snapshot_magic)) != 0)
+        {
+            ec = corrupt();
+            return;
+        }
+        std::memcpy(&h, buf.data(), sizeof(h));
+        boost::crc_32_type crc;
+        crc.process_bytes(buf.data() + sizeof(h),
+            buf.size() - sizeof(h));
+        if(crc.checksum() != h.crc)
+        {
+            ec = corrupt();
+            return;
+        }
+        auto p = buf.data() + sizeof(h);
+        auto const end = buf.data() + buf.size();
+        for(std::uint64_t i = 0; i < h.count; ++i)
+        {
+            std::int64_t balance;
+            std::uint16_t n;
+            if(end - p < 10)
+            {
+                ec = corrupt();
+                return;
+            }
+            std::memcpy(&balance, p, 8);
+            std::memcpy(&n, p + 8, 2);
+            p += 10;
+            if(end - p < n)
+            {
+                ec = corrupt();
+                return;
+            }
+            balances_.emplace(std::string(p, n), balance);
+            p += n;
+        }
+        seq = h.seq;
+        gen = h.gen;
+    }
+
+    // Stop at the first record which is incomplete or out
+    // of sequence, anything after it was never committed.
+    bool torn = false;
+    for(; ! torn; ++gen)
+    {
+        auto const path = journal_path(gen);
+        if(! file_exists(path))
+            break;
+        std::unique_ptr<journal> j;
+        try
+        {
+            j.reset(new journal(gen, path));
+        }
+        catch(ipc::interprocess_exception const&)
+        {
+            break;
+        }
+        if(std::memcmp(j->data, journal_magic,
+            sizeof(journal_magic)) != 0)
+            break;
+        std::size_t off = journal_header;
+        while(off + sizeof(entry) <= j->capacity)
+        {
+            entry e;
+            std::memcpy(&e, j->data + off, sizeof(e));
+            if(e.size == 0)
+                break;
+            auto const name = j->data + off + sizeof(e);
+            if( e.size < sizeof(e) + e.name_size ||
+                e.size % 8 != 0 ||
+                off + e.size > j->capacity ||
+                e.kind < static_cast<std::uint8_t>(kind::open) ||
+                e.kind > static_cast<std::uint8_t>(kind::settle) ||
+                e.seq != seq + 1 ||
+                e.crc != entry_crc(e, name))
+            {
+                torn = true;
+                break;
+            }
+            auto& b = balances_[std::string(name, e.name_size)];
+            if(static_cast<kind>(e.kind) == kind::open)
+                b = e.amount;
+            else
+                b += e.amount;
+            seq = e.seq;
+            off += e.size;
+        }
+    }
+    seq_ = seq;
+}
+
+void
+ledger::
+write_snapshot(
+    balances const& b,
+    std::uint64_t seq,
+    std::uint64_t gen,
+    beast::error_code& ec)
+{
+    std::vector<char> buf(sizeof(snapshot_header));
+    buf.reserve(sizeof(snapshot_header) + b.size() * 24);
+    for(auto const& e : b)
+    {
+        auto const n = static_cast<std::uint16_t>(e.first.size());
+        char tmp[10];
+        std::memcpy(tmp, &e.second, 8);
+        std::memcpy(tmp + 8, &n, 2);
+        buf.insert(buf.end(), tmp, tmp + 10);
+        buf.insert(buf.end(), e.first.begin(), e.first.end());
+    }
+    snapshot_header h;
+    std::memcpy(h.magic, snapshot_magic, sizeof(h.magic));
+    h.seq = seq;
+    h.gen = gen;
+    h.count = b.size();
+    h.pad = 0;
+    boost::crc_32_type crc;
+    crc.process_bytes(buf.data() + sizeof(h),
+        buf.size() - sizeof(h));
+    h.crc = crc.checksum();
+    std::memcpy(buf.data(), &h, sizeof(h));
+
+    // Written through a mapping, which can be flushed to disk
+    auto const dir = fs::path(path_);
+    auto const tmp = (dir / "snapshot.tmp").string();
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if(! f)
+        {
+            ec = boost::system::errc::make_error_code(
+                boost::system::errc::io_error);
+            return;
+        }
+    }
+    fs::resize_file(tmp, buf.size(), ec);
+    if(ec)
+        return;
+    try
+    {
+        ipc::file_mapping file(tmp.c_str(), ipc::read_write);
+        ipc::mapped_region region(file, ipc::read_write);
+        std::memcpy(region.get_address(), buf.data(), buf.size());
+        if(! region.flush(0, buf.size(), false))
+        {
+            ec = boost::system::errc::make_error_code(
+                boost::system::errc::io_error);
+            return;
+        }
+    }
+    catch(ipc::interprocess_exception const& e)
+    {
+        ec = beast::error_code(e.get_native_error(),
+            boost::system::system_category());
+        return;
+    }
+    fs::rename(tmp, dir / "snapshot", ec);
+    if(ec)
+        return;
+    sync_directory(path_);
+}
+
+// Remove the journals older than `gen`
+void
+ledger::
+remove_journals(std::uint64_t gen)
+{
+    beast::error_code ec;
+    std::vector<fs::path> v;
+    for(fs::directory_iterator it(path_, ec), end;
+        ! ec && it != end; it.increment(ec))
+    {
+        auto const n = journal_gen(
+            it->path().filename().string());
+        if(n != 0 && n < gen)
+            v.push_back(it->path());
+    }
+    for(auto const& p : v)
+        fs::remove(p, ec);
+}
+
+// Called on the commit thread
+void
+ledger::
+snapshot(beast::error_code& ec)
+{
+    // Only the journals to catch up on are copied with the
+    // lock held, the snapshot is made from the mirror.
+    std::vector<std::pair<
+        std::shared_ptr<journal>, std::size_t>> v;
+    std::uint64_t gen;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(journal_->size > journal_header && ! rotate())
+            return;
+        want_snapshot_ = false;
+        gen = journal_->gen;
+        v.reserve(retired_.size());
+        for(auto const& r : retired_)
+            v.emplace_back(r, r->size);
+    }
+    for(auto const& e : v)
+        mirror(e.first, e.second);
+    auto const seq = mirror_seq_;
+    write_snapshot(mirror_, seq, gen, ec);
+    if(ec)
+        return;
+
+    // The older journals are not needed anymore
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = retired_.begin();
+        while(it != retired_.end())
+        {
+            if((*it)->gen < gen)
+                it = retired_.erase(it);
+            else
+                ++it;
+        }
+    }
+    remove_journals(gen);
+    if(committed_.load(std::memory_order_relaxed) < seq)
+        committed_.store(seq, std::memory_order_release);
+    ++snapshots_;
+}
+
+// The commit thread
+void
+ledger::
+run()
+{
+    // Changes made within this interval share one flush
+    auto const interval = std::chrono::milliseconds(2);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    for(;;)
+    {
+        cv_.wait(lock,
+            [this]
+            {
+                return dirty_ || stop_;
+            });
+        if(! stop_)
+        {
+            lock.unlock();
+            std::this_thread::sleep_for(interval);
+            lock.lock();
+        }
+        dirty_ = false;
+        auto const stop = stop_;
+        auto const want_snapshot = want_snapshot_;
+        auto const retired = std::move(retired_);
+        retired_.clear();
+        auto const j = journal_;
+        auto const end = j->size;
+        auto const seq = seq_.load(std::memory_order_relaxed);
+        auto const need_spare = ! spare_;
+        lock.unlock();
+
+        // Older journals first, so a commit is a prefix
+        beast::error_code ec;
+        try
+        {
+            for(auto const& r : retired)
+                r->flush(r->size);
+            j->flush(end);
+            committed_.store(seq, std::memory_order_release);
+        }
+        catch(ipc::interprocess_exception const&)
+        {
+        }
+        for(auto const& r : retired)
+            mirror(r, r->size);
+        mirror(j, end);
+
+        if(need_spare)
+        {
+            auto sp = create_journal(j->gen + 1, ec);
+            lock.lock();
+            if(sp && ! spare_ && journal_ == j)
+                spare_ = std::move(sp);
+            lock.unlock();
+            spare_cv_.notify_all();
+        }
+
+        // A failed snapshot is tried again on the next
+        // rotation, and the journals are kept until then.
+        if(want_snapshot && ! stop)
+            snapshot(ec);
+
+        lock.lock();
+        if(stop)
+            break;
+    }
+}
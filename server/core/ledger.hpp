@@ -0,0 +1,233 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_LEDGER_HPP
+#define LOUNGE_LEDGER_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/string.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/** The chip balances of the players, kept on disk.
+
+    Every change to a balance is appended to a memory
+    mapped journal while holding a lock, which takes a few
+    hundred nanoseconds, and callers never wait for the
+    disk. A background thread flushes the journal at most
+    every `commit_interval`, so each flush commits all of
+    the changes made since the last one.
+
+    When the journal is half full, the balances are written
+    to a compact snapshot and a new journal is started. On
+    open, the snapshot is loaded and the journals written
+    after it are replayed, stopping at the first record
+    which is incomplete, as after a crash.
+
+    A crash loses at most the changes of the last commit
+    interval, and the balances are always consistent with
+    some prefix of the changes.
+
+    The ledger trusts the account names it is given. The
+    tables use the name from `identify`, which is not
+    authenticated, so the chips belong to whoever connects
+    with that name; two connections may even share them.
+*/
+class ledger
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /** Constructor
+
+        @param path The directory holding the files.
+
+        @param journal_size The size of each journal file.
+
+        @param initial_balance The balance of a new account.
+    */
+    explicit
+    ledger(
+        std::string path = "ledger",
+        std::size_t journal_size = 64 * 1024 * 1024,
+        std::int64_t initial_balance = 1000);
+
+    ~ledger();
+
+    /// Return the directory holding the files
+    std::string const&
+    path() const noexcept
+    {
+        return path_;
+    }
+
+    /** Load the balances and start the commit thread.
+
+        The journals are compacted into a new snapshot.
+    */
+    void
+    open(beast::error_code& ec);
+
+    /** Commit every change and stop the commit thread.
+
+        The balances may still be read afterwards.
+    */
+    void
+    close();
+
+    /** Return the balance of an account.
+
+        The account is opened if it does not exist.
+    */
+    std::int64_t
+    balance(beast::string_view account);
+
+    /** Take a wager from an account.
+
+        @return The new balance, or -1 if the
+        balance is smaller than the wager.
+    */
+    std::int64_t
+    wager(
+        beast::string_view account,
+        std::int64_t amount);
+
+    /** Pay the outcome of a wager to an account.
+
+        @return The new balance.
+    */
+    std::int64_t
+    settle(
+        beast::string_view account,
+        std::int64_t amount);
+
+    /// Return the sequence number of the last change
+    std::uint64_t
+    sequence() const noexcept
+    {
+        return seq_.load(std::memory_order_acquire);
+    }
+
+    /// Return the sequence number of the last change on disk
+    std::uint64_t
+    committed() const noexcept
+    {
+        return committed_.load(std::memory_order_acquire);
+    }
+
+    /// Return the number of snapshots written since open
+    std::size_t
+    snapshots() const noexcept
+    {
+        return snapshots_.load(std::memory_order_relaxed);
+    }
+
+private:
+    enum class kind : std::uint8_t
+    {
+        open = 1,
+        wager,
+        settle
+    };
+
+    struct journal;
+
+    using balances =
+        std::unordered_map<std::string, std::int64_t>;
+
+    std::string const path_;
+    std::size_t const journal_size_;
+    std::int64_t const initial_balance_;
+
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::condition_variable spare_cv_;
+    balances balances_;
+    std::shared_ptr<journal> journal_;
+    std::shared_ptr<journal> spare_;
+    std::vector<std::shared_ptr<journal>> retired_;
+    std::atomic<std::uint64_t> seq_;
+    std::atomic<std::uint64_t> committed_;
+    std::atomic<std::size_t> snapshots_;
+    bool dirty_ = false;
+    bool want_snapshot_ = false;
+    bool stop_ = false;
+    std::thread thread_;
+
+    // Used only by the commit thread. The balances after the
+    // records it has read from the journals, which snapshots
+    // are made of, so they never copy `balances_`.
+    balances mirror_;
+    std::shared_ptr<journal> mirror_journal_;
+    std::size_t mirror_end_ = 0;
+    std::uint64_t mirror_seq_ = 0;
+
+    void
+    make_room(
+        std::unique_lock<std::mutex>& lock,
+        std::size_t records,
+        beast::string_view account);
+
+    std::int64_t&
+    find_or_open(beast::string_view account);
+
+    void
+    append(
+        kind k,
+        beast::string_view account,
+        std::int64_t amount);
+
+    bool
+    rotate();
+
+    void
+    mirror(
+        std::shared_ptr<journal> const& j,
+        std::size_t end);
+
+    std::string
+    journal_path(std::uint64_t gen) const;
+
+    std::shared_ptr<journal>
+    create_journal(
+        std::uint64_t gen,
+        beast::error_code& ec);
+
+    void
+    replay(
+        std::uint64_t& gen,
+        beast::error_code& ec);
+
+    void
+    write_snapshot(
+        balances const& b,
+        std::uint64_t seq,
+        std::uint64_t gen,
+        beast::error_code& ec);
+
+    void
+    remove_journals(std::uint64_t gen);
+
+    void
+    snapshot(beast::error_code& ec);
+
+    void
+    run();
+};
+
+#endif
@@ -9,9 +9,11 @@
 
 #include "listener.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
 #include "server.hpp"
 #include "server_certificate.hpp"
 #include "service.hpp"
+#include "timer_wheel.hpp"
 #include "utility.hpp"
 #include <boost/beast/core/detect_ssl.hpp>
 #include <boost/asio/coroutine.hpp>
@@ -41,6 +43,14 @@ run_https_session(
     endpoint_type ep,
     flat_storage storage);
 
+extern
+void
+run_http_session(
+    server& srv,
+    listener& lst,
+    pipe_stream stream,
+    endpoint_type ep,
+    flat_storage storage);
 
 namespace {
 
@@ -58,6 +68,7 @@ class detector
     stream_type stream_;
     endpoint_type ep_;
     flat_storage storage_;
+    wheel_timer deadline_;
 
 public:
     detector(
@@ -73,6 +84,7 @@ public:
         , ctx_(ctx)
         , stream_(std::move(sock))
         , ep_(ep)
+        , deadline_(srv_.timer_wheel())
     {
         lst_.insert(this);
     }
@@ -109,6 +121,26 @@ public:
         stream_.cancel();
     }
 
+    // Close the connection if nothing arrives in time
+    void
+    set_deadline(std::chrono::seconds n)
+    {
+        boost::weak_ptr<detector> wp =
+            boost::weak_from(this);
+        deadline_.expires_after(n,
+            [wp]
+            {
+                auto sp = wp.lock();
+                if(! sp)
+                    return;
+                auto const ex = sp->stream_.get_executor();
+                net::post(ex,
+                    beast::bind_front_handler(
+                        &detector::do_stop,
+                        std::move(sp)));
+            });
+    }
+
 #include <boost/asio/yield.hpp>
     void
     operator()(
@@ -118,14 +150,14 @@ public:
         reenter(*this)
         {
             // Set the expiration
-            stream_.expires_after(
-                std::chrono::seconds(30));
+            set_deadline(std::chrono::seconds(30));
 
             // See if a TLS handshake is requested
             yield beast::async_detect_ssl(
                 stream_,
                 storage_,
                 bind_front(this));
+            deadline_.cancel();
 
             // Report any error
             if(ec)
@@ -189,7 +221,7 @@ class listener_impl
 
     server& srv_;
     section& log_;
-    std::mutex mutex_;
+    std::mutex mutable mutex_;
     listener_config cfg_;
     asio::ssl::context ctx_;
     net::basic_socket_acceptor<
@@ -197,6 +229,16 @@ class listener_impl
     boost::container::flat_set<
         session*> sessions_;
     endpoint_type ep_;
+    counter& accepted_;
+    gauge& active_;
+
+    static
+    std::string
+    labels(listener_config const& cfg)
+    {
+        return "listener=\"" + std::string(
+            cfg.name.data(), cfg.name.size()) + "\"";
+    }
 
 public:
     listener_impl(
@@ -207,6 +249,14 @@ public:
         , cfg_(std::move(cfg))
         , ctx_(asio::ssl::context::tlsv12)
         , acceptor_(srv_.make_executor())
+        , accepted_(srv_.metrics().make_counter(
+            "lounge_connections_total",
+            "Connections accepted",
+            labels(cfg_)))
+        , active_(srv_.metrics().make_gauge(
+            "lounge_sessions",
+            "Sessions open",
+            labels(cfg_)))
     {
         cfg_.kind = listener_config::allow_tls;
 
@@ -283,6 +333,7 @@ public:
             v.reserve(sessions_.size());
             for(auto p : sessions_)
                 v.emplace_back(boost::weak_from(p));
+            active_.sub(sessions_.size());
             sessions_.clear();
             sessions_.shrink_to_fit();
         }
@@ -309,6 +360,8 @@ public:
                 if(! acceptor_.is_open())
                     return;
 
+                accepted_.inc();
+
                 // Launch a new session for this connection
                 if(cfg_.kind == listener_config::no_tls)
                 {
@@ -367,18 +420,33 @@ public:
     //
     //--------------------------------------------------------------------------
 
+    listener_config const&
+    config() const noexcept override
+    {
+        return cfg_;
+    }
+
     void
     insert(session* p) override
     {
         std::lock_guard<std::mutex> lock(mutex_);
         sessions_.insert(p);
+        active_.add();
     }
 
     void
     erase(session* p) override
     {
         std::lock_guard<std::mutex> lock(mutex_);
-        sessions_.erase(p);
+        if(sessions_.erase(p) > 0)
+            active_.sub();
+    }
+
+    std::size_t
+    session_count() const override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_.size();
     }
 
     //--------------------------------------------------------------------------
@@ -411,6 +479,137 @@ public:
     }
 };
 
+//------------------------------------------------------------------------------
+
+// Launches sessions on in-process pipes
+class pipe_listener_impl
+    : public service
+    , public pipe_listener
+{
+    server& srv_;
+    section& log_;
+    std::mutex mutable mutex_;
+    listener_config cfg_;
+    boost::container::flat_set<
+        session*> sessions_;
+    counter& accepted_;
+    gauge& active_;
+
+    static
+    std::string
+    labels(listener_config const& cfg)
+    {
+        return "listener=\"" + std::string(
+            cfg.name.data(), cfg.name.size()) + "\"";
+    }
+
+public:
+    pipe_listener_impl(
+        server& srv,
+        listener_config cfg)
+        : srv_(srv)
+        , log_(srv_.log().get_section("listener"))
+        , cfg_(std::move(cfg))
+        , accepted_(srv_.metrics().make_counter(
+            "lounge_connections_total",
+            "Connections accepted",
+            labels(cfg_)))
+        , active_(srv_.metrics().make_gauge(
+            "lounge_sessions",
+            "Sessions open",
+            labels(cfg_)))
+    {
+    }
+
+    ~pipe_listener_impl()
+    {
+        BOOST_ASSERT(sessions_.empty());
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // pipe_listener
+    //
+    //--------------------------------------------------------------------------
+
+    pipe_stream
+    connect(executor_type ex) override
+    {
+        auto p = make_pipe(
+            srv_.make_executor(), std::move(ex));
+        accepted_.inc();
+        run_http_session(
+            srv_,
+            *this,
+            std::move(p.first),
+            endpoint_type{},
+            {});
+        return std::move(p.second);
+    }
+
+    listener_config const&
+    config() const noexcept override
+    {
+        return cfg_;
+    }
+
+    void
+    insert(session* p) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions_.insert(p);
+        active_.add();
+    }
+
+    void
+    erase(session* p) override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if(sessions_.erase(p) > 0)
+            active_.sub();
+    }
+
+    std::size_t
+    session_count() const override
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return sessions_.size();
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // service
+    //
+    //--------------------------------------------------------------------------
+
+    void
+    on_start() override
+    {
+    }
+
+    void
+    on_stop() override
+    {
+        LOG_TRC(log_, "pipe_listener::on_stop");
+
+        // Stop all the sessions
+        std::vector<
+            boost::weak_ptr<session>> v;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            v.reserve(sessions_.size());
+            for(auto p : sessions_)
+                v.emplace_back(boost::weak_from(p));
+            active_.sub(sessions_.size());
+            sessions_.clear();
+            sessions_.shrink_to_fit();
+        }
+        for(auto& e : v)
+            if(auto sp = e.lock())
+                sp->on_stop();
+    }
+};
+
 } // (anon)
 
 //------------------------------------------------------------------------------
@@ -423,6 +622,22 @@ run_listener(
     auto sp = boost::make_unique<listener_impl>(
             srv, std::move(cfg));
     bool open = sp->open();
+    srv.insert(static_cast<listener&>(*sp));
     srv.insert(std::move(sp));
     return open;
 }
+
+pipe_listener&
+run_pipe_listener(
+    server& srv,
+    beast::string_view name)
+{
+    listener_config cfg;
+    cfg.name = json::string_view(name.data(), name.size());
+    auto sp = boost::make_unique<pipe_listener_impl>(
+        srv, std::move(cfg));
+    auto& lst = *sp;
+    srv.insert(static_cast<listener&>(lst));
+    srv.insert(std::move(sp));
+    return lst;
+}
@@ -11,6 +11,7 @@
 #define LOUNGE_LISTENER_HPP
 
 #include "config.hpp"
+#include "pipe_stream.hpp"
 #include "server.hpp"
 #include "session.hpp"
 #include <boost/beast/core/error.hpp>
@@ -25,6 +26,8 @@
 */
 struct listener_config
 {
+    listener_config() = default;
+
     explicit
     listener_config(json::value&& jv);
 
@@ -35,7 +38,10 @@ struct listener_config
     net::ip::address address;
 
     // port number
-    unsigned short port_num;
+    unsigned short port_num = 0;
+
+    // offload TLS to the kernel after the handshake
+    bool ktls = false;
 
     enum
     {
@@ -53,6 +59,11 @@ class listener
 public:
     virtual ~listener() = default;
 
+    /// Return the configuration used to create the listener
+    virtual
+    listener_config const&
+    config() const noexcept = 0;
+
     /// Add a session to the listener
     virtual
     void
@@ -62,6 +73,35 @@ public:
     virtual
     void
     erase(session* p) = 0;
+
+    /// Return the number of sessions
+    virtual
+    std::size_t
+    session_count() const = 0;
+};
+
+//------------------------------------------------------------------------------
+
+/** A listener for in-process connections.
+
+    Each call to connect creates a pipe and runs an HTTP
+    session on the server end, exactly as if a socket had
+    been accepted. Test harnesses use this to attach many
+    simulated clients to a running server without the
+    kernel's network stack.
+*/
+class pipe_listener : public listener
+{
+public:
+    /** Connect to the server.
+
+        @param ex The executor for the returned stream.
+
+        @returns The client end of the connection.
+    */
+    virtual
+    pipe_stream
+    connect(executor_type ex) = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -76,4 +116,16 @@ run_listener(
     server& srv,
     listener_config cfg);
 
+/** Create a listener for in-process connections.
+
+    The listener is owned by the server.
+
+    @param name The name of the listener for logs.
+*/
+extern
+pipe_listener&
+run_pipe_listener(
+    server& srv,
+    beast::string_view name);
+
 #endif
@@ -8,25 +8,63 @@
 //
 
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "mpsc_queue.hpp"
 #include <boost/beast/_experimental/unit_test/dstream.hpp>
 #include <boost/beast/core/file.hpp>
 #include <boost/container/set.hpp>
 #include <boost/smart_ptr/make_unique.hpp>
+#include <boost/throw_exception.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
 #include <memory>
 #include <mutex>
 #include <set>
+#include <thread>
 
 //------------------------------------------------------------------------------
 
 namespace {
 
+/*  Lines are formatted on the calling thread and pushed onto
+    a lock-free queue. One background thread takes them off in
+    batches and writes each batch to the error device and the
+    log file with a single call.
+*/
 class logger_impl : public logger
 {
+    // The writer flushes at least this often
+    static std::chrono::milliseconds constexpr
+        flush_interval{10};
+
+    // The largest batch handed to a single write
+    static std::size_t constexpr batch_size = 64 * 1024;
+
+    struct entry : mpsc_node
+    {
+        std::string s;
+    };
+
     beast::unit_test::dstream cerr_;
     logger_config cfg_;
     beast::file file_;
     std::mutex m_;
+    std::mutex sm_;
+    counter* lines_ = nullptr;
+    counter* bytes_ = nullptr;
+    counter* dropped_ = nullptr;
+
+    mpsc_queue<entry> q_;
+    std::atomic<std::size_t> pending_;
+    std::atomic<std::size_t> nsample_;
+    std::atomic<std::size_t> ndropped_;
+    std::atomic<bool> stop_;
+    std::mutex wm_;
+    std::condition_variable wake_;
+    std::condition_variable space_;
+    std::thread thread_;
 
     struct hash;
 
@@ -36,7 +74,6 @@ class logger_impl : public logger
 
         logger_impl& log_;
         std::string name_;
-        int thresh_ = 0;
 
     public:
         section_impl(
@@ -45,6 +82,7 @@ class logger_impl : public logger
             : log_(log)
             , name_(name.to_string())
         {
+            threshold(log_.cfg_.threshold(name));
         }
 
         beast::string_view
@@ -64,19 +102,7 @@ class logger_impl : public logger
         do_write(
             beast::string_view s) override
         {
-            std::lock_guard<
-                std::mutex> lock(log_.m_);
-            beast::error_code ec;
-            log_.cerr_ << s;
-            log_.file_.write(
-                s.data(), s.size(), ec);
-            // VFALCO what about ec?
-        }
-
-        int
-        threshold() const noexcept override
-        {
-            return thresh_;
+            log_.push(s);
         }
     };
 
@@ -97,6 +123,137 @@ class logger_impl : public logger
 
     //--------------------------------------------------------------------------
 
+    // Write to the error device and the log file
+    void
+    write_out(beast::string_view s)
+    {
+        std::lock_guard<std::mutex> lock(m_);
+        beast::error_code ec;
+        cerr_ << s;
+        file_.write(s.data(), s.size(), ec);
+        // VFALCO what about ec?
+    }
+
+    // Returns `false` if the line should be discarded
+    bool
+    make_room()
+    {
+        if(pending_.load(std::memory_order_relaxed) <
+                cfg_.queue_limit)
+            return true;
+        switch(cfg_.overflow)
+        {
+        case logger_config::block:
+        {
+            std::unique_lock<std::mutex> lock(wm_);
+            space_.wait(lock,
+                [this]
+                {
+                    return stop_.load() ||
+                        pending_.load() < cfg_.queue_limit;
+                });
+            return true;
+        }
+
+        case logger_config::drop:
+            break;
+
+        case logger_config::sample:
+            if(nsample_++ % cfg_.sample_rate == 0)
+                return true;
+            break;
+        }
+        ++ndropped_;
+        if(dropped_)
+            dropped_->inc();
+        return false;
+    }
+
+    void
+    push(beast::string_view s)
+    {
+        // Before the log is open, write directly
+        if(thread_.joinable() && ! make_room())
+            return;
+        if(lines_)
+        {
+            lines_->inc();
+            bytes_->inc(s.size());
+        }
+        if(! thread_.joinable())
+            return write_out(s);
+
+        // Counted before the push, so the writer can never
+        // subtract an entry which was not yet added.
+        auto const e = new entry;
+        e->s.assign(s.data(), s.size());
+        auto const was_empty = pending_++ == 0;
+        q_.push(e);
+        if(was_empty)
+            wake_.notify_one();
+    }
+
+    // Move queued lines into the batch
+    std::size_t
+    drain(std::string& batch)
+    {
+        std::size_t n = 0;
+        while(batch.size() < batch_size)
+        {
+            auto const e = q_.pop();
+            if(! e)
+                break;
+            batch.append(e->s);
+            delete e;
+            ++n;
+        }
+        return n;
+    }
+
+    // The background writer
+    void
+    run()
+    {
+        std::string batch;
+        batch.reserve(batch_size);
+        for(;;)
+        {
+            auto const n = drain(batch);
+            if(n > 0)
+            {
+                // Under the lock, so a producer blocked in
+                // make_room can not miss the notification.
+                {
+                    std::lock_guard<std::mutex> lock(wm_);
+                    pending_ -= n;
+                }
+                space_.notify_all();
+                write_out(batch);
+                batch.clear();
+                continue;
+            }
+
+            auto const lost = ndropped_.exchange(0);
+            if(lost > 0)
+                write_out("logger\t3\t" +
+                    std::to_string(lost) + " lines dropped\n");
+
+            if(stop_ && pending_ == 0)
+                break;
+
+            // Producers notify without the lock, so a
+            // wakeup can be missed; the timeout bounds it.
+            std::unique_lock<std::mutex> lock(wm_);
+            wake_.wait_for(lock, flush_interval,
+                [this]
+                {
+                    return stop_.load() || pending_.load() > 0;
+                });
+        }
+    }
+
+    //--------------------------------------------------------------------------
+
     std::ostream&
     cerr() override
     {
@@ -122,25 +279,115 @@ class logger_impl : public logger
             return false;
         }
 
+        if(cfg_.sample_rate < 1)
+            cfg_.sample_rate = 1;
+        thread_ = std::thread(&logger_impl::run, this);
         return true;
     }
 
     section&
     get_section(beast::string_view name) override
     {
+        // Sessions ask for their section from any thread
+        std::lock_guard<std::mutex> lock(sm_);
         auto result =
             sections_.emplace(*this, name);
         return *result.first;
     }
 
+    void
+    configure(logger_config const& cfg) override
+    {
+        std::lock_guard<std::mutex> lock(sm_);
+        cfg_.level = cfg.level;
+        cfg_.sections = cfg.sections;
+        for(auto& s : sections_)
+            const_cast<section_impl&>(s).threshold(
+                cfg_.threshold(s.name()));
+    }
+
+    bool
+    set_threshold(
+        beast::string_view name,
+        int level) override
+    {
+        std::lock_guard<std::mutex> lock(sm_);
+        for(auto& s : sections_)
+        {
+            if(s.name() != name)
+                continue;
+            const_cast<section_impl&>(s).threshold(level);
+
+            // Remember it for a later reload
+            for(auto& e : cfg_.sections)
+            {
+                if(e.first == name)
+                {
+                    e.second = level;
+                    return true;
+                }
+            }
+            cfg_.sections.emplace_back(
+                name.to_string(), level);
+            return true;
+        }
+        return false;
+    }
+
+    void
+    attach(metrics& m) override
+    {
+        lines_ = &m.make_counter(
+            "lounge_log_lines_total",
+            "Lines written to the log");
+        bytes_ = &m.make_counter(
+            "lounge_log_bytes_total",
+            "Bytes written to the log");
+        dropped_ = &m.make_counter(
+            "lounge_log_dropped_total",
+            "Lines discarded because the log queue was full");
+    }
+
 public:
     explicit
     logger_impl()
         : cerr_(std::cerr)
+        , pending_(0)
+        , nsample_(0)
+        , ndropped_(0)
+        , stop_(false)
     {
     }
+
+    ~logger_impl()
+    {
+        if(thread_.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(wm_);
+                stop_ = true;
+            }
+            wake_.notify_one();
+            space_.notify_all();
+            thread_.join();
+        }
+
+        // Anything pushed after the writer stopped
+        std::string batch;
+        while(drain(batch) > 0)
+        {
+            write_out(batch);
+            batch.clear();
+        }
+    }
 };
 
+std::chrono::milliseconds constexpr
+    logger_impl::flush_interval;
+
+std::size_t constexpr
+    logger_impl::batch_size;
+
 } // (anon)
 
 //------------------------------------------------------------------------------
@@ -149,6 +396,82 @@ logger_config::
 logger_config(json::value&& jv)
     : path(std::move(jv.at("log").at("path").as_string()))
 {
+    auto& obj = jv.at("log").as_object();
+    auto it = obj.find("level");
+    if(it != obj.end())
+    {
+        level = parse_log_level(it->value());
+        if(level < 0)
+            BOOST_THROW_EXCEPTION(beast::system_error(
+                make_error_code(boost::system::errc::invalid_argument)));
+    }
+    it = obj.find("sections");
+    if(it != obj.end())
+    {
+        for(auto& e : it->value().as_object())
+        {
+            auto const n = parse_log_level(e.value());
+            if(n < 0)
+                BOOST_THROW_EXCEPTION(beast::system_error(
+                    make_error_code(boost::system::errc::invalid_argument)));
+            sections.emplace_back(e.key().to_string(), n);
+        }
+    }
+    it = obj.find("queue");
+    if(it != obj.end())
+        queue_limit = json::number_cast<
+            std::size_t>(it->value());
+    it = obj.find("sample");
+    if(it != obj.end())
+        sample_rate = json::number_cast<
+            std::size_t>(it->value());
+    it = obj.find("overflow");
+    if(it != obj.end())
+    {
+        auto const& s = it->value().as_string();
+        if(s == "block")
+            overflow = block;
+        else if(s == "drop")
+            overflow = drop;
+        else if(s == "sample")
+            overflow = sample;
+        else
+            BOOST_THROW_EXCEPTION(beast::system_error(
+                make_error_code(boost::system::errc::invalid_argument)));
+    }
+}
+
+int
+logger_config::
+threshold(beast::string_view name) const noexcept
+{
+    for(auto const& e : sections)
+        if(e.first == name)
+            return e.second;
+    return level;
+}
+
+int
+parse_log_level(json::value const& jv)
+{
+    static char const* const names[] = {
+        "trace", "debug", "info", "warning", "error", "fatal" };
+
+    if(jv.is_number())
+    {
+        auto const n = json::number_cast<int>(jv);
+        if(n >= 0 && n <= 5)
+            return n;
+        return -1;
+    }
+    if(jv.is_string())
+    {
+        auto const& s = jv.get_string();
+        for(int i = 0; i <= 5; ++i)
+            if(s == names[i])
+                return i;
+    }
+    return -1;
 }
 
 std::unique_ptr<logger>
@@ -14,22 +14,74 @@
 #include <boost/beast/core/error.hpp>
 #include <boost/beast/core/string.hpp>
 #include <boost/json.hpp>
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <ostream>
-#include <sstream>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** The lowest level which is compiled in.
+
+    Log statements below this level are removed
+    by the compiler, whatever the thresholds are.
+*/
+#ifndef LOUNGE_LOG_MIN_LEVEL
+#define LOUNGE_LOG_MIN_LEVEL 0
+#endif
+
+/** Return the level for a name or number, or -1.
+
+    The names are trace, debug, info, warning, error, and fatal.
+*/
+int
+parse_log_level(json::value const& jv);
 
 struct logger_config
 {
+    /// What to do when the queue of unwritten lines is full
+    enum overflow_policy
+    {
+        /// Wait for the writer to catch up
+        block,
+
+        /// Discard the line
+        drop,
+
+        /// Keep one line in every `sample`, discard the rest
+        sample
+    };
+
     logger_config() = default;
 
     explicit
     logger_config(json::value&& jv);
 
     json::string path;
+
+    /// The number of lines which may wait to be written
+    std::size_t queue_limit = 65536;
+
+    overflow_policy overflow = block;
+
+    std::size_t sample_rate = 16;
+
+    /// The threshold for sections not listed in `sections`
+    int level = 2;
+
+    /// The thresholds of individual sections, by name
+    std::vector<std::pair<std::string, int>> sections;
+
+    /// Return the threshold for a section
+    int
+    threshold(beast::string_view name) const noexcept;
 };
 
 //------------------------------------------------------------------------------
 
+class metrics;
 class section;
 
 class logger
@@ -53,6 +105,36 @@ public:
     virtual
     section&
     get_section(beast::string_view name) = 0;
+
+    /** Report the amount logged to the metrics registry.
+
+        This must be called before any other threads
+        are started.
+    */
+    virtual
+    void
+    attach(metrics& m) = 0;
+
+    /** Apply the thresholds in a configuration.
+
+        This may be called at any time, from any thread.
+        The other settings are not changed.
+    */
+    virtual
+    void
+    configure(logger_config const& cfg) = 0;
+
+    /** Change the threshold of one section.
+
+        This may be called at any time, from any thread.
+
+        @return `false` if there is no such section.
+    */
+    virtual
+    bool
+    set_threshold(
+        beast::string_view name,
+        int level) = 0;
 };
 
 //------------------------------------------------------------------------------
@@ -61,6 +143,50 @@ class section
 {
     friend class logger;
 
+    // Appends to a string which keeps its capacity
+    class line_buf : public std::streambuf
+    {
+    public:
+        std::string s;
+
+    protected:
+        int_type
+        overflow(int_type ch) override
+        {
+            if(! traits_type::eq_int_type(
+                    ch, traits_type::eof()))
+                s.push_back(traits_type::to_char_type(ch));
+            return ch;
+        }
+
+        std::streamsize
+        xsputn(char const* p, std::streamsize n) override
+        {
+            s.append(p, static_cast<std::size_t>(n));
+            return n;
+        }
+    };
+
+    struct line
+    {
+        line_buf buf;
+        std::ostream os;
+
+        line()
+            : os(&buf)
+        {
+        }
+    };
+
+    // Lines are formatted in a per-thread buffer
+    static
+    line&
+    this_line()
+    {
+        static thread_local line ln;
+        return ln;
+    }
+
     template<class T1, class T2, class... TN>
     static
     void
@@ -87,38 +213,58 @@ class section
     virtual void prepare(
         int level, std::ostream& os) = 0;
 
+    /** Called with each formatted line.
+
+        The string is only valid for the duration of the call.
+    */
     virtual void do_write(
         beast::string_view s) = 0;
 
+    std::atomic<int> thresh_;
+
+protected:
+    section() noexcept
+        : thresh_(0)
+    {
+    }
+
 public:
     virtual ~section() = default;
 
-    virtual
+    /// Return the lowest level which is written
     int
-    threshold() const noexcept = 0;
+    threshold() const noexcept
+    {
+        return thresh_.load(std::memory_order_relaxed);
+    }
+
+    /// Set the lowest level which is written
+    void
+    threshold(int level) noexcept
+    {
+        thresh_.store(level, std::memory_order_relaxed);
+    }
 
     template<class... Args>
     void
     write(int level, Args const&... args)
     {
-        std::string s;
-        {
-            std::stringstream ss;
-            prepare(level, ss);
-            append(ss, args...);
-            ss << '\n';
-            s = ss.str();
-        }
-        do_write(s);
+        auto& ln = this_line();
+        ln.buf.s.clear();
+        prepare(level, ln.os);
+        append(ln.os, args...);
+        ln.os << '\n';
+        do_write(ln.buf.s);
     }
 };
 
 #define LOG_AT_LEVEL(sect, level, ...) \
     do { \
-        if(level >= sect.threshold()) \
+        if( level >= LOUNGE_LOG_MIN_LEVEL && \
+            level >= sect.threshold()) \
             sect.write(level, __VA_ARGS__); \
     } while(false)
-    
+
 
 /// Log at trace level
 #define LOG_TRC(sect, ...) LOG_AT_LEVEL(sect, 0, __VA_ARGS__)
@@ -136,6 +282,6 @@ public:
 #define LOG_ERR(sect, ...) LOG_AT_LEVEL(sect, 4, __VA_ARGS__)
 
 /// Log at fatal level
-#define LOG_FTL(sect, ...) LOG_AT_LEVEL(sect, 0, __VA_ARGS__)
+#define LOG_FTL(sect, ...) LOG_AT_LEVEL(sect, 5, __VA_ARGS__)
 
 #endif
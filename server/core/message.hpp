@@ -117,6 +117,13 @@ public:
             ++p_->count;
     }
 
+    /// Return the number of bytes in the message
+    std::size_t
+    size() const noexcept
+    {
+        return p_ ? p_->cb.size() : 0;
+    }
+
     iterator
     begin() const noexcept
     {
@@ -0,0 +1,124 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_MESSAGE_BODY_HPP
+#define LOUNGE_MESSAGE_BODY_HPP
+
+#include "config.hpp"
+#include "message.hpp"
+#include <boost/beast/http/message.hpp>
+#include <boost/optional.hpp>
+#include <cstdint>
+#include <utility>
+
+/** A Body which sends a shared @ref message.
+
+    The body holds a reference to the message, so the
+    same buffer may be sent to any number of recipients
+    without copying. A contiguous range of the message
+    may be sent instead of the whole.
+*/
+struct message_body
+{
+    class value_type
+    {
+        message m_;
+        std::size_t pos_ = 0;
+        std::size_t len_ = 0;
+
+    public:
+        value_type() = default;
+
+        value_type(message m)
+            : m_(std::move(m))
+            , len_(m_.size())
+        {
+        }
+
+        /// Send `len` bytes of `m` starting at `pos`
+        value_type(
+            message m,
+            std::size_t pos,
+            std::size_t len)
+            : m_(std::move(m))
+            , pos_(pos)
+            , len_(len)
+        {
+            BOOST_ASSERT(pos_ + len_ <= m_.size());
+        }
+
+        value_type(value_type&&) = default;
+
+        value_type&
+        operator=(value_type&& other) noexcept
+        {
+            swap(m_, other.m_);
+            pos_ = other.pos_;
+            len_ = other.len_;
+            return *this;
+        }
+
+        std::size_t
+        size() const noexcept
+        {
+            return len_;
+        }
+
+        net::const_buffer
+        data() const noexcept
+        {
+            if(len_ == 0)
+                return {};
+            return {
+                static_cast<char const*>(
+                    m_.begin()->data()) + pos_,
+                len_ };
+        }
+    };
+
+    static
+    std::uint64_t
+    size(value_type const& body) noexcept
+    {
+        return body.size();
+    }
+
+    class writer
+    {
+        value_type const& body_;
+
+    public:
+        using const_buffers_type =
+            net::const_buffer;
+
+        template<bool isRequest, class Fields>
+        explicit
+        writer(
+            http::header<isRequest, Fields> const&,
+            value_type const& body)
+            : body_(body)
+        {
+        }
+
+        void
+        init(beast::error_code& ec)
+        {
+            ec = {};
+        }
+
+        boost::optional<std::pair<const_buffers_type, bool>>
+        get(beast::error_code& ec)
+        {
+            ec = {};
+            return {{ body_.data(), false }};
+        }
+    };
+};
+
+#endif
@@ -0,0 +1,315 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "metrics.hpp"
+#include <boost/assert.hpp>
+#include <boost/throw_exception.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+// Append one sample line
+template<class Number>
+void
+write_sample(
+    std::string& out,
+    beast::string_view name,
+    beast::string_view suffix,
+    beast::string_view labels,
+    beast::string_view le,
+    Number value)
+{
+    out.append(name.data(), name.size());
+    out.append(suffix.data(), suffix.size());
+    if(! labels.empty() || ! le.empty())
+    {
+        out.push_back('{');
+        out.append(labels.data(), labels.size());
+        if(! le.empty())
+        {
+            if(! labels.empty())
+                out.push_back(',');
+            out.append("le=\"");
+            out.append(le.data(), le.size());
+            out.push_back('"');
+        }
+        out.push_back('}');
+    }
+    out.push_back(' ');
+    out.append(std::to_string(value));
+    out.push_back('\n');
+}
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+std::uint64_t
+counter::
+value() const noexcept
+{
+    std::uint64_t n = 0;
+    for(auto const& s : v_)
+        n += s.v.load(std::memory_order_relaxed);
+    return n;
+}
+
+void
+counter::
+write(
+    std::string& out,
+    beast::string_view name,
+    beast::string_view labels) const
+{
+    write_sample(out, name, {}, labels, {}, value());
+}
+
+//------------------------------------------------------------------------------
+
+std::int64_t
+gauge::
+value() const noexcept
+{
+    std::int64_t n = 0;
+    for(auto const& s : v_)
+        n += s.v.load(std::memory_order_relaxed);
+    return n;
+}
+
+void
+gauge::
+write(
+    std::string& out,
+    beast::string_view name,
+    beast::string_view labels) const
+{
+    write_sample(out, name, {}, labels, {}, value());
+}
+
+//------------------------------------------------------------------------------
+
+histogram::
+histogram(std::vector<std::uint64_t> bounds)
+    : bounds_(std::move(bounds))
+    , stride_((bounds_.size() + 2 + 7) & ~std::size_t(7))
+{
+    BOOST_ASSERT(std::is_sorted(
+        bounds_.begin(), bounds_.end()));
+    std::size_t const line = 64;
+    std::size_t const bytes = shards * stride_ *
+        sizeof(std::atomic<std::uint64_t>);
+    std::size_t space = bytes + line;
+    storage_.reset(new char[space]);
+    void* p = storage_.get();
+    p = std::align(line, bytes, p, space);
+    BOOST_ASSERT(p);
+    v_ = static_cast<std::atomic<std::uint64_t>*>(p);
+    for(std::size_t i = 0; i < shards * stride_; ++i)
+        new(&v_[i]) std::atomic<std::uint64_t>(0);
+}
+
+void
+histogram::
+observe(std::uint64_t value) noexcept
+{
+    auto const p = &v_[this_shard() * stride_];
+    auto const i = static_cast<std::size_t>(
+        std::lower_bound(
+            bounds_.begin(), bounds_.end(), value) -
+        bounds_.begin());
+    p[i].fetch_add(1, std::memory_order_relaxed);
+    p[bounds_.size() + 1].fetch_add(
+        value, std::memory_order_relaxed);
+}
+
+std::vector<std::uint64_t>
+histogram::
+counts() const
+{
+    std::vector<std::uint64_t> v(bounds_.size() + 1);
+    for(std::size_t i = 0; i < shards; ++i)
+    {
+        auto const p = &v_[i * stride_];
+        for(std::size_t j = 0; j < v.size(); ++j)
+            v[j] += p[j].load(std::memory_order_relaxed);
+    }
+    return v;
+}
+
+std::uint64_t
+histogram::
+sum() const noexcept
+{
+    std::uint64_t n = 0;
+    for(std::size_t i = 0; i < shards; ++i)
+        n += v_[i * stride_ + bounds_.size() + 1].load(
+            std::memory_order_relaxed);
+    return n;
+}
+
+std::uint64_t
+histogram::
+quantile(double q) const
+{
+    auto const v = counts();
+    std::uint64_t total = 0;
+    for(auto n : v)
+        total += n;
+    if(total == 0 || bounds_.empty())
+        return 0;
+
+    // The rank of the quantile, counting from one
+    auto rank = static_cast<std::uint64_t>(
+        std::ceil(q * static_cast<double>(total)));
+    if(rank < 1)
+        rank = 1;
+    std::uint64_t n = 0;
+    for(std::size_t i = 0; i < bounds_.size(); ++i)
+    {
+        n += v[i];
+        if(n >= rank)
+            return bounds_[i];
+    }
+    return bounds_.back();
+}
+
+void
+histogram::
+write(
+    std::string& out,
+    beast::string_view name,
+    beast::string_view labels) const
+{
+    // Buckets are cumulative in the exposition format
+    auto const v = counts();
+    std::uint64_t n = 0;
+    for(std::size_t i = 0; i < bounds_.size(); ++i)
+    {
+        n += v[i];
+        write_sample(out, name, "_bucket", labels,
+            std::to_string(bounds_[i]), n);
+    }
+    n += v.back();
+    write_sample(out, name, "_bucket", labels, "+Inf", n);
+    write_sample(out, name, "_sum", labels, {}, sum());
+    write_sample(out, name, "_count", labels, {}, n);
+}
+
+std::vector<std::uint64_t>
+log_linear_bounds(
+    std::uint64_t max,
+    std::size_t steps)
+{
+    BOOST_ASSERT(steps > 0);
+    std::vector<std::uint64_t> v;
+    std::uint64_t step = 1;
+    std::uint64_t b = 0;
+    while(b < max)
+    {
+        b += step;
+        v.push_back(b);
+
+        // Widen the buckets at each power of two,
+        // keeping `steps` buckets per power of two.
+        if(b >= 2 * steps * step)
+            step *= 2;
+    }
+    return v;
+}
+
+//------------------------------------------------------------------------------
+
+template<class T, class... Args>
+T&
+metrics::
+get(
+    char const* type,
+    beast::string_view name,
+    beast::string_view help,
+    beast::string_view labels,
+    Args&&... args)
+{
+    std::lock_guard<std::mutex> lock(m_);
+    auto& f = families_[name.to_string()];
+    if(f.v.empty())
+    {
+        f.help = help.to_string();
+        f.type = type;
+    }
+    else if(std::strcmp(f.type, type) != 0)
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "metric type mismatch"));
+    }
+    for(auto const& e : f.v)
+        if(e.first == labels)
+            return static_cast<T&>(*e.second);
+    f.v.emplace_back(labels.to_string(),
+        std::unique_ptr<metric>(new T(
+            std::forward<Args>(args)...)));
+    return static_cast<T&>(*f.v.back().second);
+}
+
+counter&
+metrics::
+make_counter(
+    beast::string_view name,
+    beast::string_view help,
+    beast::string_view labels)
+{
+    return get<counter>("counter", name, help, labels);
+}
+
+gauge&
+metrics::
+make_gauge(
+    beast::string_view name,
+    beast::string_view help,
+    beast::string_view labels)
+{
+    return get<gauge>("gauge", name, help, labels);
+}
+
+histogram&
+metrics::
+make_histogram(
+    beast::string_view name,
+    beast::string_view help,
+    std::vector<std::uint64_t> bounds,
+    beast::string_view labels)
+{
+    return get<histogram>("histogram",
+        name, help, labels, std::move(bounds));
+}
+
+void
+metrics::
+write(std::string& out) const
+{
+    std::lock_guard<std::mutex> lock(m_);
+    for(auto const& f : families_)
+    {
+        out.append("# HELP ");
+        out.append(f.first);
+        out.push_back(' ');
+        out.append(f.second.help);
+        out.append("\n# TYPE ");
+        out.append(f.first);
+        out.push_back(' ');
+        out.append(f.second.type);
+        out.push_back('\n');
+        for(auto const& e : f.second.v)
+            e.second->write(out, f.first, e.first);
+    }
+}
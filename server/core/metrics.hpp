@@ -0,0 +1,263 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_METRICS_HPP
+#define LOUNGE_METRICS_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+/** Base class for a value in the metrics registry.
+
+    Each metric keeps one slot per shard, and every thread
+    records into the slot of its own shard, so threads do
+    not contend on the hot path. The shards are only added
+    together when the value is read.
+*/
+class metric
+{
+public:
+    /// The number of shards in each metric
+    static std::size_t constexpr shards = 16;
+
+    virtual ~metric() = default;
+
+    /// Append the samples in the text exposition format
+    virtual
+    void
+    write(
+        std::string& out,
+        beast::string_view name,
+        beast::string_view labels) const = 0;
+
+protected:
+    // One slot per cache line, to avoid false sharing
+    template<class T>
+    struct slot
+    {
+        std::atomic<T> v;
+        char pad[64 - sizeof(std::atomic<T>)];
+
+        slot() noexcept
+            : v(0)
+        {
+        }
+    };
+
+    // Return the shard for the calling thread
+    static
+    std::size_t
+    this_shard() noexcept
+    {
+        static std::atomic<std::size_t> next(0);
+        static thread_local std::size_t const i =
+            next++ % shards;
+        return i;
+    }
+};
+
+//------------------------------------------------------------------------------
+
+/// A value which only goes up
+class counter : public metric
+{
+    slot<std::uint64_t> v_[shards];
+
+public:
+    void
+    inc(std::uint64_t n = 1) noexcept
+    {
+        v_[this_shard()].v.fetch_add(
+            n, std::memory_order_relaxed);
+    }
+
+    std::uint64_t
+    value() const noexcept;
+
+    void
+    write(
+        std::string& out,
+        beast::string_view name,
+        beast::string_view labels) const override;
+};
+
+//------------------------------------------------------------------------------
+
+/// A value which goes up and down
+class gauge : public metric
+{
+    slot<std::int64_t> v_[shards];
+
+public:
+    void
+    add(std::int64_t n = 1) noexcept
+    {
+        v_[this_shard()].v.fetch_add(
+            n, std::memory_order_relaxed);
+    }
+
+    void
+    sub(std::int64_t n = 1) noexcept
+    {
+        add(-n);
+    }
+
+    std::int64_t
+    value() const noexcept;
+
+    void
+    write(
+        std::string& out,
+        beast::string_view name,
+        beast::string_view labels) const override;
+};
+
+//------------------------------------------------------------------------------
+
+/** A distribution of observed values.
+
+    Each observation is counted in the first bucket whose
+    upper bound is not less than the value, or in the
+    overflow bucket.
+*/
+class histogram : public metric
+{
+    std::vector<std::uint64_t> bounds_;
+    std::size_t stride_;
+
+    // Per shard: one count per bucket, the overflow
+    // bucket, then the sum. Each shard is rounded up
+    // to a whole number of cache lines, and `v_` is
+    // aligned to a cache line within `storage_`.
+    std::unique_ptr<char[]> storage_;
+    std::atomic<std::uint64_t>* v_;
+
+public:
+    /** Constructor
+
+        @param bounds The upper bounds of the buckets,
+        in increasing order.
+    */
+    explicit
+    histogram(std::vector<std::uint64_t> bounds);
+
+    void
+    observe(std::uint64_t value) noexcept;
+
+    /// Return the upper bounds of the buckets
+    std::vector<std::uint64_t> const&
+    bounds() const noexcept
+    {
+        return bounds_;
+    }
+
+    /// Return the count in each bucket, then the overflow bucket
+    std::vector<std::uint64_t>
+    counts() const;
+
+    /// Return the sum of all observed values
+    std::uint64_t
+    sum() const noexcept;
+
+    /** Return an estimate of a quantile.
+
+        The result is the upper bound of the bucket holding
+        the quantile, or the largest bound if it falls in the
+        overflow bucket. Zero is returned if the histogram
+        is empty.
+
+        @param q The quantile, from 0 to 1.
+    */
+    std::uint64_t
+    quantile(double q) const;
+
+    void
+    write(
+        std::string& out,
+        beast::string_view name,
+        beast::string_view labels) const override;
+};
+
+/** Return bucket bounds with a bounded relative error.
+
+    Each power of two up to `max` is divided into `steps`
+    equal buckets, in the manner of an HDR histogram, so
+    the error of a quantile is at most `1 / steps`.
+*/
+std::vector<std::uint64_t>
+log_linear_bounds(
+    std::uint64_t max,
+    std::size_t steps);
+
+//------------------------------------------------------------------------------
+
+/** A registry of named metrics.
+
+    Metrics are identified by a name and an optional list of
+    labels, such as `listener="public"`. Requesting a metric
+    which already exists returns the same object, so callers
+    should look up their metrics once and keep the reference.
+    Metrics live as long as the registry.
+*/
+class metrics
+{
+    struct family
+    {
+        std::string help;
+        char const* type;
+        std::vector<std::pair<
+            std::string, std::unique_ptr<metric>>> v;
+    };
+
+    std::mutex mutable m_;
+    std::map<std::string, family> families_;
+
+    template<class T, class... Args>
+    T&
+    get(
+        char const* type,
+        beast::string_view name,
+        beast::string_view help,
+        beast::string_view labels,
+        Args&&... args);
+
+public:
+    counter&
+    make_counter(
+        beast::string_view name,
+        beast::string_view help,
+        beast::string_view labels = {});
+
+    gauge&
+    make_gauge(
+        beast::string_view name,
+        beast::string_view help,
+        beast::string_view labels = {});
+
+    histogram&
+    make_histogram(
+        beast::string_view name,
+        beast::string_view help,
+        std::vector<std::uint64_t> bounds,
+        beast::string_view labels = {});
+
+    /// Append every metric in the text exposition format
+    void
+    write(std::string& out) const;
+};
+
+#endif
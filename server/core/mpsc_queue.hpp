@@ -0,0 +1,113 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_MPSC_QUEUE_HPP
+#define LOUNGE_MPSC_QUEUE_HPP
+
+#include "config.hpp"
+#include <atomic>
+
+/** Base class for elements of an @ref mpsc_queue
+*/
+class mpsc_node
+{
+    template<class T>
+    friend class mpsc_queue;
+
+    std::atomic<mpsc_node*> next_;
+
+public:
+    mpsc_node() noexcept
+        : next_(nullptr)
+    {
+    }
+};
+
+/** An intrusive multi-producer, single-consumer queue.
+
+    Any thread may push without locking, only one thread
+    at a time may pop. The queue does not own the elements,
+    which must derive from @ref mpsc_node.
+
+    This is the algorithm by Dmitry Vyukov. A pop can fail
+    while a push is half finished, even though the queue
+    is not empty, so the consumer should try again later.
+*/
+template<class T>
+class mpsc_queue
+{
+    std::atomic<mpsc_node*> head_;
+    mpsc_node* tail_;
+    mpsc_node stub_;
+
+    void
+    push_node(mpsc_node* n) noexcept
+    {
+        n->next_.store(nullptr, std::memory_order_relaxed);
+        auto const prev = head_.exchange(
+            n, std::memory_order_acq_rel);
+        prev->next_.store(n, std::memory_order_release);
+    }
+
+public:
+    mpsc_queue() noexcept
+        : head_(&stub_)
+        , tail_(&stub_)
+    {
+    }
+
+    mpsc_queue(mpsc_queue const&) = delete;
+    mpsc_queue& operator=(mpsc_queue const&) = delete;
+
+    /// Add an element. May be called from any thread.
+    void
+    push(T* t) noexcept
+    {
+        push_node(t);
+    }
+
+    /** Remove the oldest element, or return `nullptr`.
+
+        Only one thread may call this at a time.
+    */
+    T*
+    pop() noexcept
+    {
+        auto tail = tail_;
+        auto next = tail->next_.load(
+            std::memory_order_acquire);
+        if(tail == &stub_)
+        {
+            if(! next)
+                return nullptr;
+            tail_ = next;
+            tail = next;
+            next = next->next_.load(
+                std::memory_order_acquire);
+        }
+        if(next)
+        {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        if(tail != head_.load(std::memory_order_acquire))
+            return nullptr;
+        push_node(&stub_);
+        next = tail->next_.load(
+            std::memory_order_acquire);
+        if(next)
+        {
+            tail_ = next;
+            return static_cast<T*>(tail);
+        }
+        return nullptr;
+    }
+};
+
+#endif
@@ -0,0 +1,107 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "pipe_stream.hpp"
+
+pipe_stream::
+pipe_stream(
+    std::shared_ptr<detail::pipe_state> in,
+    std::shared_ptr<detail::pipe_state> out,
+    ::executor_type ex)
+    : in_(std::move(in))
+    , out_(std::move(out))
+    , ex_(std::move(ex))
+{
+}
+
+pipe_stream::
+~pipe_stream()
+{
+    close();
+}
+
+pipe_stream&
+pipe_stream::
+operator=(pipe_stream&& other)
+{
+    if(this != &other)
+    {
+        close();
+        in_ = std::move(other.in_);
+        out_ = std::move(other.out_);
+        ex_ = other.ex_;
+    }
+    return *this;
+}
+
+bool
+pipe_stream::
+is_open() const
+{
+    if(! in_)
+        return false;
+    std::lock_guard<std::mutex> lock(in_->m);
+    return ! in_->closed;
+}
+
+void
+pipe_stream::
+close()
+{
+    if(! in_)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(in_->m);
+        if(in_->closed)
+            return;
+        in_->closed = true;
+        in_->b.clear();
+        if(in_->pending)
+            std::unique_ptr<detail::pipe_state::op>(
+                std::move(in_->pending))->complete(
+                    net::error::operation_aborted, *in_);
+    }
+    shutdown_send();
+}
+
+void
+pipe_stream::
+shutdown_send()
+{
+    if(! out_)
+        return;
+    std::lock_guard<std::mutex> lock(out_->m);
+    out_->eof = true;
+    if(out_->pending)
+        std::unique_ptr<detail::pipe_state::op>(
+            std::move(out_->pending))->complete(
+                net::error::eof, *out_);
+}
+
+std::pair<pipe_stream, pipe_stream>
+make_pipe(
+    pipe_stream::executor_type const& ex1,
+    pipe_stream::executor_type const& ex2)
+{
+    auto const a = std::make_shared<detail::pipe_state>();
+    auto const b = std::make_shared<detail::pipe_state>();
+    return std::pair<pipe_stream, pipe_stream>(
+        pipe_stream(a, b, ex1),
+        pipe_stream(b, a, ex2));
+}
+
+void
+teardown(
+    beast::role_type,
+    pipe_stream& s,
+    beast::error_code& ec)
+{
+    s.close();
+    ec = {};
+}
@@ -0,0 +1,353 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_PIPE_STREAM_HPP
+#define LOUNGE_PIPE_STREAM_HPP
+
+#include "config.hpp"
+#include "types.hpp"
+#include <boost/beast/core/bind_handler.hpp>
+#include <boost/beast/core/error.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/core/role.hpp>
+#include <boost/asio/associated_executor.hpp>
+#include <boost/asio/async_result.hpp>
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/post.hpp>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+
+class pipe_stream;
+
+namespace detail {
+
+// One direction of a pipe
+struct pipe_state
+{
+    // A read waiting for data
+    struct op
+    {
+        virtual ~op() = default;
+
+        // Called with the mutex held
+        virtual
+        void
+        complete(
+            beast::error_code ec,
+            pipe_state& s) = 0;
+    };
+
+    std::mutex m;
+    beast::flat_buffer b;
+    std::unique_ptr<op> pending;
+    bool eof = false;       // the writer shut down
+    bool closed = false;    // the reader closed
+};
+
+template<class Handler, class MutableBufferSequence>
+class pipe_read_op : public pipe_state::op
+{
+    Handler h_;
+    MutableBufferSequence b_;
+    executor_type ex_;
+    net::executor_work_guard<typename
+        net::associated_executor<Handler,
+            executor_type>::type> wg_;
+
+public:
+    pipe_read_op(
+        Handler&& h,
+        MutableBufferSequence const& b,
+        executor_type const& ex)
+        : h_(std::move(h))
+        , b_(b)
+        , ex_(ex)
+        , wg_(net::get_associated_executor(h_, ex_))
+    {
+    }
+
+    void
+    complete(
+        beast::error_code ec,
+        pipe_state& s) override
+    {
+        std::size_t n = 0;
+        if(! ec)
+        {
+            n = net::buffer_copy(b_, s.b.data());
+            s.b.consume(n);
+        }
+        net::post(ex_, beast::bind_front_handler(
+            std::move(h_), ec, n));
+    }
+};
+
+struct run_pipe_read_op
+{
+    template<class ReadHandler, class MutableBufferSequence>
+    void
+    operator()(
+        ReadHandler&& h,
+        pipe_stream* s,
+        MutableBufferSequence const& buffers) const;
+};
+
+struct run_pipe_write_op
+{
+    template<class WriteHandler, class ConstBufferSequence>
+    void
+    operator()(
+        WriteHandler&& h,
+        pipe_stream* s,
+        ConstBufferSequence const& buffers) const;
+};
+
+} // detail
+
+/** One end of an in-memory, bidirectional byte stream.
+
+    Pipes connect a client and a server within one process
+    without involving the kernel, so end-to-end tests and
+    benchmarks are not affected by network noise. Each end
+    meets the requirements of AsyncStream and may be used
+    from a different executor than the other end.
+
+    Writes complete immediately, the data is buffered
+    until the other end reads it. Timeouts are not
+    supported, as a pipe never stalls on the network.
+*/
+class pipe_stream
+{
+    std::shared_ptr<detail::pipe_state> in_;
+    std::shared_ptr<detail::pipe_state> out_;
+    ::executor_type ex_;
+
+    friend struct detail::run_pipe_read_op;
+    friend struct detail::run_pipe_write_op;
+
+    pipe_stream(
+        std::shared_ptr<detail::pipe_state> in,
+        std::shared_ptr<detail::pipe_state> out,
+        ::executor_type ex);
+
+    template<class Handler>
+    void
+    post(
+        Handler&& h,
+        beast::error_code ec,
+        std::size_t n)
+    {
+        net::post(ex_, beast::bind_front_handler(
+            std::forward<Handler>(h), ec, n));
+    }
+
+public:
+    using executor_type = ::executor_type;
+
+    /** Return a connected pair of streams.
+
+        @param ex1 The executor for the first stream.
+
+        @param ex2 The executor for the second stream.
+    */
+    friend
+    std::pair<pipe_stream, pipe_stream>
+    make_pipe(
+        executor_type const& ex1,
+        executor_type const& ex2);
+
+    /// Destructor, closes the stream
+    ~pipe_stream();
+
+    pipe_stream(pipe_stream&&) = default;
+
+    pipe_stream&
+    operator=(pipe_stream&& other);
+
+    executor_type
+    get_executor() const noexcept
+    {
+        return ex_;
+    }
+
+    /// Return `true` if this end of the pipe is open
+    bool
+    is_open() const;
+
+    /** Close this end of the pipe.
+
+        A pending read completes with
+        `net::error::operation_aborted`, and the
+        other end reads the end of the stream.
+    */
+    void
+    close();
+
+    /// Signal the end of the stream to the other end
+    void
+    shutdown_send();
+
+    /// Has no effect, pipes do not time out
+    void
+    expires_after(std::chrono::seconds)
+    {
+    }
+
+    /// Has no effect, pipes do not time out
+    void
+    expires_never()
+    {
+    }
+
+    template<class MutableBufferSequence, class ReadHandler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(ReadHandler,
+        void(beast::error_code, std::size_t))
+    async_read_some(
+        MutableBufferSequence const& buffers,
+        ReadHandler&& handler)
+    {
+        return net::async_initiate<ReadHandler,
+            void(beast::error_code, std::size_t)>(
+                detail::run_pipe_read_op{},
+                handler, this, buffers);
+    }
+
+    template<class ConstBufferSequence, class WriteHandler>
+    BOOST_ASIO_INITFN_RESULT_TYPE(WriteHandler,
+        void(beast::error_code, std::size_t))
+    async_write_some(
+        ConstBufferSequence const& buffers,
+        WriteHandler&& handler)
+    {
+        return net::async_initiate<WriteHandler,
+            void(beast::error_code, std::size_t)>(
+                detail::run_pipe_write_op{},
+                handler, this, buffers);
+    }
+
+    friend
+    bool
+    is_open(pipe_stream const& s)
+    {
+        return s.is_open();
+    }
+
+    friend
+    void
+    shutdown_send(pipe_stream& s)
+    {
+        s.shutdown_send();
+    }
+
+    friend
+    void
+    beast_close_socket(pipe_stream& s)
+    {
+        s.close();
+    }
+};
+
+std::pair<pipe_stream, pipe_stream>
+make_pipe(
+    pipe_stream::executor_type const& ex1,
+    pipe_stream::executor_type const& ex2);
+
+/// Close a pipe when a websocket stream closes
+void
+teardown(
+    beast::role_type role,
+    pipe_stream& s,
+    beast::error_code& ec);
+
+/// Close a pipe when a websocket stream closes
+template<class TeardownHandler>
+void
+async_teardown(
+    beast::role_type,
+    pipe_stream& s,
+    TeardownHandler&& handler)
+{
+    s.close();
+    net::post(s.get_executor(), beast::bind_front_handler(
+        std::forward<TeardownHandler>(handler),
+        beast::error_code{}));
+}
+
+//------------------------------------------------------------------------------
+
+namespace detail {
+
+template<class ReadHandler, class MutableBufferSequence>
+void
+run_pipe_read_op::
+operator()(
+    ReadHandler&& h,
+    pipe_stream* s,
+    MutableBufferSequence const& buffers) const
+{
+    using handler_type =
+        typename std::decay<ReadHandler>::type;
+    auto& in = *s->in_;
+    std::lock_guard<std::mutex> lock(in.m);
+    if(in.closed)
+        return s->post(std::forward<ReadHandler>(h),
+            net::error::bad_descriptor, 0);
+    if(net::buffer_size(buffers) == 0)
+        return s->post(std::forward<ReadHandler>(h), {}, 0);
+    if(in.b.size() > 0)
+    {
+        auto const n = net::buffer_copy(buffers, in.b.data());
+        in.b.consume(n);
+        return s->post(std::forward<ReadHandler>(h), {}, n);
+    }
+    if(in.eof)
+        return s->post(std::forward<ReadHandler>(h),
+            net::error::eof, 0);
+
+    // Wait for the other end to write
+    BOOST_ASSERT(! in.pending);
+    in.pending.reset(new pipe_read_op<
+        handler_type, MutableBufferSequence>(
+            handler_type(std::forward<ReadHandler>(h)),
+            buffers, s->ex_));
+}
+
+template<class WriteHandler, class ConstBufferSequence>
+void
+run_pipe_write_op::
+operator()(
+    WriteHandler&& h,
+    pipe_stream* s,
+    ConstBufferSequence const& buffers) const
+{
+    auto& out = *s->out_;
+    std::lock_guard<std::mutex> lock(out.m);
+    if(out.eof)
+        return s->post(std::forward<WriteHandler>(h),
+            net::error::shut_down, 0);
+    if(out.closed)
+        return s->post(std::forward<WriteHandler>(h),
+            net::error::broken_pipe, 0);
+    auto const n = net::buffer_copy(
+        out.b.prepare(net::buffer_size(buffers)), buffers);
+    out.b.commit(n);
+    if(out.pending)
+        std::unique_ptr<pipe_state::op>(
+            std::move(out.pending))->complete({}, out);
+    s->post(std::forward<WriteHandler>(h), {}, n);
+}
+
+} // detail
+
+#endif
@@ -0,0 +1,238 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "recorder.hpp"
+#include <algorithm>
+#include <fstream>
+
+namespace {
+
+// Distinguishes recorders, so a thread never uses
+// the ring of a recorder which has been destroyed.
+std::atomic<std::uint64_t> next_id(1);
+
+std::size_t
+round_up(std::size_t n) noexcept
+{
+    std::size_t v = 1;
+    while(v < n)
+        v *= 2;
+    return v;
+}
+
+} // (anon)
+
+// The events of one thread. Only the owning thread writes.
+// Like a seqlock, `started` is bumped before a slot is filled
+// and `head` after, so readers copy the slots up to `head` and
+// then discard any which `started` shows were being reused.
+struct recorder::ring
+{
+    struct slot
+    {
+        std::atomic<std::uint64_t> time;
+        std::atomic<std::uint64_t> session;
+        std::atomic<std::uint64_t> info;
+    };
+
+    std::thread::id tid;
+    std::uint16_t index;
+    std::size_t mask;
+    std::unique_ptr<slot[]> v;
+    std::atomic<std::uint64_t> head;
+    std::atomic<std::uint64_t> started;
+
+    ring(
+        std::thread::id tid_,
+        std::uint16_t index_,
+        std::size_t capacity)
+        : tid(tid_)
+        , index(index_)
+        , mask(capacity - 1)
+        , v(new slot[capacity])
+        , head(0)
+        , started(0)
+    {
+    }
+};
+
+recorder::
+recorder(
+    std::size_t capacity,
+    std::string path)
+    : id_(next_id++)
+    , capacity_(round_up(capacity))
+    , epoch_(clock_type::now())
+    , path_(std::move(path))
+    , enabled_(true)
+{
+}
+
+recorder::
+~recorder() = default;
+
+auto
+recorder::
+get_ring() ->
+    ring&
+{
+    struct cache
+    {
+        std::uint64_t id;
+        ring* r;
+    };
+    static thread_local cache c = { 0, nullptr };
+    if(c.id == id_)
+        return *c.r;
+
+    auto const tid = std::this_thread::get_id();
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find_if(
+        rings_.begin(), rings_.end(),
+        [tid](std::unique_ptr<ring> const& r)
+        {
+            return r->tid == tid;
+        });
+    if(it == rings_.end())
+    {
+        rings_.emplace_back(new ring(tid,
+            static_cast<std::uint16_t>(rings_.size()),
+            capacity_));
+        it = rings_.end() - 1;
+    }
+    c.id = id_;
+    c.r = it->get();
+    return *c.r;
+}
+
+void
+recorder::
+add(
+    trace_event e,
+    void const* session,
+    std::size_t cid) noexcept
+{
+    if(! enabled())
+        return;
+    auto& r = get_ring();
+    auto const n = r.head.load(std::memory_order_relaxed);
+    r.started.store(n + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    auto& s = r.v[n & r.mask];
+    s.time.store(static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            clock_type::now() - epoch_).count()),
+        std::memory_order_relaxed);
+    s.session.store(reinterpret_cast<std::uintptr_t>(
+        session), std::memory_order_relaxed);
+    s.info.store(
+        (static_cast<std::uint64_t>(cid) << 8) |
+            static_cast<std::uint8_t>(e),
+        std::memory_order_relaxed);
+    r.head.store(n + 1, std::memory_order_release);
+}
+
+auto
+recorder::
+events(clock_type::duration window) const ->
+    std::vector<record>
+{
+    auto const now = clock_type::now() - epoch_;
+    auto const since = now > window ?
+        static_cast<std::uint64_t>(std::chrono::duration_cast<
+            std::chrono::nanoseconds>(now - window).count()) : 0;
+
+    std::vector<record> v;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for(auto const& r : rings_)
+    {
+        auto const cap = r->mask + 1;
+        auto const last = r->head.load(std::memory_order_acquire);
+        auto const first = last > cap ? last - cap : 0;
+        auto const size = v.size();
+        for(auto i = first; i < last; ++i)
+        {
+            auto const& s = r->v[i & r->mask];
+            auto const info = s.info.load(std::memory_order_relaxed);
+            record e;
+            e.time = s.time.load(std::memory_order_relaxed);
+            e.session = s.session.load(std::memory_order_relaxed);
+            e.cid = static_cast<std::uint32_t>(info >> 8);
+            e.thread = r->index;
+            e.event = static_cast<std::uint8_t>(info & 0xff);
+            e.pad = 0;
+            v.push_back(e);
+        }
+
+        // Drop the slots which the writer reused while we
+        // copied, including the one it may be filling now.
+        std::atomic_thread_fence(std::memory_order_acquire);
+        auto const started =
+            r->started.load(std::memory_order_relaxed);
+        auto const lost = started > cap ? started - cap : 0;
+        if(lost > first)
+            v.erase(
+                v.begin() + size,
+                v.begin() + size + static_cast<std::size_t>(
+                    (std::min)(lost, last) - first));
+    }
+    v.erase(std::remove_if(v.begin(), v.end(),
+        [since](record const& e)
+        {
+            return e.time < since;
+        }), v.end());
+    std::sort(v.begin(), v.end(),
+        [](record const& a, record const& b)
+        {
+            return a.time < b.time;
+        });
+    return v;
+}
+
+std::size_t
+recorder::
+dump(
+    std::ostream& os,
+    clock_type::duration window) const
+{
+    auto const v = events(window);
+    os.write("LNGFR001", 8);
+    if(! v.empty())
+        os.write(reinterpret_cast<char const*>(v.data()),
+            static_cast<std::streamsize>(
+                v.size() * sizeof(record)));
+    return v.size();
+}
+
+std::size_t
+recorder::
+dump(
+    char const* path,
+    clock_type::duration window,
+    beast::error_code& ec) const
+{
+    std::ofstream os(path,
+        std::ios::binary | std::ios::trunc);
+    if(! os)
+    {
+        ec = beast::error_code(errno,
+            boost::system::generic_category());
+        return 0;
+    }
+    auto const n = dump(os, window);
+    os.flush();
+    if(! os)
+    {
+        ec = beast::error_code(errno,
+            boost::system::generic_category());
+        return 0;
+    }
+    ec = {};
+    return n;
+}
@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RECORDER_HPP
+#define LOUNGE_RECORDER_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/error.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/// The kinds of events kept by the flight recorder
+enum class trace_event : std::uint8_t
+{
+    accept,
+    handshake,
+    read,
+    dispatch,
+    enqueue,
+    write,
+    close
+};
+
+/** An in-memory flight recorder of session events.
+
+    Each thread records into its own fixed size ring buffer,
+    so recording an event is a few relaxed stores with no
+    locking. Old events are overwritten. The recent events
+    of all threads can be written out on demand, in a
+    binary format which `tools/flight_trace.py` converts
+    into a Chrome trace.
+
+    Sessions are identified by their address, and channels
+    by their cid, or zero if there is none.
+*/
+class recorder
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /** One event in the dump file.
+
+        A dump file starts with the 8 byte magic number
+        "LNGFR001", followed by these records, in the
+        byte order of the host.
+    */
+    struct record
+    {
+        std::uint64_t time;     // nanoseconds
+        std::uint64_t session;
+        std::uint32_t cid;
+        std::uint16_t thread;
+        std::uint8_t event;
+        std::uint8_t pad;
+    };
+
+    /** Constructor
+
+        @param capacity The number of events kept
+        for each thread, rounded up to a power of two.
+
+        @param path The file written by @ref dump
+        when no path is given.
+    */
+    explicit
+    recorder(
+        std::size_t capacity = 16384,
+        std::string path = "flight.bin");
+
+    ~recorder();
+
+    /// Return `true` if events are being recorded
+    bool
+    enabled() const noexcept
+    {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+
+    /// Return the path of the dump file
+    std::string const&
+    path() const noexcept
+    {
+        return path_;
+    }
+
+    /// Turn recording on or off
+    void
+    enable(bool value) noexcept
+    {
+        enabled_.store(value, std::memory_order_relaxed);
+    }
+
+    /// Record an event on the calling thread
+    void
+    add(
+        trace_event e,
+        void const* session,
+        std::size_t cid = 0) noexcept;
+
+    /** Return the recorded events.
+
+        @param window Only events newer than this are returned.
+    */
+    std::vector<record>
+    events(clock_type::duration window) const;
+
+    /** Write the recent events to a stream.
+
+        @return The number of events written.
+    */
+    std::size_t
+    dump(
+        std::ostream& os,
+        clock_type::duration window) const;
+
+    /** Write the recent events to a file.
+
+        @return The number of events written.
+    */
+    std::size_t
+    dump(
+        char const* path,
+        clock_type::duration window,
+        beast::error_code& ec) const;
+
+    /** Write the recent events to the dump file.
+
+        @return The number of events written.
+    */
+    std::size_t
+    dump(
+        clock_type::duration window,
+        beast::error_code& ec) const
+    {
+        return dump(path_.c_str(), window, ec);
+    }
+
+private:
+    struct ring;
+
+    ring&
+    get_ring();
+
+    std::uint64_t const id_;
+    std::size_t const capacity_;
+    clock_type::time_point const epoch_;
+    std::string const path_;
+    std::atomic<bool> enabled_;
+    std::mutex mutable mutex_;
+    std::vector<std::unique_ptr<ring>> rings_;
+};
+
+#endif
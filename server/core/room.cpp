@@ -7,23 +7,43 @@
 // Official repository: https://github.com/vinniefalco/BeastLounge
 //
 
+#include "archive.hpp"
 #include "channel.hpp"
 #include "channel_list.hpp"
+#include "history.hpp"
+#include "message.hpp"
 #include "rpc.hpp"
+#include "server.hpp"
 #include "user.hpp"
+#include <mutex>
+#include <string>
+#include <vector>
 
 namespace {
 
 class room_impl : public channel
 {
+    // Messages kept, sent on join, and per page
+    static std::size_t constexpr history_size = 256;
+    static std::size_t constexpr backfill_size = 20;
+    static std::size_t constexpr max_page = 50;
+
+    ::archive& archive_;
+    std::mutex mutex_;
+    ::history history_;
+    bool loaded_ = false;
+
 public:
     room_impl(
+        server& srv,
         beast::string_view name,
         channel_list& list)
         : channel(
             2,
             name,
             list)
+        , archive_(srv.archive())
+        , history_(history_size)
     {
     }
 
@@ -33,9 +53,16 @@ public:
     //
     //--------------------------------------------------------------------------
 
+    beast::string_view
+    type() const noexcept override
+    {
+        return "room";
+    }
+
     void
-    on_insert(user&) override
+    on_insert(user& u) override
     {
+        backfill(u, 0, backfill_size);
     }
 
     void
@@ -54,6 +81,10 @@ public:
         {
             do_say(rpc);
         }
+        else if(rpc.method == "history")
+        {
+            do_history(rpc);
+        }
         else
         {
             rpc.fail(rpc_code::method_not_found);
@@ -83,11 +114,128 @@ public:
             obj["name"] = name();
             obj["user"] = rpc.u->name;
             obj["message"] = text;
-            send(jv);
+
+            // Numbered under the lock, so the history and the
+            // archive are in order. A user joining now may
+            // receive it both in the backfill and live, and
+            // can tell by "seq". The archive only queues it.
+            auto const m = [&]
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                load();
+                auto const seq = history_.next();
+                obj["seq"] = seq;
+                auto m = make_message(jv);
+                if(m.size() > 0)
+                {
+                    history_.push(m);
+                    archive_.append(cid(), seq, m);
+                }
+                return m;
+            }();
+            send(m);
+        }
+        rpc.complete();
+    }
+
+    // Send a page of older messages as a "history" event,
+    // and return the cursor for the page before it.
+    void
+    do_history(rpc_call& rpc)
+    {
+        checked_user(rpc);
+        if(! is_joined(*rpc.u))
+            rpc.fail("not in channel");
+        std::uint64_t before = 0;
+        std::uint64_t limit = backfill_size;
+        if(rpc.params.is_object())
+        {
+            auto const& obj = rpc.params.get_object();
+            if(obj.contains("before"))
+                before = checked_uint64(rpc.params, "before");
+            if(obj.contains("limit"))
+                limit = checked_uint64(rpc.params, "limit");
         }
+        if(limit < 1 || limit > max_page)
+            rpc.fail("Invalid \"limit\"");
+        auto const next = backfill(*rpc.u, before,
+            static_cast<std::size_t>(limit));
+        json::value jv(json::object_kind);
+        if(next != 0)
+            jv.get_object()["next"] = next;
+        else
+            jv.get_object()["next"] = nullptr;
+        rpc.result = std::move(jv);
         rpc.complete();
     }
 
+    // Send a page of the history to one user in a single
+    // message, made from the stored messages as they are.
+    // Returns the cursor for the page before, or zero.
+    std::uint64_t
+    backfill(
+        user& u,
+        std::uint64_t before,
+        std::size_t limit)
+    {
+        std::vector<message> v;
+        std::uint64_t start;
+        std::uint64_t first;
+        std::uint64_t next_seq;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            load();
+            start = history_.page(before, limit, v);
+            first = history_.first();
+            next_seq = history_.next();
+        }
+
+        // Older messages than those in memory come from the archive
+        if(v.size() < limit && (start == 0 || start == first))
+        {
+            std::uint64_t from = next_seq;
+            if(start != 0)
+                from = start;
+            else if(before != 0 && before < next_seq)
+                from = before;
+            std::vector<message> older;
+            auto const n = archive_.read(
+                cid(), from, limit - v.size(), older);
+            if(n != 0)
+            {
+                older.reserve(older.size() + v.size());
+                for(auto& m : v)
+                    older.emplace_back(std::move(m));
+                v.swap(older);
+                start = n;
+            }
+        }
+        if(start == 0)
+            return 0;
+        auto const oldest = archive_.first(cid());
+        if(oldest != 0 && (first == 0 || oldest < first))
+            first = oldest;
+        auto const next = start > first ? start : 0;
+        auto const prefix =
+            "{\"verb\":\"history\",\"cid\":" +
+            std::to_string(cid()) + ",\"messages\":[";
+        auto const suffix = "],\"next\":" + (next != 0 ?
+            std::to_string(next) : std::string("null")) + "}";
+        u.send(make_batch(prefix, v, suffix));
+        return next;
+    }
+
+    // Continue the numbers of the messages in the archive,
+    // which are then paged from there. Called with the lock.
+    void
+    load()
+    {
+        if(loaded_)
+            return;
+        loaded_ = true;
+        history_.restart(archive_.last(cid()));
+    }
+
     void
     do_slash(rpc_call& rpc)
     {
@@ -96,12 +244,17 @@ public:
     }
 };
 
+std::size_t constexpr room_impl::history_size;
+std::size_t constexpr room_impl::backfill_size;
+std::size_t constexpr room_impl::max_page;
+
 } // (anon)
 
 void
 make_room(
+    server& srv,
     channel_list& list,
     beast::string_view name)
 {
-    insert<room_impl>(list, name, list);
+    insert<room_impl>(list, srv, name, list);
 }
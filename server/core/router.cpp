@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "router.hpp"
+#include <boost/throw_exception.hpp>
+#include <algorithm>
+#include <stdexcept>
+
+router::
+router()
+{
+    // The root
+    nodes_.resize(1);
+}
+
+void
+router::
+insert(
+    http::verb method,
+    beast::string_view pattern,
+    handler_type handler)
+{
+    if(pattern.empty() || pattern.front() != '/')
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "route must begin with '/'"));
+
+    std::size_t i = 0;
+    std::size_t captures = 0;
+    auto rest = pattern.substr(1);
+    for(;;)
+    {
+        auto const pos = rest.find('/');
+        auto const seg = rest.substr(0, pos);
+        if( seg.size() >= 2 &&
+            seg.front() == '{' &&
+            seg.back() == '}')
+        {
+            auto const name = seg.substr(1, seg.size() - 2);
+            if( name.empty() ||
+                ++captures > route_params::max_size)
+                BOOST_THROW_EXCEPTION(std::invalid_argument(
+                    "bad route capture"));
+            if(nodes_[i].capture == 0)
+            {
+                nodes_.emplace_back();
+                nodes_.back().segment = name.to_string();
+                nodes_[i].capture = nodes_.size() - 1;
+            }
+            else if(nodes_[nodes_[i].capture].segment != name)
+            {
+                BOOST_THROW_EXCEPTION(std::invalid_argument(
+                    "conflicting route capture"));
+            }
+            i = nodes_[i].capture;
+        }
+        else
+        {
+            if(seg.find_first_of("{}") != beast::string_view::npos)
+                BOOST_THROW_EXCEPTION(std::invalid_argument(
+                    "bad route segment"));
+            auto& v = nodes_[i].literals;
+            auto it = std::lower_bound(v.begin(), v.end(), seg,
+                [this](std::size_t c, beast::string_view s)
+                {
+                    return beast::string_view(
+                        nodes_[c].segment) < s;
+                });
+            if(it != v.end() && nodes_[*it].segment == seg)
+            {
+                i = *it;
+            }
+            else
+            {
+                // Insert before growing nodes_, which
+                // may invalidate the reference to v
+                auto const child = nodes_.size();
+                v.insert(it, child);
+                nodes_.emplace_back();
+                nodes_[child].segment = seg.to_string();
+                i = child;
+            }
+        }
+        if(pos == beast::string_view::npos)
+            break;
+        rest = rest.substr(pos + 1);
+    }
+
+    for(auto const& h : nodes_[i].handlers)
+        if(h.first == method)
+            BOOST_THROW_EXCEPTION(std::invalid_argument(
+                "duplicate route"));
+    nodes_[i].handlers.emplace_back(
+        method, std::move(handler));
+    auto& allow = nodes_[i].allow;
+    if(! allow.empty())
+        allow.append(", ");
+    auto const name = http::to_string(method);
+    allow.append(name.data(), name.size());
+}
+
+auto
+router::
+match(
+    route_request& req,
+    handler_type const*& handler) const noexcept ->
+        match_result
+{
+    node const* n = nullptr;
+    req.params.size_ = 0;
+    req.allow = {};
+    if( req.path.empty() ||
+        req.path.front() != '/' ||
+        ! match(0, req.path, req.params, n))
+        return match_result::not_found;
+    req.allow = n->allow;
+    for(auto const& h : n->handlers)
+    {
+        if(h.first == req.method)
+        {
+            handler = &h.second;
+            return match_result::found;
+        }
+    }
+    return match_result::method_not_allowed;
+}
+
+bool
+router::
+match(
+    std::size_t i,
+    beast::string_view path,
+    route_params& params,
+    node const*& result) const noexcept
+{
+    auto const& n = nodes_[i];
+    if(path.empty())
+    {
+        if(n.handlers.empty())
+            return false;
+        result = &n;
+        return true;
+    }
+
+    auto const rest = path.substr(1);
+    auto const pos = rest.find('/');
+    auto const seg = rest.substr(0, pos);
+    auto const tail = pos == beast::string_view::npos ?
+        beast::string_view{} : rest.substr(pos);
+
+    auto const it = std::lower_bound(
+        n.literals.begin(), n.literals.end(), seg,
+        [this](std::size_t c, beast::string_view s)
+        {
+            return beast::string_view(
+                nodes_[c].segment) < s;
+        });
+    if( it != n.literals.end() &&
+        nodes_[*it].segment == seg &&
+        match(*it, tail, params, result))
+        return true;
+
+    if(n.capture != 0 && ! seg.empty())
+    {
+        auto const size = params.size_;
+        params.names_[size] = nodes_[n.capture].segment;
+        params.values_[size] = seg;
+        params.size_ = size + 1;
+        if(match(n.capture, tail, params, result))
+            return true;
+        params.size_ = size;
+    }
+    return false;
+}
@@ -0,0 +1,181 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_ROUTER_HPP
+#define LOUNGE_ROUTER_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/http/message.hpp>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+/// The path segments captured by a route pattern
+class route_params
+{
+public:
+    /// The largest number of captures in one pattern
+    static std::size_t constexpr max_size = 4;
+
+    /// Return the number of captures
+    std::size_t
+    size() const noexcept
+    {
+        return size_;
+    }
+
+    /// Return the value of a capture, or an empty string
+    beast::string_view
+    operator[](beast::string_view name) const noexcept
+    {
+        for(std::size_t i = 0; i < size_; ++i)
+            if(names_[i] == name)
+                return values_[i];
+        return {};
+    }
+
+private:
+    friend class router;
+
+    beast::string_view names_[max_size];
+    beast::string_view values_[max_size];
+    std::size_t size_ = 0;
+};
+
+/// A request dispatched to a route
+struct route_request
+{
+    http::verb method;
+
+    /// The path, without the query
+    beast::string_view path;
+
+    /// The query, without the leading '?'
+    beast::string_view query;
+
+    /// The request body
+    beast::string_view body;
+
+    route_params params;
+
+    /// The methods of the matched route, for an Allow field
+    beast::string_view allow;
+};
+
+/// The response produced by a route
+struct route_response
+{
+    http::status result = http::status::ok;
+
+    beast::string_view content_type = "application/json";
+
+    /// The body. This is a pooled buffer, which is empty on entry.
+    std::string& body;
+
+    explicit
+    route_response(std::string& body_) noexcept
+        : body(body_)
+    {
+    }
+};
+
+//------------------------------------------------------------------------------
+
+/** A table of routes for dynamic HTTP resources.
+
+    A pattern is an absolute path where each segment is
+    either a literal, or a name in braces which captures
+    any segment, for example "/api/channels/{cid}".
+    Literal segments take precedence over captures.
+    Captured values are not percent-decoded.
+
+    Routes are organized as a trie which is built once at
+    startup. Matching a request does not allocate memory.
+    Routes may only be added before the server is started,
+    after which the router may be used from any thread.
+*/
+class router
+{
+public:
+    using handler_type = std::function<
+        void(route_request const&, route_response&)>;
+
+    /// The result of matching a request
+    enum class match_result
+    {
+        /// No route has the path
+        not_found,
+
+        /// A route has the path, but not the method
+        method_not_allowed,
+
+        /// The handler was found
+        found
+    };
+
+    router();
+
+    /** Add a route.
+
+        @throws std::invalid_argument if the pattern is malformed
+        or the route already exists.
+    */
+    void
+    insert(
+        http::verb method,
+        beast::string_view pattern,
+        handler_type handler);
+
+    /** Find the handler for a request.
+
+        @param req The request. The `path` must be set,
+        and the `params` are filled in on success. The
+        `allow` is set when the path matches a route.
+
+        @param handler Set to the handler on success.
+    */
+    match_result
+    match(
+        route_request& req,
+        handler_type const*& handler) const noexcept;
+
+private:
+    struct node
+    {
+        // The literal, or the name of the capture
+        std::string segment;
+
+        // Literal children, sorted by segment
+        std::vector<std::size_t> literals;
+
+        // The capture child, or zero
+        std::size_t capture = 0;
+
+        std::vector<std::pair<
+            http::verb, handler_type>> handlers;
+
+        // The methods in handlers, for an Allow field
+        std::string allow;
+    };
+
+    bool
+    match(
+        std::size_t i,
+        beast::string_view path,
+        route_params& params,
+        node const*& result) const noexcept;
+
+    std::vector<node> nodes_;
+};
+
+#endif
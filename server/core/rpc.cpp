@@ -8,6 +8,8 @@
 //
 
 #include "rpc.hpp"
+#include "metrics.hpp"
+#include "rpc_stats.hpp"
 #include "user.hpp"
 #include <boost/beast/core/error.hpp>
 #include <type_traits>
@@ -110,7 +112,9 @@ rpc_call::
 rpc_call(
     ::user& u_,
     json::storage_ptr sp)
-    : u(boost::shared_from(&u_))
+    : started_(clock_type::now())
+    , received(started_)
+    , u(boost::shared_from(&u_))
     , method(sp)
     , params(sp)
     , result(std::move(sp))
@@ -248,10 +252,25 @@ extract(
     }
 }
 
+void
+rpc_call::
+record()
+{
+    if(! stats)
+        return;
+    stats->record(
+        channel_type,
+        beast::string_view(method.data(), method.size()),
+        received,
+        started_,
+        clock_type::now());
+}
+
 void
 rpc_call::
 complete()
 {
+    record();
     if(! id_.has_value())
         return;
     json::value res(
@@ -267,6 +286,13 @@ void
 rpc_call::
 complete(rpc_error const& e)
 {
+    if(errors)
+        errors->inc();
+    // Unknown methods are not recorded, since
+    // the name of the method comes from the user.
+    if(e.code() != static_cast<int>(
+            rpc_code::method_not_found))
+        record();
     if(! id_.has_value())
         return;
     u->send(e.to_json(id_));
@@ -16,9 +16,12 @@
 #include <boost/json/value.hpp>
 #include <boost/smart_ptr/shared_ptr.hpp>
 #include <boost/optional.hpp>
+#include <chrono>
 #include <stdexcept>
 #include <utility>
 
+class counter;
+class rpc_stats;
 class user;
 
 /// Codes used in JSON-RPC error responses
@@ -122,6 +125,13 @@ public:
     {
     }
 
+    /// Return the JSON-RPC error code
+    int
+    code() const noexcept
+    {
+        return code_;
+    }
+
     json::value
     to_json(
         boost::optional<json::value> const&
@@ -140,7 +150,17 @@ class rpc_call
     */
     boost::optional<json::value> id_;
 
+    std::chrono::steady_clock::time_point started_;
+
+    void
+    record();
+
 public:
+    using clock_type = std::chrono::steady_clock;
+
+    /// When the request was received
+    clock_type::time_point received;
+
     /// The user submitting the request
     boost::shared_ptr<user> u;
 
@@ -163,6 +183,15 @@ public:
     */
     json::value result;
 
+    /// If set, this is incremented when the call fails
+    counter* errors = nullptr;
+
+    /// If set, the latency of the call is recorded here
+    rpc_stats* stats = nullptr;
+
+    /// The kind of channel handling the call, for the stats
+    beast::string_view channel_type;
+
 public:
     rpc_call(rpc_call&&) = default;
     rpc_call& operator=(rpc_call&&) = delete;
@@ -176,6 +205,18 @@ public:
         ::user& u,
         json::storage_ptr sp = {});
 
+    /** Mark the start of the handler.
+
+        The time before this is recorded as queueing. Handlers
+        which post the call elsewhere, such as to a strand,
+        should call this again when they resume.
+    */
+    void
+    start() noexcept
+    {
+        started_ = clock_type::now();
+    }
+
     /** Extract a JSON-RPC request or return an error.
     */
     void
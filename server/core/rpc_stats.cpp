@@ -0,0 +1,114 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "rpc_stats.hpp"
+#include "metrics.hpp"
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/shared_lock_guard.hpp>
+
+namespace {
+
+// Up to about one minute, within 1/8
+std::vector<std::uint64_t> const&
+latency_bounds()
+{
+    static auto const v =
+        log_linear_bounds(60000000, 8);
+    return v;
+}
+
+std::uint64_t
+to_micros(rpc_stats::clock_type::duration d) noexcept
+{
+    auto const n = std::chrono::duration_cast<
+        std::chrono::microseconds>(d).count();
+    return n > 0 ? static_cast<std::uint64_t>(n) : 0;
+}
+
+} // (anon)
+
+rpc_stats::
+rpc_stats(metrics& m)
+    : m_(m)
+{
+}
+
+void
+rpc_stats::
+record(
+    beast::string_view channel,
+    beast::string_view method,
+    clock_type::time_point received,
+    clock_type::time_point started,
+    clock_type::time_point completed)
+{
+    auto const e = get(key_type(
+        channel.to_string(), method.to_string()));
+    e.queue->observe(to_micros(started - received));
+    e.run->observe(to_micros(completed - started));
+}
+
+auto
+rpc_stats::
+get(key_type const& key) ->
+    entry
+{
+    {
+        boost::shared_lock_guard<mutex> lock(mutex_);
+        auto const it = map_.find(key);
+        if(it != map_.end())
+            return it->second;
+    }
+
+    // Only methods which a channel recognized are recorded,
+    // so the number of label sets stays bounded.
+    auto const labels =
+        "channel=\"" + key.first +
+        "\",method=\"" + key.second + "\"";
+    entry e;
+    e.queue = &m_.make_histogram(
+        "lounge_rpc_queue_microseconds",
+        "Time from reading a JSON-RPC request until its handler starts",
+        latency_bounds(), labels);
+    e.run = &m_.make_histogram(
+        "lounge_rpc_run_microseconds",
+        "Time from the start of a JSON-RPC handler until it completes",
+        latency_bounds(), labels);
+    boost::lock_guard<mutex> lock(mutex_);
+    map_.emplace(key, e);
+    return e;
+}
+
+auto
+rpc_stats::
+summaries() const ->
+    std::vector<summary>
+{
+    static double constexpr q[3] = { 0.5, 0.99, 0.999 };
+
+    std::vector<summary> v;
+    boost::shared_lock_guard<mutex> lock(mutex_);
+    v.reserve(map_.size());
+    for(auto const& e : map_)
+    {
+        summary s;
+        s.channel = e.first.first;
+        s.method = e.first.second;
+        s.count = 0;
+        for(auto n : e.second.run->counts())
+            s.count += n;
+        for(std::size_t i = 0; i < 3; ++i)
+        {
+            s.queue[i] = e.second.queue->quantile(q[i]);
+            s.run[i] = e.second.run->quantile(q[i]);
+        }
+        v.emplace_back(std::move(s));
+    }
+    return v;
+}
@@ -0,0 +1,87 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_RPC_STATS_HPP
+#define LOUNGE_RPC_STATS_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/string.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+class histogram;
+class metrics;
+
+/** Latency of JSON-RPC calls, by kind of channel and method.
+
+    Two histograms are kept for each method, in microseconds.
+    The queue time runs from reading the request until the
+    handler starts, which includes any wait for a strand.
+    The run time covers the handler, until the call is
+    completed. Both are also published in the metrics.
+*/
+class rpc_stats
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+
+    /// Percentiles for one method, in microseconds
+    struct summary
+    {
+        std::string channel;
+        std::string method;
+        std::uint64_t count;
+
+        /// The 50th, 99th, and 99.9th percentile
+        std::uint64_t queue[3];
+        std::uint64_t run[3];
+    };
+
+    explicit
+    rpc_stats(metrics& m);
+
+    /// Record one completed call
+    void
+    record(
+        beast::string_view channel,
+        beast::string_view method,
+        clock_type::time_point received,
+        clock_type::time_point started,
+        clock_type::time_point completed);
+
+    /// Return the percentiles for each method seen so far
+    std::vector<summary>
+    summaries() const;
+
+private:
+    using key_type =
+        std::pair<std::string, std::string>;
+
+    struct entry
+    {
+        histogram* queue;
+        histogram* run;
+    };
+
+    using mutex = boost::shared_mutex;
+
+    metrics& m_;
+    mutex mutable mutex_;
+    std::map<key_type, entry> map_;
+
+    entry
+    get(key_type const& key);
+};
+
+#endif
@@ -0,0 +1,161 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_SENDFILE_HPP
+#define LOUNGE_SENDFILE_HPP
+
+#include "config.hpp"
+#include <boost/beast/core/error.hpp>
+#include <boost/asio/compose.hpp>
+#include <boost/asio/coroutine.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/socket_base.hpp>
+#include <algorithm>
+#include <cstdint>
+
+#ifdef __linux__
+# include <sys/sendfile.h>
+# include <cerrno>
+/// Defined when async_sendfile is available
+# define LOUNGE_HAS_SENDFILE 1
+#endif
+
+#ifdef LOUNGE_HAS_SENDFILE
+
+namespace detail {
+
+template<class Socket>
+class sendfile_op : public net::coroutine
+{
+    // Largest amount to send in one system call, so that
+    // one connection can't monopolize the thread.
+    static std::size_t constexpr chunk = 1024 * 1024;
+
+    Socket& sock_;
+    int fd_;
+    off_t offset_;
+    std::uint64_t remain_;
+    std::size_t total_ = 0;
+
+    // Returns `false` if the socket would block
+    bool
+    send_some(beast::error_code& ec)
+    {
+        while(remain_ > 0)
+        {
+            auto const n = ::sendfile(
+                sock_.native_handle(), fd_, &offset_,
+                remain_ > chunk ? chunk :
+                    static_cast<std::size_t>(remain_));
+            if(n > 0)
+            {
+                total_ += static_cast<std::size_t>(n);
+                remain_ -= static_cast<std::size_t>(n);
+                return true;
+            }
+            if(n == 0)
+            {
+                // The file is shorter than expected
+                ec = net::error::eof;
+                return true;
+            }
+            if(errno == EINTR)
+                continue;
+            if(errno == EAGAIN || errno == EWOULDBLOCK)
+                return false;
+            ec.assign(errno, beast::system_category());
+            return true;
+        }
+        return true;
+    }
+
+public:
+    sendfile_op(
+        Socket& sock,
+        int fd,
+        std::uint64_t offset,
+        std::uint64_t count)
+        : sock_(sock)
+        , fd_(fd)
+        , offset_(static_cast<off_t>(offset))
+        , remain_(count)
+    {
+    }
+
+    template<class Self>
+    void
+    operator()(
+        Self& self,
+        beast::error_code ec = {})
+    {
+    #include <boost/asio/yield.hpp>
+        reenter(*this)
+        {
+            if(! sock_.native_non_blocking())
+                sock_.native_non_blocking(true, ec);
+
+            // Always wait first, so the handler is never
+            // invoked from the initiating function. One chunk
+            // is sent per wait, letting other handlers run.
+            while(! ec)
+            {
+                yield sock_.async_wait(
+                    net::socket_base::wait_write,
+                    std::move(self));
+                if(ec)
+                    break;
+                send_some(ec);
+                if(remain_ == 0)
+                    break;
+            }
+            self.complete(ec, total_);
+        }
+    #include <boost/asio/unyield.hpp>
+    }
+};
+
+} // detail
+
+/** Asynchronously send part of a file to a socket.
+
+    The kernel copies the file contents directly to the
+    socket using `sendfile`, so the data never passes
+    through user space.
+
+    @param sock The connected socket to write to.
+
+    @param fd The open file to read from.
+
+    @param offset The position in the file to start at.
+
+    @param count The number of bytes to send.
+
+    @param token The completion token, with the
+    signature `void(error_code, std::size_t)`.
+*/
+template<class Socket, class CompletionToken>
+BOOST_ASIO_INITFN_RESULT_TYPE(CompletionToken,
+    void(beast::error_code, std::size_t))
+async_sendfile(
+    Socket& sock,
+    int fd,
+    std::uint64_t offset,
+    std::uint64_t count,
+    CompletionToken&& token)
+{
+    return net::async_compose<CompletionToken,
+        void(beast::error_code, std::size_t)>(
+            detail::sendfile_op<Socket>(
+                sock, fd, offset, count),
+            token, sock);
+}
+
+#endif
+
+#endif
@@ -7,12 +7,21 @@
 // Official repository: https://github.com/vinniefalco/BeastLounge
 //
  
+#include "archive.hpp"
+#include "buffer_pool.hpp"
 #include "channel.hpp"
 #include "channel_list.hpp"
+#include "ledger.hpp"
 #include "listener.hpp"
 #include "logger.hpp"
+#include "metrics.hpp"
+#include "recorder.hpp"
+#include "router.hpp"
 #include "server.hpp"
 #include "service.hpp"
+#include "session_metrics.hpp"
+#include "static_cache.hpp"
+#include "timer_wheel.hpp"
 #include "utility.hpp"
 #include <boost/json.hpp>
 #include <boost/asio/basic_waitable_timer.hpp>
@@ -25,6 +34,7 @@
 #include <cstdio>
 #include <iostream>
 #include <mutex>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
@@ -32,7 +42,11 @@
 
 extern
 void
-make_blackjack_service(server&);
+make_api_routes(server&);
+
+extern
+void
+make_blackjack_service(server&, std::uint64_t, unsigned);
 
 extern
 std::unique_ptr<channel_list>
@@ -68,6 +82,10 @@ listener_config(json::value&& jv)
     , address(json::value_cast<net::ip::address>(jv.at("address")))
     , port_num(json::number_cast<unsigned short>(jv.at("port_num")))
 {
+    auto& obj = jv.as_object();
+    auto it = obj.find("ktls");
+    if(it != obj.end())
+        ktls = it->value().as_bool();
 }
 
 //------------------------------------------------------------------------------
@@ -79,6 +97,24 @@ struct server_config
     unsigned num_threads = 1;
     json::string doc_root;
 
+    // Flight recorder
+    std::string recorder_path = "flight.bin";
+    std::size_t recorder_events = 16384;
+    std::chrono::seconds recorder_window{10};
+
+    // Directory of the chip ledger
+    std::string ledger_path = "ledger";
+
+    // Directory and retention of the chat archive
+    std::string archive_path = "archive";
+    unsigned archive_days = 30;
+
+    // Seed for the blackjack shoes, zero for random
+    std::uint64_t blackjack_seed = 0;
+
+    // Snapshots per second sent to blackjack spectators
+    unsigned spectator_rate = 4;
+
     server_config() = default;
 
     explicit
@@ -88,6 +124,50 @@ struct server_config
     {
         if( num_threads < 1)
             num_threads = 1;
+
+        auto& obj = jv.as_object();
+        auto it = obj.find("flight-recorder");
+        if(it != obj.end())
+        {
+            auto& fr = it->value();
+            auto const& path = fr.at("path").as_string();
+            recorder_path.assign(path.data(), path.size());
+            recorder_events = json::number_cast<
+                std::size_t>(fr.at("events"));
+            recorder_window = std::chrono::seconds(
+                json::number_cast<unsigned>(fr.at("seconds")));
+        }
+
+        it = obj.find("ledger-path");
+        if(it != obj.end())
+        {
+            auto const& path = it->value().as_string();
+            ledger_path.assign(path.data(), path.size());
+        }
+
+        it = obj.find("archive");
+        if(it != obj.end())
+        {
+            auto& ar = it->value();
+            auto const& path = ar.at("path").as_string();
+            archive_path.assign(path.data(), path.size());
+            archive_days = json::number_cast<
+                unsigned>(ar.at("days"));
+        }
+
+        it = obj.find("blackjack-seed");
+        if(it != obj.end())
+            blackjack_seed = json::number_cast<
+                std::uint64_t>(it->value());
+
+        it = obj.find("spectator-rate");
+        if(it != obj.end())
+            spectator_rate = json::number_cast<
+                unsigned>(it->value());
+        if(spectator_rate < 1)
+            spectator_rate = 1;
+        else if(spectator_rate > 1000)
+            spectator_rate = 1000;
     }
 };
 
@@ -155,8 +235,40 @@ parse_file(
 class server_impl_base : public server
 {
 public:
+    // Declared first, since anything may hold a reference
+    // to a metric, the recorder, the ledger or the archive,
+    // and handlers left in the I/O context may own a timer
+    // on the wheel.
+    ::metrics metrics_;
+    ::session_metrics session_metrics_;
+    ::recorder recorder_;
+    ::timer_wheel timer_wheel_;
+    ::ledger ledger_;
+    ::archive archive_;
+
     net::io_context ioc_;
 
+    explicit
+    server_impl_base(server_config const& cfg)
+        : session_metrics_(metrics_)
+        , recorder_(
+            cfg.recorder_events,
+            cfg.recorder_path)
+        , timer_wheel_(cfg.num_threads)
+        , ledger_(cfg.ledger_path)
+        , archive_(
+            cfg.archive_path,
+            16 * 1024 * 1024,
+            std::chrono::hours(24 * cfg.archive_days))
+    {
+    }
+
+    ~server_impl_base()
+    {
+        // The system timers belong to the I/O context
+        timer_wheel_.close();
+    }
+
     // This function is in a base class because `server_impl`
     // needs to call it from the ctor-initializer list, which
     // would be undefined if the member function was in the
@@ -182,6 +294,7 @@ class server_impl
     using time_point = clock_type::time_point;
 
     server_config cfg_;
+    std::string config_path_;
     std::unique_ptr<logger> log_;
     std::vector<std::unique_ptr<service>> services_;
     net::basic_waitable_timer<
@@ -189,13 +302,18 @@ class server_impl
         boost::asio::wait_traits<clock_type>,
         executor_type> timer_;
     asio::basic_signal_set<executor_type> signals_;
+    asio::basic_signal_set<executor_type> admin_signals_;
     std::condition_variable cv_;
     std::mutex mutex_;
     time_point shutdown_time_;
     bool running_ = false;
     std::atomic<bool> stop_;
 
+    std::vector<listener*> listeners_;
+    ::router router_;
+    ::buffer_pool buffers_;
     std::unique_ptr<::channel_list> channel_list_;
+    ::static_cache& static_cache_;
 
     static
     std::chrono::steady_clock::time_point
@@ -208,21 +326,40 @@ public:
     explicit
     server_impl(
         server_config cfg,
+        std::string config_path,
         std::unique_ptr<logger> log)
-        : cfg_(std::move(cfg))
+        : server_impl_base(cfg)
+        , cfg_(std::move(cfg))
+        , config_path_(std::move(config_path))
         , log_(std::move(log))
         , timer_(this->make_executor())
         , signals_(
             timer_.get_executor(),
             SIGINT,
             SIGTERM)
+        , admin_signals_(timer_.get_executor())
         , shutdown_time_(never())
         , stop_(false)
         , channel_list_(make_channel_list(*this))
+        , static_cache_(make_static_cache(*this))
     {
+        log_->attach(metrics_);
         timer_.expires_at(never());
+    #ifdef SIGUSR1
+        admin_signals_.add(SIGUSR1);
+    #endif
+    #ifdef SIGHUP
+        admin_signals_.add(SIGHUP);
+    #endif
 
         make_system_channel(*this);
+        make_api_routes(*this);
+
+        timer_wheel_.start(
+            [this]
+            {
+                return this->make_executor();
+            });
     }
 
     ~server_impl()
@@ -239,6 +376,22 @@ public:
         services_.emplace_back(std::move(sp));
     }
 
+    void
+    insert(listener& lst) override
+    {
+        if(running_)
+            throw std::logic_error(
+                "server already running");
+
+        listeners_.push_back(&lst);
+    }
+
+    std::vector<listener*> const&
+    listeners() const override
+    {
+        return listeners_;
+    }
+
     void
     run() override
     {
@@ -258,6 +411,13 @@ public:
                 &server_impl::on_signal,
                 this));
 
+        // Capture SIGUSR1 to dump the flight recorder,
+        // and SIGHUP to reload the log thresholds.
+        admin_signals_.async_wait(
+            beast::bind_front_handler(
+                &server_impl::on_admin_signal,
+                this));
+
     #ifndef LOUNGE_USE_SYSTEM_EXECUTOR
         std::vector<std::thread> vt;
         while(vt.size() < cfg_.num_threads)
@@ -277,6 +437,7 @@ public:
         auto agents = std::move(services_);
         for(auto const& sp : agents)
             sp->on_stop();
+        timer_wheel_.stop();
 
         // services must be kept alive until after
         // all executor threads are joined.
@@ -291,6 +452,10 @@ public:
         for(auto& t : vt)
             t.join();
     #endif
+
+        // Nothing changes a balance or says anything anymore
+        ledger_.close();
+        archive_.close();
     }
 
     //--------------------------------------------------------------------------
@@ -389,6 +554,72 @@ public:
         }
     }
 
+    void
+    on_admin_signal(beast::error_code ec, int signum)
+    {
+        if(ec == net::error::operation_aborted)
+            return;
+
+    #ifdef SIGHUP
+        if(signum == SIGHUP)
+            reload();
+        else
+    #endif
+            dump_recorder();
+
+        admin_signals_.async_wait(
+            beast::bind_front_handler(
+                &server_impl::on_admin_signal,
+                this));
+    }
+
+    // Write the flight recorder to its file
+    void
+    dump_recorder()
+    {
+        beast::error_code ec;
+        auto const n = recorder_.dump(
+            cfg_.recorder_window, ec);
+        if(ec)
+            log_->cerr() <<
+                "recorder::dump: " << ec.message() << "\n";
+        else
+            log_->cerr() <<
+                "recorder::dump: " << n << " events to " <<
+                recorder_.path() << "\n";
+    }
+
+    // Apply the log thresholds in the configuration file
+    void
+    reload()
+    {
+        beast::error_code ec;
+        json::value jv = parse_file(
+            config_path_.c_str(), ec);
+        if(ec)
+        {
+            log_->cerr() <<
+                "reload: " << ec.message() << "\n";
+            return;
+        }
+        try
+        {
+            log_->configure(logger_config(std::move(jv)));
+            log_->cerr() << "reload: log thresholds applied\n";
+        }
+        catch(beast::system_error const& e)
+        {
+            log_->cerr() <<
+                "reload: " << e.code().message() << "\n";
+        }
+        catch(std::exception const& e)
+        {
+            // A malformed file keeps the old thresholds
+            log_->cerr() <<
+                "reload: " << e.what() << "\n";
+        }
+    }
+
     void
     stop() override
     {
@@ -415,6 +646,7 @@ public:
         timer_.cancel();
         beast::error_code ec;
         signals_.cancel(ec);
+        admin_signals_.cancel(ec);
     }
 
     //--------------------------------------------------------------------------
@@ -436,6 +668,60 @@ public:
     {
         return *channel_list_;
     }
+
+    ::static_cache&
+    static_cache() override
+    {
+        return static_cache_;
+    }
+
+    ::router&
+    router() override
+    {
+        return router_;
+    }
+
+    ::buffer_pool&
+    buffers() override
+    {
+        return buffers_;
+    }
+
+    ::metrics&
+    metrics() override
+    {
+        return metrics_;
+    }
+
+    ::session_metrics&
+    session_metrics() override
+    {
+        return session_metrics_;
+    }
+
+    ::recorder&
+    recorder() override
+    {
+        return recorder_;
+    }
+
+    ::timer_wheel&
+    timer_wheel() override
+    {
+        return timer_wheel_;
+    }
+
+    ::ledger&
+    ledger() override
+    {
+        return ledger_;
+    }
+
+    ::archive&
+    archive() override
+    {
+        return archive_;
+    }
 };
 
 } // (anon)
@@ -477,6 +763,8 @@ make_server(
 
     // Read the server configuration
     std::unique_ptr<server_impl> srv;
+    std::uint64_t blackjack_seed = 0;
+    unsigned spectator_rate = 0;
     {
         if( ! jv.is_object() ||
             ! jv.get_object().contains("server") ||
@@ -491,10 +779,13 @@ make_server(
         {
             auto& jo = jv.get_object()["server"];
             server_config cfg(std::move(jo));
+            blackjack_seed = cfg.blackjack_seed;
+            spectator_rate = cfg.spectator_rate;
 
             // Create the server
             srv = boost::make_unique<server_impl>(
                 std::move(cfg),
+                config_path,
                 std::move(log));
         }
         catch(beast::system_error const& e)
@@ -506,8 +797,34 @@ make_server(
 
     }
 
+    // Load the chip balances
+    {
+        beast::error_code ec;
+        srv->ledger_.open(ec);
+        if(ec)
+        {
+            srv->log().cerr() <<
+                "ledger: " << srv->ledger_.path() <<
+                ", " << ec.message() << "\n";
+            return nullptr;
+        }
+    }
+
+    // Load the chat archive
+    {
+        beast::error_code ec;
+        srv->archive_.open(ec);
+        if(ec)
+        {
+            srv->log().cerr() <<
+                "archive: " << srv->archive_.path() <<
+                ", " << ec.message() << "\n";
+            return nullptr;
+        }
+    }
+
     // Add services
-    make_blackjack_service(*srv);
+    make_blackjack_service(*srv, blackjack_seed, spectator_rate);
 
     // Create listeners
     {
@@ -18,11 +18,22 @@
 #include <functional>
 #include <memory>
 #include <utility>
+#include <vector>
 
+class archive;
+class buffer_pool;
 class channel_list;
+class ledger;
+class listener;
 class logger;
+class metrics;
+class recorder;
+class router;
 class rpc_handler;
 class service;
+struct session_metrics;
+class static_cache;
+class timer_wheel;
 class user;
 
 //------------------------------------------------------------------------------
@@ -49,6 +60,19 @@ public:
     insert(
         std::unique_ptr<service> sp) = 0;
 
+    /** Add a listener to the server.
+
+        Listeners may only be added before calling start().
+    */
+    virtual
+    void
+    insert(listener& lst) = 0;
+
+    /// Return the listeners
+    virtual
+    std::vector<listener*> const&
+    listeners() const = 0;
+
     //--------------------------------------------------------------------------
     //
     // Services
@@ -59,6 +83,15 @@ public:
 
     virtual logger&             log() = 0;
     virtual ::channel_list&     channel_list() = 0;
+    virtual ::static_cache&     static_cache() = 0;
+    virtual ::router&           router() = 0;
+    virtual ::buffer_pool&      buffers() = 0;
+    virtual ::metrics&          metrics() = 0;
+    virtual ::session_metrics&  session_metrics() = 0;
+    virtual ::recorder&         recorder() = 0;
+    virtual ::timer_wheel&      timer_wheel() = 0;
+    virtual ::ledger&           ledger() = 0;
+    virtual ::archive&          archive() = 0;
 
     //--------------------------------------------------------------------------
 
@@ -0,0 +1,68 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_SESSION_METRICS_HPP
+#define LOUNGE_SESSION_METRICS_HPP
+
+#include "config.hpp"
+#include "metrics.hpp"
+
+/** The metrics shared by all sessions.
+
+    These are looked up once by the server, so accepting
+    a connection does not take the registry's lock.
+*/
+struct session_metrics
+{
+    counter& http_requests;
+    counter& http_bytes_in;
+    counter& http_bytes_out;
+    gauge& http_queued;
+
+    counter& ws_messages_in;
+    counter& ws_messages_out;
+    counter& ws_bytes_out;
+    histogram& ws_sizes;
+    gauge& ws_queued;
+
+    explicit
+    session_metrics(metrics& m)
+        : http_requests(m.make_counter(
+            "lounge_http_requests_total",
+            "HTTP requests received"))
+        , http_bytes_in(m.make_counter(
+            "lounge_http_bytes_received_total",
+            "Bytes of HTTP requests received"))
+        , http_bytes_out(m.make_counter(
+            "lounge_http_bytes_sent_total",
+            "Bytes of HTTP responses sent"))
+        , http_queued(m.make_gauge(
+            "lounge_http_queued_responses",
+            "HTTP responses waiting to be sent"))
+        , ws_messages_in(m.make_counter(
+            "lounge_ws_messages_received_total",
+            "WebSocket messages received"))
+        , ws_messages_out(m.make_counter(
+            "lounge_ws_messages_sent_total",
+            "WebSocket messages sent"))
+        , ws_bytes_out(m.make_counter(
+            "lounge_ws_bytes_sent_total",
+            "Bytes of WebSocket messages sent"))
+        , ws_sizes(m.make_histogram(
+            "lounge_ws_message_size_bytes",
+            "Size of WebSocket messages received",
+            {64, 256, 1024, 4096, 16384, 65536}))
+        , ws_queued(m.make_gauge(
+            "lounge_ws_queued_messages",
+            "WebSocket messages waiting to be sent"))
+    {
+    }
+};
+
+#endif
@@ -0,0 +1,525 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "channel.hpp"
+#include "channel_list.hpp"
+#include "listener.hpp"
+#include "logger.hpp"
+#include "message.hpp"
+#include "pipe_stream.hpp"
+#include "recorder.hpp"
+#include "server.hpp"
+#include "timer_wheel.hpp"
+#include "user.hpp"
+#include <boost/beast/core/buffers_cat.hpp>
+#include <boost/beast/core/stream_traits.hpp>
+#include <boost/beast/http/chunk_encode.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/serializer.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/beast/ssl/ssl_stream.hpp>
+#include <boost/beast/version.hpp>
+#include <boost/asio/dispatch.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/write.hpp>
+#include <boost/make_shared.hpp>
+#include <deque>
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+/** A user which receives channel broadcasts as Server-Sent Events.
+
+    Each broadcast message is written as one chunk holding
+    the prefix, the shared message buffer, and the suffix,
+    so the message is never copied for this recipient.
+
+    When nothing has been written for a while, a comment is
+    sent, so that proxies do not close an idle response.
+*/
+template<class Derived>
+class sse_session_base
+    : public user
+{
+    // Slow readers are disconnected once
+    // this many messages are waiting.
+    static std::size_t constexpr queue_limit = 256;
+
+    using response_type =
+        http::response<http::empty_body>;
+
+protected:
+    server& srv_;
+    listener& lst_;
+    section& log_;
+    recorder& rec_;
+    endpoint_type ep_;
+    std::deque<message> mq_;
+    response_type res_;
+    http::response_serializer<http::empty_body> sr_;
+    wheel_timer keepalive_;
+    char buf_[64];
+
+public:
+    sse_session_base(
+        server& srv,
+        listener& lst,
+        endpoint_type ep)
+        : srv_(srv)
+        , lst_(lst)
+        , log_(srv_.log().get_section("sse_session"))
+        , rec_(srv_.recorder())
+        , ep_(ep)
+        , sr_(res_)
+        , keepalive_(srv_.timer_wheel())
+    {
+        lst_.insert(this);
+    }
+
+    ~sse_session_base()
+    {
+        rec_.add(trace_event::close, this);
+        lst_.erase(this);
+    }
+
+    // The CRTP pattern
+    Derived*
+    impl()
+    {
+        return static_cast<Derived*>(this);
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // sse_session
+    //
+    //--------------------------------------------------------------------------
+
+    void
+    run(std::size_t cid)
+    {
+        // The stream stays open indefinitely
+        beast::get_lowest_layer(
+            impl()->stream()).expires_never();
+
+        auto const c = srv_.channel_list().at(cid);
+        if(! c)
+        {
+            auto res = boost::make_shared<
+                http::response<http::string_body>>(
+                    http::status::not_found, 11);
+            res->set(http::field::server, BOOST_BEAST_VERSION_STRING);
+            res->set(http::field::content_type, "text/html");
+            res->keep_alive(false);
+            res->body() = "Unknown channel";
+            res->prepare_payload();
+            return http::async_write(
+                impl()->stream(),
+                *res,
+                beast::bind_front_handler(
+                    &sse_session_base::on_not_found,
+                    boost::shared_from(this),
+                    res));
+        }
+
+        res_.version(11);
+        res_.result(http::status::ok);
+        res_.set(http::field::server, BOOST_BEAST_VERSION_STRING);
+        res_.set(http::field::content_type, "text/event-stream");
+        res_.set(http::field::cache_control, "no-cache");
+        res_.chunked(true);
+        http::async_write_header(
+            impl()->stream(),
+            sr_,
+            beast::bind_front_handler(
+                &sse_session_base::on_header,
+                boost::shared_from(this),
+                c));
+    }
+
+    void
+    on_not_found(
+        boost::shared_ptr<
+            http::response<http::string_body>> const&,
+        beast::error_code ec,
+        std::size_t)
+    {
+        if(ec)
+            return impl()->fail(ec, "async_write");
+        impl()->do_close();
+    }
+
+    void
+    on_header(
+        boost::shared_ptr<channel> const& c,
+        beast::error_code ec,
+        std::size_t)
+    {
+        if(ec)
+            return impl()->fail(ec, "async_write_header");
+
+        // Broadcasts start arriving now
+        c->insert(*this);
+        set_keepalive();
+        do_read();
+    }
+
+    // Send a comment if nothing else is written first
+    void
+    set_keepalive()
+    {
+        boost::weak_ptr<sse_session_base> wp =
+            boost::weak_from(this);
+        keepalive_.expires_after(std::chrono::seconds(30),
+            [wp]
+            {
+                auto sp = wp.lock();
+                if(! sp)
+                    return;
+                auto const ex = sp->impl()->stream().get_executor();
+                net::post(ex,
+                    beast::bind_front_handler(
+                        &sse_session_base::on_keepalive,
+                        std::move(sp)));
+            });
+    }
+
+    void
+    on_keepalive()
+    {
+        if(! is_open(beast::get_lowest_layer(impl()->stream())))
+            return;
+
+        // A write in progress rearms the timer when it completes.
+        // The empty message stands for the comment.
+        if(! mq_.empty())
+            return;
+        mq_.emplace_back();
+        do_write();
+    }
+
+    // The client sends nothing, so this completes
+    // when the connection is closed.
+    void
+    do_read()
+    {
+        impl()->stream().async_read_some(
+            net::buffer(buf_),
+            beast::bind_front_handler(
+                &sse_session_base::on_read,
+                boost::shared_from(this)));
+    }
+
+    void
+    on_read(beast::error_code ec, std::size_t)
+    {
+        if(! ec)
+            return do_read();
+        if(ec != net::error::eof)
+            impl()->fail(ec, "async_read_some");
+        do_stop();
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // session
+    //
+    //--------------------------------------------------------------------------
+
+    void
+    on_stop() override
+    {
+        net::post(
+            impl()->stream().get_executor(),
+            beast::bind_front_handler(
+                &sse_session_base::do_stop,
+                boost::shared_from(this)));
+    }
+
+    void
+    do_stop()
+    {
+        beast::close_socket(
+            beast::get_lowest_layer(impl()->stream()));
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // user
+    //
+    //--------------------------------------------------------------------------
+
+    void
+    send(json::value const& jv) override
+    {
+        send(make_message(jv));
+    }
+
+    void
+    send(message m) override
+    {
+        net::dispatch(
+            impl()->stream().get_executor(),
+            beast::bind_front_handler(
+                &sse_session_base::do_send,
+                boost::shared_from(this),
+                std::move(m)));
+    }
+
+    void
+    do_send(message m)
+    {
+        if(! is_open(beast::get_lowest_layer(impl()->stream())))
+            return;
+        if(mq_.size() >= queue_limit)
+        {
+            LOG_INF(log_, "do_send", '\t', "queue full");
+            return do_stop();
+        }
+        mq_.emplace_back(std::move(m));
+        set_backlog(mq_.size());
+        rec_.add(trace_event::enqueue, this);
+        if(mq_.size() == 1)
+            do_write();
+    }
+
+    void
+    do_write()
+    {
+        BOOST_ASSERT(! mq_.empty());
+        if(mq_.front().size() == 0)
+            return net::async_write(
+                impl()->stream(),
+                http::make_chunk(net::const_buffer(":\n\n", 3)),
+                beast::bind_front_handler(
+                    &sse_session_base::on_write,
+                    boost::shared_from(this)));
+        net::async_write(
+            impl()->stream(),
+            http::make_chunk(beast::buffers_cat(
+                net::const_buffer("data: ", 6),
+                mq_.front(),
+                net::const_buffer("\n\n", 2))),
+            beast::bind_front_handler(
+                &sse_session_base::on_write,
+                boost::shared_from(this)));
+    }
+
+    void
+    on_write(beast::error_code ec, std::size_t)
+    {
+        BOOST_ASSERT(! mq_.empty());
+        if(ec)
+            return impl()->fail(ec, "async_write");
+        rec_.add(trace_event::write, this);
+        mq_.pop_front();
+        set_backlog(mq_.size());
+        if(! mq_.empty())
+            return do_write();
+        set_keepalive();
+    }
+};
+
+//------------------------------------------------------------------------------
+
+class plain_sse_session_impl
+    : public sse_session_base<plain_sse_session_impl>
+{
+    stream_type stream_;
+
+public:
+    plain_sse_session_impl(
+        server& srv,
+        listener& lst,
+        stream_type stream,
+        endpoint_type ep)
+        : sse_session_base(
+            srv, lst, ep)
+        , stream_(std::move(stream))
+    {
+    }
+
+    stream_type&
+    stream()
+    {
+        return stream_;
+    }
+
+    void
+    do_close()
+    {
+        beast::error_code ec;
+        stream_.socket().shutdown(
+            tcp::socket::shutdown_send, ec);
+    }
+
+    // Report a failure
+    void
+    fail(beast::error_code ec, char const* what)
+    {
+        if(ec == net::error::operation_aborted)
+            LOG_TRC(log_, what, '\t', ec.message());
+        else
+            LOG_INF(log_, what, '\t', ec.message());
+    }
+};
+
+//------------------------------------------------------------------------------
+
+class ssl_sse_session_impl
+    : public sse_session_base<ssl_sse_session_impl>
+{
+    beast::ssl_stream<stream_type> stream_;
+
+public:
+    ssl_sse_session_impl(
+        server& srv,
+        listener& lst,
+        beast::ssl_stream<
+            stream_type> stream,
+        endpoint_type ep)
+        : sse_session_base(
+            srv, lst, ep)
+        , stream_(std::move(stream))
+    {
+    }
+
+    beast::ssl_stream<stream_type>&
+    stream()
+    {
+        return stream_;
+    }
+
+    void
+    do_close()
+    {
+        stream_.async_shutdown(
+            beast::bind_front_handler(
+                &ssl_sse_session_impl::on_shutdown,
+                boost::shared_from(this)));
+    }
+
+    void
+    on_shutdown(beast::error_code ec)
+    {
+        if(ec)
+            return fail(ec, "on_shutdown");
+    }
+
+    // Report a failure
+    void
+    fail(beast::error_code ec, char const* what)
+    {
+        // See the comment in ws_user.cpp
+        if(ec == asio::ssl::error::stream_truncated)
+            return;
+
+        if(ec == net::error::operation_aborted)
+            LOG_TRC(log_, what, '\t', ec.message());
+        else
+            LOG_INF(log_, what, '\t', ec.message());
+    }
+};
+
+//------------------------------------------------------------------------------
+
+class pipe_sse_session_impl
+    : public sse_session_base<pipe_sse_session_impl>
+{
+    pipe_stream stream_;
+
+public:
+    pipe_sse_session_impl(
+        server& srv,
+        listener& lst,
+        pipe_stream stream,
+        endpoint_type ep)
+        : sse_session_base(
+            srv, lst, ep)
+        , stream_(std::move(stream))
+    {
+    }
+
+    pipe_stream&
+    stream()
+    {
+        return stream_;
+    }
+
+    void
+    do_close()
+    {
+        stream_.shutdown_send();
+    }
+
+    // Report a failure
+    void
+    fail(beast::error_code ec, char const* what)
+    {
+        if(ec == net::error::operation_aborted)
+            LOG_TRC(log_, what, '\t', ec.message());
+        else
+            LOG_INF(log_, what, '\t', ec.message());
+    }
+};
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+void
+run_sse_session(
+    server& srv,
+    listener& lst,
+    stream_type stream,
+    endpoint_type ep,
+    std::size_t cid)
+{
+    auto sp = boost::make_shared<
+            plain_sse_session_impl>(
+        srv, lst,
+        std::move(stream),
+        ep);
+    sp->run(cid);
+}
+
+void
+run_sse_session(
+    server& srv,
+    listener& lst,
+    beast::ssl_stream<
+        stream_type> stream,
+    endpoint_type ep,
+    std::size_t cid)
+{
+    auto sp = boost::make_shared<
+            ssl_sse_session_impl>(
+        srv, lst,
+        std::move(stream),
+        ep);
+    sp->run(cid);
+}
+
+void
+run_sse_session(
+    server& srv,
+    listener& lst,
+    pipe_stream stream,
+    endpoint_type ep,
+    std::size_t cid)
+{
+    auto sp = boost::make_shared<
+            pipe_sse_session_impl>(
+        srv, lst,
+        std::move(stream),
+        ep);
+    sp->run(cid);
+}
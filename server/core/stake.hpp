@@ -0,0 +1,98 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_STAKE_HPP
+#define LOUNGE_STAKE_HPP
+
+#include "config.hpp"
+#include "ledger.hpp"
+#include <boost/assert.hpp>
+#include <boost/beast/core/string.hpp>
+#include <cstdint>
+#include <string>
+
+/** The chips a player has on a table.
+
+    A bet is taken from the ledger when it is made, and is
+    closed out by `settle`, with the payout at the end of
+    the round, or by `refund` when the player leaves before
+    it. A seat is never given up with a wager outstanding,
+    so every debit in the ledger has a matching credit.
+
+    This is not thread-safe.
+*/
+class stake
+{
+    ::ledger* ledger_ = nullptr;
+    std::string account_;
+    std::int64_t chips_ = 0;
+    std::int64_t wager_ = 0;
+
+public:
+    /** Take a seat for an account, reading its balance
+
+        The account is only a name, so any user who
+        identifies with it may play with its chips.
+    */
+    void
+    sit(::ledger& lg, beast::string_view account)
+    {
+        BOOST_ASSERT(wager_ == 0);
+        ledger_ = &lg;
+        account_.assign(account.data(), account.size());
+        chips_ = lg.balance(account);
+    }
+
+    /// Return the balance, less the wager
+    std::int64_t
+    chips() const noexcept
+    {
+        return chips_;
+    }
+
+    /// Return the chips bet this round
+    std::int64_t
+    wager() const noexcept
+    {
+        return wager_;
+    }
+
+    /// Bet more chips, returning `false` if there are not enough
+    bool
+    bet(std::int64_t amount)
+    {
+        BOOST_ASSERT(ledger_);
+        auto const chips = ledger_->wager(account_, amount);
+        if(chips < 0)
+            return false;
+        chips_ = chips;
+        wager_ += amount;
+        return true;
+    }
+
+    /// Close out the wager, paying `amount` back
+    void
+    settle(std::int64_t amount)
+    {
+        if(wager_ == 0 && amount == 0)
+            return;
+        BOOST_ASSERT(ledger_);
+        chips_ = ledger_->settle(account_, amount);
+        wager_ = 0;
+    }
+
+    /// Close out the wager, paying it back
+    void
+    refund()
+    {
+        settle(wager_);
+    }
+};
+
+#endif
@@ -0,0 +1,547 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "static_cache.hpp"
+#include "http_conditional.hpp"
+#include "logger.hpp"
+#include "server.hpp"
+#include "service.hpp"
+#include "types.hpp"
+#include <boost/beast/core/file.hpp>
+#include <boost/beast/core/string.hpp>
+#include <boost/beast/http/rfc7230.hpp>
+#include <boost/beast/zlib/deflate_stream.hpp>
+#include <boost/container/flat_map.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/thread/lock_guard.hpp>
+#include <boost/thread/shared_lock_guard.hpp>
+#include <boost/thread/shared_mutex.hpp>
+#include <boost/crc.hpp>
+#include <boost/make_shared.hpp>
+#include <boost/make_unique.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+//------------------------------------------------------------------------------
+
+beast::string_view
+mime_type(beast::string_view path)
+{
+    using beast::iequals;
+    auto const ext = [&path]
+    {
+        auto const pos = path.rfind(".");
+        if(pos == beast::string_view::npos)
+            return beast::string_view{};
+        return path.substr(pos);
+    }();
+    if(iequals(ext, ".htm"))  return "text/html";
+    if(iequals(ext, ".html")) return "text/html";
+    if(iequals(ext, ".php"))  return "text/html";
+    if(iequals(ext, ".css"))  return "text/css";
+    if(iequals(ext, ".txt"))  return "text/plain";
+    if(iequals(ext, ".js"))   return "application/javascript";
+    if(iequals(ext, ".json")) return "application/json";
+    if(iequals(ext, ".xml"))  return "application/xml";
+    if(iequals(ext, ".swf"))  return "application/x-shockwave-flash";
+    if(iequals(ext, ".flv"))  return "video/x-flv";
+    if(iequals(ext, ".png"))  return "image/png";
+    if(iequals(ext, ".jpe"))  return "image/jpeg";
+    if(iequals(ext, ".jpeg")) return "image/jpeg";
+    if(iequals(ext, ".jpg"))  return "image/jpeg";
+    if(iequals(ext, ".gif"))  return "image/gif";
+    if(iequals(ext, ".bmp"))  return "image/bmp";
+    if(iequals(ext, ".ico"))  return "image/vnd.microsoft.icon";
+    if(iequals(ext, ".tiff")) return "image/tiff";
+    if(iequals(ext, ".tif"))  return "image/tiff";
+    if(iequals(ext, ".svg"))  return "image/svg+xml";
+    if(iequals(ext, ".svgz")) return "image/svg+xml";
+    return "application/text";
+}
+
+//------------------------------------------------------------------------------
+
+static_file::coding
+static_file::
+select(beast::string_view accept_encoding) const
+{
+    bool listed[num_codings] = {};
+    bool accepted[num_codings] = { true, false, false };
+    bool any = false;
+    for(auto const& e : http::ext_list{accept_encoding})
+    {
+        // A q-value of zero means "not acceptable"
+        bool ok = true;
+        for(auto const& p : e.second)
+            if(beast::iequals(p.first, "q"))
+                ok = p.second.find_first_not_of("0.") !=
+                    beast::string_view::npos;
+        if( beast::iequals(e.first, "gzip") ||
+            beast::iequals(e.first, "x-gzip"))
+        {
+            listed[gzip] = true;
+            accepted[gzip] = ok;
+        }
+        else if(beast::iequals(e.first, "br"))
+        {
+            listed[brotli] = true;
+            accepted[brotli] = ok;
+        }
+        else if(e.first == "*")
+        {
+            any = ok;
+        }
+    }
+
+    auto best = identity;
+    for(auto c : { gzip, brotli })
+    {
+        if(! (listed[c] ? accepted[c] : any))
+            continue;
+        if( body[c].size() > 0 &&
+            body[c].size() < body[best].size())
+            best = c;
+    }
+    return best;
+}
+
+beast::string_view
+static_file::
+name(coding c) noexcept
+{
+    switch(c)
+    {
+    case gzip:      return "gzip";
+    case brotli:    return "br";
+    default:
+        break;
+    }
+    return "identity";
+}
+
+//------------------------------------------------------------------------------
+
+namespace {
+
+namespace fs = boost::filesystem;
+
+// Files larger than this are served from disk
+std::uint64_t constexpr max_file_size = 1024 * 1024;
+
+// How often the document root is checked for changes
+std::chrono::seconds constexpr rescan_interval{2};
+
+// Returns `true` if compressing the type is worthwhile
+bool
+is_compressible(beast::string_view type)
+{
+    return
+        type.starts_with("text/") ||
+        type == "application/javascript" ||
+        type == "application/json" ||
+        type == "application/xml" ||
+        type == "image/svg+xml";
+}
+
+// Read an entire file into a message
+message
+load_file(
+    std::string const& path,
+    beast::error_code& ec)
+{
+    beast::file f;
+    f.open(path.c_str(), beast::file_mode::scan, ec);
+    if(ec)
+        return {};
+    auto const size = f.size(ec);
+    if(ec)
+        return {};
+    std::unique_ptr<char[]> buf(
+        new char[static_cast<std::size_t>(size)]);
+    std::size_t n = 0;
+    while(n < size)
+    {
+        auto const bytes = f.read(
+            buf.get() + n, size - n, ec);
+        if(ec)
+            return {};
+        if(bytes == 0)
+            break;
+        n += bytes;
+    }
+    return message(net::const_buffer(buf.get(), n));
+}
+
+void
+put_le32(unsigned char* p, std::uint32_t v)
+{
+    p[0] = static_cast<unsigned char>(v);
+    p[1] = static_cast<unsigned char>(v >> 8);
+    p[2] = static_cast<unsigned char>(v >> 16);
+    p[3] = static_cast<unsigned char>(v >> 24);
+}
+
+// Return the gzip (RFC 1952) encoding of a buffer,
+// or a null message if it would not be smaller.
+message
+gzip_encode(net::const_buffer in)
+{
+    static unsigned char const header[10] = {
+        0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 2, 255 };
+
+    beast::zlib::deflate_stream ds;
+    ds.reset(9, 15, 9, beast::zlib::Strategy::normal);
+    std::vector<unsigned char> out(
+        sizeof(header) + ds.upper_bound(in.size()) + 8);
+    std::memcpy(out.data(), header, sizeof(header));
+
+    beast::zlib::z_params zs;
+    zs.next_in = in.data();
+    zs.avail_in = in.size();
+    zs.next_out = out.data() + sizeof(header);
+    zs.avail_out = out.size() - sizeof(header) - 8;
+    beast::error_code ec;
+    ds.write(zs, beast::zlib::Flush::finish, ec);
+    if(ec != beast::zlib::error::end_of_stream)
+        return {};
+
+    boost::crc_32_type crc;
+    crc.process_bytes(in.data(), in.size());
+    auto const n = sizeof(header) + zs.total_out;
+    put_le32(&out[n], crc.checksum());
+    put_le32(&out[n + 4],
+        static_cast<std::uint32_t>(in.size()));
+    if(n + 8 >= in.size())
+        return {};
+    return message(net::const_buffer(out.data(), n + 8));
+}
+
+//------------------------------------------------------------------------------
+
+class static_cache_impl
+    : public static_cache
+    , public service
+{
+    // Detects changes to a file or its precompressed variants
+    struct entry
+    {
+        boost::shared_ptr<static_file const> file;
+        std::uint64_t size;
+        std::time_t stamp[static_file::num_codings];
+    };
+
+    struct less
+    {
+        using is_transparent = std::true_type;
+
+        bool
+        operator()(
+            beast::string_view lhs,
+            beast::string_view rhs) const noexcept
+        {
+            return lhs < rhs;
+        }
+    };
+
+    using map_type = boost::container::flat_map<
+        std::string, entry, less>;
+
+    using mutex = boost::shared_mutex;
+    using lock_guard = boost::lock_guard<mutex>;
+    using shared_lock_guard = boost::shared_lock_guard<mutex>;
+
+    server& srv_;
+    section& log_;
+    std::string root_;
+
+    // The table is replaced as a whole, the lock
+    // is only held to copy or swap the pointer.
+    mutex mutable m_;
+    boost::shared_ptr<map_type const> files_;
+
+    // The document root is scanned on this thread
+    std::mutex thread_mutex_;
+    std::condition_variable cv_;
+    bool stop_ = false;
+    std::thread thread_;
+
+public:
+    explicit
+    static_cache_impl(server& srv)
+        : srv_(srv)
+        , log_(srv_.log().get_section("static_cache"))
+        , root_(srv_.doc_root().to_string())
+        , files_(boost::make_shared<map_type>())
+    {
+        // Fill the cache before any connections are accepted
+        rescan();
+    }
+
+    ~static_cache_impl()
+    {
+        stop();
+        if(thread_.joinable())
+            thread_.join();
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // static_cache
+    //
+    //--------------------------------------------------------------------------
+
+    boost::shared_ptr<static_file const>
+    find(beast::string_view target) const override
+    {
+        auto const pos = target.find('?');
+        if(pos != beast::string_view::npos)
+            target = target.substr(0, pos);
+        auto const files = table();
+        auto it = files->find(target);
+        if(it == files->end())
+            return nullptr;
+        return it->second.file;
+    }
+
+    //--------------------------------------------------------------------------
+    //
+    // service
+    //
+    //--------------------------------------------------------------------------
+
+    void
+    on_start() override
+    {
+        thread_ = std::thread(&static_cache_impl::run, this);
+    }
+
+    void
+    on_stop() override
+    {
+        stop();
+    }
+
+private:
+    void
+    stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(thread_mutex_);
+            stop_ = true;
+        }
+        cv_.notify_one();
+    }
+
+    // Walking the tree and compressing files is kept
+    // off the I/O threads, which only see the result.
+    void
+    run()
+    {
+        std::unique_lock<std::mutex> lock(thread_mutex_);
+        while(! cv_.wait_for(lock, rescan_interval,
+            [this]
+            {
+                return stop_;
+            }))
+        {
+            lock.unlock();
+            rescan();
+            lock.lock();
+        }
+    }
+
+    boost::shared_ptr<map_type const>
+    table() const
+    {
+        shared_lock_guard lock(m_);
+        return files_;
+    }
+
+    // Load a file and its codings
+    boost::shared_ptr<static_file const>
+    load(
+        std::string const& path,
+        std::string const& target,
+        entry const& e,
+        beast::error_code& ec)
+    {
+        auto f = boost::make_shared<static_file>();
+        f->target = target;
+        f->type = mime_type(target);
+        f->last_write = e.stamp[static_file::identity];
+
+        // messages are immutable, so swap them in
+        auto const set =
+            [&f](static_file::coding c, message m)
+            {
+                swap(f->body[c], m);
+            };
+
+        set(static_file::identity, load_file(path, ec));
+        if(ec)
+            return nullptr;
+
+        // Precompressed variants on disk take precedence
+        if(e.stamp[static_file::gzip] != 0)
+        {
+            set(static_file::gzip, load_file(path + ".gz", ec));
+            if(ec)
+                return nullptr;
+        }
+        else if(is_compressible(f->type))
+        {
+            set(static_file::gzip, gzip_encode(
+                *f->body[static_file::identity].begin()));
+        }
+        if(e.stamp[static_file::brotli] != 0)
+        {
+            set(static_file::brotli, load_file(path + ".br", ec));
+            if(ec)
+                return nullptr;
+        }
+
+        // Compute the validators once, instead of per request
+        f->last_modified = format_http_date(f->last_write);
+        for(int i = 0; i < static_file::num_codings; ++i)
+        {
+            auto const c = static_cast<static_file::coding>(i);
+            if(c == static_file::identity || f->body[c].size() > 0)
+                f->etag[c] = make_etag(f->body[c].size(), f->last_write,
+                    c == static_file::identity ?
+                        beast::string_view{} : static_file::name(c));
+        }
+        return f;
+    }
+
+    // Bring the cache up to date with the document root
+    void
+    rescan()
+    {
+        struct status
+        {
+            std::uint64_t size;
+            std::time_t time;
+        };
+
+        // One pass over the tree, the precompressed
+        // variants of each file are looked up in it.
+        std::unordered_map<std::string, status> found;
+        boost::system::error_code ec;
+        for(fs::recursive_directory_iterator it(root_, ec), end;
+            ! ec && it != end; it.increment(ec))
+        {
+            boost::system::error_code ec2;
+            auto const size = fs::file_size(it->path(), ec2);
+            if(ec2)
+                continue; // Not a regular file
+            auto const time = fs::last_write_time(it->path(), ec2);
+            if(ec2)
+                continue;
+            found.emplace(it->path().string(), status{size, time});
+        }
+        if(ec)
+            LOG_INF(log_, "scan \"", root_, "\"\t", ec.message());
+
+        auto const stamp =
+            [&found](std::string const& path) -> std::time_t
+            {
+                auto const it = found.find(path);
+                return it == found.end() ? 0 : it->second.time;
+            };
+
+        auto const prev = table();
+        map_type files;
+        files.reserve(prev->size());
+        std::size_t loaded = 0;
+        auto const root = fs::path(root_).generic_string();
+        for(auto const& f : found)
+        {
+            auto const& path = f.first;
+            if(f.second.size > max_file_size)
+                continue;
+
+            // A variant is served with its file, not by itself
+            auto const ext = fs::path(path).extension();
+            if( (ext == ".gz" || ext == ".br") &&
+                found.count(path.substr(0, path.size() - 3)) > 0)
+                continue;
+
+            auto target = fs::path(path).generic_string().substr(
+                root.size());
+            if(target.empty() || target.front() != '/')
+                target.insert(target.begin(), '/');
+
+            entry e;
+            e.size = f.second.size;
+            e.stamp[static_file::identity] = f.second.time;
+            e.stamp[static_file::gzip] = stamp(path + ".gz");
+            e.stamp[static_file::brotli] = stamp(path + ".br");
+
+            // Keep the cached copy if nothing changed
+            auto const it = prev->find(target);
+            if( it != prev->end() &&
+                it->second.size == e.size &&
+                std::equal(
+                    std::begin(e.stamp), std::end(e.stamp),
+                    std::begin(it->second.stamp)))
+                e.file = it->second.file;
+            if(! e.file)
+            {
+                beast::error_code ec2;
+                e.file = load(path, target, e, ec2);
+                if(ec2)
+                {
+                    LOG_INF(log_, "load \"", path, "\"\t", ec2.message());
+                    continue;
+                }
+                LOG_TRC(log_, "loaded \"", target, "\"");
+                ++loaded;
+            }
+
+            // A directory target refers to its index
+            beast::string_view const index = "/index.html";
+            if(beast::string_view(target).ends_with(index))
+                files.emplace(
+                    target.substr(0, target.size() - index.size() + 1), e);
+
+            files.emplace(std::move(target), std::move(e));
+        }
+
+        auto const n = files.size();
+        if(loaded == 0 && n == prev->size())
+            return;
+        auto next = boost::make_shared<map_type const>(std::move(files));
+        {
+            lock_guard lock(m_);
+            files_.swap(next);
+        }
+        LOG_INF(log_, "rescan\t", loaded,
+            " files loaded, ", n, " entries");
+    }
+};
+
+} // (anon)
+
+//------------------------------------------------------------------------------
+
+static_cache&
+make_static_cache(server& srv)
+{
+    auto sp = boost::make_unique<static_cache_impl>(srv);
+    auto& result = *sp;
+    srv.insert(std::move(sp));
+    return result;
+}
@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_STATIC_CACHE_HPP
+#define LOUNGE_STATIC_CACHE_HPP
+
+#include "config.hpp"
+#include "message.hpp"
+#include <boost/beast/core/string.hpp>
+#include <boost/smart_ptr/shared_ptr.hpp>
+#include <cstdint>
+#include <ctime>
+#include <string>
+
+class server;
+
+//------------------------------------------------------------------------------
+
+/** A file held in the static asset cache.
+
+    Objects of this type are immutable once published,
+    and may be shared by any number of responses.
+*/
+class static_file
+{
+public:
+    /// The content codings which may be stored
+    enum coding
+    {
+        identity = 0,
+        gzip,
+        brotli,
+
+        num_codings
+    };
+
+    /// The request target, for example "/index.html"
+    std::string target;
+
+    /// The MIME type
+    beast::string_view type;
+
+    /// The time of the last modification
+    std::time_t last_write = 0;
+
+    /// The value of the Last-Modified field
+    std::string last_modified;
+
+    /** The contents for each coding.
+
+        Only the identity coding is always present.
+    */
+    message body[num_codings];
+
+    /// The entity tag for each coding which is present
+    std::string etag[num_codings];
+
+    /// Returns `true` if any compressed coding is present
+    bool
+    has_codings() const noexcept
+    {
+        return
+            body[gzip].size() > 0 ||
+            body[brotli].size() > 0;
+    }
+
+    /** Return the best coding for an Accept-Encoding field value.
+
+        The smallest coding acceptable to the
+        client is chosen, or identity if none are.
+    */
+    coding
+    select(beast::string_view accept_encoding) const;
+
+    /// Return the Content-Encoding token for a coding
+    static
+    beast::string_view
+    name(coding c) noexcept;
+};
+
+//------------------------------------------------------------------------------
+
+/** An in-memory cache of the files under the document root.
+
+    The cache is filled when the server is created, and the
+    document root is checked periodically for changes on a
+    thread of its own. Large files are not cached and must be
+    served from disk. Precompressed variants, such as
+    "app.js.gz", are served as codings of their file only.
+*/
+class static_cache
+{
+public:
+    virtual ~static_cache() = default;
+
+    /** Return the cached file for a request target, or nullptr.
+
+        Targets ending in a slash refer to "index.html"
+        in that directory. Any query string is ignored.
+    */
+    virtual
+    boost::shared_ptr<static_file const>
+    find(beast::string_view target) const = 0;
+};
+
+/** Create the static asset cache.
+
+    The cache is added to the server as a service.
+*/
+extern
+static_cache&
+make_static_cache(server& srv);
+
+/// Return a reasonable mime type based on the extension of a file.
+extern
+beast::string_view
+mime_type(beast::string_view path);
+
+#endif
@@ -10,6 +10,7 @@
 #include "rpc.hpp"
 #include "channel.hpp"
 #include "channel_list.hpp"
+#include "rpc_stats.hpp"
 #include "server.hpp"
 #include "user.hpp"
 #include <boost/make_shared.hpp>
@@ -33,6 +34,12 @@ public:
     {
     }
 
+    beast::string_view
+    type() const noexcept override
+    {
+        return "system";
+    }
+
 protected:
     void
     on_insert(user&) override
@@ -60,6 +67,10 @@ protected:
         {
             do_stop(rpc);
         }
+        else if(rpc.method == "rpc_stats")
+        {
+            do_rpc_stats(rpc);
+        }
         else
         {
             rpc.fail(rpc_code::method_not_found);
@@ -91,6 +102,25 @@ protected:
         rpc.complete();
     }
 
+    void
+    do_rpc_stats(rpc_call& rpc)
+    {
+        auto& arr = rpc.result.emplace_array();
+        for(auto const& s :
+            srv_.channel_list().rpc_stats().summaries())
+        {
+            json::value jv = {
+                { "channel", s.channel },
+                { "method", s.method },
+                { "count", s.count },
+                { "queue", { s.queue[0], s.queue[1], s.queue[2] } },
+                { "run", { s.run[0], s.run[1], s.run[2] } }
+            };
+            arr.emplace_back(std::move(jv));
+        }
+        rpc.complete();
+    }
+
     void
     do_stop(rpc_call& rpc)
     {
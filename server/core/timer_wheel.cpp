@@ -0,0 +1,384 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#include "timer_wheel.hpp"
+#include <boost/asio/post.hpp>
+#include <boost/assert.hpp>
+#include <mutex>
+
+/*
+    Each shard is a set of wheels of 64 slots. A timer due
+    within 64 ticks is kept in the first wheel, in the slot
+    for its expiration tick. Timers due later are kept in
+    the wheel whose slots are wide enough, and move down a
+    wheel each time the one below completes a revolution,
+    so every timer is touched at most once per wheel.
+*/
+struct timer_wheel::shard
+{
+    static unsigned constexpr bits = 6;
+    static unsigned constexpr levels = 4;
+    static std::size_t constexpr slots = std::size_t(1) << bits;
+    static std::uint64_t constexpr mask = slots - 1;
+
+    // The farthest a timer may be scheduled, in ticks
+    static std::uint64_t constexpr span =
+        std::uint64_t(1) << (bits * levels);
+
+    using handlers = std::vector<std::function<void()>>;
+
+    timer_wheel& w;
+    std::mutex m;
+    std::unique_ptr<timer_type> timer;
+    wheel_timer* slot[levels][slots];
+    std::uint64_t now = 0;          // the next tick to process
+    std::size_t count = 0;
+    bool armed = false;
+    bool stopped = true;
+
+    explicit
+    shard(timer_wheel& w_)
+        : w(w_)
+    {
+        for(auto& level : slot)
+            for(auto& head : level)
+                head = nullptr;
+    }
+
+    // Return the last tick which has started
+    std::uint64_t
+    tick_now() const
+    {
+        return static_cast<std::uint64_t>(
+            (clock_type::now() - w.epoch_) / w.resolution_);
+    }
+
+    void
+    link(wheel_timer& t) noexcept
+    {
+        if(t.expiry_ < now)
+            t.expiry_ = now;
+        auto delta = t.expiry_ - now;
+        if(delta >= span)
+        {
+            delta = span - 1;
+            t.expiry_ = now + delta;
+        }
+        unsigned level = 0;
+        while(delta >> (bits * (level + 1)))
+            ++level;
+        auto& head = slot[level][
+            (t.expiry_ >> (bits * level)) & mask];
+        t.head_ = &head;
+        t.prev_ = nullptr;
+        t.next_ = head;
+        if(head)
+            head->prev_ = &t;
+        head = &t;
+    }
+
+    void
+    unlink(wheel_timer& t) noexcept
+    {
+        if(t.prev_)
+            t.prev_->next_ = t.next_;
+        else
+            *t.head_ = t.next_;
+        if(t.next_)
+            t.next_->prev_ = t.prev_;
+        t.head_ = nullptr;
+        t.prev_ = nullptr;
+        t.next_ = nullptr;
+    }
+
+    // Move the timers in a slot down to the wheels below
+    void
+    cascade(unsigned level, std::size_t index) noexcept
+    {
+        auto t = slot[level][index];
+        slot[level][index] = nullptr;
+        while(t)
+        {
+            auto const next = t->next_;
+            link(*t);
+            t = next;
+        }
+    }
+
+    // Process the tick `now`, collecting the expired handlers
+    void
+    advance(handlers& fired)
+    {
+        auto const index = now & mask;
+        if(index == 0)
+        {
+            for(unsigned level = 1; level < levels; ++level)
+            {
+                auto const i =
+                    (now >> (bits * level)) & mask;
+                cascade(level, i);
+                if(i != 0)
+                    break;
+            }
+        }
+        auto& head = slot[0][index];
+        while(head)
+        {
+            auto& t = *head;
+            unlink(t);
+            --count;
+            fired.emplace_back(std::move(t.handler_));
+            t.handler_ = nullptr;
+        }
+        ++now;
+    }
+
+    // Wait for the next tick, on the strand
+    void
+    arm()
+    {
+        std::lock_guard<std::mutex> lock(m);
+        if(stopped)
+            return;
+        timer->expires_at(w.epoch_ + w.resolution_ * now);
+        timer->async_wait(
+            [this](beast::error_code ec)
+            {
+                on_timer(ec);
+            });
+    }
+
+    void
+    on_timer(beast::error_code ec)
+    {
+        if(ec == net::error::operation_aborted)
+            return;
+
+        handlers fired;
+        {
+            std::lock_guard<std::mutex> lock(m);
+            if(stopped)
+                return;
+            auto const target = tick_now();
+            while(count > 0 && now <= target)
+                advance(fired);
+            if(count == 0)
+            {
+                armed = false;
+            }
+            else
+            {
+                timer->expires_at(w.epoch_ + w.resolution_ * now);
+                timer->async_wait(
+                    [this](beast::error_code ec)
+                    {
+                        on_timer(ec);
+                    });
+            }
+        }
+
+        // Invoked without the lock, so a
+        // handler may schedule a timer.
+        for(auto& f : fired)
+            f();
+    }
+};
+
+//------------------------------------------------------------------------------
+
+timer_wheel::
+timer_wheel(
+    std::size_t shards,
+    duration resolution)
+    : resolution_(resolution)
+    , epoch_(clock_type::now())
+    , next_(0)
+{
+    BOOST_ASSERT(resolution_.count() > 0);
+    if(shards < 1)
+        shards = 1;
+    shards_.reserve(shards);
+    while(shards_.size() < shards)
+        shards_.emplace_back(new shard(*this));
+}
+
+timer_wheel::
+~timer_wheel()
+{
+}
+
+void
+timer_wheel::
+start(std::function<executor_type()> const& make_executor)
+{
+    for(auto& sp : shards_)
+    {
+        auto& s = *sp;
+        s.timer.reset(new timer_type(make_executor()));
+        bool arm = false;
+        {
+            std::lock_guard<std::mutex> lock(s.m);
+            s.stopped = false;
+            if(s.count > 0 && ! s.armed)
+            {
+                s.armed = true;
+                arm = true;
+            }
+        }
+        if(arm)
+            net::post(
+                s.timer->get_executor(),
+                [&s]
+                {
+                    s.arm();
+                });
+    }
+}
+
+void
+timer_wheel::
+stop()
+{
+    for(auto& sp : shards_)
+    {
+        auto& s = *sp;
+        {
+            // Only a waiting timer needs cancelling
+            std::lock_guard<std::mutex> lock(s.m);
+            if(s.stopped)
+                continue;
+            s.stopped = true;
+            if(! s.armed)
+                continue;
+        }
+        net::post(
+            s.timer->get_executor(),
+            [&s]
+            {
+                s.timer->cancel();
+            });
+    }
+}
+
+void
+timer_wheel::
+close()
+{
+    for(auto& sp : shards_)
+    {
+        std::lock_guard<std::mutex> lock(sp->m);
+        sp->stopped = true;
+        sp->timer.reset();
+    }
+}
+
+std::size_t
+timer_wheel::
+size() const
+{
+    std::size_t n = 0;
+    for(auto& sp : shards_)
+    {
+        std::lock_guard<std::mutex> lock(sp->m);
+        n += sp->count;
+    }
+    return n;
+}
+
+auto
+timer_wheel::
+pick() noexcept ->
+    shard&
+{
+    return *shards_[next_++ % shards_.size()];
+}
+
+//------------------------------------------------------------------------------
+
+wheel_timer::
+wheel_timer(timer_wheel& wheel) noexcept
+    : s_(wheel.pick())
+{
+}
+
+wheel_timer::
+~wheel_timer()
+{
+    cancel();
+}
+
+void
+wheel_timer::
+expires_after(
+    timer_wheel::duration after,
+    std::function<void()> handler)
+{
+    auto const& w = s_.w;
+
+    // Round up, so the timer never fires early
+    auto const elapsed =
+        timer_wheel::clock_type::now() - w.epoch_ + after;
+    auto const resolution = std::chrono::duration_cast<
+        timer_wheel::clock_type::duration>(w.resolution_);
+    auto const expiry = static_cast<std::uint64_t>(
+        (elapsed + resolution -
+            timer_wheel::clock_type::duration(1)) / resolution);
+
+    std::function<void()> prev;
+    bool arm = false;
+    {
+        std::lock_guard<std::mutex> lock(s_.m);
+        if(head_)
+        {
+            s_.unlink(*this);
+            --s_.count;
+        }
+        else if(s_.count == 0)
+        {
+            // The wheels are empty, catch up to the clock
+            auto const t = s_.tick_now();
+            if(s_.now < t)
+                s_.now = t;
+        }
+        prev = std::move(handler_);
+        handler_ = std::move(handler);
+        expiry_ = expiry;
+        s_.link(*this);
+        ++s_.count;
+        if(! s_.armed && ! s_.stopped)
+        {
+            s_.armed = true;
+            arm = true;
+        }
+    }
+    if(arm)
+    {
+        auto& s = s_;
+        net::post(
+            s.timer->get_executor(),
+            [&s]
+            {
+                s.arm();
+            });
+    }
+}
+
+void
+wheel_timer::
+cancel() noexcept
+{
+    std::function<void()> prev;
+    std::lock_guard<std::mutex> lock(s_.m);
+    if(! head_)
+        return;
+    s_.unlink(*this);
+    --s_.count;
+    prev = std::move(handler_);
+    handler_ = nullptr;
+}
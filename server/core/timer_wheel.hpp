@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_TIMER_WHEEL_HPP
+#define LOUNGE_TIMER_WHEEL_HPP
+
+#include "config.hpp"
+#include "types.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+class wheel_timer;
+
+//------------------------------------------------------------------------------
+
+/** A hierarchical timing wheel.
+
+    Timers which are rearmed far more often than they
+    expire, such as session deadlines, are kept in wheels
+    of slots instead of in the heap of the I/O context.
+    Scheduling and cancelling take constant time, and each
+    shard of the wheel uses a single system timer which
+    wakes once per tick while any timer is pending.
+
+    Expirations are rounded up to the next tick, so a
+    timer never fires early, and fires at most one tick
+    late when the shard's strand is not busy.
+*/
+class timer_wheel
+{
+public:
+    using clock_type = std::chrono::steady_clock;
+    using duration = std::chrono::milliseconds;
+
+    /** Constructor
+
+        @param shards The number of independent wheels, each
+        with its own lock and system timer. One per I/O thread
+        keeps contention low.
+
+        @param resolution The length of one tick.
+    */
+    explicit
+    timer_wheel(
+        std::size_t shards,
+        duration resolution = std::chrono::milliseconds(100));
+
+    ~timer_wheel();
+
+    /** Start the system timers.
+
+        @param make_executor A function returning the
+        strand for the system timer of each shard.
+    */
+    void
+    start(std::function<executor_type()> const& make_executor);
+
+    /** Stop the system timers.
+
+        Pending timers will not fire after this returns,
+        and the I/O context may run out of work.
+    */
+    void
+    stop();
+
+    /** Destroy the system timers.
+
+        This must be called before the I/O context is
+        destroyed. Timers may still be cancelled afterwards.
+    */
+    void
+    close();
+
+    /// Return the length of one tick
+    duration
+    resolution() const noexcept
+    {
+        return resolution_;
+    }
+
+    /// Return the number of pending timers
+    std::size_t
+    size() const;
+
+private:
+    friend class wheel_timer;
+
+    struct shard;
+
+    duration resolution_;
+    clock_type::time_point epoch_;
+    std::vector<std::unique_ptr<shard>> shards_;
+    std::atomic<std::size_t> next_;
+
+    shard&
+    pick() noexcept;
+};
+
+//------------------------------------------------------------------------------
+
+/** A timer scheduled on a @ref timer_wheel.
+
+    The handler is invoked on the strand of the wheel's
+    shard, outside of any lock. Since the owner of the timer
+    may be gone by then, the handler usually holds a weak
+    pointer and posts the real work to the owner's strand.
+    Destroying the timer cancels it.
+*/
+class wheel_timer
+{
+    friend class timer_wheel;
+
+    timer_wheel::shard& s_;
+    wheel_timer* prev_ = nullptr;
+    wheel_timer* next_ = nullptr;
+    wheel_timer** head_ = nullptr;
+    std::uint64_t expiry_ = 0;
+    std::function<void()> handler_;
+
+public:
+    explicit
+    wheel_timer(timer_wheel& wheel) noexcept;
+
+    ~wheel_timer();
+
+    wheel_timer(wheel_timer const&) = delete;
+    wheel_timer& operator=(wheel_timer const&) = delete;
+
+    /** Schedule the handler, replacing any pending one.
+
+        @param after The time from now until the handler is invoked.
+
+        @param handler The function to invoke.
+    */
+    void
+    expires_after(
+        timer_wheel::duration after,
+        std::function<void()> handler);
+
+    /// Cancel the pending handler, if any
+    void
+    cancel() noexcept;
+};
+
+#endif
@@ -59,4 +59,16 @@ using flat_storage = beast::flat_buffer;
 /// The type of network endpoint
 using endpoint_type = tcp::endpoint;
 
+/** Return `true` if the connection under a stream is open.
+
+    Sessions call this on the lowest layer of their stream,
+    other kinds of transport provide their own overload.
+*/
+inline
+bool
+is_open(stream_type const& stream) noexcept
+{
+    return stream.socket().is_open();
+}
+
 #endif
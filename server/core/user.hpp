@@ -15,6 +15,7 @@
 #include "utility.hpp"
 #include <boost/json/value.hpp>
 #include <boost/container/flat_set.hpp>
+#include <atomic>
 #include <mutex>
 #include <string>
 
@@ -26,6 +27,7 @@ class user : public session
 {
     std::mutex mutex_;
     boost::container::flat_set<channel*> channels_;
+    std::atomic<std::size_t> backlog_{0};
 
 public:
     std::string name;
@@ -51,6 +53,24 @@ public:
     virtual
     void
     send(message m) = 0;
+
+    /** Return the number of messages waiting to be sent.
+
+        Channels use this to send less to a slow connection.
+    */
+    std::size_t
+    backlog() const noexcept
+    {
+        return backlog_.load(std::memory_order_relaxed);
+    }
+
+protected:
+    /// Called by the session when its queue changes
+    void
+    set_backlog(std::size_t n) noexcept
+    {
+        backlog_.store(n, std::memory_order_relaxed);
+    }
 };
 
 #endif
@@ -11,8 +11,13 @@
 #include "listener.hpp"
 #include "logger.hpp"
 #include "message.hpp"
+#include "metrics.hpp"
+#include "pipe_stream.hpp"
+#include "recorder.hpp"
 #include "rpc.hpp"
 #include "server.hpp"
+#include "session_metrics.hpp"
+#include "timer_wheel.hpp"
 #include "user.hpp"
 #include <boost/beast/websocket/stream.hpp>
 #include <boost/beast/core/stream_traits.hpp>
@@ -22,6 +27,7 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/dispatch.hpp>
 #include <boost/asio/post.hpp>
+#include <boost/smart_ptr/weak_ptr.hpp>
 #include <iostream>
 #include <vector>
 
@@ -41,6 +47,16 @@ protected:
     endpoint_type ep_;
     flat_storage msg_;
     std::vector<message> mq_;
+    counter& messages_in_;
+    counter& messages_out_;
+    counter& bytes_out_;
+    histogram& sizes_;
+    gauge& queued_;
+    counter& rpc_errors_;
+    recorder& rec_;
+    wheel_timer deadline_;
+    wheel_timer ping_;
+    std::uint64_t deadline_gen_ = 0;
 
 public:
     ws_session_base(
@@ -51,12 +67,23 @@ public:
         , lst_(lst)
         , log_(srv_.log().get_section("ws_session"))
         , ep_(ep)
+        , messages_in_(srv_.session_metrics().ws_messages_in)
+        , messages_out_(srv_.session_metrics().ws_messages_out)
+        , bytes_out_(srv_.session_metrics().ws_bytes_out)
+        , sizes_(srv_.session_metrics().ws_sizes)
+        , queued_(srv_.session_metrics().ws_queued)
+        , rpc_errors_(srv_.channel_list().rpc_errors())
+        , rec_(srv_.recorder())
+        , deadline_(srv_.timer_wheel())
+        , ping_(srv_.timer_wheel())
     {
         lst_.insert(this);
     }
 
     ~ws_session_base()
     {
+        rec_.add(trace_event::close, this);
+        queued_.sub(mq_.size());
         lst_.erase(this);
     }
 
@@ -76,10 +103,16 @@ public:
     void
     run(websocket::request_type req)
     {
-        // Apply settings to stream
+        // The handshake and idle timeouts, and the keep-alive
+        // pings, are kept on the server's timer wheel instead
+        // of in the stream, since the idle timeout is rearmed
+        // for every message.
         impl()->ws().set_option(
-            websocket::stream_base::timeout::suggested(
-                beast::role_type::server));
+            websocket::stream_base::timeout{
+                websocket::stream_base::none(),
+                websocket::stream_base::none(),
+                false});
+        set_deadline(std::chrono::seconds(30));
 
         // Limit the maximum incoming message size
         impl()->ws().read_message_max(64 * 1024);
@@ -102,6 +135,19 @@ public:
             // Report any handshaking errors
             if(ec)
                 return fail(ec, "async_accept");
+            rec_.add(trace_event::handshake, this);
+
+            // A pong is activity, so a client which only
+            // receives is kept by answering the pings.
+            impl()->ws().control_callback(
+                [this](
+                    websocket::frame_type kind,
+                    beast::string_view)
+                {
+                    if(kind == websocket::frame_type::pong)
+                        set_idle();
+                });
+            set_idle();
 
             for(;;)
             {
@@ -113,7 +159,14 @@ public:
                 if(ec)
                     return fail(ec, "async_read");
 
+                set_idle();
+                messages_in_.inc();
+                sizes_.observe(bytes_transferred);
+                rec_.add(trace_event::read, this);
+
                 // Parse the buffer into JSON
+                auto const received =
+                    rpc_call::clock_type::now();
                 json::parser pr;
                 auto const cb = msg_.data();
                 json::value jv = json::parse(
@@ -124,6 +177,8 @@ public:
 
                 // Validate and extract the JSON-RPC request
                 rpc_call rpc(*this);
+                rpc.received = received;
+                rpc.errors = &rpc_errors_;
                 rpc.extract(std::move(jv), ec);
                 try
                 {
@@ -157,6 +212,79 @@ public:
             LOG_INF(log_, what, '\t', ec.message());
     }
 
+    // Close the connection if the deadline passes first
+    void
+    set_deadline(std::chrono::seconds n)
+    {
+        boost::weak_ptr<ws_session_base> wp =
+            boost::weak_from(this);
+        auto const gen = ++deadline_gen_;
+        deadline_.expires_after(n,
+            [wp, gen]
+            {
+                auto sp = wp.lock();
+                if(! sp)
+                    return;
+                auto const ex = sp->impl()->ws().get_executor();
+                net::post(ex,
+                    beast::bind_front_handler(
+                        &ws_session_base::on_deadline,
+                        std::move(sp), gen));
+            });
+    }
+
+    // Close the connection after the idle period, pinging
+    // the client halfway through it.
+    void
+    set_idle()
+    {
+        set_deadline(std::chrono::seconds(300));
+        boost::weak_ptr<ws_session_base> wp =
+            boost::weak_from(this);
+        ping_.expires_after(std::chrono::seconds(150),
+            [wp]
+            {
+                auto sp = wp.lock();
+                if(! sp)
+                    return;
+                auto const ex = sp->impl()->ws().get_executor();
+                net::post(ex,
+                    beast::bind_front_handler(
+                        &ws_session_base::on_ping,
+                        std::move(sp)));
+            });
+    }
+
+    void
+    on_ping()
+    {
+        if(! impl()->ws().is_open())
+            return;
+        impl()->ws().async_ping({},
+            beast::bind_front_handler(
+                &ws_session_base::on_ping_sent,
+                boost::shared_from(this)));
+    }
+
+    void
+    on_ping_sent(beast::error_code ec)
+    {
+        if(ec)
+            return fail(ec, "async_ping");
+    }
+
+    void
+    on_deadline(std::uint64_t gen)
+    {
+        // The deadline was rearmed after the wheel
+        // fired, and before this ran.
+        if(gen != deadline_gen_)
+            return;
+        LOG_TRC(log_, "deadline", '\t', ep_);
+        beast::close_socket(
+            beast::get_lowest_layer(impl()->ws()));
+    }
+
     //--------------------------------------------------------------------------
     //
     // session
@@ -207,10 +335,12 @@ public:
     void
     do_send(message m)
     {
-        if(! beast::get_lowest_layer(
-            impl()->ws()).socket().is_open())
+        if(! is_open(beast::get_lowest_layer(impl()->ws())))
             return;
         mq_.emplace_back(std::move(m));
+        set_backlog(mq_.size());
+        queued_.add();
+        rec_.add(trace_event::enqueue, this);
         if(mq_.size() == 1)
             do_write();
     }
@@ -232,15 +362,20 @@ public:
     on_write(
         std::size_t idx,
         beast::error_code ec,
-        std::size_t)
+        std::size_t bytes_transferred)
     {
         BOOST_ASSERT(! mq_.empty());
         if(ec)
             return fail(ec, "on_write");
+        messages_out_.inc();
+        bytes_out_.inc(bytes_transferred);
+        rec_.add(trace_event::write, this);
+        queued_.sub();
         auto const last = mq_.size() - 1;
         if(idx != last)
             swap(mq_[idx], mq_[last]);
         mq_.resize(last);
+        set_backlog(mq_.size());
         if(! mq_.empty())
             do_write();
     }
@@ -343,6 +478,32 @@ public:
     }
 };
 
+//------------------------------------------------------------------------------
+
+class pipe_ws_session_impl
+    : public ws_session_base<pipe_ws_session_impl>
+{
+    websocket::stream<pipe_stream> ws_;
+
+public:
+    pipe_ws_session_impl(
+        server& srv,
+        listener& lst,
+        pipe_stream stream,
+        endpoint_type ep)
+        : ws_session_base(
+            srv, lst, ep)
+        , ws_(std::move(stream))
+    {
+    }
+
+    websocket::stream<pipe_stream>&
+    ws()
+    {
+        return ws_;
+    }
+};
+
 } // (anon)
 
 //------------------------------------------------------------------------------
@@ -380,6 +541,22 @@ run_ws_session(
     sp->run(std::move(req));
 }
 
+void
+run_ws_session(
+    server& srv,
+    listener& lst,
+    pipe_stream stream,
+    endpoint_type ep,
+    websocket::request_type req)
+{
+    auto sp = boost::make_shared<
+            pipe_ws_session_impl>(
+        srv, lst,
+        std::move(stream),
+        ep);
+    sp->run(std::move(req));
+}
+
 /*
 
 ws_session is created
@@ -0,0 +1,229 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/archive.hpp"
+
+#include "temp_dir.hpp"
+#include "test_suite.hpp"
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+class archive_test
+{
+public:
+    // The smallest segments, about four hundred records each
+    static std::size_t constexpr segment_size = 65536;
+
+    static
+    std::string
+    text(std::size_t cid, std::uint64_t seq)
+    {
+        return "{\"cid\":" + std::to_string(cid) +
+            ",\"seq\":" + std::to_string(seq) +
+            ",\"message\":\"" + std::string(64, 'x') + "\"}";
+    }
+
+    static
+    void
+    append(archive& ar, std::size_t cid, std::uint64_t seq)
+    {
+        auto const s = text(cid, seq);
+        ar.append(cid, seq, message(net::buffer(s)));
+    }
+
+    // Return true if v holds the messages from seq onwards
+    static
+    bool
+    same(
+        std::vector<message> const& v,
+        std::size_t cid,
+        std::uint64_t seq)
+    {
+        for(auto const& m : v)
+            if(beast::buffers_to_string(m) != text(cid, seq++))
+                return false;
+        return true;
+    }
+
+    void
+    testReadWrite()
+    {
+        temp_dir dir;
+        {
+            archive ar(dir.path.string(), segment_size);
+            beast::error_code ec;
+            ar.open(ec);
+            BOOST_TEST(! ec);
+            for(std::uint64_t seq = 1; seq <= 1000; ++seq)
+                for(std::size_t cid = 1; cid <= 3; ++cid)
+                    append(ar, cid, seq);
+
+            // An old number is not written again
+            append(ar, 1, 500);
+            ar.close();
+            BOOST_TEST(ar.segments() > 2);
+            BOOST_TEST(ar.last(1) == 1000);
+        }
+        archive ar(dir.path.string(), segment_size);
+        beast::error_code ec;
+        ar.open(ec);
+        BOOST_TEST(! ec);
+        for(std::size_t cid = 1; cid <= 3; ++cid)
+        {
+            BOOST_TEST(ar.first(cid) == 1);
+            BOOST_TEST(ar.last(cid) == 1000);
+
+            std::vector<message> v;
+            BOOST_TEST(ar.read(cid, 0, 10, v) == 991);
+            BOOST_TEST(v.size() == 10);
+            BOOST_TEST(same(v, cid, 991));
+
+            v.clear();
+            BOOST_TEST(ar.read(cid, 500, 20, v) == 480);
+            BOOST_TEST(v.size() == 20);
+            BOOST_TEST(same(v, cid, 480));
+
+            v.clear();
+            BOOST_TEST(ar.read(cid, 5, 10, v) == 1);
+            BOOST_TEST(v.size() == 4);
+            BOOST_TEST(same(v, cid, 1));
+
+            v.clear();
+            BOOST_TEST(ar.read(cid, 1, 10, v) == 0);
+            BOOST_TEST(v.empty());
+        }
+        std::vector<message> v;
+        BOOST_TEST(ar.read(4, 0, 10, v) == 0);
+        BOOST_TEST(ar.first(4) == 0);
+    }
+
+    void
+    testCompact()
+    {
+        // Each run leaves a small segment, which are merged
+        temp_dir dir;
+        std::uint64_t seq = 0;
+        for(int i = 0; i < 5; ++i)
+        {
+            archive ar(dir.path.string(), segment_size);
+            beast::error_code ec;
+            ar.open(ec);
+            BOOST_TEST(! ec);
+            BOOST_TEST(ar.last(1) == seq);
+            for(int j = 0; j < 20; ++j)
+                append(ar, 1, ++seq);
+            ar.close();
+        }
+        archive ar(dir.path.string(), segment_size);
+        beast::error_code ec;
+        ar.open(ec);
+        BOOST_TEST(! ec);
+        BOOST_TEST(ar.segments() == 2);
+        std::vector<message> v;
+        BOOST_TEST(ar.read(1, 0, 100, v) == 1);
+        BOOST_TEST(v.size() == 100);
+        BOOST_TEST(same(v, 1, 1));
+    }
+
+    void
+    testExpire()
+    {
+        temp_dir dir;
+        {
+            archive ar(dir.path.string(), segment_size);
+            beast::error_code ec;
+            ar.open(ec);
+            BOOST_TEST(! ec);
+            for(std::uint64_t seq = 1; seq <= 100; ++seq)
+                append(ar, 1, seq);
+        }
+        std::this_thread::sleep_for(
+            std::chrono::milliseconds(10));
+        archive ar(dir.path.string(), segment_size,
+            std::chrono::hours(0));
+        beast::error_code ec;
+        ar.open(ec);
+        BOOST_TEST(! ec);
+        BOOST_TEST(ar.last(1) == 0);
+        BOOST_TEST(ar.segments() == 1);
+    }
+
+    void
+    testDuplicates()
+    {
+        // A segment left behind by a merge, as after a crash
+        temp_dir dir;
+        {
+            archive ar(dir.path.string(), segment_size);
+            beast::error_code ec;
+            ar.open(ec);
+            BOOST_TEST(! ec);
+            for(std::uint64_t seq = 1; seq <= 50; ++seq)
+                append(ar, 1, seq);
+        }
+        fs::copy_file(dir.path / "segment.1", dir.path / "segment.2");
+
+        archive ar(dir.path.string(), segment_size);
+        beast::error_code ec;
+        ar.open(ec);
+        BOOST_TEST(! ec);
+        BOOST_TEST(ar.segments() == 2);
+        std::vector<message> v;
+        BOOST_TEST(ar.read(1, 0, 100, v) == 1);
+        BOOST_TEST(v.size() == 50);
+        BOOST_TEST(same(v, 1, 1));
+    }
+
+    void
+    testQuiet()
+    {
+        // A quiet room between the records of a busy one
+        temp_dir dir;
+        archive ar(dir.path.string(), segment_size);
+        beast::error_code ec;
+        ar.open(ec);
+        BOOST_TEST(! ec);
+        for(std::uint64_t seq = 1; seq <= 2000; ++seq)
+        {
+            append(ar, 2, seq);
+            if(seq % 100 == 0)
+                append(ar, 1, seq / 100);
+        }
+        ar.close();
+        BOOST_TEST(ar.segments() > 2);
+        std::vector<message> v;
+        BOOST_TEST(ar.read(1, 0, 5, v) == 16);
+        BOOST_TEST(v.size() == 5);
+        BOOST_TEST(same(v, 1, 16));
+        v.clear();
+        BOOST_TEST(ar.read(1, 3, 5, v) == 1);
+        BOOST_TEST(v.size() == 2);
+        BOOST_TEST(same(v, 1, 1));
+    }
+
+    void
+    run()
+    {
+        testReadWrite();
+        testCompact();
+        testExpire();
+        testDuplicates();
+        testQuiet();
+    }
+};
+
+std::size_t constexpr archive_test::segment_size;
+
+TEST_SUITE(archive_test, "lounge.server.archive");
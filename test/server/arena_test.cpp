@@ -0,0 +1,79 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/arena.hpp"
+
+#include <string>
+#include <vector>
+
+#include "test_suite.hpp"
+
+class arena_test
+{
+public:
+    void
+    testArena()
+    {
+        arena a(1024);
+        {
+            auto p1 = a.allocate(10, 1);
+            auto p2 = a.allocate(8, 8);
+            BOOST_TEST(reinterpret_cast<
+                std::uintptr_t>(p2) % 8 == 0);
+            BOOST_TEST(a.used() >= 18);
+
+            // too big, comes from the heap
+            auto p3 = a.allocate(2048, 1);
+            auto const used = a.used();
+            a.deallocate(p3);
+            BOOST_TEST(a.used() == used);
+
+            a.deallocate(p1);
+            BOOST_TEST(a.used() == used);
+            a.deallocate(p2);
+            BOOST_TEST(a.used() == 0);
+
+            // the buffer is reused from the start
+            BOOST_TEST(a.allocate(10, 1) == p1);
+            a.deallocate(p1);
+        }
+    }
+
+    void
+    testAllocator()
+    {
+        arena a(4096);
+        using string_type = std::basic_string<char,
+            std::char_traits<char>, arena_allocator<char>>;
+        {
+            std::vector<string_type,
+                arena_allocator<string_type>> v{
+                    arena_allocator<string_type>(a)};
+            for(int i = 0; i < 10; ++i)
+                v.emplace_back(std::string(100, 'x').c_str(),
+                    arena_allocator<char>(a));
+            BOOST_TEST(a.used() > 1000);
+            BOOST_TEST(v.back().size() == 100);
+            BOOST_TEST(
+                arena_allocator<char>(a) ==
+                arena_allocator<int>(a));
+        }
+        BOOST_TEST(a.used() == 0);
+    }
+
+    void
+    run()
+    {
+        testArena();
+        testAllocator();
+    }
+};
+
+TEST_SUITE(arena_test, "lounge.server.arena");
@@ -78,10 +78,51 @@ public:
         }
     }
 
+    // The totals kept while dealing match a full rescan
+    void
+    testIncremental()
+    {
+        shoe sh(6, 1);
+        bool same = true;
+        for(auto i = 0; i < 10000; ++i)
+        {
+            hand h;
+            while(! h.is_done())
+            {
+                h.deal(sh);
+                auto h2 = h;
+                h2.eval();
+                same &=
+                    h.total == h2.total &&
+                    h.soft == h2.soft &&
+                    h.busted == h2.busted &&
+                    h.twenty_one == h2.twenty_one &&
+                    h.blackjack == h2.blackjack;
+            }
+        }
+        BOOST_TEST(same);
+
+        hand h;
+        h.add(1);
+        h.add(6);
+        BOOST_TEST(h.is_soft_17());
+        h.add(10);
+        BOOST_TEST(! h.is_soft_17());
+        BOOST_TEST(h.total == 17);
+
+        h.clear();
+        h.add(8);
+        h.add(21);
+        BOOST_TEST(h.split() == 21);
+        BOOST_TEST(h.total == 8);
+        BOOST_TEST(h.cards.size() == 1);
+    }
+
     void
     run()
     {
         testHand();
+        testIncremental();
     }
 };
 
@@ -0,0 +1,125 @@
+//
+// Copyright (c) 2020 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "blackjack/random.hpp"
+
+#include "blackjack/game.hpp"
+#include "test_suite.hpp"
+#include <algorithm>
+#include <map>
+#include <vector>
+
+namespace blackjack {
+
+class blackjack_random_test
+{
+public:
+    void
+    testPcg32()
+    {
+        // From the reference implementation's demo
+        pcg32 g(42, 54);
+        BOOST_TEST(g() == 0xa15c02b7);
+        BOOST_TEST(g() == 0x7b47f409);
+        BOOST_TEST(g() == 0xba1d3330);
+    }
+
+    void
+    testBounded()
+    {
+        pcg32 g(1);
+        std::uint32_t counts[7] = {};
+        bool in_range = true;
+        for(int i = 0; i < 70000; ++i)
+        {
+            auto const v = bounded(g, 7);
+            in_range &= v < 7;
+            ++counts[v % 7];
+        }
+        BOOST_TEST(in_range);
+        for(auto n : counts)
+            BOOST_TEST(n > 9500 && n < 10500);
+    }
+
+    void
+    testShuffle()
+    {
+        pcg32 g(2);
+
+        // Every permutation of four is equally likely
+        std::map<std::vector<int>, int> seen;
+        for(int i = 0; i < 24000; ++i)
+        {
+            std::vector<int> v{1, 2, 3, 4};
+            shuffle(v.begin(), v.end(), g);
+            ++seen[v];
+        }
+        BOOST_TEST(seen.size() == 24);
+        for(auto const& e : seen)
+            BOOST_TEST(e.second > 850 && e.second < 1150);
+
+        // A batched shuffle is still a permutation
+        std::vector<int> v(416);
+        for(std::size_t i = 0; i < v.size(); ++i)
+            v[i] = static_cast<int>(i);
+        shuffle(v.begin(), v.end(), g);
+        auto w = v;
+        std::sort(w.begin(), w.end());
+        bool ordered = true;
+        for(std::size_t i = 0; i < w.size(); ++i)
+            ordered &= w[i] == static_cast<int>(i);
+        BOOST_TEST(ordered);
+        BOOST_TEST(v != w);
+
+        // Every position receives every value
+        std::vector<int> first(13);
+        for(int i = 0; i < 13000; ++i)
+        {
+            std::vector<int> u(13);
+            for(int j = 0; j < 13; ++j)
+                u[j] = j;
+            shuffle(u.begin(), u.end(), g);
+            ++first[u[0]];
+        }
+        for(auto n : first)
+            BOOST_TEST(n > 850 && n < 1150);
+    }
+
+    void
+    testReplay()
+    {
+        shoe a(6, 12345);
+        shoe b(6, 12345);
+        BOOST_TEST(a.seed() == 12345);
+        bool same = true;
+        for(int i = 0; i < 1000; ++i)
+            same &= a.deal() == b.deal();
+        BOOST_TEST(same);
+
+        shoe c(6, 12346);
+        bool differ = false;
+        for(int i = 0; i < 52; ++i)
+            differ |= a.deal() != c.deal();
+        BOOST_TEST(differ);
+    }
+
+    void
+    run()
+    {
+        testPcg32();
+        testBounded();
+        testShuffle();
+        testReplay();
+    }
+};
+
+TEST_SUITE(blackjack_random_test, "lounge.server.blackjack_random");
+
+} // blackjack
@@ -0,0 +1,116 @@
+//
+// Copyright (c) 2020 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "blackjack/simulator.hpp"
+
+#include "test_suite.hpp"
+
+namespace blackjack {
+
+class blackjack_simulator_test
+{
+public:
+    // Cards of the first suit, 1 is the ace
+    static
+    hand
+    make_hand(std::initializer_list<char> cards)
+    {
+        hand h;
+        for(auto c : cards)
+            h.add(c);
+        return h;
+    }
+
+    void
+    testEval()
+    {
+        auto h = make_hand({1, 6});
+        BOOST_TEST(h.total == 17);
+        BOOST_TEST(h.soft);
+        h = make_hand({1, 6, 10});
+        BOOST_TEST(h.total == 17);
+        BOOST_TEST(! h.soft);
+        h = make_hand({1, 1, 9});
+        BOOST_TEST(h.total == 21);
+        BOOST_TEST(h.soft);
+        BOOST_TEST(! h.blackjack);
+        h = make_hand({1, 13});
+        BOOST_TEST(h.blackjack);
+        h = make_hand({10, 12, 2});
+        BOOST_TEST(h.busted);
+    }
+
+    void
+    testStrategy()
+    {
+        rules r;
+        strategy const st(r);
+        auto const decide =
+            [&st](hand const& h, int up)
+            {
+                return st.decide(h, up, true, true, true);
+            };
+        BOOST_TEST(decide(make_hand({10, 6}), 10) == action::surrender);
+        BOOST_TEST(st.decide(make_hand({10, 6}), 10,
+            true, true, false) == action::hit);
+        BOOST_TEST(decide(make_hand({10, 2}), 4) == action::stand);
+        BOOST_TEST(decide(make_hand({5, 6}), 1) == action::hit);
+        BOOST_TEST(decide(make_hand({8, 8}), 10) == action::split);
+        BOOST_TEST(decide(make_hand({1, 1}), 1) == action::split);
+        BOOST_TEST(decide(make_hand({5, 5}), 9) == action::double_down);
+        BOOST_TEST(decide(make_hand({1, 7}), 4) == action::double_down);
+        BOOST_TEST(st.decide(make_hand({1, 7}), 4,
+            false, false, false) == action::stand);
+
+        r.hit_soft_17 = true;
+        r.double_after_split = false;
+        strategy const h17(r);
+        BOOST_TEST(h17.decide(make_hand({5, 6}), 1,
+            true, true, true) == action::double_down);
+        BOOST_TEST(h17.decide(make_hand({2, 2}), 2,
+            true, true, true) == action::hit);
+    }
+
+    void
+    testSimulate()
+    {
+        rules r;
+        auto const a = simulate(r, 200000, 2, 42);
+        auto const b = simulate(r, 200000, 2, 42);
+        BOOST_TEST(a.rounds == 200000);
+        BOOST_TEST(a.sum == b.sum);
+        BOOST_TEST(a.sum_sq == b.sum_sq);
+
+        // Six decks with these rules are about 0.4%,
+        // and the standard error here is about 0.26%.
+        BOOST_TEST(a.house_edge() > -0.02);
+        BOOST_TEST(a.house_edge() < 0.03);
+        BOOST_TEST(a.variance() > 1.1);
+        BOOST_TEST(a.variance() < 1.5);
+
+        // Paying 1:1 for a natural costs the player
+        // about 2.3%, far more than the noise.
+        r.blackjack_payout = 1;
+        auto const c = simulate(r, 200000, 2, 42);
+        BOOST_TEST(c.house_edge() > a.house_edge());
+    }
+
+    void
+    run()
+    {
+        testEval();
+        testStrategy();
+        testSimulate();
+    }
+};
+
+TEST_SUITE(blackjack_simulator_test, "lounge.server.blackjack_simulator");
+
+} // blackjack
@@ -0,0 +1,259 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/channel.hpp"
+
+#include "core/channel_list.hpp"
+#include "core/message.hpp"
+#include "core/metrics.hpp"
+#include "core/rpc.hpp"
+#include "core/rpc_stats.hpp"
+#include "core/user.hpp"
+#include "test_suite.hpp"
+#include <boost/make_shared.hpp>
+
+class channel_test
+{
+public:
+    class test_list : public channel_list
+    {
+        metrics metrics_;
+        ::rpc_stats rpc_stats_;
+        counter& rpc_errors_;
+
+    public:
+        test_list()
+            : rpc_stats_(metrics_)
+            , rpc_errors_(metrics_.make_counter(
+                "lounge_rpc_errors_total", ""))
+        {
+        }
+
+        uid_type
+        next_uid() noexcept override
+        {
+            return 1;
+        }
+
+        std::size_t
+        next_cid() noexcept override
+        {
+            return 1;
+        }
+
+        boost::shared_ptr<channel>
+        at(std::size_t) const override
+        {
+            return nullptr;
+        }
+
+        std::vector<boost::shared_ptr<channel>>
+        channels() const override
+        {
+            return {};
+        }
+
+        void
+        dispatch(rpc_call&) override
+        {
+        }
+
+        void
+        erase(channel const&) override
+        {
+        }
+
+        ::rpc_stats&
+        rpc_stats() noexcept override
+        {
+            return rpc_stats_;
+        }
+
+        counter&
+        rpc_errors() noexcept override
+        {
+            return rpc_errors_;
+        }
+
+        void
+        on_send(std::size_t, std::size_t) noexcept override
+        {
+        }
+
+    private:
+        void
+        insert(boost::shared_ptr<channel>) override
+        {
+        }
+    };
+
+    // Counts messages, with an adjustable backlog
+    class test_user : public user
+    {
+    public:
+        std::size_t received = 0;
+
+        void
+        on_stop() override
+        {
+        }
+
+        void
+        send(json::value const&) override
+        {
+            ++received;
+        }
+
+        void
+        send(message) override
+        {
+            ++received;
+        }
+
+        void
+        set_backlog(std::size_t n) noexcept
+        {
+            user::set_backlog(n);
+        }
+    };
+
+    class test_channel : public channel
+    {
+    public:
+        explicit
+        test_channel(channel_list& list)
+            : channel("test", list)
+        {
+            set_default_tier(tier::spectator);
+        }
+
+        beast::string_view
+        type() const noexcept override
+        {
+            return "test";
+        }
+
+    private:
+        void
+        on_insert(user&) override
+        {
+        }
+
+        void
+        on_erase(user&) override
+        {
+        }
+
+        void
+        on_dispatch(rpc_call&) override
+        {
+        }
+    };
+
+    static
+    message
+    snapshot()
+    {
+        return message(net::buffer("{}", 2));
+    }
+
+    void
+    testMembership()
+    {
+        // Spectators see players arrive and leave
+        test_list list;
+        test_channel c(list);
+        auto a = boost::make_shared<test_user>();
+        auto b = boost::make_shared<test_user>();
+        BOOST_TEST(c.insert(*a));
+        BOOST_TEST(c.insert(*b));
+        BOOST_TEST(a->received == 2);
+        BOOST_TEST(c.erase(*b));
+        BOOST_TEST(a->received == 3);
+        BOOST_TEST(b->received == 2);
+        BOOST_TEST(c.erase(*a));
+    }
+
+    void
+    testTiers()
+    {
+        test_list list;
+        test_channel c(list);
+        auto a = boost::make_shared<test_user>();
+        auto b = boost::make_shared<test_user>();
+        c.insert(*a);
+        c.insert(*b);
+        BOOST_TEST(c.set_tier(*b, channel::tier::live));
+        a->received = 0;
+        b->received = 0;
+
+        c.send_snapshot(snapshot());
+        BOOST_TEST(a->received == 1);
+        BOOST_TEST(b->received == 0);
+
+        c.send(snapshot());
+        BOOST_TEST(a->received == 2);
+        BOOST_TEST(b->received == 1);
+
+        BOOST_TEST(c.erase(*a));
+        BOOST_TEST(c.erase(*b));
+        BOOST_TEST(! c.set_tier(*a, channel::tier::live));
+    }
+
+    void
+    testBackoff()
+    {
+        test_list list;
+        test_channel c(list);
+        auto a = boost::make_shared<test_user>();
+        c.insert(*a);
+        a->received = 0;
+
+        // A connection which falls behind is sent
+        // one of every 2, 4, 8 and then 16 snapshots.
+        a->set_backlog(5);
+        for(int i = 0; i < 64; ++i)
+            c.send_snapshot(snapshot());
+        BOOST_TEST(a->received == 0);
+
+        // It is sent every snapshot after draining,
+        // once the skip steps back down.
+        a->set_backlog(0);
+        for(int i = 0; i < 16; ++i)
+            c.send_snapshot(snapshot());
+        BOOST_TEST(a->received == 5);
+        for(int i = 0; i < 16; ++i)
+            c.send_snapshot(snapshot());
+        BOOST_TEST(a->received == 21);
+
+        // A changed tier starts over at every snapshot
+        a->set_backlog(5);
+        for(int i = 0; i < 64; ++i)
+            c.send_snapshot(snapshot());
+        BOOST_TEST(c.set_tier(*a, channel::tier::spectator));
+        a->set_backlog(0);
+        a->received = 0;
+        for(int i = 0; i < 8; ++i)
+            c.send_snapshot(snapshot());
+        BOOST_TEST(a->received == 8);
+
+        BOOST_TEST(c.erase(*a));
+    }
+
+    void
+    run()
+    {
+        testMembership();
+        testTiers();
+        testBackoff();
+    }
+};
+
+TEST_SUITE(channel_test, "lounge.server.channel");
@@ -0,0 +1,119 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/history.hpp"
+
+#include "test_suite.hpp"
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <string>
+
+class history_test
+{
+public:
+    static
+    message
+    make(std::string const& s)
+    {
+        return message(net::const_buffer(s.data(), s.size()));
+    }
+
+    static
+    std::string
+    str(std::vector<message> const& v)
+    {
+        return beast::buffers_to_string(
+            make_batch("[", v, "]"));
+    }
+
+    void
+    testPage()
+    {
+        history h(4);
+        std::vector<message> v;
+        BOOST_TEST(h.first() == 0);
+        BOOST_TEST(h.page(0, 10, v) == 0);
+        BOOST_TEST(v.empty());
+
+        for(int i = 1; i <= 6; ++i)
+            BOOST_TEST(h.push(make(std::to_string(i))) ==
+                static_cast<std::uint64_t>(i));
+        BOOST_TEST(h.next() == 7);
+
+        // Only the last four are kept
+        BOOST_TEST(h.first() == 3);
+        BOOST_TEST(h.page(0, 10, v) == 3);
+        BOOST_TEST(str(v) == "[3,4,5,6]");
+
+        v.clear();
+        BOOST_TEST(h.page(0, 2, v) == 5);
+        BOOST_TEST(str(v) == "[5,6]");
+
+        // Paging back with the cursor
+        v.clear();
+        BOOST_TEST(h.page(5, 2, v) == 3);
+        BOOST_TEST(str(v) == "[3,4]");
+        v.clear();
+        BOOST_TEST(h.page(3, 2, v) == 0);
+        BOOST_TEST(v.empty());
+    }
+
+    void
+    testBatch()
+    {
+        // The stored buffers are shared, not copied
+        auto const m = make("{\"a\":1}");
+        history h(2);
+        h.push(m);
+        std::vector<message> v;
+        h.page(0, 1, v);
+        BOOST_TEST(v.front().begin()->data() == m.begin()->data());
+
+        v.push_back(make("{\"b\":2}"));
+        auto const b = make_batch(
+            "{\"messages\":[", v, "],\"next\":null}");
+        BOOST_TEST(beast::buffers_to_string(b) ==
+            "{\"messages\":[{\"a\":1},{\"b\":2}],\"next\":null}");
+        BOOST_TEST(beast::buffers_to_string(
+            make_batch("[", {}, "]")) == "[]");
+    }
+
+    void
+    testRestart()
+    {
+        history h(4);
+        h.push(make("1"));
+        h.push(make("2"));
+
+        // Numbers continue from those kept elsewhere
+        h.restart(100);
+        std::vector<message> v;
+        BOOST_TEST(h.first() == 0);
+        BOOST_TEST(h.next() == 101);
+        BOOST_TEST(h.page(0, 10, v) == 0);
+
+        BOOST_TEST(h.push(make("101")) == 101);
+        BOOST_TEST(h.push(make("102")) == 102);
+        BOOST_TEST(h.first() == 101);
+        BOOST_TEST(h.page(0, 10, v) == 101);
+        BOOST_TEST(str(v) == "[101,102]");
+        v.clear();
+        BOOST_TEST(h.page(101, 10, v) == 0);
+    }
+
+    void
+    run()
+    {
+        testPage();
+        testRestart();
+        testBatch();
+    }
+};
+
+TEST_SUITE(history_test, "lounge.server.history");
@@ -0,0 +1,161 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/http_conditional.hpp"
+
+#include "test_suite.hpp"
+
+class http_conditional_test
+{
+public:
+    void
+    testDate()
+    {
+        BOOST_TEST(format_http_date(0) ==
+            "Thu, 01 Jan 1970 00:00:00 GMT");
+        BOOST_TEST(format_http_date(784111777) ==
+            "Sun, 06 Nov 1994 08:49:37 GMT");
+        BOOST_TEST(format_http_date(951782400) ==
+            "Tue, 29 Feb 2000 00:00:00 GMT");
+
+        std::time_t t = 0;
+        BOOST_TEST(parse_http_date(
+            "Sun, 06 Nov 1994 08:49:37 GMT", t));
+        BOOST_TEST(t == 784111777);
+        BOOST_TEST(parse_http_date(
+            format_http_date(1577836799), t));
+        BOOST_TEST(t == 1577836799);
+
+        BOOST_TEST(! parse_http_date("", t));
+        BOOST_TEST(! parse_http_date(
+            "Sunday, 06-Nov-94 08:49:37 GMT", t));
+        BOOST_TEST(! parse_http_date(
+            "Sun, 06 Nov 1994 08:49:37 UTC", t));
+        BOOST_TEST(! parse_http_date(
+            "Sun, 06 Foo 1994 08:49:37 GMT", t));
+        BOOST_TEST(! parse_http_date(
+            "Sun, 06 Nov 1994 24:49:37 GMT", t));
+    }
+
+    void
+    testConditional()
+    {
+        auto const etag = make_etag(1234, 784111777);
+        BOOST_TEST(etag == "\"4d2-2ebc98a1\"");
+        BOOST_TEST(make_etag(1234, 784111777, "gzip") ==
+            "\"4d2-2ebc98a1-gzip\"");
+
+        auto const date = format_http_date(784111777);
+
+        BOOST_TEST(! is_not_modified("", "", etag, 784111777));
+        BOOST_TEST(is_not_modified(etag, "", etag, 784111777));
+        BOOST_TEST(is_not_modified("*", "", etag, 784111777));
+        BOOST_TEST(is_not_modified(
+            "\"x\" , W/" + etag, "", etag, 784111777));
+        BOOST_TEST(! is_not_modified("\"x\"", "", etag, 784111777));
+
+        BOOST_TEST(is_not_modified("", date, etag, 784111777));
+        BOOST_TEST(is_not_modified("", date, etag, 784111776));
+        BOOST_TEST(! is_not_modified("", date, etag, 784111778));
+        BOOST_TEST(! is_not_modified("", "garbage", etag, 784111777));
+
+        // If-None-Match takes precedence
+        BOOST_TEST(! is_not_modified("\"x\"", date, etag, 784111777));
+
+        BOOST_TEST(is_range_current("", etag, 784111777));
+        BOOST_TEST(is_range_current(etag, etag, 784111777));
+        BOOST_TEST(! is_range_current("W/" + etag, etag, 784111777));
+        BOOST_TEST(! is_range_current("\"x\"", etag, 784111777));
+        BOOST_TEST(is_range_current(date, etag, 784111777));
+        BOOST_TEST(! is_range_current(date, etag, 784111778));
+    }
+
+    void
+    testRange()
+    {
+        std::vector<byte_range> v;
+
+        auto const check =
+            [&v](beast::string_view field,
+                std::uint64_t size,
+                range_result result,
+                std::vector<byte_range> const& expected)
+            {
+                if(! BOOST_TEST(
+                    parse_range(field, size, v) == result))
+                    return;
+                if(result != range_result::satisfiable)
+                    return;
+                if(! BOOST_TEST(v.size() == expected.size()))
+                    return;
+                for(std::size_t i = 0; i < v.size(); ++i)
+                {
+                    BOOST_TEST(v[i].first == expected[i].first);
+                    BOOST_TEST(v[i].last == expected[i].last);
+                }
+            };
+
+        auto const ok = range_result::satisfiable;
+        auto const bad = range_result::unsatisfiable;
+        auto const ignore = range_result::ignore;
+
+        check("bytes=0-499", 1000, ok, {{0, 499}});
+        check("bytes=500-", 1000, ok, {{500, 999}});
+        check("bytes=-300", 1000, ok, {{700, 999}});
+        check("bytes=-3000", 1000, ok, {{0, 999}});
+        check("bytes=900-5000", 1000, ok, {{900, 999}});
+        check("BYTES=0-0", 1000, ok, {{0, 0}});
+        check("bytes=0-1, 10-19", 1000, ok, {{0, 1}, {10, 19}});
+
+        // coalescing
+        check("bytes=10-19,0-1", 1000, ok, {{0, 1}, {10, 19}});
+        check("bytes=0-499,100-600", 1000, ok, {{0, 600}});
+        check("bytes=0-9,10-19", 1000, ok, {{0, 19}});
+        check("bytes=0-,0-,0-", 1000, ok, {{0, 999}});
+
+        // unsatisfiable
+        check("bytes=1000-", 1000, bad, {});
+        check("bytes=-0", 1000, bad, {});
+        check("bytes=0-", 0, bad, {});
+        check("bytes=2000-3000, 1000-", 1000, bad, {});
+        check("bytes=2000-3000, 0-1", 1000, ok, {{0, 1}});
+
+        // invalid
+        check("", 1000, ignore, {});
+        check("bytes=", 1000, ignore, {});
+        check("items=0-1", 1000, ignore, {});
+        check("bytes=5-1", 1000, ignore, {});
+        check("bytes=a-1", 1000, ignore, {});
+        check("bytes=0-1x", 1000, ignore, {});
+        check("bytes=-", 1000, ignore, {});
+        check("bytes=99999999999999999999-", 1000, ignore, {});
+        check("bytes=0-0,2-2,4-4,6-6,8-8,10-10,12-12,14-14,"
+            "16-16,18-18,20-20,22-22,24-24,26-26,28-28,30-30,"
+            "32-32", 1000, ignore, {});
+
+        BOOST_TEST(content_range({0, 499}, 1000) ==
+            "bytes 0-499/1000");
+        BOOST_TEST(multipart_head("b", "text/plain", {0, 1}, 10) ==
+            "\r\n--b\r\nContent-Type: text/plain\r\n"
+            "Content-Range: bytes 0-1/10\r\n\r\n");
+        BOOST_TEST(multipart_tail("b") == "\r\n--b--\r\n");
+        BOOST_TEST(make_boundary() != make_boundary());
+    }
+
+    void
+    run()
+    {
+        testDate();
+        testConditional();
+        testRange();
+    }
+};
+
+TEST_SUITE(http_conditional_test, "lounge.server.http_conditional");
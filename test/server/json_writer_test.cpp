@@ -0,0 +1,83 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/json_writer.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <string>
+
+#include "test_suite.hpp"
+
+class json_writer_test
+{
+public:
+    void
+    testWriter()
+    {
+        std::string s;
+        json_writer w(s);
+        w.begin_array();
+        w.begin_object();
+        w.member("name", "lounge");
+        w.member("port", 8080);
+        w.member("tls", false);
+        w.key("list");
+        w.begin_array();
+        w.value(1);
+        w.null();
+        w.begin_array();
+        w.end_array();
+        w.end_array();
+        w.end_object();
+        w.begin_object();
+        w.end_object();
+        w.end_array();
+        BOOST_TEST(s ==
+            "[{\"name\":\"lounge\",\"port\":8080,\"tls\":false,"
+            "\"list\":[1,null,[]]},{}]");
+    }
+
+    void
+    testValues()
+    {
+        auto const check =
+            [](std::string const& expected, void(*f)(json_writer&))
+            {
+                std::string s;
+                json_writer w(s);
+                f(w);
+                BOOST_TEST(s == expected);
+            };
+
+        check("0", [](json_writer& w){ w.value(0); });
+        check("-1", [](json_writer& w){ w.value(-1); });
+        check("-9223372036854775808", [](json_writer& w){
+            w.value((std::numeric_limits<std::int64_t>::min)()); });
+        check("18446744073709551615", [](json_writer& w){
+            w.value((std::numeric_limits<std::uint64_t>::max)()); });
+        check("true", [](json_writer& w){ w.value(true); });
+        check("0.5", [](json_writer& w){ w.value(0.5); });
+        check("null", [](json_writer& w){
+            w.value(std::numeric_limits<double>::infinity()); });
+        check("\"a\\\"b\\\\c\\n\\u0001\"", [](json_writer& w){
+            w.value(beast::string_view("a\"b\\c\n\x01", 7)); });
+        check("\"\"", [](json_writer& w){ w.value(""); });
+    }
+
+    void
+    run()
+    {
+        testWriter();
+        testValues();
+    }
+};
+
+TEST_SUITE(json_writer_test, "lounge.server.json_writer");
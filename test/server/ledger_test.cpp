@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/ledger.hpp"
+
+#include "temp_dir.hpp"
+#include "test_suite.hpp"
+#include <boost/filesystem/operations.hpp>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace fs = boost::filesystem;
+
+class ledger_test
+{
+public:
+    void
+    testReplay()
+    {
+        temp_dir dir;
+        std::uint64_t seq;
+        {
+            ledger lg(dir.path.string());
+            beast::error_code ec;
+            lg.open(ec);
+            BOOST_TEST(! ec);
+            BOOST_TEST(lg.balance("alice") == 1000);
+            BOOST_TEST(lg.wager("alice", 100) == 900);
+            BOOST_TEST(lg.wager("alice", 2000) == -1);
+            BOOST_TEST(lg.settle("alice", 250) == 1150);
+            BOOST_TEST(lg.wager("bob", 1000) == 0);
+            seq = lg.sequence();
+            lg.close();
+            BOOST_TEST(lg.committed() == seq);
+        }
+        {
+            ledger lg(dir.path.string());
+            beast::error_code ec;
+            lg.open(ec);
+            BOOST_TEST(! ec);
+            BOOST_TEST(lg.sequence() == seq);
+            BOOST_TEST(lg.balance("alice") == 1150);
+            BOOST_TEST(lg.balance("bob") == 0);
+        }
+    }
+
+    void
+    testRotate()
+    {
+        // Each journal holds about a hundred records
+        temp_dir dir;
+        {
+            ledger lg(dir.path.string(), 4096);
+            beast::error_code ec;
+            lg.open(ec);
+            BOOST_TEST(! ec);
+            for(int i = 0; i < 2000; ++i)
+            {
+                lg.wager("player" + std::to_string(i % 10), 1);
+
+                // Give the commit thread time for snapshots
+                if(i % 100 == 99)
+                    std::this_thread::sleep_for(
+                        std::chrono::milliseconds(10));
+            }
+            BOOST_TEST(lg.snapshots() > 0);
+        }
+        ledger lg(dir.path.string(), 4096);
+        beast::error_code ec;
+        lg.open(ec);
+        BOOST_TEST(! ec);
+        bool same = true;
+        for(int i = 0; i < 10; ++i)
+            same &= lg.balance(
+                "player" + std::to_string(i)) == 800;
+        BOOST_TEST(same);
+    }
+
+    void
+    testTorn()
+    {
+        temp_dir dir;
+        {
+            ledger lg(dir.path.string(), 4096);
+            beast::error_code ec;
+            lg.open(ec);
+            BOOST_TEST(! ec);
+            lg.wager("alice", 10);
+            lg.wager("alice", 10);
+            lg.wager("alice", 10);
+        }
+
+        // Damage the last record, as a crash during the write would
+        for(fs::directory_iterator it(dir.path), end; it != end; ++it)
+        {
+            auto const name = it->path().filename().string();
+            if(name.compare(0, 8, "journal.") != 0)
+                continue;
+            std::vector<char> buf;
+            {
+                std::ifstream f(it->path().string(), std::ios::binary);
+                buf.assign(
+                    std::istreambuf_iterator<char>(f),
+                    std::istreambuf_iterator<char>());
+            }
+            auto n = buf.size();
+            while(n > 0 && buf[n - 1] == 0)
+                --n;
+            if(n <= 32)
+                continue;
+            buf[n - 1] ^= 1;
+            std::ofstream f(it->path().string(),
+                std::ios::binary | std::ios::trunc);
+            f.write(buf.data(), buf.size());
+        }
+
+        ledger lg(dir.path.string(), 4096);
+        beast::error_code ec;
+        lg.open(ec);
+        BOOST_TEST(! ec);
+        BOOST_TEST(lg.balance("alice") == 980);
+    }
+
+    void
+    run()
+    {
+        testReplay();
+        testRotate();
+        testTorn();
+    }
+};
+
+TEST_SUITE(ledger_test, "lounge.server.ledger");
@@ -24,6 +24,8 @@ public:
         auto m = message(cb);
         BOOST_TEST(
             beast::buffer_bytes(m) == cb.size());
+        BOOST_TEST(m.size() == cb.size());
+        BOOST_TEST(message().size() == 0);
         BOOST_TEST(
             beast::buffers_to_string(m) ==
                 "Hello, world!");
@@ -0,0 +1,151 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/metrics.hpp"
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "test_suite.hpp"
+
+class metrics_test
+{
+public:
+    void
+    testCounter()
+    {
+        counter c;
+        BOOST_TEST(c.value() == 0);
+        c.inc();
+        c.inc(41);
+        BOOST_TEST(c.value() == 42);
+
+        // Every thread records into its own shard
+        std::vector<std::thread> vt;
+        for(int i = 0; i < 8; ++i)
+            vt.emplace_back(
+                [&c]
+                {
+                    for(int j = 0; j < 1000; ++j)
+                        c.inc();
+                });
+        for(auto& t : vt)
+            t.join();
+        BOOST_TEST(c.value() == 8042);
+    }
+
+    void
+    testGauge()
+    {
+        gauge g;
+        g.add(5);
+        g.sub(7);
+        BOOST_TEST(g.value() == -2);
+    }
+
+    void
+    testHistogram()
+    {
+        histogram h({10, 100});
+        h.observe(0);
+        h.observe(10);
+        h.observe(11);
+        h.observe(1000);
+        auto const v = h.counts();
+        BOOST_TEST(v.size() == 3);
+        BOOST_TEST(v[0] == 2);
+        BOOST_TEST(v[1] == 1);
+        BOOST_TEST(v[2] == 1);
+        BOOST_TEST(h.sum() == 1021);
+    }
+
+    void
+    testQuantile()
+    {
+        histogram h({1, 2, 4, 8});
+        BOOST_TEST(h.quantile(0.5) == 0);
+        for(std::uint64_t i = 1; i <= 8; ++i)
+            h.observe(i);
+        BOOST_TEST(h.quantile(0) == 1);
+        BOOST_TEST(h.quantile(0.25) == 2);
+        BOOST_TEST(h.quantile(0.5) == 4);
+        BOOST_TEST(h.quantile(1) == 8);
+        h.observe(100);
+        BOOST_TEST(h.quantile(1) == 8);
+    }
+
+    void
+    testBounds()
+    {
+        auto const v = log_linear_bounds(32, 4);
+        std::vector<std::uint64_t> const e = {
+            1, 2, 3, 4, 5, 6, 7, 8,
+            10, 12, 14, 16, 20, 24, 28, 32 };
+        BOOST_TEST(v == e);
+        BOOST_TEST(log_linear_bounds(1000, 8).back() >= 1000);
+    }
+
+    void
+    testRegistry()
+    {
+        metrics m;
+        auto& c1 = m.make_counter("x_total", "Things", "a=\"1\"");
+        auto& c2 = m.make_counter("x_total", "Things", "a=\"2\"");
+        BOOST_TEST(&c1 != &c2);
+        BOOST_TEST(&m.make_counter("x_total", "", "a=\"1\"") == &c1);
+        bool threw = false;
+        try
+        {
+            m.make_gauge("x_total", "Things");
+        }
+        catch(std::invalid_argument const&)
+        {
+            threw = true;
+        }
+        BOOST_TEST(threw);
+
+        c1.inc(3);
+        m.make_gauge("g", "A gauge").add(-1);
+        m.make_histogram("h", "Sizes", {1, 2}).observe(2);
+
+        std::string s;
+        m.write(s);
+        BOOST_TEST(s ==
+            "# HELP g A gauge\n"
+            "# TYPE g gauge\n"
+            "g -1\n"
+            "# HELP h Sizes\n"
+            "# TYPE h histogram\n"
+            "h_bucket{le=\"1\"} 0\n"
+            "h_bucket{le=\"2\"} 1\n"
+            "h_bucket{le=\"+Inf\"} 1\n"
+            "h_sum 2\n"
+            "h_count 1\n"
+            "# HELP x_total Things\n"
+            "# TYPE x_total counter\n"
+            "x_total{a=\"1\"} 3\n"
+            "x_total{a=\"2\"} 0\n");
+    }
+
+    void
+    run()
+    {
+        testCounter();
+        testGauge();
+        testHistogram();
+        testQuantile();
+        testBounds();
+        testRegistry();
+    }
+};
+
+TEST_SUITE(metrics_test, "lounge.server.metrics");
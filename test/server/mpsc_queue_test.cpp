@@ -0,0 +1,96 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/mpsc_queue.hpp"
+
+#include "test_suite.hpp"
+#include <thread>
+#include <vector>
+
+class mpsc_queue_test
+{
+public:
+    struct item : mpsc_node
+    {
+        int producer;
+        int value;
+    };
+
+    void
+    testOrder()
+    {
+        item v[3];
+        mpsc_queue<item> q;
+        BOOST_TEST(q.pop() == nullptr);
+        for(int i = 0; i < 3; ++i)
+        {
+            v[i].value = i;
+            q.push(&v[i]);
+        }
+        BOOST_TEST(q.pop() == &v[0]);
+        BOOST_TEST(q.pop() == &v[1]);
+        q.push(&v[0]);
+        BOOST_TEST(q.pop() == &v[2]);
+        BOOST_TEST(q.pop() == &v[0]);
+        BOOST_TEST(q.pop() == nullptr);
+    }
+
+    void
+    testThreads()
+    {
+        int const producers = 4;
+        int const count = 10000;
+        std::vector<item> v(producers * count);
+        mpsc_queue<item> q;
+        std::vector<std::thread> vt;
+        for(int p = 0; p < producers; ++p)
+            vt.emplace_back(
+                [&v, &q, p, count]
+                {
+                    for(int i = 0; i < count; ++i)
+                    {
+                        auto& e = v[p * count + i];
+                        e.producer = p;
+                        e.value = i;
+                        q.push(&e);
+                    }
+                });
+
+        // Each producer's items arrive in order
+        std::vector<int> next(producers, 0);
+        int n = 0;
+        bool ordered = true;
+        while(n < producers * count)
+        {
+            auto const e = q.pop();
+            if(! e)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            if(e->value != next[e->producer]++)
+                ordered = false;
+            ++n;
+        }
+        for(auto& t : vt)
+            t.join();
+        BOOST_TEST(ordered);
+        BOOST_TEST(q.pop() == nullptr);
+    }
+
+    void
+    run()
+    {
+        testOrder();
+        testThreads();
+    }
+};
+
+TEST_SUITE(mpsc_queue_test, "lounge.server.mpsc_queue");
@@ -0,0 +1,199 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/listener.hpp"
+
+#include "core/logger.hpp"
+#include "core/server.hpp"
+#include "temp_dir.hpp"
+#include "test_suite.hpp"
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <boost/beast/core/flat_buffer.hpp>
+#include <boost/beast/http/empty_body.hpp>
+#include <boost/beast/http/read.hpp>
+#include <boost/beast/http/string_body.hpp>
+#include <boost/beast/http/write.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#include <boost/asio/io_context.hpp>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <thread>
+
+extern
+std::unique_ptr<logger>
+make_logger();
+
+extern
+std::unique_ptr<server>
+make_server(
+    char const* config_path,
+    std::unique_ptr<logger> log);
+
+class pipe_listener_test
+{
+public:
+    // A server with only a pipe listener,
+    // running on a thread of its own.
+    struct test_server
+    {
+        temp_dir dir;
+        std::unique_ptr<server> srv;
+        pipe_listener* lst = nullptr;
+        std::thread t;
+
+        test_server()
+        {
+            boost::filesystem::create_directories(dir.path);
+            auto const root = dir.path.string();
+            auto const path = root + "/config.json";
+            {
+                std::ofstream f(path);
+                f <<
+                    "{\"listeners\":[],"
+                    "\"server\":{"
+                        "\"threads\":1,"
+                        "\"doc-root\":\"" << root << "\","
+                        "\"ledger-path\":\"" << root << "/ledger\","
+                        "\"archive\":{\"path\":\"" <<
+                            root << "/archive\",\"days\":1}},"
+                    "\"log\":{\"path\":\"" << root <<
+                        "/log.txt\",\"level\":\"warning\"}}";
+            }
+            srv = make_server(path.c_str(), make_logger());
+            if(! srv)
+                return;
+            lst = &run_pipe_listener(*srv, "test");
+            t = std::thread(
+                [this]
+                {
+                    srv->run();
+                });
+        }
+
+        ~test_server()
+        {
+            if(! srv)
+                return;
+            srv->stop();
+            t.join();
+        }
+    };
+
+    net::io_context ioc_;
+
+    pipe_stream
+    connect(pipe_listener& lst)
+    {
+        return lst.connect(
+            net::make_strand(ioc_.get_executor()));
+    }
+
+    void
+    testHttp(pipe_listener& lst)
+    {
+        auto s = connect(lst);
+        http::request<http::empty_body> req(
+            http::verb::get, "/metrics", 11);
+        req.set(http::field::host, "test");
+        http::response<http::string_body> res;
+        beast::flat_buffer b;
+        beast::error_code ec1, ec2;
+        http::async_write(s, req,
+            [&](beast::error_code ec, std::size_t)
+            {
+                ec1 = ec;
+                if(ec)
+                    return;
+                http::async_read(s, b, res,
+                    [&](beast::error_code ec, std::size_t)
+                    {
+                        ec2 = ec;
+                    });
+            });
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(! ec1);
+        BOOST_TEST(! ec2);
+        BOOST_TEST(res.result() == http::status::ok);
+        BOOST_TEST(res.body().find(
+            "lounge_connections_total{listener=\"test\"}") !=
+                std::string::npos);
+    }
+
+    void
+    testIdentify(pipe_listener& lst)
+    {
+        websocket::stream<pipe_stream> ws(connect(lst));
+        beast::flat_buffer b;
+        std::string reply;
+        beast::error_code result;
+        std::string const req =
+            "{\"jsonrpc\":\"2.0\",\"method\":\"identify\","
+            "\"params\":{\"cid\":1,\"name\":\"pipe\"},\"id\":1}";
+
+        // Broadcasts may arrive before the response
+        std::function<void()> read =
+            [&]
+            {
+                ws.async_read(b,
+                    [&](beast::error_code ec, std::size_t)
+                    {
+                        if(ec)
+                        {
+                            result = ec;
+                            return;
+                        }
+                        auto s = beast::buffers_to_string(b.data());
+                        b.consume(b.size());
+                        if(s.find("\"id\":1") == std::string::npos)
+                            return read();
+                        reply = std::move(s);
+                    });
+            };
+        ws.async_handshake("test", "/",
+            [&](beast::error_code ec)
+            {
+                if(ec)
+                {
+                    result = ec;
+                    return;
+                }
+                ws.async_write(net::buffer(req),
+                    [&](beast::error_code ec, std::size_t)
+                    {
+                        if(ec)
+                        {
+                            result = ec;
+                            return;
+                        }
+                        read();
+                    });
+            });
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(! result);
+        BOOST_TEST(reply.find("\"result\"") != std::string::npos);
+        BOOST_TEST(reply.find("\"error\"") == std::string::npos);
+    }
+
+    void
+    run()
+    {
+        test_server ts;
+        BOOST_TEST(ts.srv != nullptr);
+        if(! ts.srv)
+            return;
+        testHttp(*ts.lst);
+        testIdentify(*ts.lst);
+    }
+};
+
+TEST_SUITE(pipe_listener_test, "lounge.server.pipe_listener");
@@ -0,0 +1,197 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/pipe_stream.hpp"
+
+#include "test_suite.hpp"
+#include <boost/beast/core/buffers_to_string.hpp>
+#include <boost/beast/websocket/stream.hpp>
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+#include <string>
+
+class pipe_stream_test
+{
+public:
+    net::io_context ioc_;
+
+    std::pair<pipe_stream, pipe_stream>
+    make()
+    {
+        return make_pipe(
+            net::make_strand(ioc_.get_executor()),
+            net::make_strand(ioc_.get_executor()));
+    }
+
+    void
+    testReadWrite()
+    {
+        auto p = make();
+        char buf[16];
+        beast::error_code ec1, ec2;
+        std::size_t n1 = 0, n2 = 0;
+        net::async_write(p.first, net::buffer("hello", 5),
+            [&](beast::error_code ec, std::size_t n)
+            {
+                ec1 = ec;
+                n1 = n;
+            });
+        net::async_read(p.second, net::buffer(buf, 5),
+            [&](beast::error_code ec, std::size_t n)
+            {
+                ec2 = ec;
+                n2 = n;
+            });
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(! ec1);
+        BOOST_TEST(! ec2);
+        BOOST_TEST(n1 == 5);
+        BOOST_TEST(n2 == 5);
+        BOOST_TEST(std::string(buf, n2) == "hello");
+
+        // A read waits for the write
+        n2 = 0;
+        p.second.async_read_some(net::buffer(buf),
+            [&](beast::error_code ec, std::size_t n)
+            {
+                ec2 = ec;
+                n2 = n;
+            });
+        ioc_.poll();
+        ioc_.restart();
+        BOOST_TEST(n2 == 0);
+        net::async_write(p.first, net::buffer("world", 5),
+            [](beast::error_code, std::size_t)
+            {
+            });
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(! ec2);
+        BOOST_TEST(std::string(buf, n2) == "world");
+    }
+
+    void
+    testEof()
+    {
+        auto p = make();
+        char buf[16];
+        beast::error_code ec1;
+        std::size_t n1 = 0;
+        p.first.shutdown_send();
+        p.second.async_read_some(net::buffer(buf),
+            [&](beast::error_code ec, std::size_t n)
+            {
+                ec1 = ec;
+                n1 = n;
+            });
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(ec1 == net::error::eof);
+        BOOST_TEST(n1 == 0);
+        BOOST_TEST(p.first.is_open());
+    }
+
+    void
+    testClose()
+    {
+        auto p = make();
+        char buf[16];
+        beast::error_code ec1, ec2, ec3;
+        p.first.async_read_some(net::buffer(buf),
+            [&](beast::error_code ec, std::size_t)
+            {
+                ec1 = ec;
+            });
+        p.second.async_read_some(net::buffer(buf),
+            [&](beast::error_code ec, std::size_t)
+            {
+                ec2 = ec;
+            });
+        p.first.close();
+        BOOST_TEST(! p.first.is_open());
+        p.second.async_write_some(net::buffer("x", 1),
+            [&](beast::error_code ec, std::size_t)
+            {
+                ec3 = ec;
+            });
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(ec1 == net::error::operation_aborted);
+        BOOST_TEST(ec2 == net::error::eof);
+        BOOST_TEST(ec3 == net::error::broken_pipe);
+    }
+
+    void
+    testWebSocket()
+    {
+        auto p = make();
+        websocket::stream<pipe_stream> client(std::move(p.first));
+        websocket::stream<pipe_stream> server(std::move(p.second));
+        beast::flat_buffer b;
+        std::string received;
+        beast::error_code ec1, ec2;
+        server.async_accept(
+            [&](beast::error_code ec)
+            {
+                if(ec)
+                    return;
+                server.async_read(b,
+                    [&](beast::error_code ec, std::size_t)
+                    {
+                        if(ec)
+                            return;
+                        received = beast::buffers_to_string(b.data());
+
+                        // Answers the close frame
+                        server.async_read(b,
+                            [&](beast::error_code ec, std::size_t)
+                            {
+                                ec2 = ec;
+                            });
+                    });
+            });
+        client.async_handshake("localhost", "/",
+            [&](beast::error_code ec)
+            {
+                if(ec)
+                    return;
+                client.async_write(net::buffer("ping", 4),
+                    [&](beast::error_code ec, std::size_t)
+                    {
+                        if(ec)
+                            return;
+                        client.async_close(
+                            websocket::close_code::normal,
+                            [&](beast::error_code ec)
+                            {
+                                ec1 = ec;
+                            });
+                    });
+            });
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(received == "ping");
+        BOOST_TEST(! ec1);
+        BOOST_TEST(ec2 == websocket::error::closed);
+    }
+
+    void
+    run()
+    {
+        testReadWrite();
+        testEof();
+        testClose();
+        testWebSocket();
+    }
+};
+
+TEST_SUITE(pipe_stream_test, "lounge.server.pipe_stream");
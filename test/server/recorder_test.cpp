@@ -0,0 +1,110 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/recorder.hpp"
+
+#include "test_suite.hpp"
+#include <sstream>
+#include <thread>
+
+class recorder_test
+{
+public:
+    void
+    testAdd()
+    {
+        int x;
+        recorder r(8);
+        r.add(trace_event::accept, &x);
+        r.add(trace_event::dispatch, &x, 5);
+        r.add(trace_event::close, &x);
+        auto const v = r.events(std::chrono::seconds(10));
+        BOOST_TEST(v.size() == 3);
+        BOOST_TEST(v[0].event ==
+            static_cast<std::uint8_t>(trace_event::accept));
+        BOOST_TEST(v[1].event ==
+            static_cast<std::uint8_t>(trace_event::dispatch));
+        BOOST_TEST(v[1].cid == 5);
+        BOOST_TEST(v[1].session ==
+            reinterpret_cast<std::uintptr_t>(&x));
+        BOOST_TEST(v[0].time <= v[1].time);
+        BOOST_TEST(v[1].time <= v[2].time);
+    }
+
+    void
+    testWrap()
+    {
+        recorder r(4);
+        for(std::size_t i = 0; i < 10; ++i)
+            r.add(trace_event::read, nullptr, i);
+        auto const v = r.events(std::chrono::seconds(10));
+        BOOST_TEST(v.size() == 4);
+        BOOST_TEST(v.front().cid == 6);
+        BOOST_TEST(v.back().cid == 9);
+    }
+
+    void
+    testDisable()
+    {
+        recorder r(4);
+        r.enable(false);
+        r.add(trace_event::read, nullptr);
+        BOOST_TEST(r.events(std::chrono::seconds(10)).empty());
+        r.enable(true);
+        r.add(trace_event::read, nullptr);
+        BOOST_TEST(r.events(std::chrono::seconds(10)).size() == 1);
+    }
+
+    void
+    testThreads()
+    {
+        recorder r(64);
+        r.add(trace_event::accept, nullptr);
+        std::thread t(
+            [&r]
+            {
+                r.add(trace_event::write, nullptr);
+                r.add(trace_event::write, nullptr);
+            });
+        t.join();
+        auto const v = r.events(std::chrono::seconds(10));
+        BOOST_TEST(v.size() == 3);
+        std::size_t n = 0;
+        for(auto const& e : v)
+            if(e.thread != v[0].thread)
+                ++n;
+        BOOST_TEST(n == 2);
+    }
+
+    void
+    testDump()
+    {
+        recorder r(8);
+        r.add(trace_event::enqueue, nullptr, 3);
+        r.add(trace_event::write, nullptr, 3);
+        std::ostringstream os;
+        BOOST_TEST(r.dump(os, std::chrono::seconds(10)) == 2);
+        auto const s = os.str();
+        BOOST_TEST(s.size() == 8 + 2 * sizeof(recorder::record));
+        BOOST_TEST(s.compare(0, 8, "LNGFR001") == 0);
+    }
+
+    void
+    run()
+    {
+        testAdd();
+        testWrap();
+        testDisable();
+        testThreads();
+        testDump();
+    }
+};
+
+TEST_SUITE(recorder_test, "lounge.server.recorder");
@@ -0,0 +1,150 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/router.hpp"
+
+#include <stdexcept>
+#include <string>
+
+#include "test_suite.hpp"
+
+class router_test
+{
+public:
+    static
+    router::handler_type
+    make_handler(std::string name)
+    {
+        return
+            [name](route_request const&, route_response& res)
+            {
+                res.body = name;
+            };
+    }
+
+    // Returns the name of the matched handler, or the result
+    static
+    std::string
+    match(
+        router const& r,
+        beast::string_view path,
+        route_request& req,
+        http::verb method = http::verb::get)
+    {
+        req.method = method;
+        req.path = path;
+        router::handler_type const* h = nullptr;
+        switch(r.match(req, h))
+        {
+        case router::match_result::not_found:
+            return "404";
+        case router::match_result::method_not_allowed:
+            return "405";
+        default:
+            break;
+        }
+        std::string s;
+        route_response res(s);
+        (*h)(req, res);
+        return s;
+    }
+
+    void
+    testMatch()
+    {
+        router r;
+        r.insert(http::verb::get, "/", make_handler("root"));
+        r.insert(http::verb::get, "/api/http", make_handler("http"));
+        r.insert(http::verb::get, "/api/channels", make_handler("list"));
+        r.insert(http::verb::get, "/api/channels/{cid}", make_handler("one"));
+        r.insert(http::verb::get, "/api/channels/top", make_handler("top"));
+        r.insert(http::verb::post, "/api/channels/{cid}", make_handler("post"));
+        r.insert(http::verb::get,
+            "/api/channels/{cid}/users/{uid}", make_handler("user"));
+
+        route_request req;
+        BOOST_TEST(match(r, "/", req) == "root");
+        BOOST_TEST(match(r, "/api/http", req) == "http");
+        BOOST_TEST(req.params.size() == 0);
+        BOOST_TEST(match(r, "/api", req) == "404");
+        BOOST_TEST(match(r, "/api/", req) == "404");
+        BOOST_TEST(match(r, "/api/http/", req) == "404");
+        BOOST_TEST(match(r, "/api/https", req) == "404");
+        BOOST_TEST(match(r, "api/http", req) == "404");
+        BOOST_TEST(match(r, "", req) == "404");
+        BOOST_TEST(match(r, "/api/http", req,
+            http::verb::delete_) == "405");
+        BOOST_TEST(req.allow == "GET");
+
+        BOOST_TEST(match(r, "/api/channels", req) == "list");
+        BOOST_TEST(match(r, "/api/channels/", req) == "404");
+        BOOST_TEST(match(r, "/api/channels/42", req) == "one");
+        BOOST_TEST(req.params.size() == 1);
+        BOOST_TEST(req.params["cid"] == "42");
+        BOOST_TEST(req.params["uid"] == "");
+        BOOST_TEST(match(r, "/api/channels/42", req,
+            http::verb::post) == "post");
+        BOOST_TEST(match(r, "/api/channels/42", req,
+            http::verb::put) == "405");
+        BOOST_TEST(req.allow == "GET, POST");
+
+        // literals take precedence
+        BOOST_TEST(match(r, "/api/channels/top", req) == "top");
+        BOOST_TEST(req.params.size() == 0);
+
+        // backtrack from a literal into a capture
+        BOOST_TEST(match(r, "/api/channels/top/users/7", req) == "user");
+        BOOST_TEST(req.params.size() == 2);
+        BOOST_TEST(req.params["cid"] == "top");
+        BOOST_TEST(req.params["uid"] == "7");
+        BOOST_TEST(match(r, "/api/channels/1/users", req) == "404");
+        BOOST_TEST(req.params.size() == 0);
+        BOOST_TEST(req.allow.empty());
+    }
+
+    void
+    testInsert()
+    {
+        auto const fails =
+            [](beast::string_view pattern)
+            {
+                router r;
+                r.insert(http::verb::get, "/a/{x}", make_handler(""));
+                try
+                {
+                    r.insert(http::verb::get, pattern, make_handler(""));
+                }
+                catch(std::invalid_argument const&)
+                {
+                    return true;
+                }
+                return false;
+            };
+
+        BOOST_TEST(fails(""));
+        BOOST_TEST(fails("a"));
+        BOOST_TEST(fails("/a/{x}"));
+        BOOST_TEST(fails("/a/{y}/b"));
+        BOOST_TEST(fails("/{}"));
+        BOOST_TEST(fails("/a{b}"));
+        BOOST_TEST(fails("/{a}/{b}/{c}/{d}/{e}"));
+        BOOST_TEST(! fails("/a/{x}/b"));
+        BOOST_TEST(! fails("/{a}/{b}/{c}/{d}"));
+    }
+
+    void
+    run()
+    {
+        testMatch();
+        testInsert();
+    }
+};
+
+TEST_SUITE(router_test, "lounge.server.router");
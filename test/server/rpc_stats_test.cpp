@@ -0,0 +1,63 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/rpc_stats.hpp"
+
+#include "core/metrics.hpp"
+#include "test_suite.hpp"
+
+class rpc_stats_test
+{
+public:
+    using clock_type = rpc_stats::clock_type;
+
+    void
+    testRecord()
+    {
+        metrics m;
+        rpc_stats st(m);
+        BOOST_TEST(st.summaries().empty());
+
+        auto const t0 = clock_type::now();
+        for(int i = 0; i < 100; ++i)
+            st.record("blackjack", "bet", t0,
+                t0 + std::chrono::microseconds(10),
+                t0 + std::chrono::microseconds(110));
+        st.record("room", "say", t0, t0, t0);
+
+        auto const v = st.summaries();
+        BOOST_TEST(v.size() == 2);
+        BOOST_TEST(v[0].channel == "blackjack");
+        BOOST_TEST(v[0].method == "bet");
+        BOOST_TEST(v[0].count == 100);
+        BOOST_TEST(v[0].queue[0] == 10);
+        BOOST_TEST(v[0].run[0] >= 100);
+        BOOST_TEST(v[0].run[2] <= 113);
+        BOOST_TEST(v[1].channel == "room");
+        BOOST_TEST(v[1].count == 1);
+        BOOST_TEST(v[1].run[0] == 1);
+
+        // The histograms are published
+        std::string s;
+        m.write(s);
+        BOOST_TEST(s.find(
+            "lounge_rpc_run_microseconds_count"
+            "{channel=\"blackjack\",method=\"bet\"} 100") !=
+                std::string::npos);
+    }
+
+    void
+    run()
+    {
+        testRecord();
+    }
+};
+
+TEST_SUITE(rpc_stats_test, "lounge.server.rpc_stats");
@@ -0,0 +1,82 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/stake.hpp"
+
+#include "temp_dir.hpp"
+#include "test_suite.hpp"
+
+class stake_test
+{
+public:
+    void
+    testLeave()
+    {
+        // Betting then leaving gives every chip back
+        temp_dir dir;
+        {
+            ledger lg(dir.path.string(), 4096);
+            beast::error_code ec;
+            lg.open(ec);
+            BOOST_TEST(! ec);
+            for(int i = 0; i < 500; ++i)
+            {
+                stake st;
+                st.sit(lg, "alice");
+                BOOST_TEST(st.bet(5));
+                BOOST_TEST(st.bet(5));
+                BOOST_TEST(st.chips() == 990);
+                BOOST_TEST(st.wager() == 10);
+                st.refund();
+                BOOST_TEST(st.wager() == 0);
+                BOOST_TEST(st.chips() == 1000);
+            }
+        }
+        ledger lg(dir.path.string(), 4096);
+        beast::error_code ec;
+        lg.open(ec);
+        BOOST_TEST(! ec);
+        BOOST_TEST(lg.balance("alice") == 1000);
+    }
+
+    void
+    testSettle()
+    {
+        temp_dir dir;
+        ledger lg(dir.path.string(), 4096);
+        beast::error_code ec;
+        lg.open(ec);
+        BOOST_TEST(! ec);
+        stake st;
+        st.sit(lg, "bob");
+        BOOST_TEST(! st.bet(2000));
+        BOOST_TEST(st.wager() == 0);
+
+        // A win pays twice the wager
+        BOOST_TEST(st.bet(100));
+        st.settle(200);
+        BOOST_TEST(st.chips() == 1100);
+
+        // A loss pays nothing
+        BOOST_TEST(st.bet(100));
+        st.settle(0);
+        BOOST_TEST(st.chips() == 1000);
+        BOOST_TEST(lg.balance("bob") == 1000);
+    }
+
+    void
+    run()
+    {
+        testLeave();
+        testSettle();
+    }
+};
+
+TEST_SUITE(stake_test, "lounge.server.stake");
@@ -0,0 +1,34 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+#ifndef LOUNGE_TEST_TEMP_DIR_HPP
+#define LOUNGE_TEST_TEMP_DIR_HPP
+
+#include <boost/filesystem/operations.hpp>
+#include <boost/system/error_code.hpp>
+
+/// A directory which is removed afterwards
+struct temp_dir
+{
+    boost::filesystem::path path;
+
+    temp_dir()
+        : path(boost::filesystem::temp_directory_path() /
+            boost::filesystem::unique_path("lounge-%%%%-%%%%"))
+    {
+    }
+
+    ~temp_dir()
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(path, ec);
+    }
+};
+
+#endif
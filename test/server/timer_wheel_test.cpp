@@ -0,0 +1,121 @@
+//
+// Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+//
+// Distributed under the Boost Software License, Version 1.0. (See accompanying
+// file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+//
+// Official repository: https://github.com/vinniefalco/BeastLounge
+//
+
+// Test that header file is self-contained.
+#include "core/timer_wheel.hpp"
+
+#include "test_suite.hpp"
+#include <boost/asio/io_context.hpp>
+#include <string>
+
+class timer_wheel_test
+{
+public:
+    using clock_type = timer_wheel::clock_type;
+    using ms = std::chrono::milliseconds;
+
+    net::io_context ioc_;
+
+    void
+    start(timer_wheel& w)
+    {
+        w.start(
+            [this]
+            {
+                return net::make_strand(ioc_.get_executor());
+            });
+    }
+
+    void
+    testOrder()
+    {
+        timer_wheel w(2, ms(1));
+        start(w);
+        std::string s;
+        wheel_timer t1(w), t2(w), t3(w), t4(w);
+        auto const t0 = clock_type::now();
+        bool early = false;
+        auto const fire =
+            [&](char c, ms after)
+            {
+                return [&, c, after]
+                {
+                    early |= clock_type::now() - t0 < after;
+                    s.push_back(c);
+                };
+            };
+        t1.expires_after(ms(30), fire('c', ms(30)));
+        t2.expires_after(ms(10), fire('a', ms(10)));
+        t3.expires_after(ms(20), fire('b', ms(20)));
+
+        // Beyond the first wheel
+        t4.expires_after(ms(150), fire('d', ms(150)));
+        BOOST_TEST(w.size() == 4);
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(s == "abcd");
+        BOOST_TEST(! early);
+        BOOST_TEST(w.size() == 0);
+        w.stop();
+        w.close();
+    }
+
+    void
+    testCancel()
+    {
+        timer_wheel w(1, ms(1));
+        start(w);
+        int n = 0;
+        wheel_timer t1(w), t2(w);
+        t1.expires_after(ms(5), [&]{ n += 1; });
+        t2.expires_after(ms(5), [&]{ n += 10; });
+        t1.cancel();
+
+        // Rescheduling replaces the handler
+        t2.expires_after(ms(10), [&]{ n += 100; });
+        {
+            wheel_timer t3(w);
+            t3.expires_after(ms(1), [&]{ n += 1000; });
+        }
+        BOOST_TEST(w.size() == 1);
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(n == 100);
+        w.stop();
+        w.close();
+    }
+
+    void
+    testStop()
+    {
+        timer_wheel w(1, ms(1));
+        start(w);
+        bool fired = false;
+        wheel_timer t(w);
+        t.expires_after(std::chrono::seconds(60),
+            [&]{ fired = true; });
+        w.stop();
+        ioc_.run();
+        ioc_.restart();
+        BOOST_TEST(! fired);
+        w.close();
+        t.cancel();
+        BOOST_TEST(w.size() == 0);
+    }
+
+    void
+    run()
+    {
+        testOrder();
+        testCancel();
+        testStop();
+    }
+};
+
+TEST_SUITE(timer_wheel_test, "lounge.server.timer_wheel");
@@ -0,0 +1,56 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+#
+# Distributed under the Boost Software License, Version 1.0. (See accompanying
+# file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#
+# Official repository: https://github.com/vinniefalco/BeastLounge
+#
+
+# Compare the output of bench-micro against a stored baseline.
+#
+# Prints the change in time per operation of every benchmark
+# found in both files, and exits with status 1 if any of them
+# is slower than the baseline by more than the threshold.
+#
+# Usage: bench_compare.py baseline.json current.json [percent]
+
+import json
+import sys
+
+
+def load(path):
+    with open(path) as f:
+        return {b["name"]: b["ns_per_op"] for b in json.load(f)["benchmarks"]}
+
+
+def main(argv):
+    if len(argv) < 3:
+        sys.stderr.write(
+            "Usage: bench_compare.py baseline.json current.json [percent]\n")
+        return 2
+    base = load(argv[1])
+    cur = load(argv[2])
+    threshold = float(argv[3]) if len(argv) > 3 else 10.0
+    slower = 0
+    print("%-40s %12s %12s %8s" % ("name", "baseline", "current", "change"))
+    for name in sorted(cur):
+        if name not in base:
+            print("%-40s %12s %12.1f %8s" % (name, "-", cur[name], "new"))
+            continue
+        change = 100.0 * (cur[name] - base[name]) / base[name]
+        mark = ""
+        if change > threshold:
+            mark = " *"
+            slower += 1
+        print("%-40s %12.1f %12.1f %+7.1f%%%s" % (
+            name, base[name], cur[name], change, mark))
+    if slower:
+        print("%d benchmark(s) slower by more than %g%%" % (slower, threshold))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,61 @@
+#!/usr/bin/env python3
+#
+# Copyright (c) 2018-2019 Vinnie Falco (vinnie dot falco at gmail dot com)
+#
+# Distributed under the Boost Software License, Version 1.0. (See accompanying
+# file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+#
+# Official repository: https://github.com/vinniefalco/BeastLounge
+#
+
+# Convert a flight recorder dump into a Chrome trace.
+#
+# The server writes a dump on SIGUSR1. Load the output in
+# chrome://tracing or https://ui.perfetto.dev. Each server
+# thread is a track, and each event carries its session and
+# channel.
+#
+# Usage: flight_trace.py flight.bin [trace.json]
+
+import json
+import struct
+import sys
+
+MAGIC = b"LNGFR001"
+RECORD = struct.Struct("=QQIHBx")
+EVENTS = ["accept", "handshake", "read", "dispatch",
+          "enqueue", "write", "close"]
+
+
+def convert(data):
+    if data[:len(MAGIC)] != MAGIC:
+        raise ValueError("not a flight recorder dump")
+    events = []
+    for off in range(len(MAGIC), len(data) - RECORD.size + 1, RECORD.size):
+        time, session, cid, thread, event = RECORD.unpack_from(data, off)
+        name = EVENTS[event] if event < len(EVENTS) else str(event)
+        events.append({
+            "name": name,
+            "ph": "i",
+            "s": "t",
+            "ts": time / 1000.0,
+            "pid": 1,
+            "tid": thread,
+            "args": {"session": "0x%x" % session, "cid": cid},
+        })
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main(argv):
+    if len(argv) < 2:
+        sys.stderr.write("Usage: flight_trace.py flight.bin [trace.json]\n")
+        return 1
+    with open(argv[1], "rb") as f:
+        trace = convert(f.read())
+    out = open(argv[2], "w") if len(argv) > 2 else sys.stdout
+    json.dump(trace, out)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))